@@ -73,8 +73,9 @@ flip_ports(uint32_t ports)
 // actual AggregateIPFlows operations
 
 AggregateIPFlows::AggregateIPFlows()
+    : _flow_alloc(sizeof(FlowInfo))
 #if CLICK_USERLEVEL
-    : _traceinfo_file(0), _packet_source(0), _filepos_h(0)
+    , _traceinfo_file(0), _packet_source(0), _filepos_h(0)
 #endif
 {
 }
@@ -143,6 +144,7 @@ AggregateIPFlows::initialize(ErrorHandler *errh)
     else if (_traceinfo_filename && !(_traceinfo_file = fopen(_traceinfo_filename.c_str(), "w")))
 	return errh->error("%s: %s", _traceinfo_filename.c_str(), strerror(errno));
     if (_traceinfo_file) {
+	_flow_alloc.increase_size(sizeof(StatFlowInfo));
 	fprintf(_traceinfo_file, "<?xml version='1.0' standalone='yes'?>\n\
 <trace");
 	if (_packet_source) {
@@ -200,11 +202,11 @@ AggregateIPFlows::delete_flowinfo(const HostPair &hp, FlowInfo *finfo, bool real
 </flow>\n",
 		sinfo->_packets[0], sinfo->_packets[1]);
 	if (really_delete)
-	    delete sinfo;
+	    _flow_alloc.deallocate(sinfo);
     } else
 #endif
 	if (really_delete)
-	    delete finfo;
+	    _flow_alloc.deallocate(finfo);
 }
 
 void
@@ -388,14 +390,17 @@ AggregateIPFlows::find_flow_info(Map &m, HostPairInfo *hpinfo, uint32_t ports, b
 	}
 
     // make and install new FlowInfo pair
+    void *data = _flow_alloc.allocate();
+    if (!data)
+	return 0;
     FlowInfo *finfo;
 #if CLICK_USERLEVEL
     if (stats()) {
-	finfo = new StatFlowInfo(ports, hpinfo->_flows, _next);
+	finfo = new(data) StatFlowInfo(ports, hpinfo->_flows, _next);
 	stat_new_flow_hook(p, finfo);
     } else
 #endif
-	finfo = new FlowInfo(ports, hpinfo->_flows, _next);
+	finfo = new(data) FlowInfo(ports, hpinfo->_flows, _next);
 
     finfo->_reverse = flipped;
     hpinfo->_flows = finfo;
@@ -583,7 +588,24 @@ AggregateIPFlows::pull(int)
     return 0;
 }
 
-enum { H_CLEAR };
+enum { H_CLEAR, H_ALLOCATOR };
+
+String
+AggregateIPFlows::read_handler(Element *e, void *thunk)
+{
+    AggregateIPFlows *af = static_cast<AggregateIPFlows *>(e);
+    switch ((intptr_t)thunk) {
+      case H_ALLOCATOR: {
+	  StringAccum sa;
+	  sa << "objects " << af->_flow_alloc.nallocated()
+	     << " capacity " << af->_flow_alloc.capacity()
+	     << " bytes " << af->_flow_alloc.memory_usage();
+	  return sa.take_string();
+      }
+      default:
+	return String();
+    }
+}
 
 int
 AggregateIPFlows::write_handler(const String &, Element *e, void *thunk, ErrorHandler *)
@@ -606,6 +628,7 @@ void
 AggregateIPFlows::add_handlers()
 {
     add_write_handler("clear", write_handler, (void *)H_CLEAR);
+    add_read_handler("allocator", read_handler, (void *)H_ALLOCATOR);
 }
 
 ELEMENT_REQUIRES(AggregateNotifier)
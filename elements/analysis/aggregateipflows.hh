@@ -4,6 +4,7 @@
 #include <click/element.hh>
 #include <click/ipflowid.hh>
 #include <click/hashtable.hh>
+#include <click/hashallocator.hh>
 #include "aggregatenotifier.hh"
 CLICK_DECLS
 class HandlerCall;
@@ -120,6 +121,12 @@ notifications when new aggregates are created and old ones are deleted.
 Clears all flow information. Future packets will get new aggregate annotation
 values. This may cause packets to be emitted if FRAGMENTS is true.
 
+=h allocator read-only
+
+Returns the number of flows allocated, the number of flows the flow
+allocator's memory can hold, and that memory's size in bytes.  Memory freed
+by expired flows is reused for new flows but not returned to the system.
+
 =e
 
 This configuration counts the number of packets in each flow in a trace, using
@@ -211,6 +218,7 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
     typedef HashTable<HostPair, HostPairInfo> Map;
     Map _tcp_map;
     Map _udp_map;
+    HashAllocator _flow_alloc;	// FlowInfo or StatFlowInfo
 
     uint32_t _next;
     unsigned _active_sec;
@@ -257,6 +265,7 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
     int handle_fragment(Packet *, HostPairInfo *);
     int handle_packet(Packet *);
 
+    static String read_handler(Element *, void *);
     static int write_handler(const String &, Element *, void *, ErrorHandler *);
 
 };
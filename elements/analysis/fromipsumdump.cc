@@ -26,6 +26,7 @@
 #include <click/error.hh>
 #include <click/glue.hh>
 #include <click/straccum.hh>
+#include <click/algorithm.hh>
 #include <clicknet/ip.h>
 #include <clicknet/udp.h>
 #include <clicknet/tcp.h>
@@ -73,8 +74,10 @@ FromIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     bool stop = false, active = true, zero = true, checksum = false, multipacket = false, timing = false, allow_nonexistent = false;
     uint8_t default_proto = IP_PROTO_TCP;
     _sampling_prob = (1 << SAMPLING_SHIFT);
-    String default_contents, default_flowid;
+    String default_contents, default_flowid, fields;
 
+    if (_ff.configure_keywords(conf, this, errh) < 0)
+	return -1;
     if (Args(conf, this, errh)
 	.read_mp("FILENAME", FilenameArg(), _ff.filename())
 	.read("STOP", stop)
@@ -89,6 +92,7 @@ FromIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("DEFAULT_FLOWID", AnyArg(), default_flowid)
 	.read("CONTENTS", AnyArg(), default_contents)
 	.read("FLOWID", AnyArg(), default_flowid)
+	.read("FIELDS", AnyArg(), fields)
 	.read("ALLOW_NONEXISTENT", allow_nonexistent)
 	.complete() < 0)
 	return -1;
@@ -107,7 +111,22 @@ FromIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _allow_nonexistent = allow_nonexistent;
     _have_timing = false;
     _multipacket = multipacket;
-    _have_flowid = _have_aggregate = _binary = false;
+    _have_flowid = _have_aggregate = _binary = _columnar = false;
+    _chunk_left = 0;
+
+    Vector<String> words;
+    cp_spacevec(fields, words);
+    _projection.clear();
+    for (int i = 0; i < words.size(); i++) {
+	String word = cp_unquote(words[i]);
+	if (const IPSummaryDump::FieldReader *f = IPSummaryDump::FieldReader::find(word))
+	    _projection.push_back(f);
+	else
+	    errh->error("unknown content type '%s'", word.c_str());
+    }
+    if (errh->nerrors())
+	return -1;
+
     if (default_contents)
 	bang_data(default_contents, errh);
     if (default_flowid)
@@ -142,6 +161,31 @@ FromIPSummaryDump::read_binary(String &result, ErrorHandler *errh)
     return (textual ? 2 : 1);
 }
 
+int
+FromIPSummaryDump::read_chunk(const String &record, ErrorHandler *errh)
+{
+    assert(_columnar);
+    _chunk_left = 0;
+    if (record.length() < 4)
+	return _ff.error(errh, "columnar chunk too short");
+
+    const uint8_t *s = reinterpret_cast<const uint8_t *>(record.data());
+    uint32_t n = GET4(s);
+    if (n > IPSummaryDump::MAX_CHUNK)
+	return _ff.error(errh, "bad columnar chunk");
+    s += 4;
+    for (Column *c = _columns.begin(); c != _columns.end(); ++c) {
+	s = IPSummaryDump::decode_column(record, s, n, c->width, c->width >= 0 ? &c->data : 0);
+	if (!s)
+	    return _ff.error(errh, "bad columnar chunk");
+	c->pos = reinterpret_cast<const uint8_t *>(c->data.data());
+    }
+    if (s != reinterpret_cast<const uint8_t *>(record.end()))
+	return _ff.error(errh, "bad columnar chunk");
+    _chunk_left = n;
+    return 0;
+}
+
 int
 FromIPSummaryDump::initialize(ErrorHandler *errh)
 {
@@ -233,14 +277,24 @@ FromIPSummaryDump::bang_data(const String &line, ErrorHandler *errh)
 	    f = &IPSummaryDump::null_reader;
 	}
 	_fields.push_back(f);
-	_field_order.push_back(_fields.size() - 1);
+	if (!_projection.size() || find(_projection.begin(), _projection.end(), f) != _projection.end())
+	    _field_order.push_back(_fields.size() - 1);
     }
 
     if (_fields.size() == 0)
 	_ff.error(errh, "no contents specified");
+    else if (_field_order.size() == 0)
+	_ff.warning(errh, "dump contains none of the FIELDS");
 
-    click_qsort(_field_order.begin(), _fields.size(), sizeof(int),
+    click_qsort(_field_order.begin(), _field_order.size(), sizeof(int),
 		sort_fields_compare, this);
+
+    // columnar dumps decode only the columns we use
+    _columns.assign(_fields.size(), Column());
+    for (int *fip = _field_order.begin(); fip != _field_order.end(); ++fip)
+	if (_fields[*fip]->inject)
+	    _columns[*fip].width = IPSummaryDump::column_width(_fields[*fip]->type);
+    _chunk_left = 0;
 }
 
 void
@@ -316,6 +370,19 @@ FromIPSummaryDump::bang_binary(const String &line, ErrorHandler *errh)
     _ff.set_lineno(1);
 }
 
+void
+FromIPSummaryDump::bang_columnar(const String &line, ErrorHandler *errh)
+{
+    Vector<String> words;
+    cp_spacevec(line, words);
+    if (words.size() != 1)
+	_ff.error(errh, "bad !columnar specification");
+    _binary = _columnar = true;
+    _chunk_left = 0;
+    _ff.set_landmark_pattern("%f:record %l");
+    _ff.set_lineno(1);
+}
+
 static void
 set_checksums(WritablePacket *q, click_ip *iph)
 {
@@ -353,11 +420,19 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
     const char *end;
 
     while (1) {
-	if ((binary = _binary)) {
+	if (_columnar && _chunk_left) {
+	    // next packet from the current chunk
+	    binary = true;
+	    data = end = 0;
+	    break;
+	} else if ((binary = _binary)) {
 	    int result = read_binary(line, errh);
 	    if (result <= 0)
 		goto eof;
-	    else
+	    else if (result == 1 && _columnar) {
+		read_chunk(line, errh);
+		continue;
+	    } else
 		binary = (result == 1);
 	} else if (_ff.read_line(line, errh, true) <= 0) {
 	  eof:
@@ -386,6 +461,8 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
 		bang_aggregate(line, errh);
 	    else if (data + 8 <= end && memcmp(data, "!binary", 7) == 0 && isspace((unsigned char) data[7]))
 		bang_binary(line, errh);
+	    else if (data + 10 <= end && memcmp(data, "!columnar", 9) == 0 && isspace((unsigned char) data[9]))
+		bang_columnar(line, errh);
 	    else if (data + 10 <= end && memcmp(data, "!contents", 9) == 0 && isspace((unsigned char) data[9]))
 		bang_data(line, errh);
 	}
@@ -406,7 +483,26 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
     int nfields = 0;
 
     // new code goes here
-    if (_binary) {
+    if (_columnar) {
+	// advance every column we read, even after a field kills the packet
+	--_chunk_left;
+	for (int *fip = _field_order.begin(); fip != _field_order.end(); ++fip) {
+	    Column &c = _columns[*fip];
+	    if (c.width < 0)
+		continue;
+	    const uint8_t *s = c.pos;
+	    c.pos += (c.width == IPSummaryDump::W_VARIABLE ? 1 + s[0] : c.width);
+	    const IPSummaryDump::FieldReader *f = _fields[*fip];
+	    if (!d.p)
+		continue;
+	    d.clear_values();
+	    if (f->inb(d, s, c.pos, f)) {
+		f->inject(d, f);
+		nfields++;
+	    }
+	}
+
+    } else if (_binary) {
 	Vector<const unsigned char *> args;
 	int nbytes;
 	for (const IPSummaryDump::FieldReader * const *fp = _fields.begin(); fp != _fields.end(); ++fp) {
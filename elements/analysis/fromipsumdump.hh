@@ -13,7 +13,7 @@ CLICK_DECLS
 /*
 =c
 
-FromIPSummaryDump(FILENAME [, I<keywords> STOP, TIMING, ACTIVE, ZERO, CHECKSUM, PROTO, MULTIPACKET, SAMPLE, CONTENTS, FLOWID])
+FromIPSummaryDump(FILENAME [, I<keywords> STOP, TIMING, ACTIVE, ZERO, CHECKSUM, PROTO, MULTIPACKET, SAMPLE, CONTENTS, FIELDS, FLOWID])
 
 =s traces
 
@@ -25,8 +25,10 @@ Reads IP packet descriptors from a file produced by ToIPSummaryDump, then
 creates packets containing info from the descriptors and pushes them out the
 output. Optionally stops the driver when there are no more packets.
 
-The file may be compressed with gzip(1) or bzip2(1); FromIPSummaryDump will
-run zcat(1) or bzcat(1) to uncompress it.
+The file may be in ASCII, binary, or columnar format (see ToIPSummaryDump),
+and may be compressed with gzip(1), bzip2(1), or zstd(1).
+FromIPSummaryDump decompresses gzip and zstd files in-process when Click was
+built with zlib or libzstd, and otherwise runs zcat(1), bzcat(1), or zstd(1).
 
 FromIPSummaryDump reads from the file named FILENAME unless FILENAME is a
 single dash 'C<->', in which case it reads from the standard input. It will
@@ -93,6 +95,14 @@ String, containing a space-separated list of content names (see
 ToIPSummaryDump for the possibilities). Defines the default contents of the
 dump.
 
+=item FIELDS
+
+String, containing a space-separated list of content names. If given, then
+FromIPSummaryDump builds packets from only these fields of the dump, and
+ignores the others. In columnar dumps (see ToIPSummaryDump's COLUMNAR), the
+ignored fields are not decoded at all, which makes reading a few fields of a
+wide dump much faster. By default all fields are used.
+
 =item FLOWID
 
 String, containing a space-separated flow ID (source address, source port,
@@ -106,6 +116,11 @@ Boolean.  If true, allow nonexistent and empty files: FromIPSummaryDump will
 successfully initialize even if the input file is nonexistent or empty.
 Defaults to false.
 
+=item DECOMPRESS_PIPE
+
+Boolean.  If true, always decompress compressed files by running an external
+program, rather than in-process.  Defaults to false.
+
 =back
 
 Only available in user-level processes.
@@ -177,6 +192,7 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
 
     Vector<const IPSummaryDump::FieldReader *> _fields;
     Vector<int> _field_order;
+    Vector<const IPSummaryDump::FieldReader *> _projection;
     uint16_t _default_proto;
     uint32_t _sampling_prob;
     IPFlowID _flowid;
@@ -191,6 +207,7 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     bool _have_flowid : 1;
     bool _have_aggregate : 1;
     bool _binary : 1;
+    bool _columnar : 1;
     bool _timing : 1;
     bool _have_timing : 1;
     bool _allow_nonexistent : 1;
@@ -207,7 +224,17 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     int _minor_version;
     IPFlowID _given_flowid;
 
+    struct Column {
+	String data;
+	const uint8_t *pos;
+	int width;		// -1 if the column is not read
+	Column() : pos(0), width(-1) { }
+    };
+    Vector<Column> _columns;
+    uint32_t _chunk_left;
+
     int read_binary(String &, ErrorHandler *);
+    int read_chunk(const String &, ErrorHandler *);
 
     static int sort_fields_compare(const void *, const void *, void *);
     void bang_data(const String &, ErrorHandler *);
@@ -215,6 +242,7 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     void bang_flowid(const String &, ErrorHandler *);
     void bang_aggregate(const String &, ErrorHandler *);
     void bang_binary(const String &, ErrorHandler *);
+    void bang_columnar(const String &, ErrorHandler *);
     void check_defaults();
     bool check_timing(Packet *p);
     Packet *read_packet(ErrorHandler *);
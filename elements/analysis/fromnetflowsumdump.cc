@@ -62,6 +62,8 @@ FromNetFlowSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _multipacket = _timing = false;
     String link = "input";
 
+    if (_ff.configure_keywords(conf, this, errh) < 0)
+	return -1;
     if (Args(conf, this, errh)
 	.read_mp("FILENAME", FilenameArg(), _ff.filename())
 	.read("STOP", stop)
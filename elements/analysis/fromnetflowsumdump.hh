@@ -24,8 +24,10 @@ summary format described below, then creates packets containing info from the
 descriptors and pushes them out the output. Optionally stops the driver when
 there are no more packets.
 
-FILE may be compressed with gzip(1) or bzip2(1); FromNetFlowSummaryDump will
-run zcat(1) or bzcat(1) to uncompress it.
+FILE may be compressed with gzip(1), bzip2(1), or zstd(1).
+FromNetFlowSummaryDump decompresses gzip and zstd files in-process when Click
+was built with zlib or libzstd, and otherwise runs zcat(1), bzcat(1), or
+zstd(1).
 
 Keyword arguments are:
 
@@ -64,6 +66,11 @@ interface numbers are pinned at 255 (or 15, for "both").  Default is "input".
 Boolean.  If true, FromNetDlowSummaryDump tries to maintain the timing of the
 original packet stream.  TIMING is false by default.
 
+=item DECOMPRESS_PIPE
+
+Boolean.  If true, always decompress compressed files by running an external
+program, rather than in-process.  Defaults to false.
+
 =back
 
 Only available in user-level processes.
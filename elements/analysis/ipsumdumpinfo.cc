@@ -24,6 +24,7 @@
 #include <click/packet_anno.hh>
 #include <click/args.hh>
 #include <click/ipflowid.hh>
+#include <click/hashtable.hh>
 #include <clicknet/ip.h>
 #include <clicknet/tcp.h>
 #include <clicknet/udp.h>
@@ -507,6 +508,276 @@ const uint8_t tcp_flag_mapping[256] = {
     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0  // 0xF-
 };
 
+
+// COLUMNAR DUMPS
+
+int column_width(int type)
+{
+    switch (type) {
+      case B_0:
+      case B_1:
+      case B_2:
+      case B_4:
+      case B_6PTR:
+      case B_8:
+      case B_16:
+	return type;
+      case B_4NET:
+	return 4;
+      case B_SPECIAL:
+	return W_VARIABLE;
+      default:
+	return -1;
+    }
+}
+
+static inline uint64_t column_get(const uint8_t *s, int width)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < width; ++i)
+	v = (v << 8) | s[i];
+    return v;
+}
+
+static inline void column_put(uint8_t *s, uint64_t v, int width)
+{
+    for (int i = width - 1; i >= 0; --i, v >>= 8)
+	s[i] = v;
+}
+
+static inline int varint_size(uint64_t v)
+{
+    int n = 1;
+    for (; v >= 0x80; v >>= 7)
+	++n;
+    return n;
+}
+
+static inline void varint_put(StringAccum &sa, uint64_t v)
+{
+    for (; v >= 0x80; v >>= 7)
+	sa << (char) ((v & 0x7F) | 0x80);
+    sa << (char) v;
+}
+
+static inline const uint8_t *varint_get(const uint8_t *s, const uint8_t *end, uint64_t &v)
+{
+    v = 0;
+    for (int shift = 0; s < end && shift < 64; shift += 7, ++s) {
+	v |= (uint64_t) (*s & 0x7F) << shift;
+	if (!(*s & 0x80))
+	    return s + 1;
+    }
+    return 0;
+}
+
+static inline uint64_t zigzag(uint64_t d)
+{
+    return (d << 1) ^ (uint64_t) ((int64_t) d >> 63);
+}
+
+static inline uint64_t unzigzag(uint64_t z)
+{
+    return (z >> 1) ^ -(z & 1);
+}
+
+/** @brief Append a column of @a n values, each @a width bytes, to @a sa.
+ *
+ * The values are encoded with whichever of C_RAW, C_DICT, C_DELTA, and
+ * C_DELTA_TS is smallest.  Fixed-width values are treated as big-endian
+ * numbers.  If @a width is W_VARIABLE, each value is a length byte followed
+ * by that many bytes, and the column is always raw. */
+void encode_column(StringAccum &sa, const uint8_t *values, int n, int width)
+{
+    int lenpos = sa.length();
+    sa.extend(4);
+
+    int codec = C_RAW;
+    size_t raw_size;
+    if (width == W_VARIABLE) {
+	const uint8_t *s = values;
+	for (int i = 0; i < n; ++i)
+	    s += 1 + s[0];
+	raw_size = s - values;
+    } else
+	raw_size = (size_t) n * width;
+
+    uint64_t *v = 0;
+    HashTable<uint64_t, uint32_t> dict;
+    uint64_t scale = 0;
+    if (width >= 1 && width <= 8 && n > 1) {
+	v = new uint64_t[n];
+	size_t best = raw_size;
+	size_t delta_size = 0, ts_size = 0;
+	uint64_t last = 0;
+	bool dict_ok = true;
+	for (int i = 0; i < n; ++i) {
+	    v[i] = column_get(values + i * width, width);
+	    delta_size += varint_size(zigzag(v[i] - last));
+	    last = v[i];
+	    if (dict_ok) {
+		uint32_t next = dict.size();
+		dict.find_insert(v[i], next);
+		dict_ok = (dict.size() <= 65536);
+	    }
+	}
+
+	if (dict_ok) {
+	    int ib = (dict.size() <= 1 ? 0 : (dict.size() <= 256 ? 1 : 2));
+	    size_t dict_size = varint_size(dict.size()) + dict.size() * width + (size_t) n * ib;
+	    if (dict_size < best)
+		codec = C_DICT, best = dict_size;
+	}
+	if (delta_size < best)
+	    codec = C_DELTA, best = delta_size;
+
+	if (width == 8) {
+	    uint32_t maxlo = 0;
+	    for (int i = 0; i < n; ++i)
+		if ((uint32_t) v[i] > maxlo)
+		    maxlo = v[i];
+	    scale = (maxlo < 1000000 ? 1000000 : (maxlo < 1000000000 ? 1000000000 : 0));
+	    if (scale) {
+		ts_size = varint_size(scale);
+		last = 0;
+		for (int i = 0; i < n; ++i) {
+		    uint64_t t = (v[i] >> 32) * scale + (uint32_t) v[i];
+		    ts_size += varint_size(zigzag(t - last));
+		    last = t;
+		}
+		if (ts_size < best)
+		    codec = C_DELTA_TS, best = ts_size;
+	    }
+	}
+    }
+
+    sa << (char) codec << (char) width;
+    if (codec == C_RAW)
+	sa.append((const char *) values, raw_size);
+    else if (codec == C_DICT) {
+	// dictionary values in order of first appearance
+	uint32_t k = dict.size();
+	int ib = (k <= 1 ? 0 : (k <= 256 ? 1 : 2));
+	varint_put(sa, k);
+	uint8_t *d = (uint8_t *) sa.extend(k * width);
+	for (HashTable<uint64_t, uint32_t>::iterator it = dict.begin(); it; ++it)
+	    column_put(d + it.value() * width, it.key(), width);
+	uint8_t *x = (uint8_t *) sa.extend(n * ib);
+	for (int i = 0; i < n && ib; ++i) {
+	    uint32_t idx = dict.get(v[i]);
+	    if (ib == 2)
+		*x++ = idx >> 8;
+	    *x++ = idx;
+	}
+    } else if (codec == C_DELTA) {
+	uint64_t last = 0;
+	for (int i = 0; i < n; ++i) {
+	    varint_put(sa, zigzag(v[i] - last));
+	    last = v[i];
+	}
+    } else {
+	varint_put(sa, scale);
+	uint64_t last = 0;
+	for (int i = 0; i < n; ++i) {
+	    uint64_t t = (v[i] >> 32) * scale + (uint32_t) v[i];
+	    varint_put(sa, zigzag(t - last));
+	    last = t;
+	}
+    }
+    delete[] v;
+
+    uint8_t *lp = (uint8_t *) sa.data() + lenpos;
+    column_put(lp, sa.length() - lenpos - 4, 4);
+}
+
+/** @brief Decode the column starting at @a s in @a chunk.
+ * @param n number of values in the column
+ * @param width expected value width, or W_VARIABLE
+ * @param out if nonnull, set to the column's values, concatenated
+ * @return the end of the column, or null if the column is corrupt
+ *
+ * If @a out is null, the column is skipped without being decoded.  Decoded
+ * values never share memory with @a chunk, which may belong to a file
+ * buffer. */
+const uint8_t *decode_column(const String &chunk, const uint8_t *s, int n,
+			     int width, String *out)
+{
+    const uint8_t *end = (const uint8_t *) chunk.end();
+    if (s + 6 > end || n < 0 || n > MAX_CHUNK)
+	return 0;
+    uint32_t len = column_get(s, 4);
+    if (len < 2 || len > (uint32_t) (end - s - 4))
+	return 0;
+    int codec = s[4];
+    end = s + 4 + len;
+    s += 6;
+    if (!out)
+	return end;
+    if (s[-1] != width || width == 0)
+	return (s[-1] == width && codec == C_RAW ? end : 0);
+
+    if (codec == C_RAW) {
+	const uint8_t *x = s;
+	if (width == W_VARIABLE)
+	    for (int i = 0; i < n; ++i)
+		x += (x < end ? 1 + x[0] : 1);
+	else
+	    x += (size_t) n * width;
+	if (x != end)
+	    return 0;
+	*out = String(s, end);
+	return end;
+    } else if (width > 8 || (codec == C_DELTA_TS && width != 8))
+	return 0;
+
+    StringAccum sa(n * width);
+    uint8_t *o = (uint8_t *) sa.extend(n * width);
+    if (!o)
+	return 0;
+    if (codec == C_DICT) {
+	uint64_t k;
+	if (!(s = varint_get(s, end, k)) || k > 65536
+	    || k * width > (uint64_t) (end - s))
+	    return 0;
+	const uint8_t *d = s;
+	s += k * width;
+	int ib = (k <= 1 ? 0 : (k <= 256 ? 1 : 2));
+	if (s + (size_t) n * ib != end || (k == 0 && n))
+	    return 0;
+	for (int i = 0; i < n; ++i, o += width) {
+	    uint32_t idx = 0;
+	    if (ib == 2)
+		idx = (s[0] << 8) | s[1];
+	    else if (ib == 1)
+		idx = s[0];
+	    s += ib;
+	    if (idx >= k)
+		return 0;
+	    memcpy(o, d + idx * width, width);
+	}
+    } else if (codec == C_DELTA || codec == C_DELTA_TS) {
+	uint64_t scale = 0, last = 0, z;
+	if (codec == C_DELTA_TS
+	    && (!(s = varint_get(s, end, scale)) || scale == 0))
+	    return 0;
+	for (int i = 0; i < n; ++i, o += width) {
+	    if (!(s = varint_get(s, end, z)))
+		return 0;
+	    last += unzigzag(z);
+	    if (codec == C_DELTA)
+		column_put(o, last, width);
+	    else
+		column_put(o, ((last / scale) << 32) | (last % scale), 8);
+	}
+	if (s != end)
+	    return 0;
+    } else
+	return 0;
+
+    *out = sa.take_string();
+    return end;
+}
+
 }
 
 ELEMENT_REQUIRES(userlevel)
@@ -207,6 +207,19 @@ void unparse_tcp_opt(StringAccum&, const click_tcp*, int mask);
 void unparse_tcp_opt_binary(StringAccum&, const uint8_t*, int olen, int mask);
 void unparse_tcp_opt_binary(StringAccum&, const click_tcp*, int mask);
 
+// columnar dumps: each column is a length word, a codec, a value width, and
+// the codec's data
+enum { C_RAW = 0,		// values concatenated
+       C_DICT = 1,		// dictionary of distinct values, then indexes
+       C_DELTA = 2,		// varint differences between values
+       C_DELTA_TS = 3 };	// varint differences between sec*scale+subsec
+enum { W_VARIABLE = 255 };	// values are a length byte plus data
+enum { MAX_CHUNK = 1048576 };	// most packets in a chunk
+int column_width(int type);
+void encode_column(StringAccum &sa, const uint8_t *values, int n, int width);
+const uint8_t *decode_column(const String &chunk, const uint8_t *s, int n,
+			     int width, String *out);
+
 inline PacketDesc::PacketDesc(const Element *e_, Packet* p_, StringAccum* sa_, StringAccum* bad_sa_, bool careful_trunc_, bool force_extra_length_)
     : p(p_), iph(0), udph(0), tcph(0), tailpad(0), sa(sa_), bad_sa(bad_sa_),
       careful_trunc(careful_trunc_), force_extra_length(force_extra_length_),
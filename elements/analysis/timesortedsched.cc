@@ -24,12 +24,14 @@
 #include <click/args.hh>
 #include <click/router.hh>
 #include <click/heap.hh>
+#include <click/straccum.hh>
 CLICK_DECLS
 
 TimeSortedSched::TimeSortedSched()
     : _pkt(0), _npkt(0), _input(0), _nready(0),
       _notifier(Notifier::SEARCH_CONTINUE_WAKE), _buffer(1),
-      _well_ordered(true)
+      _well_ordered(true), _count(0), _byte_count(0),
+      _sample_count(0), _sample_byte_count(0)
 {
 }
 
@@ -86,10 +88,18 @@ TimeSortedSched::cleanup(CleanupStage)
     delete[] _input;
 }
 
+inline void
+TimeSortedSched::sample()
+{
+    _sample_time = Timestamp::now_steady();
+    _sample_count = _count;
+    _sample_byte_count = _byte_count;
+}
+
 Packet*
 TimeSortedSched::pull(int)
 {
-    bool signals_on = false;
+    bool signals_on = false, starved = false;
     // first maybe fill in buffer
     for (int rpos = _nready - 1; rpos >= 0; --rpos) {
 	int i = _input[rpos].ready;
@@ -107,38 +117,83 @@ TimeSortedSched::pull(int)
 		    break;
 		}
 	    }
+	    // An input that is still awake but has nothing buffered (say, a
+	    // prefetching FromDump whose decoding thread fell behind) may yet
+	    // deliver the earliest packet, so don't emit until it does.
+	    if (is.space == _buffer && is.signal)
+		starved = true;
 	}
     }
 
     // then maybe emit a packet
     _notifier.set_active(_npkt > 0 || signals_on);
-    if (_npkt > 0) {
+    if (_npkt > 0 && !starved) {
 	Packet *p = _pkt[0].p;
 	if (p->timestamp_anno()) {
 	    if (_last_emission && p->timestamp_anno() < _last_emission)
 		_well_ordered = false;
 	    _last_emission = p->timestamp_anno();
 	}
-	input_s &is = _input[_pkt[0].input];
-	++is.space;
-	if (is.space == 1) {
-	    _input[_nready].ready = _pkt[0].input;
-	    ++_nready;
+
+	// Refill from the same input in place, which needs one sift rather
+	// than a pop and a push.
+	int i = _pkt[0].input;
+	input_s &is = _input[i];
+	Packet *q;
+	if (is.signal && (q = input(i).pull())) {
+	    _pkt[0].p = q;
+	    change_heap(_pkt, _pkt + _npkt, _pkt, heap_less());
+	} else {
+	    ++is.space;
+	    if (is.space == 1) {
+		_input[_nready].ready = i;
+		++_nready;
+	    }
+	    pop_heap(_pkt, _pkt + _npkt, heap_less());
+	    --_npkt;
 	}
-	pop_heap(_pkt, _pkt + _npkt, heap_less());
-	--_npkt;
+
+	++_count;
+	_byte_count += p->length();
+	if (_count == 1)
+	    _first_emission = Timestamp::now_steady();
+	else if ((_count & 63) == 0)
+	    sample();
 	return p;
     } else {
+	if (_sample_count != _count)
+	    sample();
 	if (_stop && !signals_on)
 	    router()->please_stop_driver();
 	return 0;
     }
 }
 
+String
+TimeSortedSched::read_handler(Element *e, void *)
+{
+    TimeSortedSched *tss = static_cast<TimeSortedSched *>(e);
+    counter_t usec = (tss->_sample_time - tss->_first_emission).usecval();
+    StringAccum sa;
+    if (tss->_sample_count < 2 || usec == 0)
+	sa << "0 0.000";
+    else {
+	// bytes per microsecond are megabytes per second
+	counter_t mbps1000 = tss->_sample_byte_count * 1000 / usec;
+	sa << (tss->_sample_count - 1) * 1000000 / usec << ' '
+	   << mbps1000 / 1000 << '.';
+	sa.snprintf(4, "%03u", (unsigned) (mbps1000 % 1000));
+    }
+    return sa.take_string();
+}
+
 void
 TimeSortedSched::add_handlers()
 {
     add_data_handlers("well_ordered", Handler::OP_READ | Handler::CHECKBOX, &_well_ordered);
+    add_data_handlers("count", Handler::OP_READ, &_count);
+    add_data_handlers("byte_count", Handler::OP_READ, &_byte_count);
+    add_read_handler("rate", read_handler);
 }
 
 CLICK_ENDDECLS
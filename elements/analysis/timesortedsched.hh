@@ -29,7 +29,15 @@ packet streams did not arrive correctly sorted by timestamp, so
 TimeSortedSched emitted some packets out of order.  (But see BUFFER, below.)
 
 TimeSortedSched listens for notification from its inputs to avoid useless
-pulls, and provides notification for its output.
+pulls, and provides notification for its output.  An input whose notifier is
+active but that has no packet available holds back output until it delivers
+a packet or its notifier goes to sleep, since its next packet might be the
+earliest.
+
+TimeSortedSched keeps its buffered packets in a heap, so choosing the next
+packet costs O(log I<n>) for I<n> inputs.  When merging many traces, give each
+FromDump a PREFETCH buffer so that files are read and decoded in parallel on
+separate threads.
 
 Keyword arguments are:
 
@@ -66,12 +74,32 @@ stream, and stops the driver when all the files are exhausted.
   // ...
   tss -> ...;
 
+This variant decodes each file on its own thread:
+
+  tss :: TimeSortedSched(STOP true);
+  FromDump(FILE1, PREFETCH 4096) -> [0] tss;
+  FromDump(FILE2, PREFETCH 4096) -> [1] tss;
+  // ...
+
 =h well_ordered r
 
 Returns a Boolean string. If "false", then TimeSortedSched's output was not
 properly sorted by increasing timestamp, because one or more of its input
 streams was not so sorted.
 
+=h count r
+
+Returns the number of packets emitted.
+
+=h byte_count r
+
+Returns the number of bytes emitted.
+
+=h rate r
+
+Returns the average output rate, measured from the first packet emitted, as
+two space-separated numbers: packets per second and megabytes per second.
+
 =a
 
 FromDump
@@ -97,6 +125,12 @@ class TimeSortedSched : public Element { public:
 
   private:
 
+#if HAVE_INT64_TYPES
+    typedef uint64_t counter_t;
+#else
+    typedef uint32_t counter_t;
+#endif
+
     struct packet_s {
 	Packet *p;
 	int input;		// for space, consider using annotation?
@@ -124,6 +158,17 @@ class TimeSortedSched : public Element { public:
     bool _stop;
     bool _well_ordered;
 
+    // throughput, sampled every 64 packets and when the inputs run dry
+    counter_t _count;
+    counter_t _byte_count;
+    Timestamp _first_emission;
+    Timestamp _sample_time;
+    counter_t _sample_count;
+    counter_t _sample_byte_count;
+
+    inline void sample();
+    static String read_handler(Element *, void *);
+
 };
 
 CLICK_ENDDECLS
@@ -31,12 +31,13 @@
 CLICK_DECLS
 
 ToIPSummaryDump::ToIPSummaryDump()
-    : _f(0), _task(this)
+    : _f(0), _task(this), _chunk_count(0), _columns(0)
 {
 }
 
 ToIPSummaryDump::~ToIPSummaryDump()
 {
+    delete[] _columns;
 }
 
 int
@@ -48,8 +49,10 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     bool careful_trunc = true;
     bool multipacket = false;
     bool binary = false;
+    bool columnar = false;
     bool header = true;
     bool extra_length = true;
+    _chunk_size = 4096;
 
     if (Args(conf, this, errh)
 	.read_mp("FILENAME", FilenameArg(), _filename)
@@ -63,6 +66,8 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("CAREFUL_TRUNC", careful_trunc)
 	.read("EXTRA_LENGTH", extra_length)
 	.read("BINARY", binary)
+	.read("COLUMNAR", columnar)
+	.read("CHUNK", BoundedIntArg(1, (int) IPSummaryDump::MAX_CHUNK), _chunk_size)
 	.complete() < 0)
 	return -1;
 
@@ -92,6 +97,8 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	int s = f->binary_size();
 	if ((s < 0 || !f->outb) && binary)
 	    errh->error("cannot use CONTENTS %s with BINARY", word.c_str());
+	else if ((IPSummaryDump::column_width(f->type) < 0 || !f->outb) && columnar)
+	    errh->error("cannot use CONTENTS %s with COLUMNAR", word.c_str());
 	_binary_size += s;
 
 	// remove _multipacket if packet count specified
@@ -105,7 +112,8 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _bad_packets = bad_packets;
     _careful_trunc = careful_trunc;
     _multipacket = multipacket;
-    _binary = binary;
+    _binary = binary || columnar;
+    _columnar = columnar;
     _header = header;
     _extra_length = extra_length;
 
@@ -131,6 +139,12 @@ ToIPSummaryDump::initialize(ErrorHandler *errh)
     }
     _active = true;
     _output_count = 0;
+    if (_columnar) {
+	delete[] _columns;
+	_columns = new StringAccum[_fields.size()];
+	_offsets.resize(_fields.size() + 1);
+	_chunk_count = 0;
+    }
 
     // magic number
     StringAccum sa;
@@ -161,7 +175,9 @@ ToIPSummaryDump::initialize(ErrorHandler *errh)
     sa << '\n';
 
     // binary marker
-    if (_binary)
+    if (_columnar)
+	sa << "!columnar\n";
+    else if (_binary)
 	sa << "!binary\n";
 
     // print output
@@ -174,13 +190,15 @@ ToIPSummaryDump::initialize(ErrorHandler *errh)
 void
 ToIPSummaryDump::cleanup(CleanupStage)
 {
+    if (_f && _columnar)
+	write_chunk();
     if (_f && _f != stdout)
 	fclose(_f);
     _f = 0;
 }
 
 bool
-ToIPSummaryDump::summary(Packet* p, StringAccum& sa, StringAccum* bad_sa) const
+ToIPSummaryDump::summary(Packet* p, StringAccum& sa, StringAccum* bad_sa, int* offsets) const
 {
     IPSummaryDump::PacketDesc d(this, p, &sa, bad_sa, _careful_trunc, _extra_length);
 
@@ -190,10 +208,14 @@ ToIPSummaryDump::summary(Packet* p, StringAccum& sa, StringAccum* bad_sa) const
     if (_binary) {
 	sa.extend(4);
 	for (int i = 0; i < _fields.size(); i++) {
+	    if (offsets)
+		offsets[i] = sa.length();
 	    d.clear_values();
 	    bool ok = _fields[i]->extract(d, _fields[i]);
 	    _fields[i]->outb(d, ok, _fields[i]);
 	}
+	if (offsets)
+	    offsets[_fields.size()] = sa.length();
 	*(reinterpret_cast<uint32_t*>(sa.data())) = htonl(sa.length());
     } else {
 	for (int i = 0; i < _fields.size(); i++) {
@@ -247,16 +269,42 @@ ToIPSummaryDump::write_packet(Packet* p, int multipacket)
 	_sa.clear();
 	_bad_sa.clear();
 
-	summary(p, _sa, (_bad_packets ? &_bad_sa : 0));
+	summary(p, _sa, (_bad_packets ? &_bad_sa : 0),
+		(_columnar ? _offsets.begin() : 0));
 
 	if (_bad_packets && _bad_sa)
 	    write_line(_bad_sa.take_string());
-	ignore_result(fwrite(_sa.data(), 1, _sa.length(), _f));
+	if (_columnar) {
+	    // append each field to its column
+	    for (int i = 0; i < _fields.size(); i++)
+		_columns[i].append(_sa.data() + _offsets[i], _offsets[i+1] - _offsets[i]);
+	    if (++_chunk_count >= _chunk_size)
+		write_chunk();
+	} else
+	    ignore_result(fwrite(_sa.data(), 1, _sa.length(), _f));
 
 	_output_count++;
     }
 }
 
+void
+ToIPSummaryDump::write_chunk()
+{
+    if (!_chunk_count)
+	return;
+    StringAccum sa;
+    sa.extend(8);
+    for (int i = 0; i < _fields.size(); i++) {
+	IPSummaryDump::encode_column(sa, reinterpret_cast<const uint8_t *>(_columns[i].data()), _chunk_count, IPSummaryDump::column_width(_fields[i]->type));
+	_columns[i].clear();
+    }
+    uint32_t *hdr = reinterpret_cast<uint32_t *>(sa.data());
+    hdr[0] = htonl(sa.length());
+    hdr[1] = htonl(_chunk_count);
+    ignore_result(fwrite(sa.data(), 1, sa.length(), _f));
+    _chunk_count = 0;
+}
+
 void
 ToIPSummaryDump::push(int, Packet *p)
 {
@@ -287,8 +335,10 @@ ToIPSummaryDump::write_line(const String& s)
 {
     if (s.length()) {
 	assert(s.back() == '\n');
+	if (_columnar)
+	    write_chunk();
 	if (_binary) {
-	    uint32_t marker = htonl(s.length() | 0x80000000U);
+	    uint32_t marker = htonl((s.length() + 4) | 0x80000000U);
 	    ignore_result(fwrite(&marker, 4, 1, _f));
 	}
 	ignore_result(fwrite(s.data(), 1, s.length(), _f));
@@ -300,8 +350,10 @@ ToIPSummaryDump::add_note(const String &s)
 {
     if (s.length()) {
 	int extra = 1 + (s.back() == '\n' ? 0 : 1);
+	if (_columnar)
+	    write_chunk();
 	if (_binary) {
-	    uint32_t marker = htonl((s.length() + extra) | 0x80000000U);
+	    uint32_t marker = htonl((s.length() + extra + 4) | 0x80000000U);
 	    ignore_result(fwrite(&marker, 4, 1, _f));
 	}
 	fputc('#', _f);
@@ -315,8 +367,11 @@ int
 ToIPSummaryDump::flush_handler(const String &, Element *e, void *, ErrorHandler *)
 {
     ToIPSummaryDump *tod = (ToIPSummaryDump *) e;
-    if (tod->_f)
+    if (tod->_f) {
+	if (tod->_columnar)
+	    tod->write_chunk();
 	fflush(tod->_f);
+    }
     return 0;
 }
 
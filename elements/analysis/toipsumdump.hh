@@ -23,7 +23,8 @@ Writes summary information about incoming packets to FILENAME in a simple
 ASCII format---each line corresponds to a packet.  The CONTENTS keyword
 argument determines what information is written.  Writes to standard output if
 FILENAME is a single dash `C<->'.  The BINARY keyword argument writes a packed
-binary format to save space.
+binary format to save space, and the COLUMNAR keyword argument writes a
+compressed binary format that stores each field separately.
 
 ToIPSummaryDump uses packets' extra-length and extra-packet-count annotations.
 
@@ -137,6 +138,21 @@ of the dump. Ignored if HEADER is false.
 Boolean. If true, then output packet records in a binary format (explained
 below). Defaults to false.
 
+=item COLUMNAR
+
+Boolean. If true, then output packets in chunks, each of which stores the
+values of one field for many packets together (see COLUMNAR FORMAT below).
+Columnar dumps are smaller than binary dumps, and FromIPSummaryDump can read
+selected fields from them without decoding the rest. COLUMNAR accepts the
+same CONTENTS as BINARY. Defaults to false.
+
+=item CHUNK
+
+Integer between 1 and 1048576. In a columnar dump, the number of packets
+stored in each chunk. ToIPSummaryDump writes a partial chunk before any
+metadata line, when flushed, and at the end of the dump, so dumps with many
+'C<!bad>' lines compress poorly. Defaults to 4096.
+
 =item MULTIPACKET
 
 Boolean. If true, and the CONTENTS option doesn't contain 'C<count>', then
@@ -338,9 +354,47 @@ The data stored in a metadata record is just an ASCII string, ending with
 newline, same as in a regular ASCII IPSummaryDump file. 'C<!bad>' records, for
 example, are stored this way.
 
+=head1 COLUMNAR FORMAT
+
+Columnar IPSummaryDump files begin with ASCII lines, like binary files, but
+their marker line is 'C<!columnar>'. The rest of the file consists of records
+framed as in the binary format. Metadata records are unchanged; each regular
+record is a chunk holding several packets:
+
+   +---------------+---------------+---------...---------...
+   |0|record length| packet count  | column 1 | column 2 ...
+   +---------------+---------------+---------...---------...
+
+There is one column per field in the 'C<!data>' line, in order. Each column
+holds that field's values for every packet in the chunk, using the binary
+representation from the table above:
+
+   +---------------+-----+-----+------------...
+   | column length |codec|width|    data
+   +---------------+-----+-----+------------...
+
+The column length counts the bytes after the length word. Width is the
+field's binary length, or 255 for variable-length fields. Fixed-width values
+are treated as big-endian numbers by these codecs:
+
+   Codec  Name      Data
+   0      raw       The values, concatenated.
+   1      dict      A varint count K, K distinct values, then
+                    each packet's index into them (0 bytes if
+                    K is 1, 1 byte if K <= 256, otherwise 2).
+   2      delta     Each value's difference from the previous
+                    value (the first from 0), as a zigzag varint.
+   3      delta_ts  A varint SCALE, then differences of
+                    sec*SCALE+subsec as zigzag varints.
+                    Width 8 only.
+
+Varints store 7 bits per byte, least significant group first, with the high
+bit set on all bytes but the last. ToIPSummaryDump chooses the smallest codec
+for each column; variable-length fields are always raw.
+
 =h flush write-only
 
-Flush all internal buffers to disk.
+Flush all internal buffers, including any partial chunk, to disk.
 
 =a
 
@@ -383,6 +437,7 @@ class ToIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     bool _binary : 1;
     bool _header : 1;
     bool _extra_length : 1;
+    bool _columnar : 1;
     int32_t _binary_size;
     uint32_t _output_count;
     Task _task;
@@ -391,10 +446,16 @@ class ToIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     StringAccum _sa;
     StringAccum _bad_sa;
 
+    int _chunk_size;
+    int _chunk_count;
+    StringAccum *_columns;
+    Vector<int> _offsets;
+
     String _banner;
 
-    bool summary(Packet* p, StringAccum& sa, StringAccum* bad_sa) const;
+    bool summary(Packet* p, StringAccum& sa, StringAccum* bad_sa, int* offsets = 0) const;
     void write_packet(Packet* p, int multipacket);
+    void write_chunk();
     static int flush_handler(const String &, Element *, void *, ErrorHandler *);
 
 };
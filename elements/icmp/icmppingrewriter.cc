@@ -71,6 +71,7 @@ ICMPPingRewriter::ICMPPingFlow::unparse(StringAccum &sa, bool direction,
 
 ICMPPingRewriter::ICMPPingRewriter()
 {
+    _flow_size = sizeof(ICMPPingFlow);
 }
 
 ICMPPingRewriter::~ICMPPingRewriter()
@@ -103,7 +104,13 @@ ICMPPingRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
 	return -1;
 
     _annos = (dst_anno ? 1 : 0) + (has_reply_anno ? 2 + (reply_anno << 2) : 0);
-    return IPRewriterBase::configure(conf, errh);
+    if (IPRewriterBase::configure(conf, errh) < 0)
+	return -1;
+    // An echo flow's reply key derives its ports from the rewritten
+    // identifier, so patterns cannot keep it in the request's shard.
+    if (_nshards > 1)
+	return errh->error("SHARDS not supported");
+    return 0;
 }
 
 IPRewriterEntry *
@@ -114,7 +121,9 @@ ICMPPingRewriter::get_entry(int ip_p, const IPFlowID &xflowid, int input)
     bool echo = (input != get_entry_reply);
     IPFlowID flowid(xflowid.saddr(), xflowid.sport() + !echo,
 		    xflowid.daddr(), xflowid.sport() + echo);
-    IPRewriterEntry *m = _map.get(flowid);
+    Shard &sh = shard(flowid);
+    lock(sh);
+    IPRewriterEntry *m = sh.map.get(flowid);
     if (!m && (unsigned) input < (unsigned) _input_specs.size()) {
 	IPRewriterInput &is = _input_specs[input];
 	IPFlowID rewritten_flowid = IPFlowID::uninitialized_t();
@@ -123,6 +132,7 @@ ICMPPingRewriter::get_entry(int ip_p, const IPFlowID &xflowid, int input)
 	    m = ICMPPingRewriter::add_flow(IP_PROTO_ICMP, flowid, rewritten_flowid, input);
 	}
     }
+    unlock(sh);
     return m;
 }
 
@@ -130,17 +140,34 @@ IPRewriterEntry *
 ICMPPingRewriter::add_flow(int, const IPFlowID &flowid,
 			   const IPFlowID &rewritten_flowid, int input)
 {
+    Shard &sh = shard(flowid);
     void *data;
     if ((uint16_t) (flowid.sport() + 1) != flowid.dport()
 	|| (uint16_t) (rewritten_flowid.sport() + 1) != rewritten_flowid.dport()
-	|| !(data = _allocator.allocate()))
+	|| !(data = sh.allocator.allocate()))
 	return 0;
 
     ICMPPingFlow *flow = new(data) ICMPPingFlow
 	(&_input_specs[input], flowid, rewritten_flowid,
 	 !!_timeouts[1], click_jiffies() + relevant_timeout(_timeouts));
 
-    return store_flow(flow, input, _map);
+    return store_flow(flow, input, sh.map);
+}
+
+IPRewriterBase::Map *
+ICMPPingRewriter::batch_flowid(Packet *p, IPFlowID &flowid)
+{
+    const click_ip *iph = p->ip_header();
+    const click_icmp_echo *icmph = reinterpret_cast<const click_icmp_echo *>(p->icmp_header());
+    if (iph->ip_p != IP_PROTO_ICMP
+	|| !IP_FIRSTFRAG(iph)
+	|| p->transport_length() < 6
+	|| (icmph->icmp_type != ICMP_ECHO && icmph->icmp_type != ICMP_ECHOREPLY))
+	return 0;
+    bool echo = icmph->icmp_type == ICMP_ECHO;
+    flowid = IPFlowID(iph->ip_src, icmph->icmp_identifier + !echo,
+		      iph->ip_dst, icmph->icmp_identifier + echo);
+    return &shard(flowid).map;
 }
 
 void
@@ -168,11 +195,14 @@ ICMPPingRewriter::push(int port, Packet *p_in)
     IPFlowID flowid(iph->ip_src, icmph->icmp_identifier + !echo,
 		    iph->ip_dst, icmph->icmp_identifier + echo);
 
-    IPRewriterEntry *m = _map.get(flowid);
+    Shard &sh = shard(flowid);
+    lock(sh);
+    IPRewriterEntry *m = sh.map.get(flowid);
 
-    if (!m && !echo)
+    if (!m && !echo) {
+	unlock(sh);
 	goto mapping_fail;
-    else if (!m) {		// create new mapping
+    } else if (!m) {		// create new mapping
 	IPRewriterInput &is = _input_specs.at_u(port);
 	IPFlowID rewritten_flowid = IPFlowID::uninitialized_t();
 	int result = is.rewrite_flowid(flowid, rewritten_flowid, p);
@@ -181,6 +211,7 @@ ICMPPingRewriter::push(int port, Packet *p_in)
 	    m = ICMPPingRewriter::add_flow(IP_PROTO_ICMP, flowid, rewritten_flowid, port);
 	}
 	if (!m) {
+	    unlock(sh);
 	    checked_output_push(result, p);
 	    return;
 	} else if (_annos & 2)
@@ -189,9 +220,11 @@ ICMPPingRewriter::push(int port, Packet *p_in)
 
     ICMPPingFlow *mf = static_cast<ICMPPingFlow *>(m->flow());
     mf->apply(p, m->direction(), _annos);
-    mf->change_expiry_by_timeout(_heap, click_jiffies(), _timeouts);
+    mf->change_expiry_by_timeout(sh.heap, click_jiffies(), _timeouts);
 
-    output(m->output()).push(p);
+    int output_port = m->output();
+    unlock(sh);
+    output(output_port).push(p);
 }
 
 
@@ -201,10 +234,15 @@ ICMPPingRewriter::dump_mappings_handler(Element *e, void *)
     ICMPPingRewriter *rw = (ICMPPingRewriter *)e;
     StringAccum sa;
     click_jiffies_t now = click_jiffies();
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); ++iter) {
-	ICMPPingFlow *f = static_cast<ICMPPingFlow *>(iter->flow());
-	f->unparse(sa, iter->direction(), now);
-	sa << '\n';
+    for (int s = 0; s < rw->_nshards; ++s) {
+	Shard &sh = rw->_shards[s];
+	rw->lock(sh);
+	for (Map::iterator iter = sh.map.begin(); iter.live(); ++iter) {
+	    ICMPPingFlow *f = static_cast<ICMPPingFlow *>(iter->flow());
+	    f->unparse(sa, iter->direction(), now);
+	    sa << '\n';
+	}
+	rw->unlock(sh);
     }
     return sa.take_string();
 }
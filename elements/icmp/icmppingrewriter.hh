@@ -116,9 +116,10 @@ class ICMPPingRewriter : public IPRewriterBase { public:
 
   private:
 
-    SizedHashAllocator<sizeof(ICMPPingFlow)> _allocator;
     unsigned _annos;
 
+    Map *batch_flowid(Packet *p, IPFlowID &flowid);
+
     static String dump_mappings_handler(Element *, void *);
 
 };
@@ -127,9 +128,10 @@ class ICMPPingRewriter : public IPRewriterBase { public:
 inline void
 ICMPPingRewriter::destroy_flow(IPRewriterFlow *flow)
 {
-    unmap_flow(flow, _map);
+    Shard &sh = shard(flow);
+    unmap_flow(flow, sh.map);
     static_cast<ICMPPingFlow *>(flow)->~ICMPPingFlow();
-    _allocator.deallocate(flow);
+    sh.allocator.deallocate(flow);
 }
 
 CLICK_ENDDECLS
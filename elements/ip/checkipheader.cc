@@ -225,6 +225,27 @@ CheckIPHeader::simple_action(Packet *p)
   return(p);
 }
 
+void
+CheckIPHeader::push_batch(int, PacketBatch &batch)
+{
+  PacketBatch out;
+  while (Packet *p = batch.pop_front())
+    if ((p = simple_action(p)))
+      out.push_back(p);
+  if (!out.empty())
+    output(0).push_batch(out);
+}
+
+void
+CheckIPHeader::pull_batch(int, unsigned max, PacketBatch &batch)
+{
+  PacketBatch in;
+  input(0).pull_batch(max, in);
+  while (Packet *p = in.pop_front())
+    if ((p = simple_action(p)))
+      batch.push_back(p);
+}
+
 String
 CheckIPHeader::read_handler(Element *e, void *)
 {
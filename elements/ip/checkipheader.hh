@@ -112,12 +112,14 @@ class CheckIPHeader : public Element { public:
   const char *class_name() const		{ return "CheckIPHeader"; }
   const char *port_count() const		{ return PORTS_1_1X2; }
   const char *processing() const		{ return PROCESSING_A_AH; }
-  const char *flags() const			{ return "A"; }
+  const char *flags() const			{ return "A B"; }
 
   int configure(Vector<String> &, ErrorHandler *);
   void add_handlers();
 
   Packet *simple_action(Packet *);
+  void push_batch(int port, PacketBatch &batch);
+  void pull_batch(int port, unsigned max, PacketBatch &batch);
 
   struct OldBadSrcArg {
       static bool parse(const String &str, Vector<IPAddress> &result,
@@ -76,6 +76,27 @@ DecIPTTL::simple_action(Packet *p)
     }
 }
 
+void
+DecIPTTL::push_batch(int, PacketBatch &batch)
+{
+    PacketBatch out;
+    while (Packet *p = batch.pop_front())
+	if ((p = DecIPTTL::simple_action(p)))
+	    out.push_back(p);
+    if (!out.empty())
+	output(0).push_batch(out);
+}
+
+void
+DecIPTTL::pull_batch(int, unsigned max, PacketBatch &batch)
+{
+    PacketBatch in;
+    input(0).pull_batch(max, in);
+    while (Packet *p = in.pop_front())
+	if ((p = DecIPTTL::simple_action(p)))
+	    batch.push_back(p);
+}
+
 void
 DecIPTTL::add_handlers()
 {
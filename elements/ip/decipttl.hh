@@ -50,11 +50,14 @@ class DecIPTTL : public Element { public:
     const char *class_name() const		{ return "DecIPTTL"; }
     const char *port_count() const		{ return PORTS_1_1X2; }
     const char *processing() const		{ return PROCESSING_A_AH; }
+    const char *flags() const			{ return "B"; }
 
     int configure(Vector<String> &conf, ErrorHandler *errh);
     void add_handlers();
 
     Packet *simple_action(Packet *);
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, unsigned max, PacketBatch &batch);
 
   private:
 
@@ -41,7 +41,51 @@ DirectIPLookup::Table::initialize()
     _tbl_24_31_capacity = 4096;
     _vport_capacity = 1024;
     _rtable_capacity = 2048;
+    return alloc();
+}
+
+/* Make this empty table a copy of x, growing the secondary table and the
+   virtual port array if x has no room left in them. */
+int
+DirectIPLookup::Table::initialize(const Table &x)
+{
+    assert(!_tbl_0_23 && !_tbl_24_31 && !_vport && !_rtable && !_rt_hashtbl
+	   && !_tbl_0_23_plen && !_tbl_24_31_plen);
+
+    _tbl_24_31_capacity = x._tbl_24_31_capacity;
+    if ((x._tbl_24_31_empty_head & 0x8000)
+	&& x._tbl_24_31_size == x._tbl_24_31_capacity
+	&& _tbl_24_31_capacity < tbl_24_31_capacity_limit)
+	_tbl_24_31_capacity *= 2;
+    _vport_capacity = x._vport_capacity;
+    if (x._vport_empty_head < 0 && x._vport_size == x._vport_capacity
+	&& _vport_capacity < vport_capacity_limit)
+	_vport_capacity *= 2;
+    _rtable_capacity = x._rtable_capacity;
+    int r = alloc();
+    if (r < 0)
+	return r;
 
+    memcpy(_tbl_0_23, x._tbl_0_23, (sizeof(uint16_t) + sizeof(uint8_t)) * (1 << 24));
+    memcpy(_tbl_24_31, x._tbl_24_31, sizeof(uint16_t) * x._tbl_24_31_size);
+    memcpy(_tbl_24_31_plen, x._tbl_24_31_plen, sizeof(uint8_t) * x._tbl_24_31_size);
+    memcpy(_vport, x._vport, sizeof(VirtualPort) * x._vport_size);
+    memcpy(_rtable, x._rtable, sizeof(CleartextEntry) * x._rtable_size);
+    memcpy(_rt_hashtbl, x._rt_hashtbl, sizeof(int) * PREF_HASHSIZE);
+    _rtable_size = x._rtable_size;
+    _tbl_24_31_size = x._tbl_24_31_size;
+    _vport_size = x._vport_size;
+    _rt_empty_head = x._rt_empty_head;
+    _tbl_24_31_empty_head = x._tbl_24_31_empty_head;
+    _vport_head = x._vport_head;
+    _vport_empty_head = x._vport_empty_head;
+    _rcu = x._rcu;
+    return 0;
+}
+
+int
+DirectIPLookup::Table::alloc()
+{
     if ((_tbl_0_23 = (uint16_t *) CLICK_LALLOC((sizeof(uint16_t) + sizeof(uint8_t)) * (1 << 24)))
 	&& (_tbl_24_31 = (uint16_t *) CLICK_LALLOC((sizeof(uint16_t) + sizeof(uint8_t)) * _tbl_24_31_capacity))
 	&& (_vport = (VirtualPort *) CLICK_LALLOC(sizeof(VirtualPort) * _vport_capacity))
@@ -69,6 +113,18 @@ DirectIPLookup::Table::cleanup()
     _rt_hashtbl = 0;
 }
 
+/* Return true if adding a route might have to grow the secondary table or
+   the virtual port array in place. */
+bool
+DirectIPLookup::Table::must_grow() const
+{
+    return ((_tbl_24_31_empty_head & 0x8000)
+	    && _tbl_24_31_size == _tbl_24_31_capacity
+	    && _tbl_24_31_capacity < tbl_24_31_capacity_limit)
+	|| (_vport_empty_head < 0 && _vport_size == _vport_capacity
+	    && _vport_capacity < vport_capacity_limit);
+}
+
 
 inline uint32_t
 DirectIPLookup::Table::prefix_hash(uint32_t prefix, uint32_t len)
@@ -132,8 +188,10 @@ DirectIPLookup::Table::dump() const
 int
 DirectIPLookup::Table::vport_find(IPAddress gw, int16_t port)
 {
+    // _vport[0] belongs to the default route, whose removal discards it, so
+    // other routes must not share it.
     for (int vp = _vport_head; vp >= 0; vp = _vport[vp].ll_next)
-	if (_vport[vp].gw == gw && _vport[vp].port == port)
+	if (vp != 0 && _vport[vp].gw == gw && _vport[vp].port == port)
 	    return vp;
     if (_vport_empty_head < 0 && _vport_size == _vport_capacity) {
 	if (_vport_capacity == vport_capacity_limit)
@@ -171,12 +229,37 @@ DirectIPLookup::Table::vport_unref(uint16_t vport_i)
 	if (next >= 0)
 	    _vport[next].ll_prev = prev;
 
-	// Add the entry to empty vports list
-	_vport[vport_i].ll_next = _vport_empty_head;
-	_vport_empty_head = vport_i;
+	// Add the entry to empty vports list, once lookups are done with it
+	if (_rcu)
+	    _rcu->defer(free_vport, this, vport_i);
+	else
+	    free_vport(this, vport_i);
     }
 }
 
+// Frees go to the copy that replaced the table, if any: the copy has the
+// same entries, and lookups that see it cannot be using the freed one.
+
+void
+DirectIPLookup::Table::free_vport(void *thunk, uintptr_t vport_i)
+{
+    Table *t = static_cast<Table *>(thunk);
+    while (t->_successor)
+	t = t->_successor;
+    t->_vport[vport_i].ll_next = t->_vport_empty_head;
+    t->_vport_empty_head = vport_i;
+}
+
+void
+DirectIPLookup::Table::free_tbl_24_31(void *thunk, uintptr_t sec_i)
+{
+    Table *t = static_cast<Table *>(thunk);
+    while (t->_successor)
+	t = t->_successor;
+    t->_tbl_24_31[sec_i] = t->_tbl_24_31_empty_head;
+    t->_tbl_24_31_empty_head = sec_i >> 8;
+}
+
 int
 DirectIPLookup::Table::find_entry(uint32_t prefix, uint32_t plen) const
 {
@@ -192,6 +275,7 @@ DirectIPLookup::Table::add_route(const IPRoute& route, bool allow_replace, IPRou
 {
     uint32_t prefix = ntohl(route.addr.addr());
     uint32_t plen = route.prefix_len();
+    int old_vport_i = -1;
 
     int rt_i = find_entry(prefix, plen);
     if (rt_i >= 0) {
@@ -214,7 +298,8 @@ DirectIPLookup::Table::add_route(const IPRoute& route, bool allow_replace, IPRou
 	// Check if we allow for atomic route replacements at all
 	if (!allow_replace)
 	    return -EEXIST;
-	vport_unref(_rtable[rt_i].vport);
+	// Release the old vport once no table entry refers to it
+	old_vport_i = _rtable[rt_i].vport;
 
     } else {
 	// Attempt to allocate a new _rtable[] entry.
@@ -253,7 +338,7 @@ DirectIPLookup::Table::add_route(const IPRoute& route, bool allow_replace, IPRou
 	    if (!new_tbl)
 		return -ENOMEM;
 	    memcpy(new_tbl, _tbl_24_31, sizeof(uint16_t) * _tbl_24_31_capacity);
-	    memcpy(new_tbl + _tbl_24_31_capacity, _tbl_24_31_plen, sizeof(uint8_t) * _tbl_24_31_capacity);
+	    memcpy(new_tbl + 2 * _tbl_24_31_capacity, _tbl_24_31_plen, sizeof(uint8_t) * _tbl_24_31_capacity);
 	    CLICK_LFREE(_tbl_24_31, (sizeof(uint16_t) + sizeof(uint8_t)) * _tbl_24_31_capacity);
 	    _tbl_24_31 = new_tbl;
 	    _tbl_24_31_plen = (uint8_t *) (new_tbl + 2 * _tbl_24_31_capacity);
@@ -296,6 +381,10 @@ DirectIPLookup::Table::add_route(const IPRoute& route, bool allow_replace, IPRou
     ++_vport[vport_i].refcount;
     _rtable[rt_i].vport = vport_i;
 
+    // Lookups may follow table entries as soon as they are stored, so
+    // initialize the vport (and below, any secondary table range) first.
+    click_fence();
+
     for (int i = start; i < end; i++) {
 	if (_tbl_0_23[i] & 0x8000) {
 	    // Entries with plen > 24 already there in _tbl_24_31[]!
@@ -344,6 +433,7 @@ DirectIPLookup::Table::add_route(const IPRoute& route, bool allow_replace, IPRou
 			    _tbl_24_31_plen[sec_i + j] = _tbl_0_23_plen[i];
 			}
 		    }
+		    click_fence();
 		    _tbl_0_23[i] = (sec_i >> 8) | 0x8000;
 		} else {
 		    _tbl_0_23[i] = vport_i;
@@ -361,6 +451,8 @@ DirectIPLookup::Table::add_route(const IPRoute& route, bool allow_replace, IPRou
 	}
     }
 
+    if (old_vport_i >= 0)
+	vport_unref(old_vport_i);
     return 0;
 }
 
@@ -395,8 +487,7 @@ DirectIPLookup::Table::remove_route(const IPRoute& route, IPRoute* old_route, Er
 	uint32_t start, end, i, j, sec_i, sec_start, sec_end;
 	int newent = -1;
 	int newmask, prev, next;
-
-	vport_unref(_rtable[rt_i].vport);
+	uint16_t old_vport_i = _rtable[rt_i].vport;
 
 	// Prune our entry from the prefix/len hashtable
 	prev = _rtable[rt_i].ll_prev;
@@ -459,16 +550,21 @@ DirectIPLookup::Table::remove_route(const IPRoute& route, IPRoute* old_route, Er
 		    }
 		}
 		// Check if we can prune the entire secondary table range?
+		// Only a single route of at most 24 bits may cover it; equal
+		// longer prefixes may still point to different vports.
 		for (j = sec_i ; j < sec_i + 255; j++)
 		    if (_tbl_24_31_plen[j] != _tbl_24_31_plen[j+1])
 			break;
-		if (j == sec_i + 255) {
+		if (j == sec_i + 255 && _tbl_24_31_plen[sec_i] <= 24) {
 		    // Yup, adjust entries in primary tables...
 		    _tbl_0_23[i] = _tbl_24_31[sec_i];
 		    _tbl_0_23_plen[i] = _tbl_24_31_plen[sec_i];
 		    // ... and free up the entry (adding it to free space list)
-		    _tbl_24_31[sec_i] = _tbl_24_31_empty_head;
-		    _tbl_24_31_empty_head = sec_i >> 8;
+		    // once lookups are done with it
+		    if (_rcu)
+			_rcu->defer(free_tbl_24_31, this, sec_i);
+		    else
+			free_tbl_24_31(this, sec_i);
 		}
 	    } else {
 		if (plen == _tbl_0_23_plen[i]) {
@@ -480,6 +576,9 @@ DirectIPLookup::Table::remove_route(const IPRoute& route, IPRoute* old_route, Er
 		}
 	    }
 	}
+
+	// No table entry refers to the vport any more
+	vport_unref(old_vport_i);
     }
     return 0;
 }
@@ -488,27 +587,48 @@ DirectIPLookup::Table::remove_route(const IPRoute& route, IPRoute* old_route, Er
 // DIRECTIPLOOKUP
 
 DirectIPLookup::DirectIPLookup()
+    : _t(new Table)
 {
 }
 
 DirectIPLookup::~DirectIPLookup()
 {
+    delete _t;
 }
 
 int
 DirectIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     int r;
-    if ((r = _t.initialize()) < 0)
+    if ((r = _t->initialize()) < 0)
 	return r;
-    _t.flush();
+    _t->flush();
     return IPRouteTable::configure(conf, errh);
 }
 
+int
+DirectIPLookup::initialize(ErrorHandler *errh)
+{
+    // From now on, lookups may run concurrently with updates.
+    _t->_rcu = &_rcu;
+    return IPRouteTable::initialize(errh);
+}
+
 void
-DirectIPLookup::cleanup(CleanupStage)
+DirectIPLookup::cleanup(CleanupStage stage)
 {
-    _t.cleanup();
+    IPRouteTable::cleanup(stage);
+    _t->cleanup();
+}
+
+/* Replace the published table with t, which lookups have not yet seen. */
+void
+DirectIPLookup::publish(Table *t)
+{
+    Table *old_t = _t;
+    click_fence();
+    _t = t;
+    _rcu.defer_delete(old_t);
 }
 
 void
@@ -525,44 +645,141 @@ DirectIPLookup::push(int, Packet *p)
         p->kill();
 }
 
+void
+DirectIPLookup::push_batch(int, PacketBatch &batch)
+{
+    // Look up prefetch_window packets at a time in three passes.  The first
+    // prefetches each packet's _tbl_0_23 entry; the second reads it and
+    // prefetches the _tbl_24_31 entry, if any; the third resolves virtual
+    // ports.  The window's cache misses overlap instead of serializing.
+    const Table *t = _t;
+    Packet *window[prefetch_window];
+    uint32_t index[prefetch_window];
+    PacketBatch run;
+    int run_port = -1;
+
+    while (!batch.empty()) {
+        int n = 0;
+        while (n < prefetch_window && (window[n] = batch.pop_front())) {
+            index[n] = ntohl(window[n]->dst_ip_anno().addr());
+            click_prefetch(&t->_tbl_0_23[index[n] >> 8]);
+            ++n;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            uint16_t vport_i = t->_tbl_0_23[index[i] >> 8];
+            if (vport_i & 0x8000) {
+                index[i] = ((vport_i & 0x7fff) << 8) | (index[i] & 0xff);
+                click_prefetch(&t->_tbl_24_31[index[i]]);
+                index[i] |= index_tbl_24_31;
+            } else
+                index[i] = vport_i;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            uint16_t vport_i = index[i];
+            if (index[i] & index_tbl_24_31)
+                vport_i = t->_tbl_24_31[index[i] & ~index_tbl_24_31];
+            const VirtualPort &vp = t->_vport[vport_i];
+            Packet *p = window[i];
+            if (vp.port < 0) {
+                p->kill();
+                continue;
+            }
+            if (vp.gw)
+                p->set_dst_ip_anno(vp.gw);
+            if (vp.port != run_port && !run.empty())
+                output(run_port).push_batch(run);
+            run_port = vp.port;
+            run.push_back(p);
+        }
+    }
+
+    if (!run.empty())
+        output(run_port).push_batch(run);
+}
+
 int
 DirectIPLookup::lookup_route(IPAddress dest, IPAddress &gw) const
 {
+    const Table *t = _t;
     uint32_t ip_addr = ntohl(dest.addr());
-    uint16_t vport_i = _t._tbl_0_23[ip_addr >> 8];
+    uint16_t vport_i = t->_tbl_0_23[ip_addr >> 8];
 
     if (vport_i & 0x8000)
-        vport_i = _t._tbl_24_31[((vport_i & 0x7fff) << 8) | (ip_addr & 0xff)];
+        vport_i = t->_tbl_24_31[((vport_i & 0x7fff) << 8) | (ip_addr & 0xff)];
 
-    gw = _t._vport[vport_i].gw;
-    return _t._vport[vport_i].port;
+    gw = t->_vport[vport_i].gw;
+    return t->_vport[vport_i].port;
 }
 
 int
 DirectIPLookup::add_route(const IPRoute& route, bool allow_replace, IPRoute* old_route, ErrorHandler *errh)
 {
-    return _t.add_route(route, allow_replace, old_route, errh);
+    Table *t = _t;
+    const VirtualPort &dflt = t->_vport[0];
+    if (t->_rcu
+	&& (t->must_grow()
+	    || (route.prefix_len() == 0 && allow_replace
+		&& dflt.port != DISCARD_PORT
+		&& dflt.gw != route.gw && dflt.port != route.port))) {
+	// Lookups may be using t, and this change needs more than single
+	// stores, so make it to a copy.
+	Table *nt = new Table;
+	int r = (nt ? nt->initialize(*t) : -ENOMEM);
+	if (r >= 0)
+	    r = nt->add_route(route, allow_replace, old_route, errh);
+	if (r >= 0) {
+	    t->_successor = nt;
+	    publish(nt);
+	} else if (nt)
+	    _rcu.defer_delete(nt);
+	return r;
+    }
+    return t->add_route(route, allow_replace, old_route, errh);
 }
 
 int
 DirectIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler *errh)
 {
-    return _t.remove_route(route, old_route, errh);
+    return _t->remove_route(route, old_route, errh);
+}
+
+int
+DirectIPLookup::load_routes(const Vector<IPRoute> &routes, ErrorHandler *errh)
+{
+    // Build the new table where lookups cannot see it, then switch.
+    Table *nt = new Table;
+    int r = (nt ? nt->initialize() : -ENOMEM);
+    if (r >= 0) {
+	nt->flush();
+	for (const IPRoute *rt = routes.begin(); rt != routes.end() && r >= 0; ++rt)
+	    r = nt->add_route(*rt, true, 0, errh);
+    }
+    if (r < 0) {
+	delete nt;
+	return (r == -ENOMEM ? errh->error("out of memory") : r);
+    }
+    nt->_rcu = _t->_rcu;
+    publish(nt);
+    return 0;
 }
 
 int
 DirectIPLookup::flush_handler(const String &, Element *e, void *,
-				ErrorHandler *)
+				ErrorHandler *errh)
 {
     DirectIPLookup *t = static_cast<DirectIPLookup *>(e);
-    t->_t.flush();
-    return 0;
+    t->begin_update();
+    int r = t->load_routes(Vector<IPRoute>(), errh);
+    t->end_update();
+    return r;
 }
 
 String
 DirectIPLookup::dump_routes()
 {
-    return _t.dump();
+    return _t->dump();
 }
 
 void
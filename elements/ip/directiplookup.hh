@@ -33,6 +33,21 @@ relatively low CPU overhead, allowing for high update rates.
 DirectIPLookup implements the I<DIR-24-8-BASIC> lookup scheme described by
 Gupta, Lin, and McKeown in the paper cited below.
 
+Packets arriving in batches are looked up 16 at a time: DirectIPLookup
+prefetches the table entries for all 16 destinations before resolving any of
+them, so that their DRAM accesses overlap.  With a full table, this is
+considerably faster than looking packets up one by one.  IPLookupBenchmark
+measures the difference.
+
+Routes may be changed while the router runs with several threads.  Lookups
+take no locks: an update fills in new table entries before linking them in,
+and frees entries only once no lookup can still be using them.  Changes that
+cannot be made with single stores -- growing the secondary table or the list
+of next hops, or replacing the default route with one that differs in both
+GW and OUT -- are made to a copy of the table, which then replaces the
+original.  The C<flush> and C<load> handlers likewise build a new table and
+switch to it.
+
 =h table read-only
 
 Outputs a human-readable version of the current routing table.
@@ -65,6 +80,17 @@ operation.
 
 Clears the entire routing table in a single atomic operation.
 
+=h load write-only
+
+Replaces the entire routing table in a single atomic operation.  Write the new
+routes in `C<ADDR/MASK [GW] OUT>' format, one per line or separated by
+commas.
+
+=h load_file write-only
+
+Replaces the routing table with the routes in the named file, one per line.
+Lines starting with `C<#>' are ignored.
+
 =n
 
 See IPRouteTable for a performance comparison of the various IP routing
@@ -75,7 +101,7 @@ networks can contain routes for /25-or-smaller subnetworks, no matter how much
 memory you have.  If you need more than this, try RangeIPLookup.
 
 =a IPRouteTable, RangeIPLookup, RadixIPLookup, StaticIPLookup, LinearIPLookup,
-SortedIPLookup, LinuxIPLookup
+SortedIPLookup, LinuxIPLookup, IPLookupBenchmark
 
 Pankaj Gupta, Steven Lin, and Nick McKeown.  "Routing Lookups in Hardware at
 Memory Access Speeds".  In Proc. IEEE Infocom 1998, Vol. 3, pp. 1240-1247.
@@ -94,15 +120,18 @@ class DirectIPLookup : public IPRouteTable { public:
     const char *processing() const	{ return PUSH; }
 
     int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
     void cleanup(CleanupStage stage);
     void add_handlers();
 
     void push(int port, Packet* p);
+    void push_batch(int port, PacketBatch &batch);
 
     int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
     String dump_routes();
+    int load_routes(const Vector<IPRoute>&, ErrorHandler *);
 
     static int flush_handler(const String &, Element *, void *, ErrorHandler *);
 
@@ -111,7 +140,8 @@ class DirectIPLookup : public IPRouteTable { public:
 	tbl_24_31_capacity_limit = 32768 * 256,
 	vport_capacity_limit = 32768,
 	PREF_HASHSIZE = 64 * 1024, // must be a power of 2!
-	DISCARD_PORT = -1
+	DISCARD_PORT = -1,
+	prefetch_window = 16	// packets per push_batch lookup window
     };
 
     struct CleartextEntry {
@@ -155,9 +185,15 @@ class DirectIPLookup : public IPRouteTable { public:
 	uint32_t _tbl_24_31_capacity;
 	uint32_t _vport_capacity;
 
+	// If set, lookups may be running, and freed entries are reused only
+	// after a grace period.
+	RCUCollector *_rcu;
+	Table *_successor;	// copy that replaced this table
+
 	Table()
 	    : _tbl_0_23(0), _tbl_24_31(0), _vport(0), _rtable(0),
-	      _rt_hashtbl(0), _tbl_0_23_plen(0), _tbl_24_31_plen(0) {
+	      _rt_hashtbl(0), _tbl_0_23_plen(0), _tbl_24_31_plen(0),
+	      _rcu(0), _successor(0) {
 	}
 
 	~Table() {
@@ -165,7 +201,10 @@ class DirectIPLookup : public IPRouteTable { public:
 	}
 
 	int initialize();
+	int initialize(const Table &x);
 	void cleanup();
+	int alloc();
+	bool must_grow() const;
 
 	static inline uint32_t prefix_hash(uint32_t, uint32_t);
 
@@ -174,6 +213,8 @@ class DirectIPLookup : public IPRouteTable { public:
 
 	int vport_find(IPAddress gw, int16_t port);
 	void vport_unref(uint16_t);
+	static void free_vport(void *, uintptr_t);
+	static void free_tbl_24_31(void *, uintptr_t);
 
 	int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
 	int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
@@ -183,7 +224,11 @@ class DirectIPLookup : public IPRouteTable { public:
 
   protected:
 
-    Table _t;
+    Table *volatile _t;		// published table
+
+    enum { index_tbl_24_31 = 0x80000000U };
+
+    void publish(Table *t);
 
     friend class RangeIPLookup;
 
@@ -0,0 +1,970 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * hypersplitfilter.{cc,hh} -- filters IP packets by 5-tuple with a decision
+ * tree
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "hypersplitfilter.hh"
+#include "ipfilter.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <click/straccum.hh>
+#include <click/ipaddress.hh>
+#include <click/nameinfo.hh>
+CLICK_DECLS
+
+static const uint32_t dim_max[] = {
+    0xFFFFFFFFU, 0xFFFFFFFFU, 255, HyperSplitFilter::no_port, HyperSplitFilter::no_port
+};
+
+enum { prio_spacing = 1024 };
+
+bool
+HyperSplitFilter::Box::intersect(const Box &x)
+{
+    for (int d = 0; d < ndims; ++d) {
+	if (x.lo[d] > lo[d])
+	    lo[d] = x.lo[d];
+	if (x.hi[d] < hi[d])
+	    hi[d] = x.hi[d];
+	if (lo[d] > hi[d])
+	    return false;
+    }
+    return true;
+}
+
+template <typename T, typename U> static inline bool
+covers(const T &x, const U &region)
+{
+    for (int d = 0; d < HyperSplitFilter::ndims; ++d)
+	if (x.lo[d] > region.lo[d] || x.hi[d] < region.hi[d])
+	    return false;
+    return true;
+}
+
+static void
+full_box(uint32_t *lo, uint32_t *hi)
+{
+    for (int d = 0; d < HyperSplitFilter::ndims; ++d) {
+	lo[d] = 0;
+	hi[d] = dim_max[d];
+    }
+}
+
+
+/*
+ * expr ::= term | expr or term | expr || term
+ * term ::= factor | term and factor | term && factor | term factor
+ * factor ::= ( expr ) | test
+ *
+ * Each expression parses into a list of boxes, whose union is the set of
+ * matching 5-tuples.
+ */
+
+struct HyperSplitFilter::Parser {
+
+    const Vector<String> &_words;
+    int _pos;
+    const Element *_context;
+    ErrorHandler *_errh;
+
+    enum { t_none, t_host, t_net, t_port, t_proto };
+    enum { sd_none, sd_src, sd_dst, sd_and, sd_or };
+
+    Parser(const Vector<String> &words, int pos, const Element *context,
+	   ErrorHandler *errh)
+	: _words(words), _pos(pos), _context(context), _errh(errh) {
+    }
+
+    String word() const {
+	return _pos < _words.size() ? _words[_pos] : String();
+    }
+    bool at_connective() const {
+	String w = word();
+	return !w || w == ")" || w == "or" || w == "||"
+	    || w == "and" || w == "&&";
+    }
+
+    int parse_expr(Vector<Box> &result);
+    int parse_term(Vector<Box> &result);
+    int parse_factor(Vector<Box> &result);
+    int parse_test(Vector<Box> &result);
+    int check_size(const Vector<Box> &result);
+
+    static void restrict(Vector<Box> &boxes, int dim,
+			 const uint32_t *lo, const uint32_t *hi, int n);
+    static int op_ranges(const String &op, uint32_t v, uint32_t max,
+			 uint32_t *lo, uint32_t *hi);
+
+};
+
+int
+HyperSplitFilter::Parser::check_size(const Vector<Box> &result)
+{
+    if (result.size() > max_boxes)
+	return _errh->error("pattern too complex, more than %d ranges", (int) max_boxes);
+    return 0;
+}
+
+int
+HyperSplitFilter::Parser::parse_expr(Vector<Box> &result)
+{
+    if (parse_term(result) < 0)
+	return -1;
+    while (word() == "or" || word() == "||") {
+	++_pos;
+	Vector<Box> alt;
+	if (parse_term(alt) < 0)
+	    return -1;
+	for (Box *b = alt.begin(); b != alt.end(); ++b)
+	    result.push_back(*b);
+	if (check_size(result) < 0)
+	    return -1;
+    }
+    return 0;
+}
+
+int
+HyperSplitFilter::Parser::parse_term(Vector<Box> &result)
+{
+    if (parse_factor(result) < 0)
+	return -1;
+    while (1) {
+	String w = word();
+	if (!w || w == ")" || w == "or" || w == "||")
+	    return 0;
+	if (w == "and" || w == "&&")
+	    ++_pos;
+	Vector<Box> other, product;
+	if (parse_factor(other) < 0)
+	    return -1;
+	for (Box *a = result.begin(); a != result.end(); ++a)
+	    for (Box *b = other.begin(); b != other.end(); ++b) {
+		Box x = *a;
+		if (x.intersect(*b))
+		    product.push_back(x);
+	    }
+	result.swap(product);
+	if (check_size(result) < 0)
+	    return -1;
+    }
+}
+
+int
+HyperSplitFilter::Parser::parse_factor(Vector<Box> &result)
+{
+    String w = word();
+    if (w == "(") {
+	++_pos;
+	if (parse_expr(result) < 0)
+	    return -1;
+	if (word() != ")")
+	    return _errh->error("missing %<)%>");
+	++_pos;
+	return 0;
+    } else if (w == "not" || w == "!")
+	return _errh->error("negation not supported");
+    else
+	return parse_test(result);
+}
+
+void
+HyperSplitFilter::Parser::restrict(Vector<Box> &boxes, int dim,
+				   const uint32_t *lo, const uint32_t *hi, int n)
+{
+    Vector<Box> out;
+    for (Box *b = boxes.begin(); b != boxes.end(); ++b)
+	for (int i = 0; i < n; ++i)
+	    if (lo[i] <= b->hi[dim] && hi[i] >= b->lo[dim]) {
+		Box x = *b;
+		if (lo[i] > x.lo[dim])
+		    x.lo[dim] = lo[i];
+		if (hi[i] < x.hi[dim])
+		    x.hi[dim] = hi[i];
+		out.push_back(x);
+	    }
+    boxes.swap(out);
+}
+
+/* Store in lo[] and hi[] the ranges of values in [0, max] that satisfy
+   'x OP v'.  Returns the number of ranges, or -1 if OP is unknown. */
+int
+HyperSplitFilter::Parser::op_ranges(const String &op, uint32_t v, uint32_t max,
+				    uint32_t *lo, uint32_t *hi)
+{
+    int n = 0;
+    if (op == "=" || op == "==") {
+	lo[n] = hi[n] = v;
+	++n;
+    } else if (op == "!=") {
+	if (v > 0)
+	    lo[n] = 0, hi[n] = v - 1, ++n;
+	if (v < max)
+	    lo[n] = v + 1, hi[n] = max, ++n;
+    } else if (op == "<") {
+	if (v > 0)
+	    lo[n] = 0, hi[n] = v - 1, ++n;
+    } else if (op == "<=")
+	lo[n] = 0, hi[n] = v, ++n;
+    else if (op == ">") {
+	if (v < max)
+	    lo[n] = v + 1, hi[n] = max, ++n;
+    } else if (op == ">=")
+	lo[n] = v, hi[n] = max, ++n;
+    else
+	return -1;
+    return n;
+}
+
+int
+HyperSplitFilter::Parser::parse_test(Vector<Box> &result)
+{
+    String w = word();
+    Box box;
+    full_box(box.lo, box.hi);
+
+    if (w == "true" || w == "all" || w == "any" || w == "-") {
+	++_pos;
+	result.push_back(box);
+	return 0;
+    } else if (w == "false") {
+	++_pos;
+	return 0;
+    }
+
+    // collect qualifiers
+    int first_pos = _pos, proto = -1, srcdst = sd_none, type = t_none;
+    bool ip = false;
+    for (; _pos < _words.size(); ++_pos) {
+	w = _words[_pos];
+	if (w == "ip" && !ip && proto < 0 && !type)
+	    ip = true;
+	else if ((w == "tcp" || w == "udp" || w == "icmp") && proto < 0 && !type)
+	    proto = (w == "tcp" ? IP_PROTO_TCP : (w == "udp" ? IP_PROTO_UDP : IP_PROTO_ICMP));
+	else if (w == "src" && !srcdst) {
+	    srcdst = sd_src;
+	    if (_pos + 2 < _words.size()
+		&& (_words[_pos + 2] == "dst" || _words[_pos + 2] == "dest")) {
+		if (_words[_pos + 1] == "and" || _words[_pos + 1] == "&&")
+		    srcdst = sd_and, _pos += 2;
+		else if (_words[_pos + 1] == "or" || _words[_pos + 1] == "||")
+		    srcdst = sd_or, _pos += 2;
+	    }
+	} else if ((w == "dst" || w == "dest") && !srcdst)
+	    srcdst = sd_dst;
+	else if (w == "host" && !type)
+	    type = t_host;
+	else if (w == "net" && !type)
+	    type = t_net;
+	else if (w == "port" && !type)
+	    type = t_port;
+	else if (w == "proto" && !type)
+	    type = t_proto;
+	else
+	    break;
+    }
+    if (_pos == first_pos)
+	return _errh->error("unsupported test near %<%s%>", w.c_str());
+
+    if (proto >= 0) {
+	box.lo[dim_proto] = box.hi[dim_proto] = proto;
+	if (proto == IP_PROTO_ICMP && type == t_port)
+	    return _errh->error("%<icmp%> has no ports");
+    }
+    result.push_back(box);
+    if (!type && !srcdst && at_connective())
+	return 0;
+
+    // optional relational operator
+    String op = "=";
+    w = word();
+    if (w == "=" || w == "==" || w == "!=" || w == "<" || w == ">"
+	|| w == "<=" || w == ">=") {
+	op = w;
+	++_pos;
+    }
+
+    // data
+    if (_pos >= _words.size())
+	return _errh->error("missing value");
+    w = _words[_pos++];
+    uint32_t lo[2], hi[2], v;
+    int n;
+
+    if (type == t_proto) {
+	if (srcdst)
+	    _errh->warning("%<proto%>: %<src%> or %<dst%> ignored");
+	if (!NameInfo::query_int(NameInfo::T_IP_PROTO, _context, w, &v)
+	    && !IntArg().parse(w, v))
+	    return _errh->error("expected IP protocol near %<%s%>", w.c_str());
+	else if (v > 255)
+	    return _errh->error("IP protocol %u out of range", v);
+	n = op_ranges(op, v, 255, lo, hi);
+	restrict(result, dim_proto, lo, hi, n);
+	return 0;
+    }
+
+    int dims[2];
+    if (srcdst == sd_src || srcdst == sd_dst)
+	dims[0] = dims[1] = (srcdst == sd_src ? 0 : 1);
+    else
+	dims[0] = 0, dims[1] = 1;
+
+    if (type == t_port) {
+	uint16_t port;
+	if (!IPPortArg(proto >= 0 ? proto : IP_PROTO_TCP).parse(w, port, _context)
+	    && (proto >= 0 || !IPPortArg(IP_PROTO_UDP).parse(w, port, _context)))
+	    return _errh->error("expected port near %<%s%>", w.c_str());
+	n = op_ranges(op, port, 65535, lo, hi);
+	if (proto < 0) {
+	    uint32_t protos[2] = { IP_PROTO_TCP, IP_PROTO_UDP };
+	    restrict(result, dim_proto, protos, protos, 2);
+	}
+	dims[0] += dim_sport;
+	dims[1] += dim_sport;
+    } else {
+	IPAddress addr, mask;
+	bool net = false;
+	if (type != t_host && word() == "mask"
+	    && IPAddressArg().parse(w, addr, _context)) {
+	    if (_pos + 1 >= _words.size()
+		|| !IPAddressArg().parse(_words[_pos + 1], mask, _context))
+		return _errh->error("expected mask after %<%s%>", w.c_str());
+	    _pos += 2;
+	    net = true;
+	} else if (type != t_host && IPPrefixArg(type == t_net).parse(w, addr, mask, _context))
+	    net = true;
+	else if (type == t_net || !IPAddressArg().parse(w, addr, _context))
+	    return _errh->error("expected IP address near %<%s%>", w.c_str());
+	if (net) {
+	    if (op != "=" && op != "==")
+		return _errh->error("%<net%>: operator not supported");
+	    if (mask.mask_to_prefix_len() < 0)
+		return _errh->error("mask %s is not a prefix", mask.unparse().c_str());
+	    lo[0] = ntohl((addr & mask).addr());
+	    hi[0] = lo[0] | ~ntohl(mask.addr());
+	    n = 1;
+	} else
+	    n = op_ranges(op, ntohl(addr.addr()), 0xFFFFFFFFU, lo, hi);
+    }
+
+    if (srcdst == sd_or || srcdst == sd_none) {
+	Vector<Box> alt(result);
+	restrict(result, dims[0], lo, hi, n);
+	restrict(alt, dims[1], lo, hi, n);
+	for (Box *b = alt.begin(); b != alt.end(); ++b)
+	    result.push_back(*b);
+    } else {
+	restrict(result, dims[0], lo, hi, n);
+	if (srcdst == sd_and)
+	    restrict(result, dims[1], lo, hi, n);
+    }
+    return check_size(result);
+}
+
+
+HyperSplitFilter::HyperSplitFilter()
+    : _tree(new Tree), _wt(0), _leaf_size(8), _memory_limit(32 << 20),
+      _rcu_timer(rcu_timer_hook, this)
+{
+    _tree->leaves.push_back(Vector<Entry>());
+}
+
+HyperSplitFilter::~HyperSplitFilter()
+{
+    // No thread is classifying any more.
+    _rcu.flush();
+    delete _tree;
+}
+
+int
+HyperSplitFilter::parse_rule(const String &text, Rule &r, ErrorHandler *errh) const
+{
+    Vector<String> words;
+    IPFilter::separate_text(text, words);
+    if (words.size() == 0)
+	return errh->error("empty pattern");
+
+    String slotwd = words[0];
+    if (slotwd == "allow") {
+	r.action = 0;
+	if (noutputs() == 0)
+	    errh->error("%<allow%> is meaningless, element has zero outputs");
+    } else if (slotwd == "deny") {
+	r.action = -1;
+	if (noutputs() > 1)
+	    errh->warning("meaning of %<deny%> has changed (now it means %<drop%>)");
+    } else if (slotwd == "drop")
+	r.action = -1;
+    else if (IntArg().parse(slotwd, r.action)) {
+	if (r.action < 0 || r.action >= noutputs())
+	    return errh->error("slot %<%d%> out of range", r.action);
+    } else
+	return errh->error("unknown slot ID %<%s%>", slotwd.c_str());
+
+    r.boxes.clear();
+    if (words.size() == 1) {
+	Box box;
+	full_box(box.lo, box.hi);
+	r.boxes.push_back(box);
+    } else {
+	Parser parser(words, 1, this, errh);
+	if (parser.parse_expr(r.boxes) < 0)
+	    return -1;
+	if (parser._pos < words.size())
+	    return errh->error("garbage after expression at %<%s%>", words[parser._pos].c_str());
+    }
+    r.text = text.trim_space();
+    return 0;
+}
+
+int
+HyperSplitFilter::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    int leaf_size = 8;
+    uint32_t memory_limit = 32 << 20;
+    if (Args(this, errh).bind(conf)
+	.read("LEAF_SIZE", leaf_size)
+	.read("MEMORY", memory_limit)
+	.consume() < 0)
+	return -1;
+    if (leaf_size < 1)
+	return errh->error("LEAF_SIZE must be positive");
+
+    Vector<Rule> rules;
+    for (int i = 0; i < conf.size(); ++i) {
+	PrefixErrorHandler cerrh(errh, "pattern " + String(i) + ": ");
+	rules.push_back(Rule());
+	parse_rule(cp_unquote(conf[i]), rules.back(), &cerrh);
+    }
+    if (errh->nerrors())
+	return -1;
+
+    _update_lock.acquire();
+    _leaf_size = leaf_size;
+    _memory_limit = memory_limit;
+    _rules.swap(rules);
+    _order.clear();
+    for (int i = 0; i < _rules.size(); ++i)
+	_order.push_back(i);
+    _free_rules.clear();
+    rebuild_tree();
+    _update_lock.release();
+    return 0;
+}
+
+int
+HyperSplitFilter::initialize(ErrorHandler *)
+{
+    // From now on, packets may be classified while the rules change.
+    _rcu.initialize(master());
+    _rcu_timer.initialize(this);
+    return 0;
+}
+
+/* Publish the updated tree _wt in place of _tree, which packet threads may
+   still be walking; it is deleted after an RCU grace period.  Call with
+   _update_lock held. */
+void
+HyperSplitFilter::publish_tree()
+{
+    Tree *old_tree = _tree;
+    // The new tree is complete before any thread can walk it.
+    click_fence();
+    _tree = _wt;
+    _wt = 0;
+    _rcu.defer_delete(old_tree);
+    if (!_rcu.empty() && _rcu_timer.initialized() && !_rcu_timer.scheduled())
+	_rcu_timer.schedule_after_msec(rcu_collect_msec);
+}
+
+void
+HyperSplitFilter::rcu_timer_hook(Timer *timer, void *user_data)
+{
+    HyperSplitFilter *hsf = static_cast<HyperSplitFilter *>(user_data);
+    if (hsf->_update_lock.attempt()) {
+	bool more = hsf->_rcu.collect();
+	hsf->_update_lock.release();
+	if (!more)
+	    return;
+    }
+    timer->reschedule_after_msec(rcu_collect_msec);
+}
+
+
+int
+HyperSplitFilter::new_leaf()
+{
+    if (_wt->free_leaves.size()) {
+	int l = _wt->free_leaves.back();
+	_wt->free_leaves.pop_back();
+	return l;
+    }
+    _wt->leaves.push_back(Vector<Entry>());
+    return _wt->leaves.size() - 1;
+}
+
+/* Build a subtree for the region, which the entries overlap, and return
+   its reference.  Entries after the first that covers the whole region can
+   never match, and are dropped.  Each split chooses the dimension and
+   point that minimize the number of entries copied to both sides. */
+int
+HyperSplitFilter::build(Vector<Entry> &entries, Box &region, int depth)
+{
+    for (Entry *e = entries.begin(); e != entries.end(); ++e)
+	if (covers(*e, region)) {
+	    entries.erase(e + 1, entries.end());
+	    break;
+	}
+
+    int n = entries.size(), best_dim = -1, best_cost = n, best_sum = 2 * n + 1;
+    uint32_t best_point = 0;
+
+    if (n > _leaf_size && depth < max_depth && _wt->memory() < _memory_limit) {
+	Vector<uint32_t> los(n, 0), his(n, 0), points;
+	for (int d = 0; d < ndims; ++d) {
+	    uint32_t rlo = region.lo[d], rhi = region.hi[d];
+	    points.clear();
+	    for (int i = 0; i < n; ++i) {
+		los[i] = entries[i].lo[d] > rlo ? entries[i].lo[d] : rlo;
+		his[i] = entries[i].hi[d] < rhi ? entries[i].hi[d] : rhi;
+		if (los[i] > rlo)
+		    points.push_back(los[i]);
+		if (his[i] < rhi)
+		    points.push_back(his[i] + 1);
+	    }
+	    if (!points.size())
+		continue;
+	    click_qsort(los.begin(), n);
+	    click_qsort(his.begin(), n);
+	    click_qsort(points.begin(), points.size());
+
+	    // Entries starting before a split point go left; entries
+	    // ending at or after it go right.
+	    int nlo = 0, nhi = 0;
+	    for (int k = 0; k < points.size(); ++k) {
+		uint32_t p = points[k];
+		if (k > 0 && p == points[k - 1])
+		    continue;
+		while (nlo < n && los[nlo] < p)
+		    ++nlo;
+		while (nhi < n && his[nhi] < p)
+		    ++nhi;
+		int left = nlo, right = n - nhi;
+		int cost = left > right ? left : right;
+		if (cost < n && (left + right < best_sum
+		    || (left + right == best_sum && cost < best_cost))) {
+		    best_dim = d;
+		    best_point = p;
+		    best_cost = cost;
+		    best_sum = left + right;
+		}
+	    }
+	}
+	if (best_cost >= n)
+	    best_dim = -1;
+    }
+
+    if (best_dim < 0) {
+	int l = new_leaf();
+	_wt->leaves[l].swap(entries);
+	_wt->nentries += n;
+	return ~l;
+    }
+
+    Vector<Entry> left, right;
+    for (Entry *e = entries.begin(); e != entries.end(); ++e) {
+	if (e->lo[best_dim] < best_point)
+	    left.push_back(*e);
+	if (e->hi[best_dim] >= best_point)
+	    right.push_back(*e);
+    }
+    entries.clear();
+
+    int node = _wt->nodes.size();
+    _wt->nodes.push_back(Node());
+    _wt->nodes[node].threshold = best_point - 1;
+    _wt->nodes[node].dim = best_dim;
+
+    uint32_t saved = region.hi[best_dim];
+    region.hi[best_dim] = best_point - 1;
+    int child = build(left, region, depth + 1);
+    _wt->nodes[node].child[0] = child;
+    region.hi[best_dim] = saved;
+
+    saved = region.lo[best_dim];
+    region.lo[best_dim] = best_point;
+    child = build(right, region, depth + 1);
+    _wt->nodes[node].child[1] = child;
+    region.lo[best_dim] = saved;
+    return node;
+}
+
+void
+HyperSplitFilter::rebuild()
+{
+    _update_lock.acquire();
+    rebuild_tree();
+    _update_lock.release();
+}
+
+void
+HyperSplitFilter::rebuild_tree()
+{
+    _wt = new Tree;
+    Vector<Entry> entries;
+    for (int k = 0; k < _order.size(); ++k) {
+	Rule &r = _rules[_order[k]];
+	r.prio = (k + 1) * prio_spacing;
+	for (Box *b = r.boxes.begin(); b != r.boxes.end(); ++b) {
+	    Entry e;
+	    memcpy(e.lo, b->lo, sizeof(e.lo));
+	    memcpy(e.hi, b->hi, sizeof(e.hi));
+	    e.action = r.action;
+	    e.rule = _order[k];
+	    entries.push_back(e);
+	}
+    }
+
+    Box region;
+    full_box(region.lo, region.hi);
+    _wt->root = build(entries, region, 0);
+    publish_tree();
+}
+
+/* Add entry e to the leaves under ref, splitting leaves that grow too
+   large.  Returns the subtree's new reference. */
+int
+HyperSplitFilter::insert_entry(int ref, const Entry &e, Box &region, int depth)
+{
+    if (ref >= 0) {
+	int d = _wt->nodes[ref].dim;
+	uint32_t t = _wt->nodes[ref].threshold, saved;
+	if (e.lo[d] <= t) {
+	    saved = region.hi[d];
+	    region.hi[d] = t;
+	    int child = insert_entry(_wt->nodes[ref].child[0], e, region, depth + 1);
+	    _wt->nodes[ref].child[0] = child;
+	    region.hi[d] = saved;
+	}
+	if (e.hi[d] > t) {
+	    saved = region.lo[d];
+	    region.lo[d] = t + 1;
+	    int child = insert_entry(_wt->nodes[ref].child[1], e, region, depth + 1);
+	    _wt->nodes[ref].child[1] = child;
+	    region.lo[d] = saved;
+	}
+	return ref;
+    }
+
+    Vector<Entry> &leaf = _wt->leaves[~ref];
+    uint32_t prio = _rules[e.rule].prio;
+    Entry *pos = leaf.end();
+    while (pos != leaf.begin() && _rules[pos[-1].rule].prio > prio)
+	--pos;
+    if (pos == leaf.end() && pos != leaf.begin() && covers(pos[-1], region))
+	return ref;		// shadowed
+    if (covers(e, region)) {
+	_wt->nentries -= leaf.end() - pos;
+	leaf.erase(pos, leaf.end());
+	pos = leaf.end();
+    }
+    leaf.insert(pos, e);
+    ++_wt->nentries;
+
+    if (leaf.size() > _leaf_size && depth < max_depth && _wt->memory() < _memory_limit) {
+	Vector<Entry> entries;
+	entries.swap(leaf);
+	_wt->nentries -= entries.size();
+	_wt->free_leaves.push_back(~ref);
+	return build(entries, region, depth);
+    }
+    return ref;
+}
+
+/* Remove rule's entries from the leaves under ref that overlap box.
+   Returns the subtree's new reference. */
+int
+HyperSplitFilter::remove_entries(int ref, const Box &box, int rule,
+				 Box &region, int depth)
+{
+    if (ref >= 0) {
+	int d = _wt->nodes[ref].dim;
+	uint32_t t = _wt->nodes[ref].threshold, saved;
+	if (box.lo[d] <= t) {
+	    saved = region.hi[d];
+	    region.hi[d] = t;
+	    int child = remove_entries(_wt->nodes[ref].child[0], box, rule, region, depth + 1);
+	    _wt->nodes[ref].child[0] = child;
+	    region.hi[d] = saved;
+	}
+	if (box.hi[d] > t) {
+	    saved = region.lo[d];
+	    region.lo[d] = t + 1;
+	    int child = remove_entries(_wt->nodes[ref].child[1], box, rule, region, depth + 1);
+	    _wt->nodes[ref].child[1] = child;
+	    region.lo[d] = saved;
+	}
+	return ref;
+    }
+
+    Vector<Entry> &leaf = _wt->leaves[~ref];
+    if (leaf.size() && leaf.back().rule == rule && covers(leaf.back(), region)) {
+	// The leaf dropped the entries this one shadowed; find them again.
+	Vector<Entry> entries;
+	for (int k = 0; k < _order.size(); ++k) {
+	    const Rule &r = _rules[_order[k]];
+	    for (const Box *b = r.boxes.begin(); b != r.boxes.end(); ++b) {
+		Box x = *b;
+		if (x.intersect(region)) {
+		    Entry e;
+		    memcpy(e.lo, b->lo, sizeof(e.lo));
+		    memcpy(e.hi, b->hi, sizeof(e.hi));
+		    e.action = r.action;
+		    e.rule = _order[k];
+		    entries.push_back(e);
+		}
+	    }
+	}
+	_wt->nentries -= leaf.size();
+	leaf.clear();
+	_wt->free_leaves.push_back(~ref);
+	return build(entries, region, depth);
+    }
+
+    Entry *out = leaf.begin();
+    for (Entry *e = leaf.begin(); e != leaf.end(); ++e)
+	if (e->rule != rule)
+	    *out++ = *e;
+    _wt->nentries -= leaf.end() - out;
+    leaf.erase(out, leaf.end());
+    return ref;
+}
+
+/* Give the rule at _order[index] a priority between its neighbors',
+   renumbering all rules if there is no room. */
+void
+HyperSplitFilter::assign_prio(int index)
+{
+    uint32_t lo = index > 0 ? _rules[_order[index - 1]].prio : 0;
+    if (index + 1 == _order.size()) {
+	if (lo <= 0xFFFFFFFFU - prio_spacing) {
+	    _rules[_order[index]].prio = lo + prio_spacing;
+	    return;
+	}
+    } else {
+	uint32_t hi = _rules[_order[index + 1]].prio;
+	if (hi - lo >= 2) {
+	    _rules[_order[index]].prio = lo + (hi - lo) / 2;
+	    return;
+	}
+    }
+    uint32_t spacing = 0xFFFFFFFFU / (_order.size() + 1);
+    if (spacing > prio_spacing)
+	spacing = prio_spacing;
+    for (int k = 0; k < _order.size(); ++k)
+	_rules[_order[k]].prio = (k + 1) * spacing;
+}
+
+int
+HyperSplitFilter::insert_rule(int index, const String &text, ErrorHandler *errh)
+{
+    if (index < 0)
+	return errh->error("rule index %d out of range", index);
+    Rule r;
+    if (parse_rule(text, r, errh) < 0)
+	return -1;
+    return install_rule(index, r, errh);
+}
+
+int
+HyperSplitFilter::add_rule(const String &text, ErrorHandler *errh)
+{
+    Rule r;
+    if (parse_rule(text, r, errh) < 0)
+	return -1;
+    return install_rule(-1, r, errh);
+}
+
+/* Insert parsed rule r before the rule at index, or after every rule if
+   index is negative. */
+int
+HyperSplitFilter::install_rule(int index, Rule &r, ErrorHandler *errh)
+{
+    _update_lock.acquire();
+    if (index < 0)
+	index = _order.size();
+    else if (index > _order.size()) {
+	_update_lock.release();
+	return errh->error("rule index %d out of range", index);
+    }
+
+    int id;
+    if (_free_rules.size()) {
+	id = _free_rules.back();
+	_free_rules.pop_back();
+	_rules[id] = r;
+    } else {
+	id = _rules.size();
+	_rules.push_back(r);
+    }
+    _order.insert(_order.begin() + index, id);
+    assign_prio(index);
+
+    _wt = new Tree(*_tree);
+    const Rule &rr = _rules[id];
+    for (const Box *b = rr.boxes.begin(); b != rr.boxes.end(); ++b) {
+	Entry e;
+	memcpy(e.lo, b->lo, sizeof(e.lo));
+	memcpy(e.hi, b->hi, sizeof(e.hi));
+	e.action = rr.action;
+	e.rule = id;
+	Box region;
+	full_box(region.lo, region.hi);
+	_wt->root = insert_entry(_wt->root, e, region, 0);
+    }
+    publish_tree();
+    _update_lock.release();
+    return 0;
+}
+
+int
+HyperSplitFilter::remove_rule(int index, ErrorHandler *errh)
+{
+    _update_lock.acquire();
+    if (index < 0 || index >= _order.size()) {
+	_update_lock.release();
+	return errh->error("rule index %d out of range", index);
+    }
+    int id = _order[index];
+    _order.erase(_order.begin() + index);
+    _wt = new Tree(*_tree);
+    Rule &r = _rules[id];
+    for (const Box *b = r.boxes.begin(); b != r.boxes.end(); ++b) {
+	Box region;
+	full_box(region.lo, region.hi);
+	_wt->root = remove_entries(_wt->root, *b, id, region, 0);
+    }
+    r = Rule();
+    _free_rules.push_back(id);
+    publish_tree();
+    _update_lock.release();
+    return 0;
+}
+
+int
+HyperSplitFilter::Tree::depth(int ref) const
+{
+    if (ref < 0)
+	return 0;
+    int d0 = depth(nodes[ref].child[0]), d1 = depth(nodes[ref].child[1]);
+    return 1 + (d0 > d1 ? d0 : d1);
+}
+
+
+void
+HyperSplitFilter::push(int, Packet *p)
+{
+    checked_output_push(match(p), p);
+}
+
+void
+HyperSplitFilter::push_batch(int, PacketBatch &batch)
+{
+    // See Classifier::push_batch.
+    PacketBatch run;
+    int run_port = -1;
+    while (Packet *p = batch.pop_front()) {
+	int port = match(p);
+	if (port != run_port && !run.empty())
+	    checked_output_push_batch(run_port, run);
+	run_port = port;
+	run.push_back(p);
+    }
+    if (!run.empty())
+	checked_output_push_batch(run_port, run);
+}
+
+
+enum { h_rules, h_stats, h_add, h_insert, h_remove, h_rebuild };
+
+String
+HyperSplitFilter::read_handler(Element *e, void *thunk)
+{
+    HyperSplitFilter *hsf = static_cast<HyperSplitFilter *>(e);
+    StringAccum sa;
+    hsf->_update_lock.acquire();
+    const Tree *t = hsf->_tree;
+    switch ((intptr_t) thunk) {
+    case h_rules:
+	for (int k = 0; k < hsf->_order.size(); ++k)
+	    sa << k << ": " << hsf->_rules[hsf->_order[k]].text << '\n';
+	break;
+    case h_stats:
+	sa << "rules " << hsf->_order.size() << '\n'
+	   << "nodes " << t->nodes.size() << '\n'
+	   << "leaves " << (t->leaves.size() - t->free_leaves.size()) << '\n'
+	   << "entries " << t->nentries << '\n'
+	   << "depth " << t->depth(t->root) << '\n'
+	   << "memory " << t->memory() << '\n';
+	break;
+    }
+    hsf->_update_lock.release();
+    return sa.take_string();
+}
+
+int
+HyperSplitFilter::write_handler(const String &str, Element *e, void *thunk,
+				ErrorHandler *errh)
+{
+    HyperSplitFilter *hsf = static_cast<HyperSplitFilter *>(e);
+    switch ((intptr_t) thunk) {
+    case h_add:
+	return hsf->add_rule(str, errh);
+    case h_insert: {
+	String s = str;
+	int index;
+	if (!IntArg().parse(cp_shift_spacevec(s), index))
+	    return errh->error("expected %<INDEX ACTION PATTERN%>");
+	return hsf->insert_rule(index, s, errh);
+    }
+    case h_remove: {
+	int index;
+	if (!IntArg().parse(str.trim_space(), index))
+	    return errh->error("expected %<INDEX%>");
+	return hsf->remove_rule(index, errh);
+    }
+    case h_rebuild:
+	hsf->rebuild();
+	return 0;
+    default:
+	return errh->error("internal error");
+    }
+}
+
+void
+HyperSplitFilter::add_handlers()
+{
+    add_read_handler("rules", read_handler, h_rules);
+    add_read_handler("stats", read_handler, h_stats);
+    add_write_handler("add", write_handler, h_add);
+    add_write_handler("insert", write_handler, h_insert);
+    add_write_handler("remove", write_handler, h_remove);
+    add_write_handler("rebuild", write_handler, h_rebuild, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPFilter)
+EXPORT_ELEMENT(HyperSplitFilter)
@@ -0,0 +1,305 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_HYPERSPLITFILTER_HH
+#define CLICK_HYPERSPLITFILTER_HH
+#include <click/element.hh>
+#include <click/rcu.hh>
+#include <click/sync.hh>
+#include <click/timer.hh>
+#include <clicknet/ip.h>
+CLICK_DECLS
+
+/*
+=c
+
+HyperSplitFilter(ACTION_1 PATTERN_1, ..., ACTION_N PATTERN_N [, I<keywords>])
+
+=s ip
+
+filters IP packets by 5-tuple with a decision tree
+
+=d
+
+Filters IP packets like IPFilter, but classifies them with a decision tree
+over the packet's 5-tuple (source address, destination address, protocol,
+source port, and destination port) rather than with a program of word
+comparisons.  Use HyperSplitFilter for access control lists of thousands
+of rules, where IPFilter's program, and the time to compile it, grow too
+large.
+
+Each rule is an ACTION-PATTERN pair, with the same syntax and meaning as in
+IPFilter: ACTION is an output port number, 'C<allow>' (output 0), or
+'C<drop>' or 'C<deny>'.  Packets are processed according to the first
+matching rule; packets that match no rule are dropped.
+
+PATTERNs may use this subset of the IPClassifier syntax:
+
+=over 5
+
+=item 'C<true>', 'C<all>', 'C<any>', 'C<->'
+
+Matches every packet.
+
+=item 'C<tcp>', 'C<udp>', 'C<icmp>', 'C<[ip] proto> [RELOP] PROTO'
+
+Matches packets with the given IP protocol.  'C<tcp>' or 'C<udp>' may also
+qualify a following port test, as in 'C<tcp dst port 80>'.
+
+=item '[SRCDST] C<host> [RELOP] ADDR', '[SRCDST] ADDR'
+
+Matches packets with the given source or destination address.
+
+=item '[SRCDST] C<net> NETADDR/LEN', '[SRCDST] C<net> NETADDR C<mask> MASK'
+
+Matches packets whose source or destination address is in the given
+network.  MASK must be a prefix mask.
+
+=item '[C<tcp> | C<udp>] [SRCDST] C<port> [RELOP] PORT'
+
+Matches TCP or UDP packets, other than later fragments, with the given
+source or destination port.
+
+=back
+
+SRCDST is 'C<src>', 'C<dst>', 'C<src and dst>', or 'C<src or dst>'
+(the default).  RELOP is one of 'C<=>', 'C<!=>', 'C<< < >>', 'C<< > >>',
+'C<< <= >>', and 'C<< >= >>'.  Tests may be combined with 'C<and>',
+'C<&&>', 'C<or>', 'C<||>', and parentheses, but not negated.  Other tests,
+such as 'C<tcp opt>' and 'C<ip[...]>', are errors.
+
+HyperSplitFilter turns each rule into one or more ranges in each of the 5
+dimensions, and builds a binary decision tree over them in the style of the
+HyperSplit algorithm.  Each tree node splits one dimension at the point that
+copies the fewest rules to both sides.  A leaf holds at most LEAF_SIZE
+rules, which are checked in order; rules hidden by an earlier rule covering
+the whole leaf are left out.  Leaves also stop splitting once the tree uses
+MEMORY bytes.  Rules added and removed with the C<add>,
+C<insert>, and C<remove> handlers update only the leaves they overlap.
+
+Packets are classified without locks, so the handlers may update the rules
+while other threads push packets.  An update changes a copy of the tree and
+publishes it with a single pointer store; the replaced tree is freed after
+an RCU grace period.  Each update therefore costs a copy of the tree as
+well as its incremental change.
+
+Keyword arguments are:
+
+=over 8
+
+=item LEAF_SIZE
+
+Integer.  The number of rules a leaf may hold before it is split.  Default
+is 8.
+
+=item MEMORY
+
+Integer.  The number of bytes of tree nodes and leaf entries beyond which
+HyperSplitFilter stops splitting leaves.  Default is 33554432 (32 MB).
+
+=back
+
+The HyperSplitFilter element has an arbitrary number of outputs.  Input
+packets must have their IP header annotation set; CheckIPHeader and
+MarkIPHeader do this.
+
+=e
+
+  HyperSplitFilter(allow src net 10.0.0.0/8 && tcp dst port 22,
+                   1 dst host 192.168.1.1 && udp dst port >= 1024,
+                   deny all);
+
+=h rules read-only
+Returns the rules, one per line, each preceded by its index.
+
+=h add write-only
+Adds a rule, given as 'ACTION PATTERN', after the existing rules.
+
+=h insert write-only
+Takes 'INDEX ACTION PATTERN' and inserts the rule before the rule with index
+INDEX.
+
+=h remove write-only
+Removes the rule with the given index.
+
+=h rebuild write-only
+Rebuilds the decision tree from scratch.  Incremental updates can leave the
+tree less balanced than a fresh build.
+
+=h stats read-only
+Returns the number of rules, tree nodes, leaves, and leaf entries, the
+tree's depth, and the bytes it uses.
+
+=a
+
+IPFilter, IPClassifier, HyperSplitFilterTest */
+
+class HyperSplitFilter : public Element { public:
+
+    HyperSplitFilter();
+    ~HyperSplitFilter();
+
+    const char *class_name() const		{ return "HyperSplitFilter"; }
+    const char *port_count() const		{ return "1/-"; }
+    const char *processing() const		{ return PUSH; }
+    const char *flags() const			{ return "B"; }
+    bool can_live_reconfigure() const		{ return true; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    void push_batch(int port, PacketBatch &batch);
+
+    enum {
+	dim_src = 0, dim_dst = 1, dim_proto = 2, dim_sport = 3, dim_dport = 4,
+	ndims = 5,
+	no_port = 65536		// port key for packets without ports
+    };
+
+    /** @brief Store @a p's 5-tuple in @a key. */
+    static inline void make_key(const Packet *p, uint32_t *key);
+    /** @brief Return the output for 5-tuple @a key, or -1 to drop. */
+    inline int match(const uint32_t *key) const;
+    inline int match(const Packet *p) const;
+
+    int nrules() const {
+	return _order.size();
+    }
+    /** @brief Insert @a text before the rule at @a index. */
+    int insert_rule(int index, const String &text, ErrorHandler *errh);
+    /** @brief Add @a text after the existing rules. */
+    int add_rule(const String &text, ErrorHandler *errh);
+    int remove_rule(int index, ErrorHandler *errh);
+    void rebuild();
+
+  private:
+
+    struct Box {
+	uint32_t lo[ndims];
+	uint32_t hi[ndims];
+	bool intersect(const Box &x);
+    };
+
+    struct Rule {
+	String text;
+	int action;
+	uint32_t prio;
+	Vector<Box> boxes;
+    };
+
+    // A rule's box, copied into each leaf that the box overlaps.
+    struct Entry {
+	uint32_t lo[ndims];
+	uint32_t hi[ndims];
+	int action;
+	int rule;
+    };
+
+    // An inner node sends keys with key[dim] <= threshold to child[0].
+    // Children >= 0 are nodes; children < 0 are ~leaf indexes.
+    struct Node {
+	uint32_t threshold;
+	int dim;
+	int child[2];
+    };
+
+    struct Tree {
+	Vector<Node> nodes;
+	Vector<Vector<Entry> > leaves;
+	Vector<int> free_leaves;
+	int root;
+	uint32_t nentries;
+
+	Tree()
+	    : root(~0), nentries(0) {
+	}
+	uint32_t memory() const {
+	    return nodes.size() * sizeof(Node) + nentries * sizeof(Entry);
+	}
+	int depth(int ref) const;
+    };
+
+    struct Parser;
+
+    // The rules and _wt belong to updaters, which hold _update_lock.
+    Vector<Rule> _rules;	// indexed by rule ID
+    Vector<int> _order;		// rule IDs in priority order
+    Vector<int> _free_rules;
+
+    Tree * volatile _tree;	// the tree match() walks
+    Tree *_wt;			// the tree an update is changing
+
+    int _leaf_size;
+    uint32_t _memory_limit;
+
+    enum { max_depth = 64, max_boxes = 256, rcu_collect_msec = 10 };
+
+    Spinlock _update_lock;	// serializes updates
+    RCUCollector _rcu;		// trees replaced by updates
+    Timer _rcu_timer;
+
+    int parse_rule(const String &text, Rule &r, ErrorHandler *errh) const;
+    int new_leaf();
+    int build(Vector<Entry> &entries, Box &region, int depth);
+    int insert_entry(int ref, const Entry &e, Box &region, int depth);
+    int remove_entries(int ref, const Box &box, int rule, Box &region, int depth);
+    void assign_prio(int index);
+    int install_rule(int index, Rule &r, ErrorHandler *errh);
+    void rebuild_tree();
+    void publish_tree();
+    static void rcu_timer_hook(Timer *, void *);
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk,
+			     ErrorHandler *errh);
+
+};
+
+
+inline void
+HyperSplitFilter::make_key(const Packet *p, uint32_t *key)
+{
+    const click_ip *iph = p->ip_header();
+    key[dim_src] = ntohl(iph->ip_src.s_addr);
+    key[dim_dst] = ntohl(iph->ip_dst.s_addr);
+    key[dim_proto] = iph->ip_p;
+    if ((iph->ip_p == IP_PROTO_TCP || iph->ip_p == IP_PROTO_UDP)
+	&& IP_FIRSTFRAG(iph) && p->transport_length() >= 4) {
+	const uint8_t *th = p->transport_header();
+	key[dim_sport] = (th[0] << 8) | th[1];
+	key[dim_dport] = (th[2] << 8) | th[3];
+    } else
+	key[dim_sport] = key[dim_dport] = no_port;
+}
+
+inline int
+HyperSplitFilter::match(const uint32_t *key) const
+{
+    // Load the tree once: an update may replace it meanwhile.
+    const Tree *t = _tree;
+    int ref = t->root;
+    while (ref >= 0) {
+	const Node &n = t->nodes[ref];
+	ref = n.child[key[n.dim] > n.threshold];
+    }
+    const Vector<Entry> &leaf = t->leaves[~ref];
+    for (const Entry *e = leaf.begin(); e != leaf.end(); ++e)
+	if (key[0] - e->lo[0] <= e->hi[0] - e->lo[0]
+	    && key[1] - e->lo[1] <= e->hi[1] - e->lo[1]
+	    && key[2] - e->lo[2] <= e->hi[2] - e->lo[2]
+	    && key[3] - e->lo[3] <= e->hi[3] - e->lo[3]
+	    && key[4] - e->lo[4] <= e->hi[4] - e->lo[4])
+	    return e->action;
+    return -1;
+}
+
+inline int
+HyperSplitFilter::match(const Packet *p) const
+{
+    uint32_t key[ndims];
+    make_key(p, key);
+    return match(key);
+}
+
+CLICK_ENDDECLS
+#endif
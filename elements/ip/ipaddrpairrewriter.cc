@@ -68,6 +68,7 @@ IPAddrPairRewriter::IPAddrPairFlow::unparse(StringAccum &sa, bool direction,
 
 IPAddrPairRewriter::IPAddrPairRewriter()
 {
+    _flow_size = sizeof(IPAddrPairFlow);
 }
 
 IPAddrPairRewriter::~IPAddrPairRewriter()
@@ -105,13 +106,16 @@ IPRewriterEntry *
 IPAddrPairRewriter::get_entry(int, const IPFlowID &xflowid, int input)
 {
     IPFlowID flowid(xflowid.saddr(), 0, xflowid.daddr(), 0);
-    IPRewriterEntry *m = _map.get(flowid);
+    Shard &sh = shard(flowid);
+    lock(sh);
+    IPRewriterEntry *m = sh.map.get(flowid);
     if (!m && (unsigned) input < (unsigned) _input_specs.size()) {
 	IPRewriterInput &is = _input_specs[input];
 	IPFlowID rewritten_flowid = IPFlowID::uninitialized_t();
 	if (is.rewrite_flowid(flowid, rewritten_flowid, 0) == rw_addmap)
 	    m = IPAddrPairRewriter::add_flow(0, flowid, rewritten_flowid, input);
     }
+    unlock(sh);
     return m;
 }
 
@@ -119,17 +123,18 @@ IPRewriterEntry *
 IPAddrPairRewriter::add_flow(int, const IPFlowID &flowid,
 			     const IPFlowID &rewritten_flowid, int input)
 {
+    Shard &sh = shard(flowid);
     void *data;
     if (rewritten_flowid.sport()
 	|| rewritten_flowid.dport()
-	|| !(data = _allocator.allocate()))
+	|| !(data = sh.allocator.allocate()))
 	return 0;
 
     IPAddrPairFlow *flow = new(data) IPAddrPairFlow
 	(&_input_specs[input], flowid, rewritten_flowid,
 	 !!_timeouts[1], click_jiffies() + relevant_timeout(_timeouts));
 
-    return store_flow(flow, input, _map);
+    return store_flow(flow, input, sh.map);
 }
 
 void
@@ -139,7 +144,9 @@ IPAddrPairRewriter::push(int port, Packet *p_in)
     click_ip *iph = p->ip_header();
 
     IPFlowID flowid(iph->ip_src, 0, iph->ip_dst, 0);
-    IPRewriterEntry *m = _map.get(flowid);
+    Shard &sh = shard(flowid);
+    lock(sh);
+    IPRewriterEntry *m = sh.map.get(flowid);
 
     if (!m) {			// create new mapping
 	IPRewriterInput &is = _input_specs.at_u(port);
@@ -148,6 +155,7 @@ IPAddrPairRewriter::push(int port, Packet *p_in)
 	if (result == rw_addmap)
 	    m = IPAddrPairRewriter::add_flow(0, flowid, rewritten_flowid, port);
 	if (!m) {
+	    unlock(sh);
 	    checked_output_push(result, p);
 	    return;
 	} else if (_annos & 2)
@@ -156,8 +164,10 @@ IPAddrPairRewriter::push(int port, Packet *p_in)
 
     IPAddrPairFlow *mf = static_cast<IPAddrPairFlow *>(m->flow());
     mf->apply(p, m->direction(), _annos);
-    mf->change_expiry_by_timeout(_heap, click_jiffies(), _timeouts);
-    output(m->output()).push(p);
+    mf->change_expiry_by_timeout(sh.heap, click_jiffies(), _timeouts);
+    int output_port = m->output();
+    unlock(sh);
+    output(output_port).push(p);
 }
 
 
@@ -167,10 +177,15 @@ IPAddrPairRewriter::dump_mappings_handler(Element *e, void *)
     IPAddrPairRewriter *rw = (IPAddrPairRewriter *)e;
     click_jiffies_t now = click_jiffies();
     StringAccum sa;
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); iter++) {
-	IPAddrPairFlow *f = static_cast<IPAddrPairFlow *>(iter->flow());
-	f->unparse(sa, iter->direction(), now);
-	sa << '\n';
+    for (int s = 0; s < rw->_nshards; ++s) {
+	Shard &sh = rw->_shards[s];
+	rw->lock(sh);
+	for (Map::iterator iter = sh.map.begin(); iter.live(); iter++) {
+	    IPAddrPairFlow *f = static_cast<IPAddrPairFlow *>(iter->flow());
+	    f->unparse(sa, iter->direction(), now);
+	    sa << '\n';
+	}
+	rw->unlock(sh);
     }
     return sa.take_string();
 }
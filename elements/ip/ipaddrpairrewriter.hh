@@ -151,7 +151,6 @@ class IPAddrPairRewriter : public IPRewriterBase { public:
 
   private:
 
-    SizedHashAllocator<sizeof(IPAddrPairFlow)> _allocator;
     unsigned _annos;
 
     static String dump_mappings_handler(Element *, void *);
@@ -162,9 +161,10 @@ class IPAddrPairRewriter : public IPRewriterBase { public:
 inline void
 IPAddrPairRewriter::destroy_flow(IPRewriterFlow *flow)
 {
-    unmap_flow(flow, _map);
+    Shard &sh = shard(flow);
+    unmap_flow(flow, sh.map);
     static_cast<IPAddrPairFlow *>(flow)->~IPAddrPairFlow();
-    _allocator.deallocate(flow);
+    sh.allocator.deallocate(flow);
 }
 
 CLICK_ENDDECLS
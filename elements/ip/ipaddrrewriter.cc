@@ -69,6 +69,7 @@ IPAddrRewriter::IPAddrFlow::unparse(StringAccum &sa, bool direction,
 
 IPAddrRewriter::IPAddrRewriter()
 {
+    _flow_size = sizeof(IPAddrFlow);
 }
 
 IPAddrRewriter::~IPAddrRewriter()
@@ -106,10 +107,12 @@ IPRewriterEntry *
 IPAddrRewriter::get_entry(int, const IPFlowID &xflowid, int input)
 {
     IPFlowID flowid(xflowid.saddr(), 0, IPAddress(), 0);
-    IPRewriterEntry *m = _map.get(flowid);
+    Shard &sh = shard(flowid);
+    lock(sh);
+    IPRewriterEntry *m = sh.map.get(flowid);
     if (!m) {
 	IPFlowID rflowid(IPAddress(), 0, xflowid.daddr(), 0);
-	m = _map.get(rflowid);
+	m = sh.map.get(rflowid);
     }
     if (!m && (unsigned) input < (unsigned) _input_specs.size()) {
 	IPRewriterInput &is = _input_specs[input];
@@ -117,6 +120,7 @@ IPAddrRewriter::get_entry(int, const IPFlowID &xflowid, int input)
 	if (is.rewrite_flowid(flowid, rewritten_flowid, 0) == rw_addmap)
 	    m = add_flow(0, flowid, rewritten_flowid, input);
     }
+    unlock(sh);
     return m;
 }
 
@@ -124,18 +128,19 @@ IPRewriterEntry *
 IPAddrRewriter::add_flow(int, const IPFlowID &flowid,
 			 const IPFlowID &rewritten_flowid, int input)
 {
+    Shard &sh = shard(flowid);
     void *data;
     if (rewritten_flowid.sport()
 	|| rewritten_flowid.dport()
 	|| rewritten_flowid.daddr()
-	|| !(data = _allocator.allocate()))
+	|| !(data = sh.allocator.allocate()))
 	return 0;
 
     IPAddrFlow *flow = new(data) IPAddrFlow
 	(&_input_specs[input], flowid, rewritten_flowid,
 	 !!_timeouts[1], click_jiffies() + relevant_timeout(_timeouts));
 
-    return store_flow(flow, input, _map);
+    return store_flow(flow, input, sh.map);
 }
 
 void
@@ -145,11 +150,13 @@ IPAddrRewriter::push(int port, Packet *p_in)
     click_ip *iph = p->ip_header();
 
     IPFlowID flowid(iph->ip_src, 0, IPAddress(), 0);
-    IPRewriterEntry *m = _map.get(flowid);
+    Shard &sh = shard(flowid);
+    lock(sh);
+    IPRewriterEntry *m = sh.map.get(flowid);
 
     if (!m) {
 	IPFlowID rflowid = IPFlowID(IPAddress(), 0, iph->ip_dst, 0);
-	m = _map.get(rflowid);
+	m = sh.map.get(rflowid);
     }
 
     if (!m) {			// create new mapping
@@ -159,6 +166,7 @@ IPAddrRewriter::push(int port, Packet *p_in)
 	if (result == rw_addmap)
 	    m = IPAddrRewriter::add_flow(0, flowid, rewritten_flowid, port);
 	if (!m) {
+	    unlock(sh);
 	    checked_output_push(result, p);
 	    return;
 	} else if (_annos & 2)
@@ -167,8 +175,10 @@ IPAddrRewriter::push(int port, Packet *p_in)
 
     IPAddrFlow *mf = static_cast<IPAddrFlow *>(m->flow());
     mf->apply(p, m->direction(), _annos);
-    mf->change_expiry_by_timeout(_heap, click_jiffies(), _timeouts);
-    output(m->output()).push(p);
+    mf->change_expiry_by_timeout(sh.heap, click_jiffies(), _timeouts);
+    int output_port = m->output();
+    unlock(sh);
+    output(output_port).push(p);
 }
 
 
@@ -178,10 +188,15 @@ IPAddrRewriter::dump_mappings_handler(Element *e, void *)
     IPAddrRewriter *rw = (IPAddrRewriter *)e;
     StringAccum sa;
     click_jiffies_t now = click_jiffies();
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); iter++) {
-	IPAddrFlow *f = static_cast<IPAddrFlow *>(iter->flow());
-	f->unparse(sa, iter->direction(), now);
-	sa << '\n';
+    for (int s = 0; s < rw->_nshards; ++s) {
+	Shard &sh = rw->_shards[s];
+	rw->lock(sh);
+	for (Map::iterator iter = sh.map.begin(); iter.live(); iter++) {
+	    IPAddrFlow *f = static_cast<IPAddrFlow *>(iter->flow());
+	    f->unparse(sa, iter->direction(), now);
+	    sa << '\n';
+	}
+	rw->unlock(sh);
     }
     return sa.take_string();
 }
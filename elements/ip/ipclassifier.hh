@@ -228,6 +228,14 @@ is using to classify packets. At each step in the program, four bytes
 of packet data are ANDed with a mask and compared against four bytes of
 classifier pattern.
 
+=h jit read/write
+Returns true if the element classifies packets with native machine code.
+See IPFilter.
+
+=h simd read/write
+Returns the instruction set the element uses to classify batches of packets
+several at a time, or false.  See IPFilter.
+
 =a Classifier, IPFilter, CheckIPHeader, MarkIPHeader, CheckIPHeader2,
 tcpdump(1) */
 
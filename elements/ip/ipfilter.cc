@@ -163,11 +163,17 @@ IPFilter::static_cleanup()
 
 
 IPFilter::IPFilter()
+    : _batch_prog(0), _simd(false),
+      _simd_isa(Classification::Wordwise::BatchProgram::isa_best),
+      _rcu_timer(rcu_timer_hook, this)
 {
 }
 
 IPFilter::~IPFilter()
 {
+    // No thread is classifying any more.
+    _rcu.flush();
+    delete _batch_prog;
 }
 
 //
@@ -784,8 +790,8 @@ IPFilter::Primitive::compile(Classification::Wordwise::Program &p, Vector<int> &
 }
 
 
-static void
-separate_text(const String &text, Vector<String> &words)
+void
+IPFilter::separate_text(const String &text, Vector<String> &words)
 {
   const char* s = text.data();
   int len = text.length();
@@ -1286,11 +1292,70 @@ IPFilter::configure(Vector<String> &conf, ErrorHandler *errh)
     parse_program(zprog, conf, noutputs(), this, errh);
     if (!errh->nerrors()) {
 	_zprog = zprog;
+	compile_native();
+	compile_batch();
 	return 0;
     } else
 	return -1;
 }
 
+int
+IPFilter::initialize(ErrorHandler *)
+{
+#if CLICK_CLASSIFICATION_NATIVE
+    // From now on, the jit handler may replace native code while other
+    // threads run it.
+    _native.initialize(this);
+#endif
+    // Likewise, the simd handler may replace the batch program.
+    _rcu.initialize(master());
+    _rcu_timer.initialize(this);
+    return 0;
+}
+
+void
+IPFilter::compile_native()
+{
+#if CLICK_CLASSIFICATION_NATIVE
+    _native.compile(_zprog, true);
+#endif
+}
+
+/* Replace the batch program; see Classifier::compile_batch. */
+void
+IPFilter::compile_batch()
+{
+    Classification::Wordwise::BatchProgram *bp = 0;
+    if (_simd) {
+	bp = new Classification::Wordwise::BatchProgram;
+	bp->compile(_zprog, true, _simd_isa);
+    }
+
+    _update_lock.acquire();
+    Classification::Wordwise::BatchProgram *old_bp = _batch_prog;
+    click_fence();
+    _batch_prog = bp;
+    if (old_bp) {
+	_rcu.defer_delete(old_bp);
+	if (!_rcu.empty() && _rcu_timer.initialized() && !_rcu_timer.scheduled())
+	    _rcu_timer.schedule_after_msec(rcu_collect_msec);
+    }
+    _update_lock.release();
+}
+
+void
+IPFilter::rcu_timer_hook(Timer *timer, void *user_data)
+{
+    IPFilter *ipf = static_cast<IPFilter *>(user_data);
+    if (ipf->_update_lock.attempt()) {
+	bool more = ipf->_rcu.collect();
+	ipf->_update_lock.release();
+	if (!more)
+	    return;
+    }
+    timer->reschedule_after_msec(rcu_collect_msec);
+}
+
 String
 IPFilter::program_string(Element *e, void *)
 {
@@ -1298,10 +1363,70 @@ IPFilter::program_string(Element *e, void *)
     return ipf->_zprog.unparse();
 }
 
+String
+IPFilter::read_jit(Element *e, void *)
+{
+#if CLICK_CLASSIFICATION_NATIVE
+    IPFilter *ipf = static_cast<IPFilter *>(e);
+    return String(ipf->_native.compiled());
+#else
+    (void) e;
+    return String(false);
+#endif
+}
+
+int
+IPFilter::write_jit(const String &str, Element *e, void *, ErrorHandler *errh)
+{
+    IPFilter *ipf = static_cast<IPFilter *>(e);
+    bool jit;
+    if (!BoolArg().parse(str, jit))
+	return errh->error("syntax error");
+#if CLICK_CLASSIFICATION_NATIVE
+    if (jit)
+	ipf->compile_native();
+    else
+	ipf->_native.clear();
+    return 0;
+#else
+    (void) ipf;
+    return jit ? errh->error("native code not supported") : 0;
+#endif
+}
+
+String
+IPFilter::read_simd(Element *e, void *)
+{
+    IPFilter *ipf = static_cast<IPFilter *>(e);
+    if (const Classification::Wordwise::BatchProgram *bp = ipf->_batch_prog)
+	return Classification::Wordwise::BatchProgram::isa_name(bp->isa());
+    else
+	return String(false);
+}
+
+int
+IPFilter::write_simd(const String &str, Element *e, void *, ErrorHandler *errh)
+{
+    IPFilter *ipf = static_cast<IPFilter *>(e);
+    int isa = Classification::Wordwise::BatchProgram::isa_best;
+    if (!BoolArg().parse(str, ipf->_simd)) {
+	if (!Classification::Wordwise::BatchProgram::parse_isa(str, isa))
+	    return errh->error("syntax error");
+	ipf->_simd = true;
+    }
+    ipf->_simd_isa = isa;
+    ipf->compile_batch();
+    return 0;
+}
+
 void
 IPFilter::add_handlers()
 {
     add_read_handler("program", program_string, 0);
+    add_read_handler("jit", read_jit, 0);
+    add_write_handler("jit", write_jit, 0);
+    add_read_handler("simd", read_simd, 0);
+    add_write_handler("simd", write_simd, 0);
 }
 
 
@@ -1377,7 +1502,31 @@ IPFilter::length_checked_match(const IPFilterProgram &zprog, const Packet *p,
 void
 IPFilter::push(int, Packet *p)
 {
-    checked_output_push(match(_zprog, p), p);
+    checked_output_push(match(p), p);
+}
+
+void
+IPFilter::push_batch(int, PacketBatch &batch)
+{
+    // Load the program once: the simd handler may replace it meanwhile.
+    const Classification::Wordwise::BatchProgram *bp = _batch_prog;
+    if (bp && !bp->empty()) {
+	bp->push_batch(this, batch);
+	return;
+    }
+
+    // See Classifier::push_batch.
+    PacketBatch run;
+    int run_port = -1;
+    while (Packet *p = batch.pop_front()) {
+	int port = match(p);
+	if (port != run_port && !run.empty())
+	    checked_output_push_batch(run_port, run);
+	run_port = port;
+	run.push_back(p);
+    }
+    if (!run.empty())
+	checked_output_push_batch(run_port, run);
 }
 
 CLICK_ENDDECLS
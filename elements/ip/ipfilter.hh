@@ -2,6 +2,9 @@
 #define CLICK_IPFILTER_HH
 #include "elements/standard/classification.hh"
 #include <click/element.hh>
+#include <click/rcu.hh>
+#include <click/sync.hh>
+#include <click/timer.hh>
 CLICK_DECLS
 
 /*
@@ -107,6 +110,20 @@ is using to classify packets. At each step in the program, four bytes
 of packet data are ANDed with a mask and compared against four bytes of
 classifier pattern.
 
+=h jit read/write
+Returns true if the element classifies packets with native machine code,
+false if it interprets the program.  At user level on x86-64, IPFilter
+translates its program into machine code when configured.  Write false to
+interpret every packet, or true to translate the program again.
+
+=h simd read/write
+Returns the instruction set the element uses to classify batches of packets
+several at a time, pushing one sub-batch per output, or false if it
+classifies one packet at a time.  Write true or "scalar" for batch mode,
+which is a scalar walk with no vector instructions, or false to turn it off.
+A vectorized AVX2 walk ("avx2") is experimental and only used when
+requested explicitly.  See Classifier.  Default is false.
+
 =a
 
 IPClassifier, Classifier, CheckIPHeader, MarkIPHeader, CheckIPHeader2,
@@ -124,19 +141,23 @@ class IPFilter : public Element { public:
     const char *port_count() const		{ return "1/-"; }
     const char *processing() const		{ return PUSH; }
     // this element does not need AlignmentInfo; override Classifier's "A" flag
-    const char *flags() const			{ return ""; }
+    const char *flags() const			{ return "B"; }
     bool can_live_reconfigure() const		{ return true; }
 
     int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
     void add_handlers();
 
     void push(int port, Packet *);
+    void push_batch(int port, PacketBatch &batch);
 
     typedef Classification::Wordwise::CompressedProgram IPFilterProgram;
     static void parse_program(IPFilterProgram &zprog,
 			      const Vector<String> &conf, int noutputs,
 			      const Element *context, ErrorHandler *errh);
+    static void separate_text(const String &text, Vector<String> &words);
     static inline int match(const IPFilterProgram &zprog, const Packet *p);
+    inline int match(const Packet *p);
 
     enum {
 	TYPE_NONE	= 0,		// data types
@@ -258,6 +279,21 @@ class IPFilter : public Element { public:
   protected:
 
     IPFilterProgram _zprog;
+#if CLICK_CLASSIFICATION_NATIVE
+    Classification::Wordwise::NativeProgram _native;
+#endif
+    Classification::Wordwise::BatchProgram * volatile _batch_prog;
+    bool _simd;
+    int _simd_isa;
+
+    enum { rcu_collect_msec = 10 };
+    Spinlock _update_lock;	// serializes batch program updates
+    RCUCollector _rcu;		// batch programs replaced by updates
+    Timer _rcu_timer;
+
+    void compile_native();
+    void compile_batch();
+    static void rcu_timer_hook(Timer *, void *);
 
   private:
 
@@ -301,7 +337,15 @@ class IPFilter : public Element { public:
     static int length_checked_match(const IPFilterProgram &zprog,
 				    const Packet *p, int packet_length);
 
+    static inline int match_length(const Packet *p);
+
     static String program_string(Element *e, void *user_data);
+    static String read_jit(Element *e, void *user_data);
+    static int write_jit(const String &str, Element *e, void *user_data,
+			 ErrorHandler *errh);
+    static String read_simd(Element *e, void *user_data);
+    static int write_simd(const String &str, Element *e, void *user_data,
+			  ErrorHandler *errh);
 
 };
 
@@ -323,15 +367,22 @@ IPFilter::Primitive::negation_is_simple() const
 	return _type == TYPE_HOST || (_type & TYPE_FIELD) || _type == TYPE_IPFRAG;
 }
 
+/* Return the packet's length in program offsets. */
 inline int
-IPFilter::match(const IPFilterProgram &zprog, const Packet *p)
+IPFilter::match_length(const Packet *p)
 {
     int packet_length = p->network_length(),
 	network_header_length = p->network_header_length();
     if (packet_length > network_header_length)
-	packet_length += offset_transp - network_header_length;
+	return packet_length + offset_transp - network_header_length;
     else
-	packet_length += offset_net;
+	return packet_length + offset_net;
+}
+
+inline int
+IPFilter::match(const IPFilterProgram &zprog, const Packet *p)
+{
+    int packet_length = match_length(p);
 
     if (zprog.output_everything() >= 0)
 	return zprog.output_everything();
@@ -383,5 +434,18 @@ IPFilter::match(const IPFilterProgram &zprog, const Packet *p)
     }
 }
 
+inline int
+IPFilter::match(const Packet *p)
+{
+#if CLICK_CLASSIFICATION_NATIVE
+    int output;
+    if (match_length(p) >= (int) _zprog.safe_length()
+	&& _native.try_match(p->mac_header() - 2, p->network_header(),
+			     p->transport_header(), output))
+	return output;
+#endif
+    return match(_zprog, p);
+}
+
 CLICK_ENDDECLS
 #endif
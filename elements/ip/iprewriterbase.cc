@@ -33,6 +33,7 @@
 #include <click/error.hh>
 #include <click/algorithm.hh>
 #include <click/heap.hh>
+#include <click/router.hh>
 
 #ifdef CLICK_LINUXMODULE
 #include <click/cxxprotect.h>
@@ -68,7 +69,9 @@ IPMapper::rewrite_flowid(IPRewriterInput *, const IPFlowID &, IPFlowID &,
 //
 
 IPRewriterBase::IPRewriterBase()
-    : _map(0), _heap(new IPRewriterHeap), _gc_timer(gc_timer_hook, this)
+    : _shards(0), _nshards(1), _flow_size(sizeof(IPRewriterFlow)),
+      _capacity_source(0), _capacity(0x7FFFFFFF),
+      _gc_timer(gc_timer_hook, this)
 {
     _timeouts[0] = default_timeout;
     _timeouts[1] = default_guarantee;
@@ -77,8 +80,10 @@ IPRewriterBase::IPRewriterBase()
 
 IPRewriterBase::~IPRewriterBase()
 {
-    if (_heap)
-	_heap->unuse();
+    if (_shards)
+	for (int s = 0; s < _nshards; ++s)
+	    _shards[s].heap->unuse();
+    delete[] _shards;
 }
 
 
@@ -159,23 +164,36 @@ IPRewriterBase::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("GUARANTEE", SecondsArg(), _timeouts[1])
 	.read("REAP_INTERVAL", SecondsArg(), _gc_interval_sec)
 	.read("REAP_TIME", Args::deprecated, SecondsArg(), _gc_interval_sec)
+	.read("SHARDS", _nshards)
 	.consume() < 0)
 	return -1;
 
+    if (_nshards < 1 || _nshards > max_shards)
+	return errh->error("SHARDS must be between 1 and %d", (int) max_shards);
+
     if (capacity_word) {
 	Element *e;
 	IPRewriterBase *rwb;
-	if (IntArg().parse(capacity_word, _heap->_capacity))
+	if (IntArg().parse(capacity_word, _capacity))
 	    /* OK */;
 	else if ((e = cp_element(capacity_word, this))
 		 && (rwb = (IPRewriterBase *) e->cast("IPRewriterBase"))) {
-	    rwb->_heap->use();
-	    _heap->unuse();
-	    _heap = rwb->_heap;
+	    if (rwb != this)
+		_capacity_source = rwb;
 	} else
 	    return errh->error("bad MAPPING_CAPACITY");
     }
 
+    // Each shard starts with its own heap.  Rewriters that share a
+    // MAPPING_CAPACITY switch to the owner's heaps in initialize(), once
+    // every rewriter has created its shards.
+    _shards = new Shard[_nshards];
+    for (int s = 0; s < _nshards; ++s) {
+	_shards[s].heap = new IPRewriterHeap;
+	_shards[s].allocator.increase_size(_flow_size);
+    }
+    set_capacity(_capacity);
+
     if (conf.size() != ninputs())
 	return errh->error("need %d arguments, one per input port", ninputs());
 
@@ -191,13 +209,37 @@ IPRewriterBase::configure(Vector<String> &conf, ErrorHandler *errh)
     return _input_specs.size() == ninputs() ? 0 : -1;
 }
 
+IPRewriterBase *
+IPRewriterBase::capacity_owner()
+{
+    IPRewriterBase *rw = this;
+    for (int n = router()->nelements(); rw->_capacity_source; --n) {
+	if (n == 0)
+	    return 0;
+	rw = rw->_capacity_source;
+    }
+    return rw;
+}
+
 int
 IPRewriterBase::initialize(ErrorHandler *errh)
 {
+    IPRewriterBase *owner = capacity_owner();
+    if (!owner)
+	return errh->error("MAPPING_CAPACITY loop");
+    else if (owner != this) {
+	if (owner->_nshards != _nshards)
+	    return errh->error("MAPPING_CAPACITY %<%s%> has %d SHARDS, not %d", owner->name().c_str(), owner->_nshards, _nshards);
+	for (int s = 0; s < _nshards; ++s) {
+	    owner->_shards[s].heap->use();
+	    _shards[s].heap->unuse();
+	    _shards[s].heap = owner->_shards[s].heap;
+	}
+    }
     for (int i = 0; i < _input_specs.size(); ++i)
 	if ((_input_specs[i].kind == IPRewriterInput::i_pattern
 	     || _input_specs[i].kind == IPRewriterInput::i_keep)
-	    && _input_specs[i].reply_element->_heap != _heap)
+	    && _input_specs[i].reply_element->capacity_owner() != owner)
 	    return errh->error("input spec %d: reply element %<%s%> must share this MAPPING_CAPACITY", i, _input_specs[i].reply_element->name().c_str());
     _gc_timer.initialize(this);
     if (_gc_interval_sec)
@@ -208,7 +250,8 @@ IPRewriterBase::initialize(ErrorHandler *errh)
 void
 IPRewriterBase::cleanup(CleanupStage)
 {
-    shrink_heap(true);
+    if (_shards)
+	shrink_heap(true);
     for (int i = 0; i < _input_specs.size(); ++i)
 	if (_input_specs[i].kind == IPRewriterInput::i_pattern)
 	    _input_specs[i].u.pattern->unuse();
@@ -218,18 +261,61 @@ IPRewriterBase::cleanup(CleanupStage)
 IPRewriterEntry *
 IPRewriterBase::get_entry(int ip_p, const IPFlowID &flowid, int input)
 {
-    IPRewriterEntry *m = _map.get(flowid);
+    Shard &sh = shard(flowid);
+    lock(sh);
+    IPRewriterEntry *m = sh.map.get(flowid);
     if (m && ip_p && m->flow()->ip_p() && m->flow()->ip_p() != ip_p)
-	return 0;
-    if (!m && (unsigned) input < (unsigned) _input_specs.size()) {
+	m = 0;
+    else if (!m && (unsigned) input < (unsigned) _input_specs.size()) {
 	IPRewriterInput &is = _input_specs[input];
 	IPFlowID rewritten_flowid = IPFlowID::uninitialized_t();
 	if (is.rewrite_flowid(flowid, rewritten_flowid, 0) == rw_addmap)
 	    m = add_flow(ip_p, flowid, rewritten_flowid, input);
     }
+    unlock(sh);
     return m;
 }
 
+/** @brief Return the map and key that push() will look up for @a p.
+ *
+ * Returns null if push() does not look @a p up, or if the rewriter does not
+ * know.  push_batch() uses this only to prefetch, without locking the
+ * shard. */
+IPRewriterBase::Map *
+IPRewriterBase::batch_flowid(Packet *, IPFlowID &)
+{
+    return 0;
+}
+
+void
+IPRewriterBase::push_batch(int port, PacketBatch &batch)
+{
+    // Process packets in windows.  First prefetch every packet's buckets,
+    // then the entries they may match, then handle each packet with push(),
+    // whose lookups should now hit cache.  With several shards, other
+    // threads may be resizing the maps, so skip the second step, which
+    // reads bucket contents.
+    Packet *ps[batch_window];
+    Map *maps[batch_window];
+    Map::Probe probes[batch_window];
+    IPFlowID flowid = IPFlowID::uninitialized_t();
+
+    while (!batch.empty()) {
+	int n = 0;
+	while (n < batch_window && (ps[n] = batch.pop_front())) {
+	    if ((maps[n] = batch_flowid(ps[n], flowid)))
+		maps[n]->prefetch(flowid, probes[n]);
+	    ++n;
+	}
+	if (_nshards == 1)
+	    for (int i = 0; i < n; ++i)
+		if (maps[i])
+		    maps[i]->prefetch_entries(probes[i]);
+	for (int i = 0; i < n; ++i)
+	    push(port, ps[i]);
+    }
+}
+
 IPRewriterEntry *
 IPRewriterBase::store_flow(IPRewriterFlow *flow, int input,
 			   Map &map, Map *reply_map_ptr)
@@ -244,19 +330,22 @@ IPRewriterBase::store_flow(IPRewriterFlow *flow, int input,
     IPRewriterEntry *old = map.set(&flow->entry(false));
     assert(!old);
 
+    Shard &sh = shard(flow);
+    IPRewriterHeap *heap = sh.heap;
     if (!reply_map_ptr)
-	reply_map_ptr = &reply_element->_map;
+	reply_map_ptr = &reply_element->shard(flow).map;
     old = reply_map_ptr->set(&flow->entry(true));
     if (unlikely(old))		// Assume every map has the same heap.
-	old->flow()->destroy(_heap);
+	old->flow()->destroy(heap);
 
-    Vector<IPRewriterFlow *> &myheap = _heap->_heaps[flow->guaranteed()];
+    Vector<IPRewriterFlow *> &myheap = heap->_heaps[flow->guaranteed()];
     myheap.push_back(flow);
     push_heap(myheap.begin(), myheap.end(),
 	      IPRewriterFlow::heap_less(), IPRewriterFlow::heap_place());
     ++_input_specs[input].count;
+    ++sh.created;
 
-    if (unlikely(_heap->size() > _heap->capacity())) {
+    if (unlikely(heap->size() > heap->capacity())) {
 	// This may destroy the newly added mapping, if it has the lowest
 	// expiration time.  How can we tell?  If (1) flows are added to the
 	// heap one at a time, so the heap was formerly no bigger than the
@@ -264,29 +353,27 @@ IPRewriterBase::store_flow(IPRewriterFlow *flow, int input,
 	// destroy 'flow' if it's the top of the heap.
 	click_jiffies_t now_j = click_jiffies();
 	assert(click_jiffies_less(now_j, flow->expiry())
-	       && _heap->size() == _heap->capacity() + 1);
+	       && heap->size() == heap->capacity() + 1);
 	if (shrink_heap_for_new_flow(flow, now_j)) {
 	    ++_input_specs[input].failures;
+	    ++sh.failures;
 	    return 0;
 	}
     }
 
-    if (map.unbalanced())
-	map.rehash(map.bucket_count() + 1);
-    if (reply_map_ptr != &map && reply_map_ptr->unbalanced())
-	reply_map_ptr->rehash(reply_map_ptr->bucket_count() + 1);
     return &flow->entry(false);
 }
 
 void
-IPRewriterBase::shift_heap_best_effort(click_jiffies_t now_j)
+IPRewriterBase::shift_heap_best_effort(IPRewriterHeap *heap,
+				       click_jiffies_t now_j)
 {
     // Shift flows with expired guarantees to the best-effort heap.
-    Vector<IPRewriterFlow *> &guaranteed_heap = _heap->_heaps[1];
+    Vector<IPRewriterFlow *> &guaranteed_heap = heap->_heaps[1];
     while (guaranteed_heap.size() && guaranteed_heap[0]->expired(now_j)) {
 	IPRewriterFlow *mf = guaranteed_heap[0];
 	click_jiffies_t new_expiry = mf->owner()->owner->best_effort_expiry(mf);
-	mf->change_expiry(_heap, false, new_expiry);
+	mf->change_expiry(heap, false, new_expiry);
     }
 }
 
@@ -294,18 +381,19 @@ bool
 IPRewriterBase::shrink_heap_for_new_flow(IPRewriterFlow *flow,
 					 click_jiffies_t now_j)
 {
-    shift_heap_best_effort(now_j);
+    IPRewriterHeap *heap = shard(flow).heap;
+    shift_heap_best_effort(heap, now_j);
     // At this point, all flows in the guarantee heap expire in the future.
     // So remove the next-to-expire best-effort flow, unless there are none.
     // In that case we always remove the current flow to honor previous
     // guarantees (= admission control).
     IPRewriterFlow *deadf;
-    if (_heap->_heaps[0].empty()) {
+    if (heap->_heaps[0].empty()) {
 	assert(flow->guaranteed());
 	deadf = flow;
     } else
-	deadf = _heap->_heaps[0][0];
-    deadf->destroy(_heap);
+	deadf = heap->_heaps[0][0];
+    deadf->destroy(heap);
     return deadf == flow;
 }
 
@@ -313,15 +401,40 @@ void
 IPRewriterBase::shrink_heap(bool clear_all)
 {
     click_jiffies_t now_j = click_jiffies();
-    shift_heap_best_effort(now_j);
-    Vector<IPRewriterFlow *> &best_effort_heap = _heap->_heaps[0];
-    while (best_effort_heap.size() && best_effort_heap[0]->expired(now_j))
-	best_effort_heap[0]->destroy(_heap);
-
-    int32_t capacity = clear_all ? 0 : _heap->_capacity;
-    while (_heap->size() > capacity) {
-	IPRewriterFlow *deadf = _heap->_heaps[_heap->_heaps[0].empty()][0];
-	deadf->destroy(_heap);
+    for (int s = 0; s < _nshards; ++s) {
+	Shard &sh = _shards[s];
+	IPRewriterHeap *heap = sh.heap;
+	lock(sh);
+	Vector<IPRewriterFlow *>::size_type old_size = heap->size();
+
+	shift_heap_best_effort(heap, now_j);
+	Vector<IPRewriterFlow *> &best_effort_heap = heap->_heaps[0];
+	while (best_effort_heap.size() && best_effort_heap[0]->expired(now_j))
+	    best_effort_heap[0]->destroy(heap);
+
+	int32_t capacity = clear_all ? 0 : heap->_capacity;
+	while (heap->size() > capacity) {
+	    IPRewriterFlow *deadf = heap->_heaps[heap->_heaps[0].empty()][0];
+	    deadf->destroy(heap);
+	}
+
+	sh.reaped += old_size - heap->size();
+	unlock(sh);
+    }
+}
+
+/* Split capacity among the shards' heaps. */
+void
+IPRewriterBase::set_capacity(int32_t capacity)
+{
+    _capacity = capacity;
+    int32_t shard_capacity = capacity;
+    if (capacity != 0x7FFFFFFF)
+	shard_capacity = ((uint32_t) capacity + _nshards - 1) / _nshards;
+    for (int s = 0; s < _nshards; ++s) {
+	lock(_shards[s]);
+	_shards[s].heap->_capacity = shard_capacity;
+	unlock(_shards[s]);
     }
 }
 
@@ -356,11 +469,34 @@ IPRewriterBase::read_handler(Element *e, void *user_data)
 	sa << count;
 	break;
     }
-    case h_size:
-	sa << rw->_heap->size();
+    case h_size: {
+	Vector<IPRewriterFlow *>::size_type size = 0;
+	for (int s = 0; s < rw->_nshards; ++s)
+	    size += rw->_shards[s].heap->size();
+	sa << size;
 	break;
+    }
     case h_capacity:
-	sa << rw->_heap->_capacity;
+	sa << rw->capacity_owner()->_capacity;
+	break;
+    case h_shards:
+	for (int s = 0; s < rw->_nshards; ++s) {
+	    const Shard &sh = rw->_shards[s];
+	    sa << s << " flows " << sh.heap->size()
+	       << " created " << sh.created
+	       << " failures " << sh.failures
+	       << " reaped " << sh.reaped << '\n';
+	}
+	break;
+    case h_allocator:
+	for (int s = 0; s < rw->_nshards; ++s) {
+	    Shard &sh = rw->_shards[s];
+	    rw->lock(sh);
+	    sa << s << " objects " << sh.allocator.nallocated()
+	       << " capacity " << sh.allocator.capacity()
+	       << " bytes " << sh.allocator.memory_usage() << '\n';
+	    rw->unlock(sh);
+	}
 	break;
     default:
 	for (int i = 0; i < rw->_input_specs.size(); ++i) {
@@ -398,10 +534,12 @@ IPRewriterBase::write_handler(const String &str, Element *e, void *user_data, Er
     IPRewriterBase *rw = static_cast<IPRewriterBase *>(e);
     intptr_t what = reinterpret_cast<intptr_t>(user_data);
     if (what == h_capacity) {
+	int32_t capacity;
 	if (Args(e, errh).push_back_words(str)
-	    .read_mp("CAPACITY", rw->_heap->_capacity)
+	    .read_mp("CAPACITY", capacity)
 	    .complete() < 0)
 	    return -1;
+	rw->capacity_owner()->set_capacity(capacity);
 	rw->shrink_heap(false);
 	return 0;
     } else if (what == h_clear) {
@@ -422,14 +560,19 @@ IPRewriterBase::pattern_write_handler(const String &str, Element *e, void *user_
 	IPRewriterInput *spec = &rw->_input_specs[what];
 
 	// remove all existing flows created by this input
-	for (int which_heap = 0; which_heap < 2; ++which_heap) {
-	    Vector<IPRewriterFlow *> &myheap = rw->_heap->_heaps[which_heap];
-	    for (int i = myheap.size() - 1; i >= 0; --i)
-		if (myheap[i]->owner() == spec) {
-		    myheap[i]->destroy(rw->_heap);
-		    if (i < myheap.size())
-			++i;
-		}
+	for (int s = 0; s < rw->_nshards; ++s) {
+	    IPRewriterHeap *heap = rw->_shards[s].heap;
+	    rw->lock(rw->_shards[s]);
+	    for (int which_heap = 0; which_heap < 2; ++which_heap) {
+		Vector<IPRewriterFlow *> &myheap = heap->_heaps[which_heap];
+		for (int i = myheap.size() - 1; i >= 0; --i)
+		    if (myheap[i]->owner() == spec) {
+			myheap[i]->destroy(heap);
+			if (i < myheap.size())
+			    ++i;
+		    }
+	    }
+	    rw->unlock(rw->_shards[s]);
 	}
 
 	// change pattern
@@ -450,6 +593,8 @@ IPRewriterBase::add_rewriter_handlers(bool writable_patterns)
     add_read_handler("capacity", read_handler, h_capacity);
     add_write_handler("capacity", write_handler, h_capacity);
     add_write_handler("clear", write_handler, h_clear);
+    add_read_handler("shards", read_handler, h_shards);
+    add_read_handler("allocator", read_handler, h_allocator);
     for (int i = 0; i < ninputs(); ++i) {
 	String name = "pattern" + String(i);
 	add_read_handler(name, read_handler, i);
@@ -493,6 +638,6 @@ IPRewriterBase::llrpc(unsigned command, void *data)
 	return Element::llrpc(command, data);
 }
 
-ELEMENT_REQUIRES(IPRewriterMapping IPRewriterPattern)
+ELEMENT_REQUIRES(IPRewriterMapping IPRewriterPattern IPRewriterFlowMap)
 ELEMENT_PROVIDES(IPRewriterBase)
 CLICK_ENDDECLS
@@ -2,7 +2,11 @@
 #ifndef CLICK_IPREWRITERBASE_HH
 #define CLICK_IPREWRITERBASE_HH
 #include <click/timer.hh>
+#include <click/sync.hh>
+#include <click/hashallocator.hh>
+#include <click/atomic.hh>
 #include "elements/ip/iprwmapping.hh"
+#include "elements/ip/iprwflowmap.hh"
 #include <click/bitvector.hh>
 CLICK_DECLS
 class IPMapper;
@@ -18,15 +22,17 @@ struct IPRewriterInput {
     int foutput;
     IPRewriterBase *reply_element;
     int routput;
-    uint32_t count;
-    uint32_t failures;
+    atomic_uint32_t count;	// shards may update these concurrently
+    atomic_uint32_t failures;
     union {
 	IPRewriterPattern *pattern;
 	IPMapper *mapper;
     } u;
 
     IPRewriterInput()
-	: kind(i_drop), foutput(-1), routput(-1), count(0), failures(0) {
+	: kind(i_drop), foutput(-1), routput(-1) {
+	count = 0;
+	failures = 0;
 	u.pattern = 0;
     }
 
@@ -72,6 +78,7 @@ class IPRewriterHeap { public:
     Vector<IPRewriterFlow *> _heaps[2];
     int32_t _capacity;
     uint32_t _use_count;
+    Spinlock _lock;		// protects the shard when SHARDS > 1
 
     friend class IPRewriterBase;
     friend class IPRewriterFlow;
@@ -80,11 +87,29 @@ class IPRewriterHeap { public:
 
 class IPRewriterBase : public Element { public:
 
-    typedef HashContainer<IPRewriterEntry> Map;
+    typedef IPRewriterFlowMap Map;
     enum {
 	rw_drop = -1, rw_addmap = -2
     };
 
+    /* A shard holds part of the flow state.  Each flow lives in the shard
+       chosen by shard_of(), which gives both directions of a flow the same
+       shard.  Shards of rewriters that share a MAPPING_CAPACITY share their
+       heaps, and therefore their locks. */
+    struct Shard {
+	Map map;
+	IPRewriterHeap *heap;
+	HashAllocator allocator;
+	uint32_t created;
+	uint32_t failures;
+	uint32_t reaped;
+
+	Shard()
+	    : heap(0), allocator(sizeof(IPRewriterFlow)),
+	      created(0), failures(0), reaped(0) {
+	}
+    };
+
     IPRewriterBase();
     ~IPRewriterBase();
 
@@ -97,6 +122,7 @@ class IPRewriterBase : public Element { public:
 
     const char *port_count() const	{ return "1-/1-"; }
     const char *processing() const	{ return PUSH; }
+    const char *flags() const		{ return "B"; }
 
     int configure_phase() const		{ return CONFIGURE_PHASE_REWRITER; }
     int configure(Vector<String> &conf, ErrorHandler *errh);
@@ -107,8 +133,22 @@ class IPRewriterBase : public Element { public:
     IPRewriterBase *reply_element(int input) const {
 	return _input_specs[input].reply_element;
     }
-    virtual HashContainer<IPRewriterEntry> *get_map(int mapid) {
-	return likely(mapid == IPRewriterInput::mapid_default) ? &_map : 0;
+    virtual Map *get_map(int mapid, int shard) {
+	return likely(mapid == IPRewriterInput::mapid_default) ? &_shards[shard].map : 0;
+    }
+
+    int nshards() const {
+	return _nshards;
+    }
+    static inline int shard_of(const IPFlowID &flowid, int nshards);
+    int shard_index(const IPFlowID &flowid) const {
+	return _nshards == 1 ? 0 : shard_of(flowid, _nshards);
+    }
+    Shard &shard(const IPFlowID &flowid) {
+	return _shards[shard_index(flowid)];
+    }
+    Shard &shard(const IPRewriterFlow *flow) {
+	return shard(flow->entry(false).flowid());
     }
 
     enum {
@@ -124,15 +164,20 @@ class IPRewriterBase : public Element { public:
 	return flow->expiry() + _timeouts[0] - _timeouts[1];
     }
 
+    void push_batch(int port, PacketBatch &batch);
+
     int llrpc(unsigned command, void *data);
 
   protected:
 
-    Map _map;
+    Shard *_shards;
+    int _nshards;
+    size_t _flow_size;		// set by subclasses before configure
 
     Vector<IPRewriterInput> _input_specs;
 
-    IPRewriterHeap *_heap;
+    IPRewriterBase *_capacity_source;
+    int32_t _capacity;
     uint32_t _timeouts[2];
     uint32_t _gc_interval_sec;
     Timer _gc_timer;
@@ -140,13 +185,28 @@ class IPRewriterBase : public Element { public:
     enum {
 	default_timeout = 300,	   // 5 minutes
 	default_guarantee = 5,	   // 5 seconds
-	default_gc_interval = 60 * 15 // 15 minutes
+	default_gc_interval = 60 * 15, // 15 minutes
+	max_shards = 256
     };
 
+    void lock(Shard &sh) {
+	if (_nshards > 1)
+	    sh.heap->_lock.acquire();
+    }
+    void unlock(Shard &sh) {
+	if (_nshards > 1)
+	    sh.heap->_lock.release();
+    }
+
     static uint32_t relevant_timeout(const uint32_t timeouts[2]) {
 	return timeouts[1] ? timeouts[1] : timeouts[0];
     }
 
+    enum {
+	batch_window = 16	// packets whose lookups push_batch overlaps
+    };
+    virtual Map *batch_flowid(Packet *p, IPFlowID &flowid);
+
     IPRewriterEntry *store_flow(IPRewriterFlow *flow, int input,
 				Map &map, Map *reply_map_ptr = 0);
     inline void unmap_flow(IPRewriterFlow *flow,
@@ -159,7 +219,8 @@ class IPRewriterBase : public Element { public:
 
     enum {			// < 0 because individual patterns are >= 0
 	h_nmappings = -1, h_mapping_failures = -2, h_patterns = -3,
-	h_size = -4, h_capacity = -5, h_clear = -6
+	h_size = -4, h_capacity = -5, h_clear = -6, h_shards = -7,
+	h_allocator = -8
     };
     static String read_handler(Element *e, void *user_data);
     static int write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh);
@@ -170,7 +231,9 @@ class IPRewriterBase : public Element { public:
 
   private:
 
-    void shift_heap_best_effort(click_jiffies_t now_j);
+    IPRewriterBase *capacity_owner();
+    void set_capacity(int32_t capacity);
+    void shift_heap_best_effort(IPRewriterHeap *heap, click_jiffies_t now_j);
     bool shrink_heap_for_new_flow(IPRewriterFlow *flow, click_jiffies_t now_j);
     void shrink_heap(bool clear_all);
 
@@ -206,12 +269,16 @@ IPRewriterInput::rewrite_flowid(const IPFlowID &flowid,
 	rewritten_flowid = flowid;
 	return IPRewriterBase::rw_addmap;
     case i_pattern: {
-	HashContainer<IPRewriterEntry> *reply_map;
+	int shard = reply_element->shard_index(flowid);
+	IPRewriterFlowMap *reply_map;
 	if (likely(mapid == mapid_default))
-	    reply_map = &reply_element->_map;
+	    reply_map = &reply_element->_shards[shard].map;
 	else
-	    reply_map = reply_element->get_map(mapid);
-	i = u.pattern->rewrite_flowid(flowid, rewritten_flowid, *reply_map);
+	    reply_map = reply_element->get_map(mapid, shard);
+	i = u.pattern->rewrite_flowid(flowid, rewritten_flowid, *reply_map,
+				      shard, reply_element->_nshards);
+	if (i == IPRewriterBase::rw_drop)
+	    ++reply_element->_shards[shard].failures;
 	goto check_for_failure;
     }
     case i_mapper:
@@ -226,19 +293,28 @@ IPRewriterInput::rewrite_flowid(const IPFlowID &flowid,
     }
 }
 
+/** @brief Return the shard for @a flowid among @a nshards shards.
+ *
+ * The result depends only on the flow's ports, and is the same for a flow
+ * and its reverse.  Address rewriting therefore never moves a flow to a
+ * different shard; patterns that rewrite ports choose ports that keep the
+ * flow in its shard. */
+inline int
+IPRewriterBase::shard_of(const IPFlowID &flowid, int nshards)
+{
+    uint32_t x = (uint32_t) flowid.sport() + flowid.dport();
+    return ((x * 0x9E3779B1U) >> 16) % nshards;
+}
+
 inline void
 IPRewriterBase::unmap_flow(IPRewriterFlow *flow, Map &map,
 			   Map *reply_map_ptr)
 {
     //click_chatter("kill %s", hashkey().s().c_str());
     if (!reply_map_ptr)
-	reply_map_ptr = &flow->owner()->reply_element->_map;
-    Map::iterator it = map.find(flow->entry(0).hashkey());
-    if (it.get() == &flow->entry(0))
-	map.erase(it);
-    it = reply_map_ptr->find(flow->entry(1).hashkey());
-    if (it.get() == &flow->entry(1))
-	reply_map_ptr->erase(it);
+	reply_map_ptr = &flow->owner()->reply_element->shard(flow).map;
+    map.erase(&flow->entry(0));
+    reply_map_ptr->erase(&flow->entry(1));
 }
 
 CLICK_ENDDECLS
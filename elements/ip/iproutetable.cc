@@ -26,6 +26,9 @@
 #include <click/straccum.hh>
 #include <click/router.hh>
 #include "iproutetable.hh"
+#if CLICK_USERLEVEL
+# include <click/userutils.hh>
+#endif
 CLICK_DECLS
 
 bool
@@ -86,6 +89,11 @@ IPRoute::unparse() const
 }
 
 
+IPRouteTable::IPRouteTable()
+    : _rcu_timer(rcu_timer_hook, this)
+{
+}
+
 void *
 IPRouteTable::cast(const char *name)
 {
@@ -119,6 +127,36 @@ IPRouteTable::configure(Vector<String> &conf, ErrorHandler *errh)
     return r;
 }
 
+int
+IPRouteTable::initialize(ErrorHandler *)
+{
+    // From now on, lookups may run concurrently with updates.
+    _rcu.initialize(master());
+    _rcu_timer.initialize(this);
+    return 0;
+}
+
+void
+IPRouteTable::cleanup(CleanupStage)
+{
+    // No lookups are running; reclaim retired memory before the subclass
+    // destroys the structures it belongs to.
+    _rcu.flush();
+}
+
+void
+IPRouteTable::rcu_timer_hook(Timer *timer, void *user_data)
+{
+    IPRouteTable *table = static_cast<IPRouteTable *>(user_data);
+    if (table->_update_lock.attempt()) {
+	bool more = table->_rcu.collect();
+	table->_update_lock.release();
+	if (!more)
+	    return;
+    }
+    timer->reschedule_after_msec(rcu_collect_msec);
+}
+
 int
 IPRouteTable::add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *errh)
 {
@@ -145,6 +183,35 @@ IPRouteTable::dump_routes()
     return String();
 }
 
+int
+IPRouteTable::load_routes(const Vector<IPRoute> &routes, ErrorHandler *errh)
+{
+    // Replace the routes one at a time, restoring the old table on failure.
+    Vector<IPRoute> old_routes;
+    String dump = dump_routes();
+    const char *s = dump.begin(), *end = dump.end();
+    while (s < end) {
+	const char *nl = find(s, end, '\n');
+	IPRoute route;
+	if (cp_ip_route(dump.substring(s, nl), &route, false, this))
+	    old_routes.push_back(route);
+	s = nl + 1;
+    }
+
+    int r = 0, nremoved, nadded;
+    for (nremoved = 0; nremoved < old_routes.size() && r >= 0; ++nremoved)
+	r = remove_route(old_routes[nremoved], 0, errh);
+    for (nadded = 0; nadded < routes.size() && r >= 0; ++nadded)
+	r = add_route(routes[nadded], true, 0, errh);
+    if (r < 0) {
+	while (nadded > 0)
+	    remove_route(routes[--nadded], 0, errh);
+	while (nremoved > 0)
+	    add_route(old_routes[--nremoved], true, 0, errh);
+    }
+    return r;
+}
+
 
 void
 IPRouteTable::push(int, Packet *p)
@@ -164,6 +231,34 @@ IPRouteTable::push(int, Packet *p)
     }
 }
 
+void
+IPRouteTable::push_batch(int, PacketBatch &batch)
+{
+    // Emit runs of packets bound for the same output as sub-batches.
+    PacketBatch run;
+    int run_port = -1;
+    while (Packet *p = batch.pop_front()) {
+	IPAddress gw;
+	int port = lookup_route(p->dst_ip_anno(), gw);
+	if (port < 0) {
+	    static int complained = 0;
+	    if (++complained <= 5)
+		click_chatter("IPRouteTable: no route for %s", p->dst_ip_anno().unparse().c_str());
+	    p->kill();
+	    continue;
+	}
+	assert(port < noutputs());
+	if (gw)
+	    p->set_dst_ip_anno(gw);
+	if (port != run_port && !run.empty())
+	    output(run_port).push_batch(run);
+	run_port = port;
+	run.push_back(p);
+    }
+    if (!run.empty())
+	output(run_port).push_batch(run);
+}
+
 
 int
 IPRouteTable::run_command(int command, const String &str, Vector<IPRoute>* old_routes, ErrorHandler *errh)
@@ -208,14 +303,20 @@ int
 IPRouteTable::add_route_handler(const String &conf, Element *e, void *thunk, ErrorHandler *errh)
 {
     IPRouteTable *table = static_cast<IPRouteTable *>(e);
-    return table->run_command((thunk ? CMD_SET : CMD_ADD), conf, 0, errh);
+    table->begin_update();
+    int r = table->run_command((thunk ? CMD_SET : CMD_ADD), conf, 0, errh);
+    table->end_update();
+    return r;
 }
 
 int
 IPRouteTable::remove_route_handler(const String &conf, Element *e, void *, ErrorHandler *errh)
 {
     IPRouteTable *table = static_cast<IPRouteTable *>(e);
-    return table->run_command(CMD_REMOVE, conf, 0, errh);
+    table->begin_update();
+    int r = table->run_command(CMD_REMOVE, conf, 0, errh);
+    table->end_update();
+    return r;
 }
 
 int
@@ -227,10 +328,12 @@ IPRouteTable::ctrl_handler(const String &conf_in, Element *e, void *, ErrorHandl
 
     Vector<IPRoute> old_routes;
     int r = 0;
+    table->begin_update();
 
     while (s < end) {
 	const char* nl = find(s, end, '\n');
 	String line = conf.substring(s, nl);
+	s = nl + 1;
 
 	String first_word = cp_shift_spacevec(line);
 	int command;
@@ -249,9 +352,8 @@ IPRouteTable::ctrl_handler(const String &conf_in, Element *e, void *, ErrorHandl
 
 	if ((r = table->run_command(command, line, &old_routes, errh)) < 0)
 	    goto rollback;
-
-	s = nl + 1;
     }
+    table->end_update();
     return 0;
 
   rollback:
@@ -265,14 +367,77 @@ IPRouteTable::ctrl_handler(const String &conf_in, Element *e, void *, ErrorHandl
 	    table->add_route(rt, true, 0, errh);
 	old_routes.pop_back();
     }
+    table->end_update();
+    return r;
+}
+
+int
+IPRouteTable::load_handler(const String &conf_in, Element *e, void *, ErrorHandler *errh)
+{
+    IPRouteTable *table = static_cast<IPRouteTable *>(e);
+    String conf = cp_uncomment(conf_in);
+    const char *s = conf.begin(), *end = conf.end();
+
+    // Parse every route before changing the table.
+    Vector<IPRoute> routes;
+    IPRoute route;
+    int nerrors = 0;
+    for (int lineno = 1; s < end; ++lineno) {
+	const char *eol = s;
+	while (eol < end && *eol != '\n' && *eol != ',')
+	    ++eol;
+	const char *x = s;
+	while (x < eol && isspace((unsigned char) *x))
+	    ++x;
+	if (x < eol && *x == '#')	// comment runs to end of line
+	    while (eol < end && *eol != '\n')
+		++eol;
+	String line = conf.substring(s, eol);
+	s = eol + 1;
+	if (x == eol || *x == '#')
+	    continue;
+	else if (!cp_ip_route(line, &route, false, table)) {
+	    if (++nerrors <= 5)
+		errh->error("route %d should be %<ADDR/MASK [GATEWAY] OUTPUT%>", lineno);
+	} else if (route.port < 0 || route.port >= table->noutputs()) {
+	    if (++nerrors <= 5)
+		errh->error("route %d bad OUTPUT", lineno);
+	} else
+	    routes.push_back(route);
+    }
+    if (nerrors)
+	return -EINVAL;
+
+    table->begin_update();
+    int r = table->load_routes(routes, errh);
+    table->end_update();
     return r;
 }
 
+#if CLICK_USERLEVEL
+int
+IPRouteTable::load_file_handler(const String &conf, Element *e, void *thunk, ErrorHandler *errh)
+{
+    String filename;
+    if (!FilenameArg().parse(cp_uncomment(conf), filename))
+	return errh->error("expected FILENAME");
+    int before = errh->nerrors();
+    String text = file_string(filename, errh);
+    if (!text && errh->nerrors() != before)
+	return -EINVAL;
+    PrefixErrorHandler perrh(errh, filename + ": ");
+    return load_handler(text, e, thunk, &perrh);
+}
+#endif
+
 String
 IPRouteTable::table_handler(Element *e, void *)
 {
     IPRouteTable *r = static_cast<IPRouteTable*>(e);
-    return r->dump_routes();
+    r->begin_update();
+    String s = r->dump_routes();
+    r->end_update();
+    return s;
 }
 
 int
@@ -299,6 +464,10 @@ IPRouteTable::add_handlers()
     add_write_handler("set", add_route_handler, (void*) 1);
     add_write_handler("remove", remove_route_handler, 0);
     add_write_handler("ctrl", ctrl_handler, 0);
+    add_write_handler("load", load_handler, 0);
+#if CLICK_USERLEVEL
+    add_write_handler("load_file", load_file_handler, 0);
+#endif
     add_read_handler("table", table_handler, 0, Handler::EXPENSIVE);
     set_handler("lookup", Handler::OP_READ | Handler::READ_PARAM, lookup_handler);
 }
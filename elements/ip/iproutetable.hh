@@ -3,6 +3,9 @@
 #define CLICK_IPROUTETABLE_HH
 #include <click/glue.hh>
 #include <click/element.hh>
+#include <click/timer.hh>
+#include <click/sync.hh>
+#include <click/rcu.hh>
 CLICK_DECLS
 
 /*
@@ -113,6 +116,16 @@ there is no route). The default implementation returns -1.
 Returns a textual description of the current routing table. The default
 implementation returns an empty string.
 
+=item C<int B<load_routes>(const VectorE<lt>IPRouteE<gt> &routes, ErrorHandler *errh)>
+
+Replaces the entire routing table with C<routes>; a later route for a prefix
+replaces an earlier one.  Should return 0 on success and negative on failure,
+leaving the table unchanged.  The default implementation removes the routes
+listed by B<dump_routes> and adds C<routes> one at a time, so lookups that run
+concurrently can see a partial table.  Elements that can build a table off to
+the side and publish it with one store, such as RadixIPLookup, DirectIPLookup,
+and PoptrieIPLookup, override it to make the switch atomic.
+
 =back
 
 The following functions, overridden by IPRouteTable, are available for use by
@@ -150,6 +163,22 @@ This write handler callback function parses its input as a route control
 request and calls B<add_route> or B<remove_route> as directed. Normally hooked
 up to the `C<ctrl>' handler.
 
+=item C<static int B<load_handler>(const String &, Element *, void *, ErrorHandler *)>
+
+This write handler callback function parses its input as a list of routes,
+one per line or separated by commas, and calls B<load_routes> with them.
+Blank lines and lines starting with `C<#>' are ignored.  If any route is
+malformed, the table is not changed.  Normally hooked up to the `C<load>'
+handler.
+
+=item C<static int B<load_file_handler>(const String &, Element *, void *, ErrorHandler *)>
+
+This write handler callback function reads the routes file named by its
+input, in B<load_handler>'s format, and loads it with B<load_handler>.
+Handler writes through ControlSocket are limited to 64 kilobytes, too small
+for a full routing table, so full tables should be loaded this way.  User
+level only.  Normally hooked up to the `C<load_file>' handler.
+
 =item C<static String B<table_handler>(Element *, void *)>
 
 This read handler callback function returns the element's routing table via
@@ -157,8 +186,22 @@ the B<dump_routes> function. Normally hooked up to the `C<table>' handler.
 
 =back
 
-=a RadixIPLookup, DirectIPLookup, RangeIPLookup, StaticIPLookup,
-LinearIPLookup, SortedIPLookup, LinuxIPLookup */
+=head1 CONCURRENT UPDATES
+
+Route lookups on RouterThreads take no locks, so an element that is updated
+while running with several threads must never change memory a lookup might be
+reading.  RadixIPLookup, DirectIPLookup, and PoptrieIPLookup follow a
+read-copy-update discipline: updates build new structures and publish them
+with single stores, and memory they replace is handed to the protected
+RCUCollector C<_rcu>, which reclaims it after a grace period, once every
+thread has finished a driver loop iteration or blocked.  A timer collects the
+reclaimable memory.  The C<add>, C<set>, C<remove>, C<ctrl>, C<load>, and
+C<load_file> handlers serialize updates with the protected Spinlock C<_update_lock>;
+subclasses' own update handlers should bracket their updates with
+B<begin_update> and B<end_update>.
+
+=a RadixIPLookup, DirectIPLookup, RangeIPLookup, PoptrieIPLookup,
+StaticIPLookup, LinearIPLookup, SortedIPLookup, LinuxIPLookup */
 
 struct IPRoute {
     IPAddress addr;
@@ -185,32 +228,75 @@ struct IPRoute {
     String unparse_addr() const	{ return addr.unparse_with_mask(mask); }
 };
 
+// Parses 'ADDR/MASK [GW] OUT'; OUT is optional if remove_route is true.
+bool cp_ip_route(String s, IPRoute *r_store, bool remove_route, Element *context);
+
 class IPRouteTable : public Element { public:
 
+    IPRouteTable();
+
+    const char *flags() const			{ return "B"; }
     void* cast(const char*);
     int configure(Vector<String>&, ErrorHandler*);
+    int initialize(ErrorHandler*);
+    void cleanup(CleanupStage);
     void add_handlers();
 
     virtual int add_route(const IPRoute& route, bool allow_replace, IPRoute* replaced_route, ErrorHandler* errh);
     virtual int remove_route(const IPRoute& route, IPRoute* removed_route, ErrorHandler* errh);
     virtual int lookup_route(IPAddress addr, IPAddress& gw) const = 0;
     virtual String dump_routes();
+    virtual int load_routes(const Vector<IPRoute>& routes, ErrorHandler* errh);
 
     void push(int port, Packet* p);
+    void push_batch(int port, PacketBatch &batch);
 
     static int add_route_handler(const String&, Element*, void*, ErrorHandler*);
     static int remove_route_handler(const String&, Element*, void*, ErrorHandler*);
     static int ctrl_handler(const String&, Element*, void*, ErrorHandler*);
+    static int load_handler(const String&, Element*, void*, ErrorHandler*);
+#if CLICK_USERLEVEL
+    static int load_file_handler(const String&, Element*, void*, ErrorHandler*);
+#endif
     static int lookup_handler(int operation, String&, Element*, const Handler*, ErrorHandler*);
     static String table_handler(Element*, void*);
 
+  protected:
+
+    Spinlock _update_lock;	// serializes updates
+    RCUCollector _rcu;		// memory retired by updates
+
+    inline void begin_update();
+    inline void end_update();
+
   private:
 
     enum { CMD_ADD, CMD_SET, CMD_REMOVE };
+    enum { rcu_collect_msec = 10 };
+
+    Timer _rcu_timer;
+
     int run_command(int command, const String &, Vector<IPRoute>* old_routes, ErrorHandler*);
+    static void rcu_timer_hook(Timer *, void *);
 
 };
 
+/** @brief Start an update, serializing it with other updates. */
+inline void
+IPRouteTable::begin_update()
+{
+    _update_lock.acquire();
+}
+
+/** @brief Finish an update, arranging to reclaim any memory it retired. */
+inline void
+IPRouteTable::end_update()
+{
+    if (!_rcu.empty() && _rcu_timer.initialized() && !_rcu_timer.scheduled())
+	_rcu_timer.schedule_after_msec(rcu_collect_msec);
+    _update_lock.release();
+}
+
 inline StringAccum&
 operator<<(StringAccum& sa, const IPRoute& route)
 {
@@ -0,0 +1,184 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * iprwflowmap.{cc,hh} -- cuckoo hash table of IPRewriter flows
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "iprwflowmap.hh"
+CLICK_DECLS
+
+IPRewriterFlowMap::IPRewriterFlowMap()
+    : _mask(initial_buckets - 1), _size(0), _kick(0)
+{
+    _b = alloc_buckets(initial_buckets, _mem);
+}
+
+IPRewriterFlowMap::~IPRewriterFlowMap()
+{
+    delete[] _mem;
+}
+
+IPRewriterFlowMap::Bucket *
+IPRewriterFlowMap::alloc_buckets(uint32_t n, char *&mem)
+{
+    // align buckets to cache lines
+    mem = new char[n * sizeof(Bucket) + cache_line - 1];
+    Bucket *b = reinterpret_cast<Bucket *>
+	((reinterpret_cast<uintptr_t>(mem) + cache_line - 1) & ~(uintptr_t) (cache_line - 1));
+    memset(b, 0, n * sizeof(Bucket));
+    return b;
+}
+
+/* Store e in an empty slot of bucket or its alternate, if there is one. */
+bool
+IPRewriterFlowMap::place(IPRewriterEntry *e, uint32_t bucket, uint16_t sig)
+{
+    for (int which = 0; which < 2; ++which) {
+	Bucket &b = _b[bucket];
+	for (int i = 0; i < bucket_size; ++i)
+	    if (!b.sig[i]) {
+		b.sig[i] = sig;
+		b.e[i] = e;
+		return true;
+	    }
+	bucket = alternate(bucket, sig, _mask);
+    }
+    return false;
+}
+
+/* Make room for e, whose two buckets are full, by moving entries to their
+   alternate buckets.  Returns null on success.  After max_kicks moves,
+   gives up and returns the entry left without a slot, which may not be e. */
+IPRewriterEntry *
+IPRewriterFlowMap::displace(IPRewriterEntry *e, uint32_t bucket, uint16_t sig)
+{
+    for (int n = 0; n < max_kicks; ++n) {
+	Bucket &b = _b[bucket];
+	int i = _kick++ % bucket_size;
+	IPRewriterEntry *victim = b.e[i];
+	uint16_t victim_sig = b.sig[i];
+	b.e[i] = e;
+	b.sig[i] = sig;
+
+	e = victim;
+	sig = victim_sig;
+	bucket = alternate(bucket, sig, _mask);
+	Bucket &alt = _b[bucket];
+	for (int j = 0; j < bucket_size; ++j)
+	    if (!alt.sig[j]) {
+		alt.sig[j] = sig;
+		alt.e[j] = e;
+		return 0;
+	    }
+    }
+    return e;
+}
+
+/* Double the number of buckets and reinsert every entry. */
+void
+IPRewriterFlowMap::grow()
+{
+    Bucket *old_b = _b;
+    char *old_mem = _mem;
+    uint32_t old_n = _mask + 1;
+
+    for (uint32_t n = 2 * old_n; ; n *= 2) {
+	_b = alloc_buckets(n, _mem);
+	_mask = n - 1;
+	bool ok = true;
+	for (uint32_t k = 0; k < old_n && ok; ++k)
+	    for (int i = 0; i < bucket_size && ok; ++i)
+		if (old_b[k].sig[i]) {
+		    IPRewriterEntry *e = old_b[k].e[i];
+		    Probe probe;
+		    make_probe(e->flowid(), _mask, probe);
+		    ok = place(e, probe.bucket, probe.sig)
+			|| !displace(e, probe.bucket, probe.sig);
+		}
+	if (ok)
+	    break;
+	delete[] _mem;
+    }
+
+    delete[] old_mem;
+}
+
+/** @brief Add @a e to the map, replacing any entry with the same key.
+ * @return the replaced entry, or null
+ *
+ * Invalidates outstanding Probes and iterators. */
+IPRewriterEntry *
+IPRewriterFlowMap::set(IPRewriterEntry *e)
+{
+    Probe probe;
+    make_probe(e->flowid(), _mask, probe);
+    uint32_t bucket = probe.bucket;
+    for (int which = 0; which < 2; ++which) {
+	Bucket &b = _b[bucket];
+	for (int i = 0; i < bucket_size; ++i)
+	    if (b.sig[i] == probe.sig && b.e[i]->flowid() == e->flowid()) {
+		IPRewriterEntry *old = b.e[i];
+		b.e[i] = e;
+		return old;
+	    }
+	bucket = alternate(bucket, probe.sig, _mask);
+    }
+
+    ++_size;
+    // Keep the load below 7/8, where displacement chains grow long.
+    if (_size * 8 > (int) (_mask + 1) * bucket_size * 7)
+	grow();
+    else if (place(e, probe.bucket, probe.sig))
+	return 0;
+    else if (!(e = displace(e, probe.bucket, probe.sig)))
+	return 0;
+    else
+	grow();
+
+    // After growing, e is the entry still looking for a slot.
+    while (1) {
+	make_probe(e->flowid(), _mask, probe);
+	if (place(e, probe.bucket, probe.sig)
+	    || !(e = displace(e, probe.bucket, probe.sig)))
+	    return 0;
+	grow();
+    }
+}
+
+/** @brief Remove @a e from the map.
+ * @return true iff @a e was in the map
+ *
+ * Invalidates outstanding Probes, but not iterators. */
+bool
+IPRewriterFlowMap::erase(IPRewriterEntry *e)
+{
+    Probe probe;
+    make_probe(e->flowid(), _mask, probe);
+    uint32_t bucket = probe.bucket;
+    for (int which = 0; which < 2; ++which) {
+	Bucket &b = _b[bucket];
+	for (int i = 0; i < bucket_size; ++i)
+	    if (b.e[i] == e && b.sig[i]) {
+		b.sig[i] = 0;
+		b.e[i] = 0;
+		--_size;
+		return true;
+	    }
+	bucket = alternate(bucket, probe.sig, _mask);
+    }
+    return false;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPRewriterMapping)
+ELEMENT_PROVIDES(IPRewriterFlowMap)
@@ -0,0 +1,214 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_IPRW_FLOWMAP_HH
+#define CLICK_IPRW_FLOWMAP_HH
+#include <click/glue.hh>
+#include "elements/ip/iprwmapping.hh"
+CLICK_DECLS
+
+/* IPRewriterFlowMap maps IPFlowIDs to IPRewriterEntry objects.
+
+   It is a bucketized cuckoo hash table.  Each bucket holds up to six entry
+   pointers and a 16-bit signature of each entry's hash, so on 64-bit hosts a
+   bucket fills one 64-byte cache line.  A key lives in one of two buckets:
+   its primary bucket, chosen by its hash, and an alternate bucket computed
+   from the primary bucket and the signature.  A lookup therefore touches at
+   most two bucket cache lines, and dereferences only entries whose signatures
+   match -- unlike a chained table, where every probe chases a pointer into
+   the heap.  Insertion moves entries to their alternate buckets as needed to
+   make room, and doubles the table when that fails or the table is nearly
+   full.
+
+   For batched lookups, prefetch() computes a key's Probe and prefetches its
+   buckets; prefetch_entries() then prefetches the entries whose signatures
+   match.  Issuing each step for several keys before looking any of them up
+   overlaps their cache misses. */
+
+class IPRewriterFlowMap { public:
+
+    enum {
+	bucket_size = 6		// entries per bucket
+    };
+
+    struct Probe {
+	uint32_t bucket;
+	uint16_t sig;
+    };
+
+    class iterator;
+
+    IPRewriterFlowMap();
+    ~IPRewriterFlowMap();
+
+    /** @brief Return the number of entries. */
+    int size() const {
+	return _size;
+    }
+    bool empty() const {
+	return _size == 0;
+    }
+    /** @brief Return the number of buckets. */
+    uint32_t bucket_count() const {
+	return _mask + 1;
+    }
+
+    inline IPRewriterEntry *get(const IPFlowID &key) const;
+    inline void prefetch(const IPFlowID &key, Probe &probe) const;
+    inline void prefetch_entries(const Probe &probe) const;
+
+    IPRewriterEntry *set(IPRewriterEntry *e);
+    bool erase(IPRewriterEntry *e);
+
+    inline iterator begin() const;
+
+  private:
+
+    struct Bucket {
+	uint16_t sig[bucket_size];	// 0 means empty
+	IPRewriterEntry *e[bucket_size];
+    };
+
+    enum {
+	initial_buckets = 16,
+	max_kicks = 256,	// displacements before growing
+	cache_line = 64
+    };
+
+    Bucket *_b;
+    char *_mem;
+    uint32_t _mask;
+    int _size;
+    uint32_t _kick;		// rotates which slot insertion displaces
+
+    static inline uint64_t hash(const IPFlowID &key);
+    static inline void make_probe(const IPFlowID &key, uint32_t mask,
+				  Probe &probe);
+    static uint32_t alternate(uint32_t bucket, uint16_t sig, uint32_t mask) {
+	return (bucket ^ (sig * 0x5BD1E995U)) & mask;
+    }
+    static inline IPRewriterEntry *search(const Bucket &b, uint16_t sig,
+					  const IPFlowID &key);
+
+    static Bucket *alloc_buckets(uint32_t n, char *&mem);
+    bool place(IPRewriterEntry *e, uint32_t bucket, uint16_t sig);
+    IPRewriterEntry *displace(IPRewriterEntry *e, uint32_t bucket, uint16_t sig);
+    void grow();
+
+    IPRewriterFlowMap(const IPRewriterFlowMap &);
+    IPRewriterFlowMap &operator=(const IPRewriterFlowMap &);
+
+    friend class iterator;
+
+};
+
+class IPRewriterFlowMap::iterator { public:
+
+    bool live() const {
+	return _slot <= _last;
+    }
+    IPRewriterEntry *get() const {
+	return _m->_b[_slot / bucket_size].e[_slot % bucket_size];
+    }
+    IPRewriterEntry *operator->() const {
+	return get();
+    }
+    IPRewriterEntry &operator*() const {
+	return *get();
+    }
+    void operator++() {
+	for (++_slot; _slot <= _last && !get(); ++_slot)
+	    /* do nothing */;
+    }
+    void operator++(int) {
+	++*this;
+    }
+
+  private:
+
+    const IPRewriterFlowMap *_m;
+    uint32_t _slot;
+    uint32_t _last;
+
+    iterator(const IPRewriterFlowMap *m)
+	: _m(m), _slot(0), _last((m->_mask + 1) * bucket_size - 1) {
+	if (!get())
+	    ++*this;
+    }
+
+    friend class IPRewriterFlowMap;
+
+};
+
+inline uint64_t
+IPRewriterFlowMap::hash(const IPFlowID &key)
+{
+    uint64_t h = (uint64_t) key.saddr().addr() * 0x9E3779B97F4A7C15ULL
+	^ (uint64_t) key.daddr().addr() * 0xC2B2AE3D27D4EB4FULL
+	^ (uint64_t) (key.sport() | ((uint32_t) key.dport() << 16)) * 0x165667B19E3779F9ULL;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    return h ^ (h >> 32);
+}
+
+inline void
+IPRewriterFlowMap::make_probe(const IPFlowID &key, uint32_t mask, Probe &probe)
+{
+    uint64_t h = hash(key);
+    probe.bucket = (uint32_t) h & mask;
+    probe.sig = h >> 48;
+    if (!probe.sig)
+	probe.sig = 1;
+}
+
+inline IPRewriterEntry *
+IPRewriterFlowMap::search(const Bucket &b, uint16_t sig, const IPFlowID &key)
+{
+    for (int i = 0; i < bucket_size; ++i)
+	if (b.sig[i] == sig && b.e[i]->flowid() == key)
+	    return b.e[i];
+    return 0;
+}
+
+/** @brief Return the entry for @a key, or null if there is none. */
+inline IPRewriterEntry *
+IPRewriterFlowMap::get(const IPFlowID &key) const
+{
+    Probe probe;
+    make_probe(key, _mask, probe);
+    if (IPRewriterEntry *e = search(_b[probe.bucket], probe.sig, key))
+	return e;
+    return search(_b[alternate(probe.bucket, probe.sig, _mask)], probe.sig, key);
+}
+
+/** @brief Prepare to look up @a key, prefetching the buckets it may be in.
+ *
+ * The resulting @a probe remains valid only until the map is changed. */
+inline void
+IPRewriterFlowMap::prefetch(const IPFlowID &key, Probe &probe) const
+{
+    make_probe(key, _mask, probe);
+    click_prefetch(&_b[probe.bucket]);
+    click_prefetch(&_b[alternate(probe.bucket, probe.sig, _mask)]);
+}
+
+/** @brief Prefetch the entries that @a probe's key may match. */
+inline void
+IPRewriterFlowMap::prefetch_entries(const Probe &probe) const
+{
+    const Bucket &b1 = _b[probe.bucket];
+    const Bucket &b2 = _b[alternate(probe.bucket, probe.sig, _mask)];
+    for (int i = 0; i < bucket_size; ++i) {
+	if (b1.sig[i] == probe.sig)
+	    click_prefetch(b1.e[i]);
+	if (b2.sig[i] == probe.sig)
+	    click_prefetch(b2.e[i]);
+    }
+}
+
+inline IPRewriterFlowMap::iterator
+IPRewriterFlowMap::begin() const
+{
+    return iterator(this);
+}
+
+CLICK_ENDDECLS
+#endif
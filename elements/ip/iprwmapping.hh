@@ -26,7 +26,6 @@ class IPRewriterEntry { public:
 	_flowid = flowid;
 	_output = output;
 	_direction = direction;
-	_hashnext = 0;
     }
 
     const IPFlowID &flowid() const {
@@ -58,9 +57,6 @@ class IPRewriterEntry { public:
     IPFlowID _flowid;
     uint32_t _output : 24;
     uint8_t _direction;
-    IPRewriterEntry *_hashnext;
-
-    friend class HashContainer_adapter<IPRewriterEntry>;
 
 };
 
@@ -22,6 +22,7 @@
 #include <click/config.h>
 #include "iprwpattern.hh"
 #include "elements/ip/iprwmapping.hh"
+#include "elements/ip/iprwflowmap.hh"
 #include "elements/ip/iprwpatterns.hh"
 #include <clicknet/ip.h>
 #include <clicknet/tcp.h>
@@ -219,7 +220,8 @@ IPRewriterPattern::parse_with_ports(const String &conf, IPRewriterInput *input,
 int
 IPRewriterPattern::rewrite_flowid(const IPFlowID &flowid,
 				  IPFlowID &rewritten_flowid,
-				  const HashContainer<IPRewriterEntry> &reply_map)
+				  const IPRewriterFlowMap &reply_map,
+				  int shard, int nshards)
 {
     rewritten_flowid = flowid;
     if (_saddr)
@@ -231,6 +233,13 @@ IPRewriterPattern::rewrite_flowid(const IPFlowID &flowid,
     if (_dport)
 	rewritten_flowid.set_dport(_dport);
 
+    // The new flow must stay in the shard of the original, which depends on
+    // ports alone; only port variation can choose the shard.
+    bool napt_variation = _variation_top && _is_napt;
+    if (nshards > 1 && !napt_variation
+	&& IPRewriterBase::shard_of(rewritten_flowid, nshards) != shard)
+	return IPRewriterBase::rw_drop;
+
     if (_variation_top) {
 	IPFlowID lookup = rewritten_flowid.reverse();
 	uint32_t base = (_is_napt ? ntohs(_sport) : ntohl(_saddr.addr()));
@@ -239,7 +248,9 @@ IPRewriterPattern::rewrite_flowid(const IPFlowID &flowid,
 	if (_same_first
 	    && (val = ntohs(flowid.sport()) - base) <= _variation_top) {
 	    lookup.set_dport(flowid.sport());
-	    if (!reply_map.find(lookup))
+	    if ((nshards == 1
+		 || IPRewriterBase::shard_of(lookup, nshards) == shard)
+		&& !reply_map.get(lookup))
 		goto found_variation;
 	}
 
@@ -254,7 +265,9 @@ IPRewriterPattern::rewrite_flowid(const IPFlowID &flowid,
 		lookup.set_dport(htons(base + val));
 	    else
 		lookup.set_daddr(htonl(base + val));
-	    if (!reply_map.find(lookup))
+	    if ((!napt_variation || nshards == 1
+		 || IPRewriterBase::shard_of(lookup, nshards) == shard)
+		&& !reply_map.get(lookup))
 		goto found_variation;
 	}
 
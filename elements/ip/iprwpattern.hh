@@ -2,11 +2,11 @@
 #ifndef CLICK_IPRW_PATTERN_HH
 #define CLICK_IPRW_PATTERN_HH
 #include <click/element.hh>
-#include <click/hashcontainer.hh>
 #include <click/ipflowid.hh>
 CLICK_DECLS
 class IPRewriterFlow;
 class IPRewriterEntry;
+class IPRewriterFlowMap;
 class IPRewriterInput;
 
 class IPRewriterPattern { public:
@@ -38,7 +38,8 @@ class IPRewriterPattern { public:
     }
 
     int rewrite_flowid(const IPFlowID &flowid, IPFlowID &rewritten_flowid,
-		       const HashContainer<IPRewriterEntry> &reply_map);
+		       const IPRewriterFlowMap &reply_map,
+		       int shard, int nshards);
 
     String unparse() const;
 
@@ -50,7 +51,7 @@ class IPRewriterPattern { public:
     int _dport;			// net byte order
 
     uint32_t _variation_top;
-    uint32_t _next_variation;
+    uint32_t _next_variation;	// a hint, so racing shards are harmless
 
     bool _is_napt;
     bool _sequential;
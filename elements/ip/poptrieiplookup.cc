@@ -0,0 +1,703 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * poptrieiplookup.{cc,hh} -- IP routing lookup using a Poptrie
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "poptrieiplookup.hh"
+#include <click/ipaddress.hh>
+#include <click/straccum.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+CLICK_DECLS
+
+static inline uint32_t
+prefix_mask(int plen)
+{
+    return plen ? 0xFFFFFFFFU << (32 - plen) : 0;
+}
+
+PoptrieIPLookup::PoptrieIPLookup()
+    : _trie(0), _w(0), _dir_route(0)
+{
+#if CLICK_POPTRIE_POPCNT
+    __builtin_cpu_init();
+    _popcnt = __builtin_cpu_supports("popcnt");
+#endif
+}
+
+PoptrieIPLookup::~PoptrieIPLookup()
+{
+    // IPRouteTable::cleanup() has reclaimed any tries replaced by _trie
+    free_trie(_trie, 0);
+    delete[] _dir_route;
+}
+
+int
+PoptrieIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _trie = _w = make_trie();
+    _dir_route = new int[1 << dir_bits];
+    if (!_trie || !_dir_route)
+	return errh->error("out of memory");
+    clear();
+    return IPRouteTable::configure(conf, errh);
+}
+
+PoptrieIPLookup::Trie *
+PoptrieIPLookup::make_trie()
+{
+    Trie *t = new Trie;
+    t->dir = new uint32_t[1 << dir_bits];
+    t->nodes_capacity = 1024;
+    t->nodes = new Node[t->nodes_capacity];
+    t->leaves_capacity = 4096;
+    t->leaves = new uint16_t[t->leaves_capacity];
+    t->nexthops_capacity = 16;
+    t->nexthops = new NextHop[t->nexthops_capacity];
+    if (!t->dir || !t->nodes || !t->leaves || !t->nexthops) {
+	free_trie(t, 0);
+	return 0;
+    }
+
+    for (int s = 0; s < (1 << dir_bits); ++s)
+	t->dir[s] = leaf_flag;
+    t->nodes_size = t->leaves_size = 0;
+    t->nnodes = t->nleaves = 0;
+    t->nexthops[0].gw = IPAddress();
+    t->nexthops[0].port = -1;
+    t->nexthops[0].refcount = 1;
+    t->nexthops_size = 1;
+    t->successor = 0;
+    return t;
+}
+
+void
+PoptrieIPLookup::free_trie(void *thunk, uintptr_t)
+{
+    if (Trie *t = static_cast<Trie *>(thunk)) {
+	delete[] t->dir;
+	delete[] t->nodes;
+	delete[] t->leaves;
+	delete[] t->nexthops;
+	delete t;
+    }
+}
+
+/* Replace _w with a copy with room for at least nodes more nodes, leaves
+   more leaves, and nexthops more next hops.  Lookups may be reading _w, so
+   it is freed after a grace period. */
+void
+PoptrieIPLookup::grow(uint32_t nodes, uint32_t leaves, int nexthops)
+{
+    Trie *t = _w, *nt = new Trie;
+    nt->nodes_capacity = t->nodes_capacity;
+    while (t->nodes_size + nodes > nt->nodes_capacity)
+	nt->nodes_capacity *= 2;
+    nt->leaves_capacity = t->leaves_capacity;
+    while (t->leaves_size + leaves > nt->leaves_capacity)
+	nt->leaves_capacity *= 2;
+    nt->nexthops_capacity = t->nexthops_capacity;
+    while (t->nexthops_size + nexthops > nt->nexthops_capacity)
+	nt->nexthops_capacity *= 2;
+
+    nt->dir = new uint32_t[1 << dir_bits];
+    memcpy(nt->dir, t->dir, sizeof(uint32_t) << dir_bits);
+    nt->nodes = new Node[nt->nodes_capacity];
+    memcpy(nt->nodes, t->nodes, t->nodes_size * sizeof(Node));
+    nt->leaves = new uint16_t[nt->leaves_capacity];
+    memcpy(nt->leaves, t->leaves, t->leaves_size * sizeof(uint16_t));
+    nt->nexthops = new NextHop[nt->nexthops_capacity];
+    memcpy(nt->nexthops, t->nexthops, t->nexthops_size * sizeof(NextHop));
+    nt->nodes_size = t->nodes_size;
+    nt->leaves_size = t->leaves_size;
+    nt->nexthops_size = t->nexthops_size;
+    nt->nnodes = t->nnodes;
+    nt->nleaves = t->nleaves;
+    for (int n = 0; n <= 64; ++n) {
+	nt->free_nodes[n].swap(t->free_nodes[n]);
+	nt->free_leaves[n].swap(t->free_leaves[n]);
+    }
+    nt->successor = 0;
+
+    // Space that t's pending reclamations return goes to nt.
+    t->successor = nt;
+    if (t == _trie) {
+	click_fence();
+	_trie = nt;
+    }
+    _rcu.defer(free_trie, t);
+    _w = nt;
+}
+
+void
+PoptrieIPLookup::clear()
+{
+    for (int s = 0; s < (1 << dir_bits); ++s)
+	_dir_route[s] = -1;
+    _routes.clear();
+    _free_routes.clear();
+    for (int plen = 0; plen <= 32; ++plen)
+	_prefixes[plen].clear();
+    _long_routes.clear();
+}
+
+
+// LOOKUP
+
+inline int
+PoptrieIPLookup::lookup(const Trie *t, uint32_t addr) const
+{
+#if CLICK_POPTRIE_POPCNT
+    if (_popcnt)
+	return lookup_popcnt(t, addr);
+#endif
+    return lookup_nexthop(t->dir, t->nodes, t->leaves, addr);
+}
+
+#if CLICK_POPTRIE_POPCNT
+int
+PoptrieIPLookup::lookup_popcnt(const Trie *t, uint32_t addr) const
+{
+    return lookup_nexthop(t->dir, t->nodes, t->leaves, addr);
+}
+#endif
+
+int
+PoptrieIPLookup::lookup_route(IPAddress dest, IPAddress &gw) const
+{
+    const Trie *t = _trie;
+    const NextHop &nh = t->nexthops[lookup(t, ntohl(dest.addr()))];
+    gw = nh.gw;
+    return nh.port;
+}
+
+void
+PoptrieIPLookup::push(int, Packet *p)
+{
+    const Trie *t = _trie;
+    const NextHop &nh = t->nexthops[lookup(t, ntohl(p->dst_ip_anno().addr()))];
+    if (nh.port >= 0) {
+	if (nh.gw)
+	    p->set_dst_ip_anno(nh.gw);
+	output(nh.port).push(p);
+    } else
+	p->kill();
+}
+
+inline void
+PoptrieIPLookup::route_batch(PacketBatch &batch)
+{
+    // Look up prefetch_window packets at a time in three passes: prefetch
+    // each packet's _dir entry, then the root node it points to, if any,
+    // then walk the tries.  The window's cache misses overlap.
+    const Trie *t = _trie;
+    const uint32_t *dir = t->dir;
+    const Node *nodes = t->nodes;
+    const uint16_t *leaves = t->leaves;
+    const NextHop *nexthops = t->nexthops;
+    Packet *window[prefetch_window];
+    uint32_t addr[prefetch_window];
+    PacketBatch run;
+    int run_port = -1;
+
+    while (!batch.empty()) {
+	int n = 0;
+	while (n < prefetch_window && (window[n] = batch.pop_front())) {
+	    addr[n] = ntohl(window[n]->dst_ip_anno().addr());
+	    click_prefetch(&dir[addr[n] >> (32 - dir_bits)]);
+	    ++n;
+	}
+
+	for (int i = 0; i < n; ++i) {
+	    uint32_t ref = dir[addr[i] >> (32 - dir_bits)];
+	    if (!(ref & leaf_flag))
+		click_prefetch(&nodes[ref]);
+	}
+
+	for (int i = 0; i < n; ++i) {
+	    const NextHop &nh = nexthops[lookup_nexthop(dir, nodes, leaves, addr[i])];
+	    Packet *p = window[i];
+	    if (nh.port < 0) {
+		p->kill();
+		continue;
+	    }
+	    if (nh.gw)
+		p->set_dst_ip_anno(nh.gw);
+	    if (nh.port != run_port && !run.empty())
+		output(run_port).push_batch(run);
+	    run_port = nh.port;
+	    run.push_back(p);
+	}
+    }
+
+    if (!run.empty())
+	output(run_port).push_batch(run);
+}
+
+void
+PoptrieIPLookup::route_batch_generic(PacketBatch &batch)
+{
+    route_batch(batch);
+}
+
+#if CLICK_POPTRIE_POPCNT
+void
+PoptrieIPLookup::route_batch_popcnt(PacketBatch &batch)
+{
+    route_batch(batch);
+}
+#endif
+
+void
+PoptrieIPLookup::push_batch(int, PacketBatch &batch)
+{
+#if CLICK_POPTRIE_POPCNT
+    if (_popcnt) {
+	route_batch_popcnt(batch);
+	return;
+    }
+#endif
+    route_batch_generic(batch);
+}
+
+
+// UPDATES
+
+/* Return a next hop for gw and port, creating it if necessary, or -1 if
+   there are too many next hops.  A next hop whose last route went away may
+   still be read by lookups, so it is reused only after a grace period. */
+int
+PoptrieIPLookup::find_nexthop(IPAddress gw, int port)
+{
+    NextHop *nh = _w->nexthops;
+    int free = -1;
+    for (int i = 1; i < _w->nexthops_size; ++i)
+	if (nh[i].refcount < 0)
+	    free = i;
+	else if (nh[i].refcount && nh[i].gw == gw && nh[i].port == port) {
+	    ++nh[i].refcount;
+	    return i;
+	}
+    if (free < 0) {
+	if (_w->nexthops_size > max_nexthops)
+	    return -1;
+	if (_w->nexthops_size == _w->nexthops_capacity)
+	    grow(0, 0, 1);
+	nh = _w->nexthops;
+	free = _w->nexthops_size++;
+    }
+    nh[free].gw = gw;
+    nh[free].port = port;
+    nh[free].refcount = 1;
+    return free;
+}
+
+void
+PoptrieIPLookup::unref_nexthop(int nexthop)
+{
+    if (--_w->nexthops[nexthop].refcount == 0)
+	_rcu.defer(free_nexthop, _w, nexthop);
+}
+
+void
+PoptrieIPLookup::free_nexthop(void *thunk, uintptr_t nexthop)
+{
+    current(static_cast<Trie *>(thunk))->nexthops[nexthop].refcount = -1;
+}
+
+int
+PoptrieIPLookup::find_route(uint32_t addr, int plen) const
+{
+    HashTable<uint32_t, int>::const_iterator it = _prefixes[plen].find(addr);
+    return it ? it.value() : -1;
+}
+
+/* Return the route with the longest prefix of at most plen bits that
+   contains addr, or -1 if there is none. */
+int
+PoptrieIPLookup::covering_route(uint32_t addr, int plen) const
+{
+    for (; plen >= 0; --plen) {
+	int r = find_route(addr & prefix_mask(plen), plen);
+	if (r >= 0)
+	    return r;
+    }
+    return -1;
+}
+
+/* Allocate n contiguous nodes.  The free lists hold only space that no
+   lookup can reach, so it may be overwritten at once.  Allocating may grow
+   _w, so callers must not keep pointers into its arrays. */
+uint32_t
+PoptrieIPLookup::alloc_nodes(int n)
+{
+    if (!n)
+	return 0;
+    Trie *t = _w;
+    t->nnodes += n;
+    if (t->free_nodes[n].size()) {
+	uint32_t x = t->free_nodes[n].back();
+	t->free_nodes[n].pop_back();
+	return x;
+    }
+    if (t->nodes_size + n > t->nodes_capacity) {
+	grow(n, 0, 0);
+	t = _w;
+    }
+    t->nodes_size += n;
+    return t->nodes_size - n;
+}
+
+uint32_t
+PoptrieIPLookup::alloc_leaves(int n)
+{
+    if (!n)
+	return 0;
+    Trie *t = _w;
+    t->nleaves += n;
+    if (t->free_leaves[n].size()) {
+	uint32_t x = t->free_leaves[n].back();
+	t->free_leaves[n].pop_back();
+	return x;
+    }
+    if (t->leaves_size + n > t->leaves_capacity) {
+	grow(0, n, 0);
+	t = _w;
+    }
+    t->leaves_size += n;
+    return t->leaves_size - n;
+}
+
+void
+PoptrieIPLookup::free_children(Trie *t, uint32_t node)
+{
+    Node n = t->nodes[node];
+    int nchildren = popcount(n.vector), nleaves = popcount(n.leafvec);
+    for (int k = 0; k < nchildren; ++k)
+	free_children(t, n.base1 + k);
+    if (nchildren) {
+	t->free_nodes[nchildren].push_back(n.base1);
+	t->nnodes -= nchildren;
+    }
+    if (nleaves) {
+	t->free_leaves[nleaves].push_back(n.base0);
+	t->nleaves -= nleaves;
+    }
+}
+
+/* Return the trie rooted at node root, which lookups can no longer reach,
+   to the free lists. */
+void
+PoptrieIPLookup::free_slot(void *thunk, uintptr_t root)
+{
+    Trie *t = current(static_cast<Trie *>(thunk));
+    free_children(t, root);
+    t->free_nodes[1].push_back(root);
+    --t->nnodes;
+}
+
+/* Fill in node, at depth bits, from routes, which are the routes longer
+   than depth bits under the node in increasing prefix length order.
+   nexthop is the next hop for addresses no route matches. */
+void
+PoptrieIPLookup::build_node(uint32_t node, const Vector<int> &routes,
+			    int depth, int nexthop)
+{
+    uint16_t leaf[64];
+    for (int v = 0; v < 64; ++v)
+	leaf[v] = nexthop;
+    uint64_t vector = 0;
+    int shift = 64 - depth - stride;
+    for (const int *r = routes.begin(); r != routes.end(); ++r) {
+	const Route &rt = _routes[*r];
+	uint64_t key = (uint64_t) ntohl(rt.route.addr.addr()) << 32;
+	int v = (key >> shift) & 63;
+	if (rt.plen <= depth + stride) {
+	    for (int n = 1 << (depth + stride - rt.plen); n; --n, ++v)
+		leaf[v] = rt.nexthop;
+	} else
+	    vector |= (uint64_t) 1 << v;
+    }
+
+    // Compress runs of equal leaves, skipping over child nodes.
+    uint64_t leafvec = 0;
+    uint16_t runs[64];
+    int nruns = 0;
+    for (int v = 0; v < 64; ++v)
+	if (!((vector >> v) & 1) && (!nruns || leaf[v] != runs[nruns - 1])) {
+	    leafvec |= (uint64_t) 1 << v;
+	    runs[nruns++] = leaf[v];
+	}
+
+    uint32_t base0 = alloc_leaves(nruns);
+    if (nruns)
+	memcpy(&_w->leaves[base0], runs, nruns * sizeof(uint16_t));
+    uint32_t base1 = alloc_nodes(popcount(vector));
+    Node &n = _w->nodes[node];
+    n.vector = vector;
+    n.leafvec = leafvec;
+    n.base0 = base0;
+    n.base1 = base1;
+
+    Vector<int> subroutes;
+    for (int v = 0; v < 64; ++v)
+	if ((vector >> v) & 1) {
+	    subroutes.clear();
+	    for (const int *r = routes.begin(); r != routes.end(); ++r) {
+		const Route &rt = _routes[*r];
+		uint64_t key = (uint64_t) ntohl(rt.route.addr.addr()) << 32;
+		if (rt.plen > depth + stride && (int) ((key >> shift) & 63) == v)
+		    subroutes.push_back(*r);
+	    }
+	    build_node(base1, subroutes, depth + stride, leaf[v]);
+	    ++base1;
+	}
+}
+
+int
+PoptrieIPLookup::plen_compar(const void *a, const void *b, void *thunk)
+{
+    const Vector<Route> &routes = *static_cast<const Vector<Route> *>(thunk);
+    return routes[*static_cast<const int *>(a)].plen
+	- routes[*static_cast<const int *>(b)].plen;
+}
+
+/* Rebuild the dir entry, and any trie, for the /18 network slot.  The new
+   trie is built in free space, so lookups see either the old trie or the
+   new one; the old trie is freed after a grace period. */
+void
+PoptrieIPLookup::rebuild_slot(uint32_t slot)
+{
+    int nexthop = (_dir_route[slot] >= 0 ? _routes[_dir_route[slot]].nexthop : 0);
+    uint32_t ref = leaf_flag | nexthop;
+    HashTable<uint32_t, Vector<int> >::iterator it = _long_routes.find(slot);
+    if (it) {
+	Vector<int> routes(it.value());
+	click_qsort(routes.begin(), routes.size(), sizeof(int), plen_compar, &_routes);
+	ref = alloc_nodes(1);
+	build_node(ref, routes, dir_bits, nexthop);
+    }
+
+    click_fence();
+    uint32_t old = _w->dir[slot];
+    _w->dir[slot] = ref;
+    if (!(old & leaf_flag))
+	_rcu.defer(free_slot, _w, old);
+}
+
+/* Rebuild the slots covered by the prefix addr/plen, plen <= dir_bits, whose
+   covering route changes from old_route to new_route.  If old_route is
+   negative, new_route was just added. */
+void
+PoptrieIPLookup::update_slots(uint32_t addr, int plen, int old_route,
+			      int new_route)
+{
+    uint32_t slot = addr >> (32 - dir_bits);
+    uint32_t end = slot + (1U << (dir_bits - plen));
+    for (; slot != end; ++slot) {
+	int cur = _dir_route[slot];
+	if (old_route >= 0 ? cur == old_route
+	    : cur < 0 || _routes[cur].plen < plen) {
+	    _dir_route[slot] = new_route;
+	    rebuild_slot(slot);
+	}
+    }
+}
+
+int
+PoptrieIPLookup::add_route(const IPRoute &route, bool set, IPRoute *old_route, ErrorHandler *errh)
+{
+    int plen = route.prefix_len();
+    if (plen < 0)
+	return errh->error("%s: mask is not a prefix", route.unparse_addr().c_str());
+    uint32_t addr = ntohl(route.addr.addr()) & prefix_mask(plen);
+
+    int r = find_route(addr, plen);
+    if (r >= 0 && old_route)
+	*old_route = _routes[r].route;
+    if (r >= 0 && !set)
+	return -EEXIST;
+
+    int nexthop = find_nexthop(route.gw, route.port);
+    if (nexthop < 0)
+	return errh->error("too many next hops");
+
+    bool replace = (r >= 0);
+    int old_nexthop = 0;
+    if (replace)
+	old_nexthop = _routes[r].nexthop;
+    else if (_free_routes.size()) {
+	r = _free_routes.back();
+	_free_routes.pop_back();
+    } else {
+	r = _routes.size();
+	_routes.push_back(Route());
+    }
+    _routes[r].route = route;
+    _routes[r].plen = plen;
+    _routes[r].nexthop = nexthop;
+
+    uint32_t slot = addr >> (32 - dir_bits);
+    if (replace) {
+	if (plen <= dir_bits)
+	    update_slots(addr, plen, r, r);
+	else
+	    rebuild_slot(slot);
+	unref_nexthop(old_nexthop);
+    } else {
+	_prefixes[plen][addr] = r;
+	if (plen <= dir_bits)
+	    update_slots(addr, plen, -1, r);
+	else {
+	    _long_routes[slot].push_back(r);
+	    rebuild_slot(slot);
+	}
+    }
+    return 0;
+}
+
+int
+PoptrieIPLookup::remove_route(const IPRoute &route, IPRoute *old_route, ErrorHandler *)
+{
+    int plen = route.prefix_len();
+    if (plen < 0)
+	return -ENOENT;
+    uint32_t addr = ntohl(route.addr.addr()) & prefix_mask(plen);
+
+    int r = find_route(addr, plen);
+    if (r >= 0 && old_route)
+	*old_route = _routes[r].route;
+    if (r < 0 || !route.match(_routes[r].route))
+	return -ENOENT;
+
+    _prefixes[plen].erase(addr);
+    uint32_t slot = addr >> (32 - dir_bits);
+    if (plen <= dir_bits)
+	update_slots(addr, plen, r, plen ? covering_route(addr, plen - 1) : -1);
+    else {
+	HashTable<uint32_t, Vector<int> >::iterator it = _long_routes.find(slot);
+	Vector<int> &v = it.value();
+	for (int *x = v.begin(); x != v.end(); ++x)
+	    if (*x == r) {
+		*x = v.back();
+		v.pop_back();
+		break;
+	    }
+	if (v.empty())
+	    _long_routes.erase(it);
+	rebuild_slot(slot);
+    }
+
+    unref_nexthop(_routes[r].nexthop);
+    _routes[r].nexthop = -1;
+    _free_routes.push_back(r);
+    return 0;
+}
+
+String
+PoptrieIPLookup::dump_routes()
+{
+    StringAccum sa;
+    for (int i = 0; i < _routes.size(); ++i)
+	if (_routes[i].nexthop >= 0)
+	    _routes[i].route.unparse(sa, true) << '\n';
+    return sa.take_string();
+}
+
+/* Build a new trie from routes and switch to it.  The routes are checked
+   first, so that building cannot fail halfway. */
+int
+PoptrieIPLookup::load_routes(const Vector<IPRoute> &routes, ErrorHandler *errh)
+{
+    Vector<IPRoute> unique;
+    HashTable<uint64_t, int> prefix_index(-1);
+    for (const IPRoute *r = routes.begin(); r != routes.end(); ++r) {
+	int plen = r->prefix_len();
+	if (plen < 0)
+	    return errh->error("%s: mask is not a prefix", r->unparse_addr().c_str());
+	uint64_t key = ((uint64_t) (ntohl(r->addr.addr()) & prefix_mask(plen)) << 6) | plen;
+	int &i = prefix_index[key];
+	if (i < 0) {
+	    i = unique.size();
+	    unique.push_back(*r);
+	} else
+	    unique[i] = *r;
+    }
+
+    HashTable<uint64_t, int> nexthops;
+    for (const IPRoute *r = unique.begin(); r != unique.end(); ++r)
+	nexthops[((uint64_t) r->gw.addr() << 32) | (uint32_t) r->port] = 1;
+    if (nexthops.size() > max_nexthops)
+	return errh->error("too many next hops");
+
+    Trie *nt = make_trie();
+    if (!nt)
+	return errh->error("out of memory");
+    _w = nt;
+    clear();
+    for (const IPRoute *r = unique.begin(); r != unique.end(); ++r)
+	add_route(*r, true, 0, errh);
+
+    // add_route() may have replaced nt with a larger copy
+    Trie *old = _trie;
+    click_fence();
+    _trie = _w;
+    _rcu.defer(free_trie, old);
+    return 0;
+}
+
+int
+PoptrieIPLookup::flush_handler(const String &, Element *e, void *,
+			       ErrorHandler *errh)
+{
+    PoptrieIPLookup *t = static_cast<PoptrieIPLookup *>(e);
+    t->begin_update();
+    int r = t->load_routes(Vector<IPRoute>(), errh);
+    t->end_update();
+    return r;
+}
+
+String
+PoptrieIPLookup::stats_handler(Element *e, void *)
+{
+    PoptrieIPLookup *t = static_cast<PoptrieIPLookup *>(e);
+    t->begin_update();
+    const Trie *tr = t->_w;
+    int nnexthops = 0;
+    for (int i = 1; i < tr->nexthops_size; ++i)
+	nnexthops += (tr->nexthops[i].refcount > 0);
+    StringAccum sa;
+    sa << "routes " << (t->_routes.size() - t->_free_routes.size()) << '\n'
+       << "nexthops " << nnexthops << '\n'
+       << "nodes " << tr->nnodes << '\n'
+       << "leaves " << tr->nleaves << '\n'
+       << "memory " << ((1 << dir_bits) * sizeof(uint32_t)
+			+ tr->nodes_size * sizeof(Node)
+			+ tr->leaves_size * sizeof(uint16_t)
+			+ tr->nexthops_size * sizeof(NextHop)) << '\n';
+    t->end_update();
+    return sa.take_string();
+}
+
+void
+PoptrieIPLookup::add_handlers()
+{
+    IPRouteTable::add_handlers();
+    add_write_handler("flush", flush_handler, 0, Handler::BUTTON);
+    add_read_handler("stats", stats_handler, 0);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPRouteTable)
+EXPORT_ELEMENT(PoptrieIPLookup)
@@ -0,0 +1,272 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_POPTRIEIPLOOKUP_HH
+#define CLICK_POPTRIEIPLOOKUP_HH
+#if CLICK_USERLEVEL && (defined(__x86_64__) || defined(__i386__)) && __GNUC__ >= 5
+# define CLICK_POPTRIE_POPCNT 1
+#endif
+#include <click/hashtable.hh>
+#include "iproutetable.hh"
+CLICK_DECLS
+
+/*
+=c
+
+PoptrieIPLookup(ADDR1/MASK1 [GW1] OUT1, ADDR2/MASK2 [GW2] OUT2, ...)
+
+=s iproute
+
+IP routing lookup using a compressed multibit trie
+
+=d
+
+Expects a destination IP address annotation with each packet. Looks up that
+address in its routing table, using longest-prefix-match, sets the destination
+annotation to the corresponding GW (if specified), and emits the packet on the
+indicated OUTput port.
+
+Each argument is a route, specifying a destination and mask, an optional
+gateway IP address, and an output port.
+
+PoptrieIPLookup implements the Poptrie lookup scheme of Asai and Ohara, cited
+below.  A direct-indexed table on the top 18 address bits points either to a
+next hop or to a trie of 64-way nodes, each of which consumes 6 more bits.
+Nodes do not store their children's pointers; instead, each node has a
+bitmap of which children are nodes, and another marking where runs of equal
+next hops begin among the leaf children.  A population count of the bits up
+to the child's index locates the child in a contiguous array.  Most lookups
+for routes of up to 24 bits touch one table entry, one node, and one leaf.
+
+A full BGP table fits in a few megabytes, small enough for a processor's
+L2 and L3 caches, yet routes can be added and removed quickly: a change
+rebuilds only the tries under the /18 networks the route overlaps.  On x86
+processors that support it, PoptrieIPLookup uses the C<popcnt> instruction.
+
+Routes may be changed while the router runs with several threads.  Lookups
+take no locks: an update builds a /18 network's new trie in unused nodes and
+leaves, switches the table entry to it, and reuses the old trie's space only
+once no lookup can still be using it.  When the node, leaf, or next hop array
+fills up, the update copies the lookup structures into larger arrays and
+switches to the copy.  The C<flush> and C<load> handlers build new lookup
+structures and switch to them in one store.
+
+Uses the IPRouteTable interface; see IPRouteTable for description.
+
+=h table read-only
+
+Outputs a human-readable version of the current routing table.
+
+=h lookup read-only
+
+Reports the OUTput port and GW corresponding to an address.
+
+=h add write-only
+
+Adds a route to the table. Format should be `C<ADDR/MASK [GW] OUT>'.
+Fails if a route for C<ADDR/MASK> already exists.
+
+=h set write-only
+
+Sets a route, whether or not a route for the same prefix already exists.
+
+=h remove write-only
+
+Removes a route from the table. Format should be `C<ADDR/MASK>'.
+
+=h ctrl write-only
+
+Adds or removes a group of routes. Write `C<add>/C<set ADDR/MASK [GW] OUT>' to
+add a route, and `C<remove ADDR/MASK>' to remove a route. You can supply
+multiple commands, one per line; all commands are executed as one atomic
+operation.
+
+=h flush write-only
+
+Clears the entire routing table in a single atomic operation.
+
+=h load write-only
+
+Replaces the entire routing table in a single atomic operation.  Write the new
+routes in `C<ADDR/MASK [GW] OUT>' format, one per line or separated by
+commas.  If the same prefix appears more than once, the last route wins.
+
+=h load_file write-only
+
+Replaces the routing table with the routes in the named file, as C<load>
+does.
+
+=h stats read-only
+
+Returns the number of routes, next hops, trie nodes, and leaves, and the bytes
+used by the lookup structures.
+
+=n
+
+PoptrieIPLookup supports at most 65535 distinct GW, OUT pairs.
+
+=a IPRouteTable, DirectIPLookup, RangeIPLookup, RadixIPLookup,
+IPLookupBenchmark
+
+Hirochika Asai and Yasuhiro Ohara.  "Poptrie: A Compressed Trie with
+Population Count for Fast and Scalable Software IP Routing Table Lookup".
+In Proc. ACM SIGCOMM 2015, pp. 57-70.
+*/
+
+class PoptrieIPLookup : public IPRouteTable { public:
+
+    PoptrieIPLookup();
+    ~PoptrieIPLookup();
+
+    const char *class_name() const	{ return "PoptrieIPLookup"; }
+    const char *port_count() const	{ return "1/-"; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    void push_batch(int port, PacketBatch &batch);
+
+    int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
+    int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
+    int lookup_route(IPAddress, IPAddress&) const;
+    String dump_routes();
+    int load_routes(const Vector<IPRoute>&, ErrorHandler *);
+
+    static int flush_handler(const String &, Element *, void *, ErrorHandler *);
+    static String stats_handler(Element *, void *);
+
+  private:
+
+    enum {
+	dir_bits = 18,		// address bits indexed by dir
+	stride = 6,		// address bits consumed by each node
+	max_nexthops = 65535,
+	prefetch_window = 16	// packets per push_batch lookup window
+    };
+    enum { leaf_flag = 0x80000000U }; // dir entry holds a next hop
+
+    struct Node {
+	uint64_t vector;	// bit i set: child i is a node
+	uint64_t leafvec;	// bit i set: a run of leaves starts at child i
+	uint32_t base0;		// first leaf in leaves
+	uint32_t base1;		// first child node in nodes
+    };
+
+    struct NextHop {
+	IPAddress gw;
+	int port;
+	int refcount;		// 0: unused, but lookups may see it; -1: free
+    };
+
+    struct Route {
+	IPRoute route;
+	int plen;
+	int nexthop;		// index into nexthops, or -1 if free
+    };
+
+    // Lookup structures.  Updates change a Trie only where lookups cannot
+    // see, and replace it with a larger copy when an array fills up.
+    struct Trie {
+	uint32_t *dir;
+	Node *nodes;
+	uint16_t *leaves;
+	NextHop *nexthops;	// nexthops[0] is "no route"
+	uint32_t nodes_size;
+	uint32_t nodes_capacity;
+	uint32_t leaves_size;
+	uint32_t leaves_capacity;
+	int nexthops_size;
+	int nexthops_capacity;
+	int nnodes;		// nodes in use
+	int nleaves;		// leaves in use
+	Vector<int> free_nodes[65];
+	Vector<int> free_leaves[65];
+	Trie *successor;	// copy that replaced this trie
+    };
+
+    Trie *volatile _trie;	// published trie
+    Trie *_w;			// trie being updated: _trie, or a new one
+
+    // Update structures.
+    Vector<Route> _routes;
+    Vector<int> _free_routes;
+    HashTable<uint32_t, int> _prefixes[33]; // prefix address -> route
+    HashTable<uint32_t, Vector<int> > _long_routes; // /18 -> longer routes
+    int *_dir_route;		// covering route of up to 18 bits, or -1
+
+    static inline int popcount(uint64_t x) {
+#if __GNUC__
+	return __builtin_popcountll(x);
+#else
+	x -= (x >> 1) & 0x5555555555555555ULL;
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (x * 0x0101010101010101ULL) >> 56;
+#endif
+    }
+    static inline int lookup_nexthop(const uint32_t *dir, const Node *nodes,
+				     const uint16_t *leaves, uint32_t addr);
+    inline int lookup(const Trie *t, uint32_t addr) const;
+#if CLICK_POPTRIE_POPCNT
+    // Always inlined, so that route_batch_popcnt() runs a POPCNT copy.
+    inline void route_batch(PacketBatch &batch) __attribute__((always_inline));
+#else
+    inline void route_batch(PacketBatch &batch);
+#endif
+    void route_batch_generic(PacketBatch &batch);
+#if CLICK_POPTRIE_POPCNT
+    int lookup_popcnt(const Trie *t, uint32_t addr) const
+	__attribute__((target("popcnt")));
+    void route_batch_popcnt(PacketBatch &batch)
+	__attribute__((target("popcnt")));
+    bool _popcnt;
+#endif
+
+    static Trie *make_trie();
+    static void free_trie(void *, uintptr_t);
+    static void free_slot(void *, uintptr_t);
+    static void free_nexthop(void *, uintptr_t);
+    static Trie *current(Trie *t) {
+	while (t->successor)
+	    t = t->successor;
+	return t;
+    }
+    void grow(uint32_t nodes, uint32_t leaves, int nexthops);
+
+    int find_nexthop(IPAddress gw, int port);
+    void unref_nexthop(int nexthop);
+    int find_route(uint32_t addr, int plen) const;
+    int covering_route(uint32_t addr, int plen) const;
+    uint32_t alloc_nodes(int n);
+    uint32_t alloc_leaves(int n);
+    static void free_children(Trie *t, uint32_t node);
+    void build_node(uint32_t node, const Vector<int> &routes, int depth,
+		    int nexthop);
+    void rebuild_slot(uint32_t slot);
+    void update_slots(uint32_t addr, int plen, int old_route, int new_route);
+    void clear();
+    static int plen_compar(const void *a, const void *b, void *thunk);
+
+};
+
+inline int
+PoptrieIPLookup::lookup_nexthop(const uint32_t *dir, const Node *nodes,
+				const uint16_t *leaves, uint32_t addr)
+{
+    uint32_t ref = dir[addr >> (32 - dir_bits)];
+    if (ref & leaf_flag)
+	return ref & ~leaf_flag;
+    uint64_t key = (uint64_t) addr << 32;
+    int shift = 64 - dir_bits - stride;
+    const Node *n = &nodes[ref];
+    int v = (key >> shift) & 63;
+    while ((n->vector >> v) & 1) {
+	n = &nodes[n->base1 + popcount(n->vector & (((uint64_t) 2 << v) - 1)) - 1];
+	shift -= stride;
+	v = (key >> shift) & 63;
+    }
+    return leaves[n->base0 + popcount(n->leafvec & (((uint64_t) 2 << v) - 1)) - 1];
+}
+
+CLICK_ENDDECLS
+#endif
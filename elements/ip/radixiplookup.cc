@@ -103,13 +103,16 @@ RadixIPLookup::Radix::change(uint32_t addr, uint32_t mask, int key, bool set)
 
     // check if change only affects children
     if (mask & ((1U << _bitshift) - 1)) {
-	if (!_children[i1].child
-	    && (_children[i1].child = make_radix(_bitshift - 4, 16)))
+	if (!_children[i1].child) {
+	    Radix *child = make_radix(_bitshift - 4, 16);
+	    if (!child)
+		return 0;
+	    // lookups may follow the pointer as soon as it is stored
+	    click_fence();
+	    _children[i1].child = child;
 	    ++_nchildren;
-	if (_children[i1].child)
-	    return _children[i1].child->change(addr, mask, key, set);
-	else
-	    return 0;
+	}
+	return _children[i1].child->change(addr, mask, key, set);
     }
 
     // find current key
@@ -134,8 +137,66 @@ RadixIPLookup::Radix::change(uint32_t addr, uint32_t mask, int key, bool set)
 }
 
 
+/* A routing table.  Trie keys are 1 + indexes into the route array, which is
+   split into fixed-size chunks so that it can grow without moving routes
+   that lookups are reading.  A route slot is live if its extra is -1,
+   retired if -2, and otherwise free, linking to the next free slot. */
+struct RadixIPLookup::Table {
+    enum { chunk_shift = 12, chunk_size = 1 << chunk_shift,
+	   max_chunks = 2048 };
+
+    Radix *radix;
+    int default_key;
+    int nroutes;		// slots ever used
+    int vfree;			// first free slot, or -1
+    IPRoute *chunks[max_chunks];
+
+    IPRoute &route(int i) const {
+	return chunks[i >> chunk_shift][i & (chunk_size - 1)];
+    }
+};
+
+RadixIPLookup::Table *
+RadixIPLookup::make_table()
+{
+    Table *t = new Table;
+    if (t && !(t->radix = Radix::make_radix(24, 256))) {
+	delete t;
+	t = 0;
+    }
+    if (t) {
+	t->default_key = 0;
+	t->nroutes = 0;
+	t->vfree = -1;
+	memset(t->chunks, 0, sizeof(t->chunks));
+    }
+    return t;
+}
+
+void
+RadixIPLookup::free_table(void *thunk, uintptr_t)
+{
+    if (Table *t = static_cast<Table *>(thunk)) {
+	Radix::free_radix(t->radix);
+	for (int c = 0; c < Table::max_chunks && t->chunks[c]; ++c)
+	    delete[] t->chunks[c];
+	delete t;
+    }
+}
+
+void
+RadixIPLookup::free_route(void *thunk, uintptr_t i)
+{
+    Table *t = static_cast<Table *>(thunk);
+    IPRoute &r = t->route(i);
+    r.kill();
+    r.extra = t->vfree;
+    t->vfree = i;
+}
+
+
 RadixIPLookup::RadixIPLookup()
-    : _vfree(-1), _default_key(0), _radix(Radix::make_radix(24, 256))
+    : _t(make_table())
 {
 }
 
@@ -145,11 +206,11 @@ RadixIPLookup::~RadixIPLookup()
 
 
 void
-RadixIPLookup::cleanup(CleanupStage)
+RadixIPLookup::cleanup(CleanupStage stage)
 {
-    _v.clear();
-    Radix::free_radix(_radix);
-    _radix = 0;
+    IPRouteTable::cleanup(stage);
+    free_table(_t, 0);
+    _t = 0;
 }
 
 
@@ -157,85 +218,132 @@ String
 RadixIPLookup::dump_routes()
 {
     StringAccum sa;
-    for (int j = _vfree; j >= 0; j = _v[j].extra)
-	_v[j].kill();
-    for (int i = 0; i < _v.size(); i++)
-	if (_v[i].real())
-	    _v[i].unparse(sa, true) << '\n';
+    const Table *t = _t;
+    for (int i = 0; i < t->nroutes; i++) {
+	const IPRoute &r = t->route(i);
+	if (r.real() && r.extra == -1)
+	    r.unparse(sa, true) << '\n';
+    }
     return sa.take_string();
 }
 
 
 int
-RadixIPLookup::add_route(const IPRoute &route, bool set, IPRoute *old_route, ErrorHandler *)
+RadixIPLookup::add_route(Table *t, const IPRoute &route, bool set, IPRoute *old_route)
 {
-    int found = (_vfree < 0 ? _v.size() : _vfree), last_key;
+    // Fill in a free slot before the trie can refer to it.
+    int found = (t->vfree < 0 ? t->nroutes : t->vfree), next_free = -1;
+    if (found == t->nroutes) {
+	int c = found >> Table::chunk_shift;
+	if (c == Table::max_chunks)
+	    return -ENOMEM;
+	if (!t->chunks[c] && !(t->chunks[c] = new IPRoute[Table::chunk_size]))
+	    return -ENOMEM;
+    } else
+	next_free = t->route(found).extra;
+    IPRoute &slot = t->route(found);
+    slot = route;
+    slot.extra = -1;
+    click_fence();
+
+    int last_key;
     if (route.mask) {
 	uint32_t addr = ntohl(route.addr.addr());
 	uint32_t mask = ntohl(route.mask.addr());
-	last_key = _radix->change(addr, mask, found + 1, set);
+	last_key = t->radix->change(addr, mask, found + 1, set);
     } else {
-	last_key = _default_key;
+	last_key = t->default_key;
 	if (!last_key || set)
-	    _default_key = found + 1;
+	    t->default_key = found + 1;
     }
 
     if (last_key && old_route)
-	*old_route = _v[last_key - 1];
-    if (last_key && !set)
+	*old_route = t->route(last_key - 1);
+    if (last_key && !set) {
+	// nothing refers to the slot; leave it free
+	slot.kill();
+	slot.extra = next_free;
 	return -EEXIST;
-
-    if (found == _v.size())
-	_v.push_back(route);
-    else {
-	_vfree = _v[found].extra;
-	_v[found] = route;
     }
-    _v[found].extra = -1;
 
+    if (found == t->nroutes)
+	++t->nroutes;
+    else
+	t->vfree = next_free;
+
+    // lookups may still be using the replaced route
     if (last_key) {
-	_v[last_key - 1].extra = _vfree;
-	_vfree = last_key - 1;
+	t->route(last_key - 1).extra = -2;
+	_rcu.defer(free_route, t, last_key - 1);
     }
-
     return 0;
 }
 
+int
+RadixIPLookup::add_route(const IPRoute &route, bool set, IPRoute *old_route, ErrorHandler *)
+{
+    return add_route(_t, route, set, old_route);
+}
+
 int
 RadixIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler*)
 {
+    Table *t = _t;
     int last_key;
     if (route.mask) {
 	uint32_t addr = ntohl(route.addr.addr());
 	uint32_t mask = ntohl(route.mask.addr());
 	// NB: this will never actually make changes
-	last_key = _radix->change(addr, mask, 0, false);
+	last_key = t->radix->change(addr, mask, 0, false);
     } else
-	last_key = _default_key;
+	last_key = t->default_key;
 
     if (last_key && old_route)
-	*old_route = _v[last_key - 1];
-    if (!last_key || !route.match(_v[last_key - 1]))
+	*old_route = t->route(last_key - 1);
+    if (!last_key || !route.match(t->route(last_key - 1)))
 	return -ENOENT;
-    _v[last_key - 1].extra = _vfree;
-    _vfree = last_key - 1;
 
     if (route.mask) {
 	uint32_t addr = ntohl(route.addr.addr());
 	uint32_t mask = ntohl(route.mask.addr());
-	(void) _radix->change(addr, mask, 0, true);
+	(void) t->radix->change(addr, mask, 0, true);
     } else
-	_default_key = 0;
+	t->default_key = 0;
+
+    t->route(last_key - 1).extra = -2;
+    _rcu.defer(free_route, t, last_key - 1);
+    return 0;
+}
+
+int
+RadixIPLookup::load_routes(const Vector<IPRoute> &routes, ErrorHandler *errh)
+{
+    // Build the new table where lookups cannot see it, then switch.
+    Table *t = make_table();
+    if (!t)
+	return errh->error("out of memory");
+    for (const IPRoute *r = routes.begin(); r != routes.end(); ++r)
+	if (add_route(t, *r, true, 0) < 0) {
+	    _rcu.defer(free_table, t);
+	    return errh->error("out of memory");
+	}
+
+    Table *old_t = _t;
+    click_fence();
+    _t = t;
+    _rcu.defer(free_table, old_t);
     return 0;
 }
 
 int
 RadixIPLookup::lookup_route(IPAddress addr, IPAddress &gw) const
 {
-    int key = Radix::lookup(_radix, _default_key, ntohl(addr.addr()));
+    const Table *t = _t;
+    int key = Radix::lookup(t->radix, t->default_key, ntohl(addr.addr()));
     if (key) {
-	gw = _v[key - 1].gw;
-	return _v[key - 1].port;
+	const IPRoute &r = t->route(key - 1);
+	gw = r.gw;
+	return r.port;
     } else {
 	gw = 0;
 	return -1;
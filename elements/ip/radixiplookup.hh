@@ -31,6 +31,11 @@ gateway IP address, and an output port.
 
 Uses the IPRouteTable interface; see IPRouteTable for description.
 
+Routes may be changed while the router runs with several threads.  Lookups
+take no locks: updates never modify a trie node or route entry that a lookup
+could still be using, and the C<load> handler builds a new trie and switches
+to it with one store.
+
 =h table read-only
 
 Outputs a human-readable version of the current routing table.
@@ -59,6 +64,17 @@ add a route, and `C<remove ADDR/MASK>' to remove a route. You can supply
 multiple commands, one per line; all commands are executed as one atomic
 operation.
 
+=h load write-only
+
+Replaces the entire routing table.  Write the new routes in `C<ADDR/MASK [GW]
+OUT>' format, one per line or separated by commas.  Lookups see either the
+old table or the new one, never a mix.
+
+=h load_file write-only
+
+Like C<load>, but reads the routes from the named file.  Use this for full
+tables, which are too large for a single ControlSocket write.
+
 =n
 
 See IPRouteTable for a performance comparison of the various IP routing
@@ -83,17 +99,19 @@ class RadixIPLookup : public IPRouteTable { public:
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
     String dump_routes();
+    int load_routes(const Vector<IPRoute>&, ErrorHandler *);
 
   private:
 
     class Radix;
+    struct Table;
 
-    // Simple routing table
-    Vector<IPRoute> _v;
-    int _vfree;
+    Table *volatile _t;		// published table
 
-    int _default_key;
-    Radix *_radix;
+    static Table *make_table();
+    static void free_table(void *, uintptr_t);
+    static void free_route(void *, uintptr_t);
+    int add_route(Table *, const IPRoute&, bool, IPRoute*);
 
 };
 
@@ -52,16 +52,18 @@ RangeIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
 }
 
 int
-RangeIPLookup::initialize(ErrorHandler *)
+RangeIPLookup::initialize(ErrorHandler *errh)
 {
-    expand();
+    if (expand() < 0)
+	return errh->error("routing table needs more than %d address ranges", (int) RANGES_MAX);
     _active = true;
-    return 0;
+    return IPRouteTable::initialize(errh);
 }
 
 void
-RangeIPLookup::cleanup(CleanupStage)
+RangeIPLookup::cleanup(CleanupStage stage)
 {
+    IPRouteTable::cleanup(stage);
     _helper.cleanup();
 }
 
@@ -87,6 +89,29 @@ RangeIPLookup::push(int, Packet *p)
         p->kill();
 }
 
+void
+RangeIPLookup::push_batch(int, PacketBatch &batch)
+{
+    PacketBatch run;
+    int run_port = -1;
+    while (Packet *p = batch.pop_front()) {
+        IPAddress gw;
+        int port = RangeIPLookup::lookup_route(p->dst_ip_anno(), gw);
+        if (port < 0) {
+            p->kill();
+            continue;
+        }
+        if (gw)
+            p->set_dst_ip_anno(gw);
+        if (port != run_port && !run.empty())
+            output(run_port).push_batch(run);
+        run_port = port;
+        run.push_back(p);
+    }
+    if (!run.empty())
+        output(run_port).push_batch(run);
+}
+
 int
 RangeIPLookup::lookup_route(IPAddress dest, IPAddress &gw) const
 {
@@ -127,18 +152,34 @@ RangeIPLookup::add_handlers()
 int
 RangeIPLookup::add_route(const IPRoute& route, bool allow_replace, IPRoute* old_route, ErrorHandler *errh)
 {
-    int error = _helper.add_route(route, allow_replace, old_route, errh);
-    if (error == 0 && _active)
+    IPRoute old;
+    int error = _helper.add_route(route, allow_replace, &old, errh);
+    if (error == 0 && _active && expand() < 0) {
+	// Undo the change, which must leave few enough ranges.
+	if (old.port >= 0)
+	    _helper.add_route(old, true, 0, errh);
+	else
+	    _helper.remove_route(route, 0, errh);
 	expand();
+	return errh->error("routing table needs more than %d address ranges", (int) RANGES_MAX);
+    }
+    if (old_route)
+	*old_route = old;
     return error;
 }
 
 int
 RangeIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler *errh)
 {
-    int error = _helper.remove_route(route, old_route, errh);
-    if (error == 0 && _active)
+    IPRoute old;
+    int error = _helper.remove_route(route, &old, errh);
+    if (error == 0 && _active && expand() < 0) {
+	_helper.add_route(old, false, 0, errh);
 	expand();
+	return errh->error("routing table needs more than %d address ranges", (int) RANGES_MAX);
+    }
+    if (old_route)
+	*old_route = old;
     return error;
 }
 
@@ -150,7 +191,7 @@ RangeIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandl
  * more efficient method for updating range-based lookup structures in
  * the future, which would not depend on huge directiplookup tables.
  */
-void
+int
 RangeIPLookup::expand()
 {
     uint32_t range_t_index = 0;
@@ -174,6 +215,8 @@ RangeIPLookup::expand()
 		for (j = 0; j < 256; j++) {
 		    vport_i1 = _helper._tbl_24_31[tbl_24_31_index + j];
 		    if (vport_i != vport_i1) {
+			if (range_t_index == RANGES_MAX)
+			    return -ENOMEM;
 			vport_i = vport_i1;
 			_range_t[range_t_index] =
 					vport_i << (32 - KICKSTART_BITS) |
@@ -186,6 +229,8 @@ RangeIPLookup::expand()
 	    } else {
 		vport_i1 = _helper._tbl_0_23[tbl_0_23_index];
 		if (vport_i != vport_i1) {
+		    if (range_t_index == RANGES_MAX)
+			return -ENOMEM;
 		    vport_i = vport_i1;
 		    _range_t[range_t_index] =
 					vport_i << (32 - KICKSTART_BITS) |
@@ -204,15 +249,16 @@ RangeIPLookup::expand()
 		  range_t_index, sizeof(_range_base) + sizeof(_range_len),
 		  range_t_index * sizeof(uint32_t));
 #endif
+    return 0;
 }
 
 void
 RangeIPLookup::flush_table()
 {
     _helper.flush();
-    memset(_range_base, 0, sizeof(_range_base));
-    memset(_range_len, 0, sizeof(_range_len));
-    memset(_range_t, 0, sizeof(_range_t));
+    memset(_range_base, 0, (1 << KICKSTART_BITS) * sizeof(uint32_t));
+    memset(_range_len, 0, (1 << KICKSTART_BITS) * sizeof(uint32_t));
+    memset(_range_t, 0, RANGES_MAX * sizeof(uint32_t));
 }
 
 int
@@ -220,7 +266,9 @@ RangeIPLookup::flush_handler(const String &, Element *e, void *,
                                 ErrorHandler *)
 {
     RangeIPLookup *t = static_cast<RangeIPLookup *>(e);
+    t->begin_update();
     t->flush_table();
+    t->end_update();
     return 0;
 }
 
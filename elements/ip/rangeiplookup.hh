@@ -34,6 +34,9 @@ realistic snapshot taken from a core Internet router) occupies only around
 affinity can be maintained, worst-case lookup rates exceeding 20 million
 lookups per second can be achieved using modern commodity CPUs.
 
+The lookup structure holds at most 262144 address ranges.  Route updates that
+would need more fail.
+
 RangeIPLookup maintains a large DirectIPLookup table as well as its own
 tables.  Although this subsidiary table is only accessed during route updates,
 it significantly adds to RangeIPLookup's total memory footprint.
@@ -94,6 +97,7 @@ class RangeIPLookup : public IPRouteTable { public:
     void cleanup(CleanupStage);
     void add_handlers();
     void push(int port, Packet* p);
+    void push_batch(int port, PacketBatch &batch);
 
     int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
@@ -105,7 +109,7 @@ class RangeIPLookup : public IPRouteTable { public:
   protected:
 
     void flush_table();
-    void expand();
+    int expand();
 
     enum { KICKSTART_BITS = 12 };
     enum { RANGES_MAX = 256 * 1024 };
@@ -3,20 +3,24 @@
 #define CLICK_IP6ROUTETABLE_HH
 #include <click/glue.hh>
 #include <click/element.hh>
+#include <click/ip6address.hh>
 CLICK_DECLS
 
 class IP6RouteTable : public Element { public:
 
     void* cast(const char*);
+    void add_handlers();
 
     virtual int add_route(IP6Address, IP6Address, IP6Address, int, ErrorHandler *);
     virtual int remove_route(IP6Address, IP6Address, ErrorHandler *);
+    virtual int lookup_route(IP6Address, IP6Address &) const;
     virtual String dump_routes();
 
     static int add_route_handler(const String&, Element*, void*, ErrorHandler*);
     static int remove_route_handler(const String&, Element*, void*, ErrorHandler*);
     static int ctrl_handler(const String&, Element*, void*, ErrorHandler*);
     static String table_handler(Element*, void*);
+    static int lookup_handler(int, String&, Element*, const Handler*, ErrorHandler*);
 
 };
 
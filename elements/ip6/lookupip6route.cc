@@ -151,6 +151,10 @@ LookupIP6Route::add_route(IP6Address addr, IP6Address mask, IP6Address gw,
     return errh->error("port number out of range"); // Can't happen...
 
   _t.add(addr, mask, gw, output);
+  _last_addr = IP6Address();
+#ifdef IP_RT_CACHE2
+  _last_addr2 = _last_addr;
+#endif
   return 0;
 }
 
@@ -159,16 +163,20 @@ LookupIP6Route::remove_route(IP6Address addr, IP6Address mask,
 			     ErrorHandler *)
 {
   _t.del(addr, mask);
+  _last_addr = IP6Address();
+#ifdef IP_RT_CACHE2
+  _last_addr2 = _last_addr;
+#endif
   return 0;
 }
 
-void
-LookupIP6Route::add_handlers()
+int
+LookupIP6Route::lookup_route(IP6Address addr, IP6Address &gw) const
 {
-    add_write_handler("add", add_route_handler, 0);
-    add_write_handler("remove", remove_route_handler, 0);
-    add_write_handler("ctrl", ctrl_handler, 0);
-    add_read_handler("table", table_handler, 0);
+  int ifi;
+  if (_t.lookup(addr, gw, ifi))
+    return ifi;
+  return -1;
 }
 
 CLICK_ENDDECLS
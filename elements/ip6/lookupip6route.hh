@@ -21,6 +21,25 @@ CLICK_DECLS
  * a destination and mask, a gateway (zero means none),
  * and an output index.
  *
+ * LookupIP6Route examines every route for every packet.  PoptrieIP6Lookup
+ * is much faster on large tables.
+ *
+ * =h table read-only
+ * Outputs a human-readable version of the current routing table.
+ *
+ * =h lookup read-only
+ * Reports the OUTput port and GW corresponding to an address.
+ *
+ * =h add write-only
+ * Adds a route to the table. Format should be `C<ADDR/PREFIX [GW] OUT>'.
+ *
+ * =h remove write-only
+ * Removes a route from the table. Format should be `C<ADDR/PREFIX>'.
+ *
+ * =h ctrl write-only
+ * Adds or removes a route. Write `C<add ADDR/PREFIX [GW] OUT>' to add a
+ * route, and `C<remove ADDR/PREFIX>' to remove a route.
+ *
  * =e
  *
  *   ... -> GetIP6Address(24) -> rt;
@@ -37,6 +56,7 @@ CLICK_DECLS
  *   rt[2] -> ... -> ToDevice(eth1);
  *   ...
  *
+ * =a PoptrieIP6Lookup, IP6LookupBenchmark
  */
 
 class LookupIP6Route : public IP6RouteTable {
@@ -50,12 +70,12 @@ public:
 
   int configure(Vector<String> &, ErrorHandler *);
   int initialize(ErrorHandler *);
-  void add_handlers();
 
   void push(int port, Packet *p);
 
   int add_route(IP6Address, IP6Address, IP6Address, int, ErrorHandler *);
   int remove_route(IP6Address, IP6Address, ErrorHandler *);
+  int lookup_route(IP6Address, IP6Address &) const;
   String dump_routes()				{ return _t.dump(); };
 
 private:
@@ -0,0 +1,695 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * poptrieip6lookup.{cc,hh} -- IP6 routing lookup using a Poptrie
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "poptrieip6lookup.hh"
+#include <click/ip6address.hh>
+#include <click/straccum.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+CLICK_DECLS
+
+static inline void
+mask_prefix(uint64_t &hi, uint64_t &lo, int plen)
+{
+    if (plen <= 64) {
+	hi = plen ? hi & (~(uint64_t) 0 << (64 - plen)) : 0;
+	lo = 0;
+    } else
+	lo &= ~(uint64_t) 0 << (128 - plen);
+}
+
+static IP6Address
+join(uint64_t hi, uint64_t lo)
+{
+    IP6Address a;
+    uint32_t *x = a.data32();
+    x[0] = htonl(hi >> 32);
+    x[1] = htonl((uint32_t) hi);
+    x[2] = htonl(lo >> 32);
+    x[3] = htonl((uint32_t) lo);
+    return a;
+}
+
+static inline int
+compare(uint64_t ahi, uint64_t alo, uint64_t bhi, uint64_t blo)
+{
+    if (ahi != bhi)
+	return ahi < bhi ? -1 : 1;
+    if (alo != blo)
+	return alo < blo ? -1 : 1;
+    return 0;
+}
+
+// Vector::resize() reserves exactly the new size; grow geometrically.
+template <typename T> static uint32_t
+append_block(Vector<T> &v, int n)
+{
+    if (v.size() + n > v.capacity())
+	v.reserve(2 * v.capacity() + n);
+    v.resize(v.size() + n);
+    return v.size() - n;
+}
+
+PoptrieIP6Lookup::PoptrieIP6Lookup()
+    : _dir(0), _dir_route(0), _nnodes(0), _nleaves(0)
+{
+#if CLICK_POPTRIE_POPCNT
+    __builtin_cpu_init();
+    _popcnt = __builtin_cpu_supports("popcnt");
+#endif
+}
+
+PoptrieIP6Lookup::~PoptrieIP6Lookup()
+{
+    delete[] _dir;
+    delete[] _dir_route;
+}
+
+int
+PoptrieIP6Lookup::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _dir = new uint32_t[1 << dir_bits];
+    _dir_route = new int[1 << dir_bits];
+    if (!_dir || !_dir_route)
+	return errh->error("out of memory");
+    clear();
+
+    int before = errh->nerrors();
+    for (int i = 0; i < conf.size(); ++i) {
+	PrefixErrorHandler cerrh(errh, "route " + String(i + 1) + ": ");
+	add_route_handler(conf[i], this, 0, &cerrh);
+    }
+    return errh->nerrors() == before ? 0 : -1;
+}
+
+void
+PoptrieIP6Lookup::clear()
+{
+    for (int s = 0; s < (1 << dir_bits); ++s) {
+	_dir[s] = leaf_flag;
+	_dir_route[s] = -1;
+    }
+    _nodes.clear();
+    _leaves.clear();
+    for (int n = 0; n <= 64; ++n) {
+	_free_nodes[n].clear();
+	_free_leaves[n].clear();
+    }
+    _nnodes = _nleaves = 0;
+
+    _nexthops.resize(1);
+    _nexthops[0].gw = IP6Address();
+    _nexthops[0].port = -1;
+    _nexthops[0].refcount = 1;
+    _routes.clear();
+    _free_routes.clear();
+    for (int plen = 0; plen <= 128; ++plen)
+	_prefixes[plen].clear();
+    _long_routes.clear();
+}
+
+
+// LOOKUP
+
+inline int
+PoptrieIP6Lookup::lookup(const IP6Address &a) const
+{
+    uint64_t hi, lo;
+    split(a, hi, lo);
+#if CLICK_POPTRIE_POPCNT
+    if (_popcnt)
+	return lookup_popcnt(hi, lo);
+#endif
+    return lookup_nexthop(hi, lo);
+}
+
+#if CLICK_POPTRIE_POPCNT
+int
+PoptrieIP6Lookup::lookup_popcnt(uint64_t hi, uint64_t lo) const
+{
+    return lookup_nexthop(_dir, _nodes.begin(), _leaves.begin(), hi, lo);
+}
+#endif
+
+int
+PoptrieIP6Lookup::lookup_route(IP6Address addr, IP6Address &gw) const
+{
+    const NextHop &nh = _nexthops[lookup(addr)];
+    gw = nh.gw;
+    return nh.port;
+}
+
+void
+PoptrieIP6Lookup::push(int, Packet *p)
+{
+    const NextHop &nh = _nexthops[lookup(DST_IP6_ANNO(p))];
+    if (nh.port >= 0) {
+	if (nh.gw)
+	    SET_DST_IP6_ANNO(p, nh.gw);
+	output(nh.port).push(p);
+    } else
+	p->kill();
+}
+
+inline void
+PoptrieIP6Lookup::route_batch(PacketBatch &batch)
+{
+    // Look up prefetch_window packets at a time, advancing every packet in
+    // the window one trie level per pass and prefetching the node or leaf
+    // it needs next.  IPv6 tries are deep, so overlapping the window's
+    // cache misses at every level, not just the first, matters.
+    const uint32_t *dir = _dir;
+    const Node *nodes = _nodes.begin();
+    const uint16_t *leaves = _leaves.begin();
+    Packet *window[prefetch_window];
+    uint64_t hi[prefetch_window], lo[prefetch_window];
+    const Node *node[prefetch_window];
+    uint32_t leaf[prefetch_window];
+    int active[prefetch_window];
+    PacketBatch run;
+    int run_port = -1;
+
+    while (!batch.empty()) {
+	int n = 0;
+	while (n < prefetch_window && (window[n] = batch.pop_front())) {
+	    split(DST_IP6_ANNO(window[n]), hi[n], lo[n]);
+	    click_prefetch(&dir[hi[n] >> (64 - dir_bits)]);
+	    ++n;
+	}
+
+	int nactive = 0;
+	for (int i = 0; i < n; ++i) {
+	    uint32_t ref = dir[hi[i] >> (64 - dir_bits)];
+	    if (ref & leaf_flag)
+		leaf[i] = ref & ~leaf_flag;
+	    else {
+		node[i] = &nodes[ref];
+		click_prefetch(node[i]);
+		hi[i] = (hi[i] << dir_bits) | (lo[i] >> (64 - dir_bits));
+		lo[i] <<= dir_bits;
+		active[nactive++] = i;
+	    }
+	}
+
+	// Leaves hold next hops; once a packet reaches one, store the leaf's
+	// index, and fetch it after the walk.
+	while (nactive) {
+	    int still = 0;
+	    for (int j = 0; j < nactive; ++j) {
+		int i = active[j];
+		const Node *x = node[i];
+		int v = hi[i] >> (64 - stride);
+		uint64_t below = ((uint64_t) 2 << v) - 1;
+		if ((x->vector >> v) & 1) {
+		    node[i] = &nodes[x->base1 + popcount(x->vector & below) - 1];
+		    click_prefetch(node[i]);
+		    hi[i] = (hi[i] << stride) | (lo[i] >> (64 - stride));
+		    lo[i] <<= stride;
+		    active[still++] = i;
+		} else {
+		    leaf[i] = leaves[x->base0 + popcount(x->leafvec & below) - 1];
+		}
+	    }
+	    nactive = still;
+	}
+
+	for (int i = 0; i < n; ++i) {
+	    const NextHop &nh = _nexthops[leaf[i]];
+	    Packet *p = window[i];
+	    if (nh.port < 0) {
+		p->kill();
+		continue;
+	    }
+	    if (nh.gw)
+		SET_DST_IP6_ANNO(p, nh.gw);
+	    if (nh.port != run_port && !run.empty())
+		output(run_port).push_batch(run);
+	    run_port = nh.port;
+	    run.push_back(p);
+	}
+    }
+
+    if (!run.empty())
+	output(run_port).push_batch(run);
+}
+
+void
+PoptrieIP6Lookup::route_batch_generic(PacketBatch &batch)
+{
+    route_batch(batch);
+}
+
+#if CLICK_POPTRIE_POPCNT
+void
+PoptrieIP6Lookup::route_batch_popcnt(PacketBatch &batch)
+{
+    route_batch(batch);
+}
+#endif
+
+void
+PoptrieIP6Lookup::push_batch(int, PacketBatch &batch)
+{
+#if CLICK_POPTRIE_POPCNT
+    if (_popcnt) {
+	route_batch_popcnt(batch);
+	return;
+    }
+#endif
+    route_batch_generic(batch);
+}
+
+
+// UPDATES
+
+int
+PoptrieIP6Lookup::find_nexthop(const IP6Address &gw, int port)
+{
+    int free = -1;
+    for (int i = 1; i < _nexthops.size(); ++i)
+	if (!_nexthops[i].refcount)
+	    free = i;
+	else if (_nexthops[i].gw == gw && _nexthops[i].port == port) {
+	    ++_nexthops[i].refcount;
+	    return i;
+	}
+    if (free < 0) {
+	if (_nexthops.size() > max_nexthops)
+	    return -1;
+	free = _nexthops.size();
+	_nexthops.push_back(NextHop());
+    }
+    _nexthops[free].gw = gw;
+    _nexthops[free].port = port;
+    _nexthops[free].refcount = 1;
+    return free;
+}
+
+int
+PoptrieIP6Lookup::find_route(uint64_t hi, uint64_t lo, int plen) const
+{
+    mask_prefix(hi, lo, plen);
+    HashTable<IP6Address, int>::const_iterator it = _prefixes[plen].find(join(hi, lo));
+    return it ? it.value() : -1;
+}
+
+/* Return the route with the longest prefix of at most plen bits that
+   contains hi:lo, or -1 if there is none. */
+int
+PoptrieIP6Lookup::covering_route(uint64_t hi, uint64_t lo, int plen) const
+{
+    for (; plen >= 0; --plen)
+	if (_prefixes[plen].size()) {
+	    int r = find_route(hi, lo, plen);
+	    if (r >= 0)
+		return r;
+	}
+    return -1;
+}
+
+/* Return the first route in the address-sorted range [b, e) whose first
+   plen bits are at least (or, if upper, greater than) those of hi:lo. */
+const int *
+PoptrieIP6Lookup::lower_bound(const int *b, const int *e, uint64_t hi,
+			      uint64_t lo, int plen, bool upper) const
+{
+    mask_prefix(hi, lo, plen);
+    while (b != e) {
+	const int *m = b + (e - b) / 2;
+	uint64_t mhi = _routes[*m].hi, mlo = _routes[*m].lo;
+	mask_prefix(mhi, mlo, plen);
+	int cmp = compare(mhi, mlo, hi, lo);
+	if (cmp < 0 || (upper && cmp == 0))
+	    b = m + 1;
+	else
+	    e = m;
+    }
+    return b;
+}
+
+uint32_t
+PoptrieIP6Lookup::alloc_nodes(int n)
+{
+    if (!n)
+	return 0;
+    _nnodes += n;
+    if (_free_nodes[n].size()) {
+	uint32_t x = _free_nodes[n].back();
+	_free_nodes[n].pop_back();
+	return x;
+    }
+    return append_block(_nodes, n);
+}
+
+uint32_t
+PoptrieIP6Lookup::alloc_leaves(int n)
+{
+    if (!n)
+	return 0;
+    _nleaves += n;
+    if (_free_leaves[n].size()) {
+	uint32_t x = _free_leaves[n].back();
+	_free_leaves[n].pop_back();
+	return x;
+    }
+    return append_block(_leaves, n);
+}
+
+/* Free n's leaves and child nodes, and recursively their children, except
+   for the subtrees of children whose bits are set in keep. */
+void
+PoptrieIP6Lookup::free_children(const Node &n, uint64_t keep)
+{
+    int nchildren = popcount(n.vector), nleaves = popcount(n.leafvec);
+    uint32_t child = n.base1;
+    for (int v = 0; v < 64; ++v)
+	if ((n.vector >> v) & 1) {
+	    if (!((keep >> v) & 1))
+		free_children(_nodes[child], 0);
+	    ++child;
+	}
+    if (nchildren) {
+	_free_nodes[nchildren].push_back(n.base1);
+	_nnodes -= nchildren;
+    }
+    if (nleaves) {
+	_free_leaves[nleaves].push_back(n.base0);
+	_nleaves -= nleaves;
+    }
+}
+
+/* Fill in node, at depth bits, from the address-sorted routes in [b, e),
+   which share the node's prefix; routes of at most depth bits are
+   ignored.  Since a prefix sorts before the prefixes it contains, later
+   routes override earlier ones.  nexthop is the next hop for addresses no
+   route matches.  If old is nonnull, it holds node's previous contents:
+   old children whose bits are set in reuse, and that are still children,
+   keep their subtrees, and everything else under old is freed. */
+void
+PoptrieIP6Lookup::build_node(uint32_t node, const int *b, const int *e,
+			     int depth, int nexthop, const Node *old,
+			     uint64_t reuse)
+{
+    uint16_t leaf[64];
+    for (int v = 0; v < 64; ++v)
+	leaf[v] = nexthop;
+    uint64_t vector = 0;
+    for (const int *r = b; r != e; ++r) {
+	const Route &rt = _routes[*r];
+	if (rt.plen <= depth)
+	    continue;
+	int v = chunk(rt.hi, rt.lo, depth);
+	if (rt.plen <= depth + stride) {
+	    for (int n = 1 << (depth + stride - rt.plen); n; --n, ++v)
+		leaf[v] = rt.nexthop;
+	} else
+	    vector |= (uint64_t) 1 << v;
+    }
+
+    // Compress runs of equal leaves, skipping over child nodes.
+    uint64_t leafvec = 0;
+    uint16_t runs[64];
+    int nruns = 0;
+    for (int v = 0; v < 64; ++v)
+	if (!((vector >> v) & 1) && (!nruns || leaf[v] != runs[nruns - 1])) {
+	    leafvec |= (uint64_t) 1 << v;
+	    runs[nruns++] = leaf[v];
+	}
+
+    if (old)
+	reuse &= old->vector & vector;
+    else
+	reuse = 0;
+    uint32_t base0 = alloc_leaves(nruns);
+    if (nruns)
+	memcpy(&_leaves[base0], runs, nruns * sizeof(uint16_t));
+    uint32_t base1 = alloc_nodes(popcount(vector));
+    _nodes[node].vector = vector;
+    _nodes[node].leafvec = leafvec;
+    _nodes[node].base0 = base0;
+    _nodes[node].base1 = base1;
+
+    // Each child's routes are contiguous.
+    const int *p = b;
+    for (int v = 0; v < 64; ++v)
+	if ((vector >> v) & 1) {
+	    while (chunk(_routes[*p].hi, _routes[*p].lo, depth) < v)
+		++p;
+	    const int *q = p;
+	    while (q != e && chunk(_routes[*q].hi, _routes[*q].lo, depth) == v)
+		++q;
+	    if ((reuse >> v) & 1)
+		_nodes[base1] = _nodes[old->base1 + popcount(old->vector & (((uint64_t) 1 << v) - 1))];
+	    else
+		build_node(base1, p, q, depth + stride, leaf[v], 0, 0);
+	    ++base1;
+	    p = q;
+	}
+
+    if (old)
+	free_children(*old, reuse);
+}
+
+/* Rebuild the _dir entry, and any trie, for the /16 network slot. */
+void
+PoptrieIP6Lookup::rebuild_slot(uint32_t slot)
+{
+    if (!(_dir[slot] & leaf_flag)) {
+	free_children(_nodes[_dir[slot]], 0);
+	_free_nodes[1].push_back(_dir[slot]);
+	--_nnodes;
+    }
+
+    int nexthop = (_dir_route[slot] >= 0 ? _routes[_dir_route[slot]].nexthop : 0);
+    HashTable<uint32_t, Vector<int> >::iterator it = _long_routes.find(slot);
+    if (!it) {
+	_dir[slot] = leaf_flag | nexthop;
+	return;
+    }
+
+    uint32_t root = alloc_nodes(1);
+    build_node(root, it.value().begin(), it.value().end(), dir_bits, nexthop, 0, 0);
+    _dir[slot] = root;
+}
+
+/* Rebuild the slots covered by the prefix hi/plen, plen <= dir_bits, whose
+   covering route changes from old_route to new_route.  If old_route is
+   negative, new_route was just added. */
+void
+PoptrieIP6Lookup::update_slots(uint64_t hi, int plen, int old_route,
+			       int new_route)
+{
+    uint32_t slot = hi >> (64 - dir_bits);
+    uint32_t end = slot + (1U << (dir_bits - plen));
+    for (; slot != end; ++slot) {
+	int cur = _dir_route[slot];
+	if (old_route >= 0 ? cur == old_route
+	    : cur < 0 || _routes[cur].plen < plen) {
+	    _dir_route[slot] = new_route;
+	    rebuild_slot(slot);
+	}
+    }
+}
+
+/* Update the trie after the route hi:lo/plen, plen > dir_bits, changed.
+   Descend while the child nodes on the route's path stay nodes, then
+   rebuild the subtrie where the route's leaves or the trie's shape
+   changed. */
+void
+PoptrieIP6Lookup::update_subtrie(uint64_t hi, uint64_t lo, int plen)
+{
+    uint32_t slot = hi >> (64 - dir_bits);
+    HashTable<uint32_t, Vector<int> >::iterator it = _long_routes.find(slot);
+    if (!it || it.value().empty() || (_dir[slot] & leaf_flag)) {
+	if (it && it.value().empty())
+	    _long_routes.erase(it);
+	rebuild_slot(slot);
+	return;
+    }
+
+    const int *b = it.value().begin(), *e = it.value().end();
+    uint32_t node = _dir[slot];
+    int depth = dir_bits;
+    while (plen > depth + stride) {
+	int v = chunk(hi, lo, depth);
+	const int *cb = lower_bound(b, e, hi, lo, depth + stride, false);
+	const int *ce = lower_bound(cb, e, hi, lo, depth + stride, true);
+	bool is_node = false;
+	for (const int *r = cb; r != ce && !is_node; ++r)
+	    is_node = _routes[*r].plen > depth + stride;
+	const Node &n = _nodes[node];
+	if (!is_node || !((n.vector >> v) & 1))
+	    break;
+	node = n.base1 + popcount(n.vector & (((uint64_t) 2 << v) - 1)) - 1;
+	depth += stride;
+	b = cb;
+	e = ce;
+    }
+
+    // Only the children the route overlaps change; move the others.
+    int v = chunk(hi, lo, depth);
+    uint64_t reuse = 0;
+    if (plen > depth + stride)
+	reuse = ~((uint64_t) 1 << v);
+    else if (plen > depth)
+	reuse = ~((((uint64_t) 1 << (1 << (depth + stride - plen))) - 1) << v);
+    int r = covering_route(hi, lo, depth);
+    Node old = _nodes[node];
+    build_node(node, b, e, depth, r >= 0 ? _routes[r].nexthop : 0, &old, reuse);
+}
+
+int
+PoptrieIP6Lookup::add_route(IP6Address addr, IP6Address mask, IP6Address gw,
+			    int port, ErrorHandler *errh)
+{
+    int plen = mask.mask_to_prefix_len();
+    if (plen < 0)
+	return errh->error("%s: mask is not a prefix", mask.unparse().c_str());
+    uint64_t hi, lo;
+    split(addr, hi, lo);
+    mask_prefix(hi, lo, plen);
+
+    int nexthop = find_nexthop(gw, port);
+    if (nexthop < 0)
+	return errh->error("too many next hops");
+
+    int r = find_route(hi, lo, plen);
+    if (r >= 0) {
+	// Replace the existing route's next hop.
+	--_nexthops[_routes[r].nexthop].refcount;
+	_routes[r].nexthop = nexthop;
+	if (plen <= dir_bits)
+	    update_slots(hi, plen, r, r);
+	else
+	    update_subtrie(hi, lo, plen);
+	return 0;
+    }
+
+    if (_free_routes.size()) {
+	r = _free_routes.back();
+	_free_routes.pop_back();
+    } else {
+	r = _routes.size();
+	_routes.push_back(Route());
+    }
+    _routes[r].hi = hi;
+    _routes[r].lo = lo;
+    _routes[r].plen = plen;
+    _routes[r].nexthop = nexthop;
+    _prefixes[plen][join(hi, lo)] = r;
+
+    if (plen <= dir_bits)
+	update_slots(hi, plen, -1, r);
+    else {
+	Vector<int> &v = _long_routes[hi >> (64 - dir_bits)];
+	const int *x = lower_bound(v.begin(), v.end(), hi, lo, 128, false);
+	while (x != v.end() && compare(_routes[*x].hi, _routes[*x].lo, hi, lo) == 0
+	       && _routes[*x].plen < plen)
+	    ++x;
+	int pos = x - v.begin();
+	if (v.size() == v.capacity())
+	    v.reserve(2 * v.capacity() + 4);
+	v.insert(v.begin() + pos, r);
+	update_subtrie(hi, lo, plen);
+    }
+    return 0;
+}
+
+int
+PoptrieIP6Lookup::remove_route(IP6Address addr, IP6Address mask,
+			       ErrorHandler *errh)
+{
+    int plen = mask.mask_to_prefix_len();
+    uint64_t hi, lo;
+    split(addr, hi, lo);
+    if (plen >= 0)
+	mask_prefix(hi, lo, plen);
+    int r = (plen >= 0 ? find_route(hi, lo, plen) : -1);
+    if (r < 0)
+	return errh->error("no route for %s/%d", join(hi, lo).unparse().c_str(), plen);
+
+    _prefixes[plen].erase(join(hi, lo));
+    if (plen <= dir_bits)
+	update_slots(hi, plen, r, plen ? covering_route(hi, lo, plen - 1) : -1);
+    else {
+	Vector<int> &v = _long_routes[hi >> (64 - dir_bits)];
+	for (int *x = v.begin() + (lower_bound(v.begin(), v.end(), hi, lo, 128, false) - v.begin());
+	     x != v.end(); ++x)
+	    if (*x == r) {
+		v.erase(x);
+		break;
+	    }
+	update_subtrie(hi, lo, plen);
+    }
+
+    --_nexthops[_routes[r].nexthop].refcount;
+    _routes[r].nexthop = -1;
+    _free_routes.push_back(r);
+    return 0;
+}
+
+String
+PoptrieIP6Lookup::dump_routes()
+{
+    StringAccum sa;
+    for (int i = 0; i < _routes.size(); ++i)
+	if (_routes[i].nexthop >= 0) {
+	    const Route &rt = _routes[i];
+	    const NextHop &nh = _nexthops[rt.nexthop];
+	    sa << join(rt.hi, rt.lo) << '/' << rt.plen << '\t' << nh.gw
+	       << '\t' << nh.port << '\n';
+	}
+    return sa.take_string();
+}
+
+int
+PoptrieIP6Lookup::flush_handler(const String &, Element *e, void *,
+				ErrorHandler *)
+{
+    static_cast<PoptrieIP6Lookup *>(e)->clear();
+    return 0;
+}
+
+String
+PoptrieIP6Lookup::stats_handler(Element *e, void *)
+{
+    PoptrieIP6Lookup *t = static_cast<PoptrieIP6Lookup *>(e);
+    int nnexthops = 0;
+    for (int i = 1; i < t->_nexthops.size(); ++i)
+	nnexthops += (t->_nexthops[i].refcount > 0);
+    StringAccum sa;
+    sa << "routes " << (t->_routes.size() - t->_free_routes.size()) << '\n'
+       << "nexthops " << nnexthops << '\n'
+       << "nodes " << t->_nnodes << '\n'
+       << "leaves " << t->_nleaves << '\n'
+       << "memory " << ((1 << dir_bits) * sizeof(uint32_t)
+			+ t->_nodes.size() * sizeof(Node)
+			+ t->_leaves.size() * sizeof(uint16_t)
+			+ t->_nexthops.size() * sizeof(NextHop)) << '\n';
+    return sa.take_string();
+}
+
+void
+PoptrieIP6Lookup::add_handlers()
+{
+    IP6RouteTable::add_handlers();
+    add_write_handler("flush", flush_handler, 0, Handler::BUTTON);
+    add_read_handler("stats", stats_handler, 0);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IP6RouteTable)
+EXPORT_ELEMENT(PoptrieIP6Lookup)
@@ -0,0 +1,240 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_POPTRIEIP6LOOKUP_HH
+#define CLICK_POPTRIEIP6LOOKUP_HH
+#if !defined(CLICK_POPTRIE_POPCNT) && CLICK_USERLEVEL && (defined(__x86_64__) || defined(__i386__)) && __GNUC__ >= 5
+# define CLICK_POPTRIE_POPCNT 1
+#endif
+#include <click/hashtable.hh>
+#include "ip6routetable.hh"
+CLICK_DECLS
+
+/*
+=c
+
+PoptrieIP6Lookup(ADDR1/PREFIX1 [GW1] OUT1, ADDR2/PREFIX2 [GW2] OUT2, ...)
+
+=s ip6
+
+IP6 routing lookup using a compressed multibit trie
+
+=d
+
+Input: IP6 packets (no ether header).  Expects a destination IP6 address
+annotation with each packet.  Looks up that address in its routing table,
+using longest-prefix-match, sets the destination annotation to the
+corresponding GW (if specified), and emits the packet on the indicated OUTput
+port.  Packets that match no route are dropped.
+
+Each argument is a route, specifying a destination and prefix length, an
+optional gateway IP6 address, and an output port.  Like LookupIP6Route,
+PoptrieIP6Lookup replaces an existing route for the same prefix.
+
+PoptrieIP6Lookup is the IPv6 version of PoptrieIPLookup.  A direct-indexed
+table on the top 16 address bits points either to a next hop or to a trie of
+64-way nodes, each of which consumes 6 more bits.  Looking up an address
+whose routes are at most 52 bits long reads one table entry, at most six
+nodes, and one leaf, and a full IPv6 BGP table fits in a few megabytes.
+LookupIP6Route, in contrast, examines every route for every packet.
+
+Routes longer than 16 bits are kept sorted by address within their /16, so a
+route change rebuilds only the subtrie of the deepest node the route touches.
+
+=h table read-only
+
+Outputs a human-readable version of the current routing table.
+
+=h lookup read-only
+
+Reports the OUTput port and GW corresponding to an address.
+
+=h add write-only
+
+Adds or replaces a route. Format should be `C<ADDR/PREFIX [GW] OUT>'.
+
+=h remove write-only
+
+Removes a route from the table. Format should be `C<ADDR/PREFIX>'.
+
+=h ctrl write-only
+
+Adds or removes a route. Write `C<add ADDR/PREFIX [GW] OUT>' to add a route,
+and `C<remove ADDR/PREFIX>' to remove a route.
+
+=h flush write-only
+
+Clears the entire routing table.
+
+=h stats read-only
+
+Returns the number of routes, next hops, trie nodes, and leaves, and the bytes
+used by the lookup structures.
+
+=n
+
+PoptrieIP6Lookup supports at most 65535 distinct GW, OUT pairs.
+
+=e
+
+  rt :: PoptrieIP6Lookup(3ffe:1ce1:2::/48 0,
+                         2001:db8::/32 2001:db8::1 1,
+                         ::/0 3ffe:1ce1:2::2 1);
+
+=a LookupIP6Route, PoptrieIPLookup, IP6LookupBenchmark */
+
+class PoptrieIP6Lookup : public IP6RouteTable { public:
+
+    PoptrieIP6Lookup();
+    ~PoptrieIP6Lookup();
+
+    const char *class_name() const	{ return "PoptrieIP6Lookup"; }
+    const char *port_count() const	{ return "1/-"; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    void push_batch(int port, PacketBatch &batch);
+
+    int add_route(IP6Address, IP6Address, IP6Address, int, ErrorHandler *);
+    int remove_route(IP6Address, IP6Address, ErrorHandler *);
+    int lookup_route(IP6Address, IP6Address &) const;
+    String dump_routes();
+
+    static int flush_handler(const String &, Element *, void *, ErrorHandler *);
+    static String stats_handler(Element *, void *);
+
+  private:
+
+    enum {
+	dir_bits = 16,		// address bits indexed by _dir
+	stride = 6,		// address bits consumed by each node
+	max_nexthops = 65535,
+	prefetch_window = 16	// packets per push_batch lookup window
+    };
+    enum { leaf_flag = 0x80000000U }; // _dir entry holds a next hop
+
+    struct Node {
+	uint64_t vector;	// bit i set: child i is a node
+	uint64_t leafvec;	// bit i set: a run of leaves starts at child i
+	uint32_t base0;		// first leaf in _leaves
+	uint32_t base1;		// first child node in _nodes
+    };
+
+    struct NextHop {
+	IP6Address gw;
+	int port;
+	int refcount;
+    };
+
+    struct Route {
+	uint64_t hi;		// address, host byte order
+	uint64_t lo;
+	int plen;
+	int nexthop;		// index into _nexthops, or -1 if free
+    };
+
+    // Lookup structures.
+    uint32_t *_dir;
+    Vector<Node> _nodes;
+    Vector<uint16_t> _leaves;
+    Vector<NextHop> _nexthops;	// _nexthops[0] is "no route"
+
+    // Update structures.
+    Vector<Route> _routes;
+    Vector<int> _free_routes;
+    HashTable<IP6Address, int> _prefixes[129]; // prefix address -> route
+    HashTable<uint32_t, Vector<int> > _long_routes; // /16 -> sorted longer routes
+    int *_dir_route;		// covering route of up to 16 bits, or -1
+    Vector<int> _free_nodes[65];
+    Vector<int> _free_leaves[65];
+    int _nnodes;
+    int _nleaves;
+
+    static inline int popcount(uint64_t x) {
+#if __GNUC__
+	return __builtin_popcountll(x);
+#else
+	x -= (x >> 1) & 0x5555555555555555ULL;
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (x * 0x0101010101010101ULL) >> 56;
+#endif
+    }
+    static inline void split(const IP6Address &a, uint64_t &hi, uint64_t &lo) {
+	const uint32_t *x = a.data32();
+	hi = ((uint64_t) ntohl(x[0]) << 32) | ntohl(x[1]);
+	lo = ((uint64_t) ntohl(x[2]) << 32) | ntohl(x[3]);
+    }
+    // Return the stride bits of hi:lo starting at bit pos, padding with 0s.
+    static inline int chunk(uint64_t hi, uint64_t lo, int pos) {
+	if (pos >= 64) {
+	    hi = lo;
+	    lo = 0;
+	    pos -= 64;
+	}
+	if (pos)
+	    hi = (hi << pos) | (lo >> (64 - pos));
+	return hi >> (64 - stride);
+    }
+    static inline int lookup_nexthop(const uint32_t *dir, const Node *nodes,
+				     const uint16_t *leaves,
+				     uint64_t hi, uint64_t lo);
+    int lookup_nexthop(uint64_t hi, uint64_t lo) const {
+	return lookup_nexthop(_dir, _nodes.begin(), _leaves.begin(), hi, lo);
+    }
+    inline int lookup(const IP6Address &a) const;
+#if CLICK_POPTRIE_POPCNT
+    // Always inlined, so that route_batch_popcnt() runs a POPCNT copy.
+    inline void route_batch(PacketBatch &batch) __attribute__((always_inline));
+#else
+    inline void route_batch(PacketBatch &batch);
+#endif
+    void route_batch_generic(PacketBatch &batch);
+#if CLICK_POPTRIE_POPCNT
+    int lookup_popcnt(uint64_t hi, uint64_t lo) const
+	__attribute__((target("popcnt")));
+    void route_batch_popcnt(PacketBatch &batch)
+	__attribute__((target("popcnt")));
+    bool _popcnt;
+#endif
+
+    int find_nexthop(const IP6Address &gw, int port);
+    int find_route(uint64_t hi, uint64_t lo, int plen) const;
+    int covering_route(uint64_t hi, uint64_t lo, int plen) const;
+    const int *lower_bound(const int *b, const int *e, uint64_t hi,
+			   uint64_t lo, int plen, bool upper) const;
+    uint32_t alloc_nodes(int n);
+    uint32_t alloc_leaves(int n);
+    void free_children(const Node &n, uint64_t keep);
+    void build_node(uint32_t node, const int *b, const int *e, int depth,
+		    int nexthop, const Node *old, uint64_t reuse);
+    void rebuild_slot(uint32_t slot);
+    void update_slots(uint64_t hi, int plen, int old_route, int new_route);
+    void update_subtrie(uint64_t hi, uint64_t lo, int plen);
+    void clear();
+
+};
+
+inline int
+PoptrieIP6Lookup::lookup_nexthop(const uint32_t *dir, const Node *nodes,
+				 const uint16_t *leaves, uint64_t hi, uint64_t lo)
+{
+    uint32_t ref = dir[hi >> (64 - dir_bits)];
+    if (ref & leaf_flag)
+	return ref & ~leaf_flag;
+    hi = (hi << dir_bits) | (lo >> (64 - dir_bits));
+    lo <<= dir_bits;
+    const Node *n = &nodes[ref];
+    int v = hi >> (64 - stride);
+    while ((n->vector >> v) & 1) {
+	n = &nodes[n->base1 + popcount(n->vector & (((uint64_t) 2 << v) - 1)) - 1];
+	hi = (hi << stride) | (lo >> (64 - stride));
+	lo <<= stride;
+	v = hi >> (64 - stride);
+    }
+    return leaves[n->base0 + popcount(n->leafvec & (((uint64_t) 2 << v) - 1)) - 1];
+}
+
+CLICK_ENDDECLS
+#endif
@@ -23,6 +23,14 @@
 #include <click/error.hh>
 #include <click/straccum.hh>
 #include <click/standard/alignmentinfo.hh>
+#include <click/element.hh>
+#if CLICK_CLASSIFICATION_NATIVE
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+#if CLICK_CLASSIFICATION_AVX2
+# include <immintrin.h>
+#endif
 CLICK_DECLS
 namespace Classification {
 namespace Wordwise {
@@ -1139,6 +1147,649 @@ Program::length_checked_match(const Packet *p)
     return -pos;
 }
 
+
+//
+// BATCH PROGRAMS
+//
+
+void
+BatchProgram::compile(const CompressedProgram &zprog, bool ip_offsets, int isa)
+{
+    clear();
+    _isa = isa == isa_best ? best_isa() : isa;
+    _output_everything = zprog.output_everything();
+    _align_offset = zprog.align_offset();
+    _ip_offsets = ip_offsets;
+    // Classifier's safe length doesn't count the alignment offset.
+    _safe_length = zprog.safe_length() + (ip_offsets ? 0 : _align_offset);
+    if (_output_everything >= 0)
+	return;
+
+    // Number the single-valued tests, then emit them.
+    const uint32_t *begin = zprog.begin(), *end = zprog.end();
+    Vector<int> first(end - begin, -1);
+    int ntests = 0;
+    for (const uint32_t *pr = begin; pr < end; pr += 4 + (pr[0] >> 17)) {
+	first[pr - begin] = ntests;
+	ntests += pr[0] >> 17;
+    }
+
+    for (const uint32_t *pr = begin; pr < end; pr += 4 + (pr[0] >> 17)) {
+	int here = pr - begin, nval = pr[0] >> 17;
+	int off = pr[0] & 0xFFFF;
+	if (ip_offsets)
+	    off = (int16_t) off;
+	uint32_t addr = off;
+	if (ip_offsets && off >= 512)
+	    addr = (2 << 16) | (off - 512);
+	else if (ip_offsets && off >= 256)
+	    addr = (1 << 16) | (off - 256);
+	int32_t j[2];
+	for (int i = 0; i < 2; ++i) {
+	    int32_t x = pr[1 + i];
+	    j[i] = x <= 0 ? x : first[here + x];
+	}
+	for (int k = 0; k < nval; ++k) {
+	    _addr.push_back(addr);
+	    _off.push_back(off);
+	    _mask.push_back(pr[3]);
+	    _value.push_back(pr[4 + k]);
+	    _j.push_back(k + 1 < nval ? _addr.size() : j[0]);
+	    _j.push_back(j[1]);
+	    _short_output.push_back((pr[0] & 0x10000) != 0);
+	}
+    }
+}
+
+void
+BatchProgram::clear()
+{
+    _addr.clear();
+    _off.clear();
+    _mask.clear();
+    _value.clear();
+    _j.clear();
+    _short_output.clear();
+    _output_everything = -1;
+}
+
+/* Set up base pointers for packet p and return its length in offset space. */
+inline int
+BatchProgram::setup(const Packet *p, const unsigned char **base) const
+{
+    if (_ip_offsets) {
+	base[0] = p->mac_header() - 2;
+	base[1] = p->network_header();
+	base[2] = p->transport_header();
+	int length = p->network_length(),
+	    network_header_length = p->network_header_length();
+	if (length > network_header_length)
+	    return length + 512 - network_header_length;
+	else
+	    return length + 256;
+    } else {
+	base[0] = base[1] = base[2] = p->data() - _align_offset;
+	return p->length() + _align_offset;
+    }
+}
+
+int
+BatchProgram::checked_match(const unsigned char * const *base, int length) const
+{
+    int pos = 0;
+    while (1) {
+	int32_t next;
+	int off = _off[pos];
+	if (off + Insn::width > length) {
+	    if (off < length) {
+		unsigned available = length - off;
+		const uint8_t *c = reinterpret_cast<const uint8_t *>(&_mask[pos]);
+		if (!(c[3]
+		      || (c[2] && available <= 2)
+		      || (c[1] && available == 1)))
+		    goto length_ok;
+	    }
+	    next = _j[2 * pos + _short_output[pos]];
+	    goto jump;
+	}
+    length_ok: {
+	    uint32_t addr = _addr[pos];
+	    uint32_t data = *reinterpret_cast<const uint32_t *>(base[addr >> 16] + (addr & 0xFFFF));
+	    next = _j[2 * pos + ((data & _mask[pos]) == _value[pos])];
+	}
+    jump:
+	if (next <= 0)
+	    return -next;
+	pos = next;
+    }
+}
+
+/* Find the next packet at or after p[next] that needs a full walk, setting
+   its base pointers.  Shorter packets on the way are classified here. */
+inline bool
+BatchProgram::fetch(Packet * const *p, int n, int &next, int *outputs,
+		    const unsigned char **base) const
+{
+    for (; next < n; ++next) {
+	int length = setup(p[next], base);
+	if ((unsigned) length >= _safe_length)
+	    return true;
+	outputs[next] = checked_match(base, length);
+    }
+    return false;
+}
+
+void
+BatchProgram::walk_scalar(Packet * const *p, int n, int *outputs) const
+{
+    const uint32_t *addr = _addr.begin(), *mask = _mask.begin(),
+	*value = _value.begin();
+    const int32_t *jump = _j.begin();
+    const unsigned char *base[lanes * 3];
+    int pos[lanes], which[lanes];
+    unsigned live = 0;
+    int next = 0;
+    for (int k = 0; k < lanes && fetch(p, n, next, outputs, base + 3 * k); ++k) {
+	pos[k] = 0;
+	which[k] = next++;
+	live |= 1U << k;
+    }
+
+    while (live)
+	for (int k = 0; k < lanes; ++k)
+	    if (live & (1U << k)) {
+		int i = pos[k];
+		const unsigned char *data = base[3 * k + (addr[i] >> 16)] + (addr[i] & 0xFFFF);
+		int32_t j = jump[2 * i + ((*reinterpret_cast<const uint32_t *>(data) & mask[i]) == value[i])];
+		if (j > 0)
+		    pos[k] = j;
+		else {
+		    outputs[which[k]] = -j;
+		    if (fetch(p, n, next, outputs, base + 3 * k)) {
+			pos[k] = 0;
+			which[k] = next++;
+		    } else
+			live &= ~(1U << k);
+		}
+	    }
+}
+
+#if CLICK_CLASSIFICATION_AVX2
+void
+BatchProgram::walk_avx2(Packet * const *p, int n, int *outputs) const
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i addr_mask = _mm256_set1_epi32(0xFFFF);
+    const __m256i one64 = _mm256_set1_epi64x(1), two64 = _mm256_set1_epi64x(2);
+
+    // Base pointers, indexed by base index * lanes + lane.  Kept in
+    // registers as well, where each test selects its lanes' bases.
+    const unsigned char *base[3 * lanes] = { 0 };
+    const unsigned char *fetched[3];
+    int pos[lanes], active[lanes], which[lanes];
+    int next = 0;
+    for (int k = 0; k < lanes; ++k) {
+	pos[k] = 0;
+	active[k] = 0;
+	if (fetch(p, n, next, outputs, fetched)) {
+	    for (int b = 0; b < 3; ++b)
+		base[b * lanes + k] = fetched[b];
+	    active[k] = -1;
+	    which[k] = next++;
+	}
+    }
+
+    __m256i vpos = zero;
+    __m256i vactive = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(active));
+    __m256i vbase[6];
+    for (int i = 0; i < 6; ++i)
+	vbase[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(base + 4 * i));
+    while (!_mm256_testz_si256(vactive, vactive)) {
+	// Each step evaluates the current test of every active lane.  Masked
+	// gathers skip idle lanes.
+	__m256i addr = _mm256_mask_i32gather_epi32(zero, reinterpret_cast<const int *>(_addr.begin()), vpos, vactive, 4);
+	__m256i bidx = _mm256_srli_epi32(addr, 16);
+	__m256i disp = _mm256_and_si256(addr, addr_mask);
+
+	__m128i active_lo = _mm256_castsi256_si128(vactive);
+	__m128i active_hi = _mm256_extracti128_si256(vactive, 1);
+	__m256i bidx_lo = _mm256_cvtepu32_epi64(_mm256_castsi256_si128(bidx));
+	__m256i bidx_hi = _mm256_cvtepu32_epi64(_mm256_extracti128_si256(bidx, 1));
+	__m256i ptr_lo = _mm256_blendv_epi8(vbase[0], vbase[2], _mm256_cmpeq_epi64(bidx_lo, one64));
+	ptr_lo = _mm256_blendv_epi8(ptr_lo, vbase[4], _mm256_cmpeq_epi64(bidx_lo, two64));
+	__m256i ptr_hi = _mm256_blendv_epi8(vbase[1], vbase[3], _mm256_cmpeq_epi64(bidx_hi, one64));
+	ptr_hi = _mm256_blendv_epi8(ptr_hi, vbase[5], _mm256_cmpeq_epi64(bidx_hi, two64));
+	ptr_lo = _mm256_add_epi64(ptr_lo, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(disp)));
+	ptr_hi = _mm256_add_epi64(ptr_hi, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(disp, 1)));
+	__m128i data_lo = _mm256_mask_i64gather_epi32(_mm_setzero_si128(), (const int *) 0, ptr_lo, active_lo, 1);
+	__m128i data_hi = _mm256_mask_i64gather_epi32(_mm_setzero_si128(), (const int *) 0, ptr_hi, active_hi, 1);
+	__m256i data = _mm256_inserti128_si256(_mm256_castsi128_si256(data_lo), data_hi, 1);
+
+	__m256i mask = _mm256_mask_i32gather_epi32(zero, reinterpret_cast<const int *>(_mask.begin()), vpos, vactive, 4);
+	__m256i value = _mm256_mask_i32gather_epi32(zero, reinterpret_cast<const int *>(_value.begin()), vpos, vactive, 4);
+	__m256i match = _mm256_cmpeq_epi32(_mm256_and_si256(data, mask), value);
+	__m256i jindex = _mm256_add_epi32(_mm256_add_epi32(vpos, vpos), _mm256_and_si256(match, one));
+	__m256i vnext = _mm256_mask_i32gather_epi32(zero, reinterpret_cast<const int *>(_j.begin()), jindex, vactive, 4);
+	vpos = _mm256_blendv_epi8(vpos, vnext, vactive);
+
+	// Lanes whose packets reached an output take the next packet.
+	__m256i done = _mm256_andnot_si256(_mm256_cmpgt_epi32(vnext, zero), vactive);
+	if (!_mm256_testz_si256(done, done)) {
+	    unsigned done_mask = _mm256_movemask_ps(_mm256_castsi256_ps(done));
+	    _mm256_storeu_si256(reinterpret_cast<__m256i *>(pos), vpos);
+	    for (int k = 0; k < lanes; ++k)
+		if (done_mask & (1U << k)) {
+		    outputs[which[k]] = -pos[k];
+		    pos[k] = 0;
+		    if (fetch(p, n, next, outputs, fetched)) {
+			for (int b = 0; b < 3; ++b)
+			    base[b * lanes + k] = fetched[b];
+			which[k] = next++;
+		    } else
+			active[k] = 0;
+		}
+	    vpos = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pos));
+	    vactive = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(active));
+	    for (int i = 0; i < 6; ++i)
+		vbase[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(base + 4 * i));
+	}
+    }
+}
+#endif
+
+int
+BatchProgram::best_isa()
+{
+    return isa_scalar;
+}
+
+/** @brief Return true iff this machine can run instruction set @a isa. */
+bool
+BatchProgram::isa_supported(int isa)
+{
+    if (isa == isa_scalar)
+	return true;
+#if CLICK_CLASSIFICATION_AVX2
+    static int avx2 = -1;
+    if (avx2 < 0) {
+	__builtin_cpu_init();
+	avx2 = __builtin_cpu_supports("avx2") != 0;
+    }
+    if (isa == isa_avx2)
+	return avx2;
+#endif
+    return false;
+}
+
+const char *
+BatchProgram::isa_name(int isa)
+{
+    return isa == isa_avx2 ? "avx2" : "scalar";
+}
+
+bool
+BatchProgram::parse_isa(const String &str, int &isa)
+{
+    if (str == "scalar")
+	isa = isa_scalar;
+    else if (str == "avx2" && isa_supported(isa_avx2))
+	isa = isa_avx2;
+    else
+	return false;
+    return true;
+}
+
+void
+BatchProgram::match(Packet * const *p, int n, int *outputs, int isa) const
+{
+    if (_output_everything >= 0) {
+	for (int i = 0; i < n; ++i)
+	    outputs[i] = _output_everything;
+	return;
+    }
+#if CLICK_CLASSIFICATION_AVX2
+    if (isa == isa_best)
+	isa = best_isa();
+    if (isa == isa_avx2) {
+	walk_avx2(p, n, outputs);
+	return;
+    }
+#endif
+    (void) isa;
+    walk_scalar(p, n, outputs);
+}
+
+void
+BatchProgram::push_batch(const Element *e, PacketBatch &batch) const
+{
+    enum { group = 64 };
+    Packet *p[group];
+    int outputs[group];
+    while (!batch.empty()) {
+	int n = 0;
+	while (n < group && !batch.empty())
+	    p[n++] = batch.pop_front();
+	match(p, n, outputs, _isa);
+
+	// Push one sub-batch per output, in order of first appearance.
+	for (int i = 0; i < n; ++i)
+	    if (p[i]) {
+		PacketBatch sub;
+		int port = outputs[i];
+		for (int j = i; j < n; ++j)
+		    if (p[j] && outputs[j] == port) {
+			sub.push_back(p[j]);
+			p[j] = 0;
+		    }
+		e->checked_output_push_batch(port, sub);
+	    }
+    }
+}
+
+
+#if CLICK_CLASSIFICATION_NATIVE
+//
+// NATIVE CODE
+//
+
+namespace {
+class NativeEmitter { public:
+
+    NativeEmitter(const CompressedProgram &zprog, bool ip_offsets)
+	: _zprog(zprog), _ip_offsets(ip_offsets), _next(-1) {
+    }
+
+    bool emit();
+
+    const StringAccum &code() const {
+	return _code;
+    }
+
+  private:
+
+    enum { cc_b = 0x2, cc_e = 0x4, cc_always = -1 };
+    enum { reg_rdx = 2, reg_rsi = 6, reg_rdi = 7 };
+
+    struct Fixup {
+	int pos;
+	bool output;
+	int target;
+    };
+
+    const CompressedProgram &_zprog;
+    bool _ip_offsets;
+    StringAccum _code;
+    Vector<int> _test_pos;	// code position by program word, or -1
+    Vector<Fixup> _fixups;
+    int _next;			// program word of the next test
+
+    void byte(int b) {
+	_code.append((char) b);
+    }
+    void imm32(uint32_t x) {
+	_code.append(reinterpret_cast<const char *>(&x), 4);
+    }
+    void jump(int cc, bool output, int target);
+    int local_jump(int cc);
+    void patch_here(int pos);
+    void search(const uint32_t *v, int n, bool last,
+		const Fixup &yes, const Fixup &no);
+
+};
+
+void
+NativeEmitter::jump(int cc, bool output, int target)
+{
+    if (cc == cc_always)
+	byte(0xE9);		// jmp rel32
+    else {
+	byte(0x0F);		// jcc rel32
+	byte(0x80 | cc);
+    }
+    Fixup f = { _code.length(), output, target };
+    _fixups.push_back(f);
+    imm32(0);
+}
+
+int
+NativeEmitter::local_jump(int cc)
+{
+    byte(0x0F);
+    byte(0x80 | cc);
+    imm32(0);
+    return _code.length() - 4;
+}
+
+void
+NativeEmitter::patch_here(int pos)
+{
+    int32_t rel = _code.length() - (pos + 4);
+    memcpy(_code.data() + pos, &rel, 4);
+}
+
+/* Emit a search of the sorted values v[0..n-1] for the word in %eax.  Large
+   sets become a binary search tree of unsigned comparisons. */
+void
+NativeEmitter::search(const uint32_t *v, int n, bool last,
+		      const Fixup &yes, const Fixup &no)
+{
+    if (n <= 3) {
+	for (int i = 0; i < n; ++i) {
+	    byte(0x3D);		// cmp $v, %eax
+	    imm32(v[i]);
+	    jump(cc_e, yes.output, yes.target);
+	}
+	if (!last || no.output || no.target != _next)
+	    jump(cc_always, no.output, no.target);
+    } else {
+	int mid = n / 2;
+	byte(0x3D);
+	imm32(v[mid]);
+	jump(cc_e, yes.output, yes.target);
+	int below = local_jump(cc_b);
+	search(v + mid + 1, n - mid - 1, false, yes, no);
+	patch_here(below);
+	search(v, mid, last, yes, no);
+    }
+}
+
+bool
+NativeEmitter::emit()
+{
+    if (_zprog.output_everything() >= 0) {
+	byte(0xB8);		// mov $output, %eax
+	imm32(_zprog.output_everything());
+	byte(0xC3);		// ret
+	return true;
+    }
+
+    const uint32_t *begin = _zprog.begin(), *end = _zprog.end();
+    if (begin == end)
+	return false;
+    _test_pos.assign(end - begin, -1);
+
+    Vector<uint32_t> values;
+    for (const uint32_t *pr = begin; pr != end; ) {
+	int nval = pr[0] >> 17;
+	if (nval == 0 || end - pr < 4 + nval)
+	    return false;
+	int here = pr - begin;
+	_test_pos[here] = _code.length();
+	_next = here + 4 + nval;
+
+	Fixup branch[2];
+	for (int i = 0; i < 2; ++i) {
+	    int32_t j = pr[1 + i];
+	    branch[i].pos = 0;
+	    branch[i].output = j <= 0;
+	    branch[i].target = j <= 0 ? -j : here + j;
+	}
+
+	if (pr[3] == 0) {
+	    // Every value is zero after masking, so the test always succeeds.
+	    jump(cc_always, branch[1].output, branch[1].target);
+	    pr += 4 + nval;
+	    continue;
+	}
+
+	int off = pr[0] & 0xFFFF, reg = reg_rdi;
+	if (_ip_offsets) {
+	    off = (int16_t) off;
+	    if (off >= 512)
+		reg = reg_rdx, off -= 512;
+	    else if (off >= 256)
+		reg = reg_rsi, off -= 256;
+	}
+	byte(0x8B);		// mov off(%reg), %eax
+	byte(0x80 | reg);
+	imm32(off);
+	if (pr[3] != 0xFFFFFFFFU) {
+	    byte(0x25);		// and $mask, %eax
+	    imm32(pr[3]);
+	}
+
+	values.clear();
+	for (int i = 0; i < nval; ++i)
+	    values.push_back(pr[4 + i]);
+	click_qsort(values.begin(), values.size());
+	int nunique = 1;
+	for (int i = 1; i < values.size(); ++i)
+	    if (values[i] != values[nunique - 1])
+		values[nunique++] = values[i];
+	search(values.begin(), nunique, true, branch[1], branch[0]);
+	pr += 4 + nval;
+    }
+
+    // One return stub per output.
+    Vector<int> outputs, output_pos;
+    for (Fixup *f = _fixups.begin(); f != _fixups.end(); ++f)
+	if (f->output) {
+	    int i = 0;
+	    while (i < outputs.size() && outputs[i] != f->target)
+		++i;
+	    if (i == outputs.size()) {
+		outputs.push_back(f->target);
+		output_pos.push_back(_code.length());
+		byte(0xB8);
+		imm32(f->target);
+		byte(0xC3);
+	    }
+	}
+
+    for (Fixup *f = _fixups.begin(); f != _fixups.end(); ++f) {
+	int dest = -1;
+	if (f->output) {
+	    for (int i = 0; i < outputs.size(); ++i)
+		if (outputs[i] == f->target)
+		    dest = output_pos[i];
+	} else if (f->target < _test_pos.size() && _test_pos[f->target] >= 0)
+	    dest = _test_pos[f->target];
+	else
+	    return false;
+	int32_t rel = dest - (f->pos + 4);
+	memcpy(_code.data() + f->pos, &rel, 4);
+    }
+    return true;
+}
+}
+
+NativeProgram::~NativeProgram()
+{
+    // No thread is matching any more.
+    _rcu.flush();
+    unmap_code(_code, _code_size);
+}
+
+/** @brief Let other threads match while the program changes.
+ * @param owner element that runs the program
+ *
+ * From now on, code replaced by compile() or clear() is unmapped by a timer
+ * on @a owner after an RCU grace period, rather than immediately. */
+void
+NativeProgram::initialize(Element *owner)
+{
+    _rcu.initialize(owner->master());
+    _timer.initialize(owner);
+}
+
+bool
+NativeProgram::compile(const CompressedProgram &zprog, bool ip_offsets)
+{
+    NativeEmitter emitter(zprog, ip_offsets);
+    if (!emitter.emit()) {
+	clear();
+	return false;
+    }
+
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t length = emitter.code().length();
+    size_t map_size = (length + page_size - 1) & ~(page_size - 1);
+    void *code = mmap(0, map_size, PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+	clear();
+	return false;
+    }
+    memcpy(code, emitter.code().data(), length);
+    if (mprotect(code, map_size, PROT_READ | PROT_EXEC) != 0) {
+	munmap(code, map_size);
+	clear();
+	return false;
+    }
+
+    publish(reinterpret_cast<function_type>(code), code, length);
+    return true;
+}
+
+void
+NativeProgram::clear()
+{
+    publish(0, 0, 0);
+}
+
+void
+NativeProgram::publish(function_type f, void *code, size_t code_size)
+{
+    _lock.acquire();
+    void *old_code = _code;
+    size_t old_code_size = _code_size;
+    // The new code is complete before any thread can call it.
+    click_fence();
+    _f = f;
+    _code = code;
+    _code_size = code_size;
+    if (old_code) {
+	_rcu.defer(unmap_code, old_code, old_code_size);
+	if (!_rcu.empty() && _timer.initialized() && !_timer.scheduled())
+	    _timer.schedule_after_msec(reclaim_msec);
+    }
+    _lock.release();
+}
+
+void
+NativeProgram::unmap_code(void *code, uintptr_t code_size)
+{
+    if (code) {
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	munmap(code, (code_size + page_size - 1) & ~(page_size - 1));
+    }
+}
+
+void
+NativeProgram::reclaim_timer_hook(Timer *timer, void *user_data)
+{
+    NativeProgram *np = static_cast<NativeProgram *>(user_data);
+    if (np->_lock.attempt()) {
+	bool more = np->_rcu.collect();
+	np->_lock.release();
+	if (!more)
+	    return;
+    }
+    timer->reschedule_after_msec(reclaim_msec);
+}
+#endif
+
 }}
 CLICK_ENDDECLS
 ELEMENT_PROVIDES(Classification)
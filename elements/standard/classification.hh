@@ -1,10 +1,22 @@
 #ifndef CLICK_CLASSIFICATION_HH
 #define CLICK_CLASSIFICATION_HH 1
 #define CLICK_CLASSIFICATION_WORDWISE_DOMINATOR_FASTPRED 1
+#if CLICK_USERLEVEL && ALLOW_MMAP && defined(__x86_64__)
+# define CLICK_CLASSIFICATION_NATIVE 1
+#endif
+#if CLICK_USERLEVEL && defined(__x86_64__) && __GNUC__ >= 5
+# define CLICK_CLASSIFICATION_AVX2 1
+#endif
 #include <click/packet.hh>
 #include <click/vector.hh>
+#if CLICK_CLASSIFICATION_NATIVE
+# include <click/rcu.hh>
+# include <click/sync.hh>
+# include <click/timer.hh>
+#endif
 CLICK_DECLS
 class ErrorHandler;
+class Element;
 namespace Classification {
 
 enum Jumps {
@@ -260,6 +272,192 @@ class CompressedProgram { public:
 };
 
 
+/** @brief A CompressedProgram laid out for classifying several packets at
+ * once.
+ *
+ * BatchProgram expands each multi-valued test into a chain of single-valued
+ * tests and stores the tests' fields in parallel arrays, so that a vector
+ * unit can fetch the current test of several packets with gather
+ * instructions.  match() walks 8 packets through the program at once, and
+ * starts the next packet in a lane as soon as the lane's packet reaches an
+ * output.  The default scalar walk interleaves the lanes' walks.  The
+ * experimental AVX2 walk, available on x86-64 processors with AVX2 and used
+ * only when requested, evaluates each step's test for all 8 lanes at once.
+ * Packets shorter than the program's safe length are classified one at a
+ * time with length checks.
+ *
+ * Offsets are interpreted as by NativeProgram. */
+class BatchProgram { public:
+
+    enum {
+	isa_scalar = 0,		///< interleaved scalar code
+	isa_avx2 = 1,		///< AVX2 gathers and compares
+	isa_best = -1		///< default; see best_isa()
+    };
+
+    BatchProgram()
+	: _output_everything(-1), _safe_length((unsigned) -1),
+	  _align_offset(0), _ip_offsets(false), _isa(isa_scalar) {
+    }
+
+    /** @brief Compile @a zprog for batch matching with instruction set
+     * @a isa, which push_batch() will use. */
+    void compile(const CompressedProgram &zprog, bool ip_offsets,
+		 int isa = isa_best);
+    void clear();
+
+    bool empty() const {
+	return _output_everything < 0 && _off.empty();
+    }
+
+    /** @brief Return the instruction set push_batch() uses. */
+    int isa() const {
+	return _isa;
+    }
+
+    /** @brief Store the output of each of the @a n packets @a p in
+     * @a outputs, using instruction set @a isa. */
+    void match(Packet * const *p, int n, int *outputs, int isa = isa_best) const;
+
+    /** @brief Classify the packets in @a batch and push them to @a e's
+     * outputs, one sub-batch per output.
+     *
+     * Packets are pushed in groups of up to 64; within each group, every
+     * output's packets keep their order, but packets bound for different
+     * outputs may be reordered. */
+    void push_batch(const Element *e, PacketBatch &batch) const;
+
+    /** @brief Return the instruction set to use by default.
+     *
+     * This is isa_scalar even where AVX2 is available: on the processors
+     * measured, the gathers cost more than interleaving saves, so the AVX2
+     * walk was the slowest batch matcher.  Select it explicitly to use it. */
+    static int best_isa();
+    static bool isa_supported(int isa);
+    static const char *isa_name(int isa);
+    /** @brief Parse an instruction set name into @a isa.
+     *
+     * Returns false if @a str names no instruction set available on this
+     * machine. */
+    static bool parse_isa(const String &str, int &isa);
+
+  private:
+
+    enum { lanes = 8 };
+
+    Vector<uint32_t> _addr;	// base pointer index << 16 | displacement
+    Vector<int32_t> _off;	// original offset, for length checks
+    Vector<uint32_t> _mask;
+    Vector<uint32_t> _value;
+    Vector<int32_t> _j;		// no, yes; > 0: next test, <= 0: -output
+    Vector<uint8_t> _short_output;
+    int _output_everything;
+    unsigned _safe_length;
+    unsigned _align_offset;
+    bool _ip_offsets;
+    int _isa;
+
+    inline int setup(const Packet *p, const unsigned char **base) const;
+    int checked_match(const unsigned char * const *base, int length) const;
+    inline bool fetch(Packet * const *p, int n, int &next, int *outputs,
+		      const unsigned char **base) const;
+    void walk_scalar(Packet * const *p, int n, int *outputs) const;
+#if CLICK_CLASSIFICATION_AVX2
+    void walk_avx2(Packet * const *p, int n, int *outputs) const
+	__attribute__((target("avx2")));
+#endif
+
+};
+
+
+#if CLICK_CLASSIFICATION_NATIVE
+/** @brief A CompressedProgram translated into x86-64 machine code.
+ *
+ * The generated function has the program's tests inlined as compare and
+ * branch instructions, with binary search trees for tests of many values.
+ * It loads packet words without checking the packet's length, so it must
+ * only be called on packets at least the program's safe_length() long; use
+ * the interpreter for shorter packets.
+ *
+ * Offsets are taken relative to one of three data pointers.  Without
+ * ip_offsets, every offset is relative to @a data0.  With ip_offsets,
+ * offsets below 256 are relative to @a data0, offsets below 512 are relative
+ * to @a data1 after subtracting 256, and others are relative to @a data2
+ * after subtracting 512, as in IPFilter.
+ *
+ * Once initialize() is called, compile() and clear() may run while other
+ * threads are matching through try_match().  Replaced code is unmapped only
+ * after an RCU grace period. */
+class NativeProgram { public:
+
+    NativeProgram()
+	: _f(0), _code(0), _code_size(0), _timer(reclaim_timer_hook, this) {
+    }
+    ~NativeProgram();
+
+    void initialize(Element *owner);
+
+    /** @brief Translate @a zprog into machine code.
+     * @return true on success, false if @a zprog can't be translated (in
+     * which case the program is cleared) */
+    bool compile(const CompressedProgram &zprog, bool ip_offsets);
+    void clear();
+
+    bool compiled() const {
+	return _f != 0;
+    }
+    size_t code_size() const {
+	return _code_size;
+    }
+
+    /** @brief Run the compiled program.
+     *
+     * The program must be compiled and must not change during the call. */
+    int match(const unsigned char *data0, const unsigned char *data1,
+	      const unsigned char *data2) const {
+	return _f(data0, data1, data2);
+    }
+
+    /** @brief Run the program if it is compiled.
+     * @return true iff the program is compiled, in which case @a output is
+     * set to its result
+     *
+     * Unlike compiled() followed by match(), this is safe while another
+     * thread compiles or clears the program. */
+    bool try_match(const unsigned char *data0, const unsigned char *data1,
+		   const unsigned char *data2, int &output) const {
+	if (function_type f = _f) {
+	    output = f(data0, data1, data2);
+	    return true;
+	} else
+	    return false;
+    }
+
+  private:
+
+    typedef int (*function_type)(const unsigned char *,
+				 const unsigned char *,
+				 const unsigned char *);
+    function_type volatile _f;
+    void *_code;
+    size_t _code_size;
+
+    enum { reclaim_msec = 10 };
+    Spinlock _lock;		// serializes publication and reclamation
+    RCUCollector _rcu;		// code replaced by compile() or clear()
+    Timer _timer;
+
+    void publish(function_type f, void *code, size_t code_size);
+    static void unmap_code(void *code, uintptr_t code_size);
+    static void reclaim_timer_hook(Timer *, void *);
+
+    NativeProgram(const NativeProgram &);
+    NativeProgram &operator=(const NativeProgram &);
+
+};
+#endif
+
+
 class DominatorOptimizer { public:
 
     DominatorOptimizer(Program *p);
@@ -23,16 +23,23 @@
 #include <click/glue.hh>
 #include <click/error.hh>
 #include <click/confparse.hh>
+#include <click/args.hh>
 #include <click/straccum.hh>
 #include <click/standard/alignmentinfo.hh>
 CLICK_DECLS
 
 Classifier::Classifier()
+    : _batch_prog(0), _simd(false),
+      _simd_isa(Classification::Wordwise::BatchProgram::isa_best),
+      _rcu_timer(rcu_timer_hook, this)
 {
 }
 
 Classifier::~Classifier()
 {
+    // No thread is classifying any more.
+    _rcu.flush();
+    delete _batch_prog;
 }
 
 Classification::Wordwise::Program
@@ -222,11 +229,79 @@ Classifier::configure(Vector<String> &conf, ErrorHandler *errh)
     if (!errh->nerrors()) {
 	prog.warn_unused_outputs(noutputs(), errh);
 	_prog = prog;
+	compile_native();
+	compile_batch();
 	return 0;
     } else
 	return -1;
 }
 
+int
+Classifier::initialize(ErrorHandler *)
+{
+#if CLICK_CLASSIFICATION_NATIVE
+    // From now on, the jit handler may replace native code while other
+    // threads run it.
+    _native.initialize(this);
+#endif
+    // Likewise, the simd handler may replace the batch program.
+    _rcu.initialize(master());
+    _rcu_timer.initialize(this);
+    return 0;
+}
+
+void
+Classifier::compile_native()
+{
+#if CLICK_CLASSIFICATION_NATIVE
+    // Native code is generated from the compressed form, which also merges
+    // chains of tests against the same word.
+    Classification::Wordwise::CompressedProgram zprog;
+    zprog.compile(_prog, false, 0);
+    _native.compile(zprog, false);
+#endif
+}
+
+/* Replace the batch program.  Other threads may be running the old one in
+   push_batch(), so build the new one off to the side, publish it with a
+   single store, and delete the old one after an RCU grace period. */
+void
+Classifier::compile_batch()
+{
+    Classification::Wordwise::BatchProgram *bp = 0;
+    if (_simd) {
+	Classification::Wordwise::CompressedProgram zprog;
+	zprog.compile(_prog, false, 0);
+	bp = new Classification::Wordwise::BatchProgram;
+	bp->compile(zprog, false, _simd_isa);
+    }
+
+    _update_lock.acquire();
+    Classification::Wordwise::BatchProgram *old_bp = _batch_prog;
+    // The new program is complete before any thread can run it.
+    click_fence();
+    _batch_prog = bp;
+    if (old_bp) {
+	_rcu.defer_delete(old_bp);
+	if (!_rcu.empty() && _rcu_timer.initialized() && !_rcu_timer.scheduled())
+	    _rcu_timer.schedule_after_msec(rcu_collect_msec);
+    }
+    _update_lock.release();
+}
+
+void
+Classifier::rcu_timer_hook(Timer *timer, void *user_data)
+{
+    Classifier *c = static_cast<Classifier *>(user_data);
+    if (c->_update_lock.attempt()) {
+	bool more = c->_rcu.collect();
+	c->_update_lock.release();
+	if (!more)
+	    return;
+    }
+    timer->reschedule_after_msec(rcu_collect_msec);
+}
+
 String
 Classifier::program_string(Element *element, void *)
 {
@@ -234,16 +309,101 @@ Classifier::program_string(Element *element, void *)
     return c->_prog.unparse();
 }
 
+String
+Classifier::read_jit(Element *element, void *)
+{
+#if CLICK_CLASSIFICATION_NATIVE
+    Classifier *c = static_cast<Classifier *>(element);
+    return String(c->_native.compiled());
+#else
+    (void) element;
+    return String(false);
+#endif
+}
+
+int
+Classifier::write_jit(const String &str, Element *element, void *, ErrorHandler *errh)
+{
+    Classifier *c = static_cast<Classifier *>(element);
+    bool jit;
+    if (!BoolArg().parse(str, jit))
+	return errh->error("syntax error");
+#if CLICK_CLASSIFICATION_NATIVE
+    if (jit)
+	c->compile_native();
+    else
+	c->_native.clear();
+    return 0;
+#else
+    (void) c;
+    return jit ? errh->error("native code not supported") : 0;
+#endif
+}
+
+String
+Classifier::read_simd(Element *element, void *)
+{
+    Classifier *c = static_cast<Classifier *>(element);
+    if (const Classification::Wordwise::BatchProgram *bp = c->_batch_prog)
+	return Classification::Wordwise::BatchProgram::isa_name(bp->isa());
+    else
+	return String(false);
+}
+
+int
+Classifier::write_simd(const String &str, Element *element, void *, ErrorHandler *errh)
+{
+    Classifier *c = static_cast<Classifier *>(element);
+    int isa = Classification::Wordwise::BatchProgram::isa_best;
+    if (!BoolArg().parse(str, c->_simd)) {
+	if (!Classification::Wordwise::BatchProgram::parse_isa(str, isa))
+	    return errh->error("syntax error");
+	c->_simd = true;
+    }
+    c->_simd_isa = isa;
+    c->compile_batch();
+    return 0;
+}
+
 void
 Classifier::add_handlers()
 {
     add_read_handler("program", Classifier::program_string, 0, Handler::CALM);
+    add_read_handler("jit", read_jit, 0);
+    add_write_handler("jit", write_jit, 0);
+    add_read_handler("simd", read_simd, 0);
+    add_write_handler("simd", write_simd, 0);
 }
 
 void
 Classifier::push(int, Packet *p)
 {
-    checked_output_push(_prog.match(p), p);
+    checked_output_push(match(p), p);
+}
+
+void
+Classifier::push_batch(int, PacketBatch &batch)
+{
+    // Load the program once: the simd handler may replace it meanwhile.
+    const Classification::Wordwise::BatchProgram *bp = _batch_prog;
+    if (bp && !bp->empty()) {
+	bp->push_batch(this, batch);
+	return;
+    }
+
+    // Emit runs of packets bound for the same output as sub-batches; this
+    // preserves packet order without per-output storage.
+    PacketBatch run;
+    int run_port = -1;
+    while (Packet *p = batch.pop_front()) {
+	int port = match(p);
+	if (port != run_port && !run.empty())
+	    checked_output_push_batch(run_port, run);
+	run_port = port;
+	run.push_back(p);
+    }
+    if (!run.empty())
+	checked_output_push_batch(run_port, run);
 }
 
 CLICK_ENDDECLS
@@ -1,6 +1,9 @@
 #ifndef CLICK_CLASSIFIER_HH
 #define CLICK_CLASSIFIER_HH
 #include <click/element.hh>
+#include <click/rcu.hh>
+#include <click/sync.hh>
+#include <click/timer.hh>
 #include "classification.hh"
 CLICK_DECLS
 
@@ -70,6 +73,31 @@ CLICK_DECLS
  *   safe length 22
  *   alignment offset 0
  *
+ * =h jit read/write
+ * Returns true if the element classifies packets with native machine code,
+ * false if it interprets the program.  At user level on x86-64, Classifier
+ * translates its program into machine code when configured, and interprets
+ * it only for packets shorter than the program's safe length.  Write false
+ * to interpret every packet, or true to translate the program again.
+ *
+ * =h simd read/write
+ * Returns the instruction set the element uses to classify batches of
+ * packets several at a time, or false if it classifies one packet at a time.
+ * In batch mode, the element walks 8 packets through the program together,
+ * and pushes each batch as one sub-batch per output.  Packets bound for the
+ * same output keep their order, but packets bound for different outputs may
+ * be reordered.  Write true or "scalar" for batch mode, or false to turn it
+ * off.  Batch mode is a scalar walk: "scalar" interleaves the 8 packets'
+ * walks in ordinary code, with no vector instructions.  A vectorized walk
+ * is experimental and never chosen automatically.  On x86-64 processors with
+ * AVX2, write "avx2" to evaluate each step for the 8 packets at once with
+ * AVX2 gathers.  On the processors measured, the gathers cost more than they
+ * save, so "avx2" was slower than "scalar"; ClassifierJITTest's BENCHMARK
+ * keyword compares them on the local host.  There is no SSE4.2 walk, since
+ * SSE4.2 has no gather instruction.  Writes may happen while other threads
+ * classify packets; the replaced batch program is freed after an RCU grace
+ * period.  Default is false.
+ *
  * =a IPClassifier, IPFilter */
 
 class Classifier : public Element { public:
@@ -81,13 +109,16 @@ class Classifier : public Element { public:
     const char *port_count() const		{ return "1/-"; }
     const char *processing() const		{ return PUSH; }
     // this element needs AlignmentInfo, so supply the "A" flag
-    const char *flags() const			{ return "A"; }
+    const char *flags() const			{ return "A B"; }
     bool can_live_reconfigure() const		{ return true; }
 
     int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
     void add_handlers();
 
+    inline int match(const Packet *p);
     void push(int port, Packet *);
+    void push_batch(int port, PacketBatch &batch);
 
     Classification::Wordwise::Program empty_program(ErrorHandler *errh) const;
     static void parse_program(Classification::Wordwise::Program &prog,
@@ -96,10 +127,41 @@ class Classifier : public Element { public:
   protected:
 
     Classification::Wordwise::Program _prog;
+#if CLICK_CLASSIFICATION_NATIVE
+    Classification::Wordwise::NativeProgram _native;
+#endif
+    Classification::Wordwise::BatchProgram * volatile _batch_prog;
+    bool _simd;
+    int _simd_isa;
+
+    enum { rcu_collect_msec = 10 };
+    Spinlock _update_lock;	// serializes batch program updates
+    RCUCollector _rcu;		// batch programs replaced by updates
+    Timer _rcu_timer;
+
+    void compile_native();
+    void compile_batch();
+    static void rcu_timer_hook(Timer *, void *);
 
     static String program_string(Element *, void *);
+    static String read_jit(Element *, void *);
+    static int write_jit(const String &, Element *, void *, ErrorHandler *);
+    static String read_simd(Element *, void *);
+    static int write_simd(const String &, Element *, void *, ErrorHandler *);
 
 };
 
+inline int
+Classifier::match(const Packet *p)
+{
+#if CLICK_CLASSIFICATION_NATIVE
+    int output;
+    if (p->length() >= _prog.safe_length()
+	&& _native.try_match(p->data() - _prog.align_offset(), 0, 0, output))
+	return output;
+#endif
+    return _prog.match(p);
+}
+
 CLICK_ENDDECLS
 #endif
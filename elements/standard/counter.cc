@@ -107,6 +107,27 @@ Counter::simple_action(Packet *p)
   return p;
 }
 
+void
+Counter::push_batch(int, PacketBatch &batch)
+{
+    PacketBatch out;
+    while (Packet *p = batch.pop_front())
+	if ((p = Counter::simple_action(p)))
+	    out.push_back(p);
+    if (!out.empty())
+	output(0).push_batch(out);
+}
+
+void
+Counter::pull_batch(int, unsigned max, PacketBatch &batch)
+{
+    PacketBatch in;
+    input(0).pull_batch(max, in);
+    while (Packet *p = in.pop_front())
+	if ((p = Counter::simple_action(p)))
+	    batch.push_back(p);
+}
+
 
 enum { H_COUNT, H_BYTE_COUNT, H_RATE, H_BIT_RATE, H_BYTE_RATE, H_RESET,
        H_COUNT_CALL, H_BYTE_COUNT_CALL };
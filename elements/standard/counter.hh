@@ -106,6 +106,7 @@ class Counter : public Element { public:
     const char *class_name() const		{ return "Counter"; }
     const char *port_count() const		{ return PORTS_1_1; }
     const char *processing() const		{ return AGNOSTIC; }
+    const char *flags() const			{ return "B"; }
 
     void reset();
 
@@ -115,6 +116,8 @@ class Counter : public Element { public:
     int llrpc(unsigned, void *);
 
     Packet *simple_action(Packet *);
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, unsigned max, PacketBatch &batch);
 
   private:
 
@@ -80,6 +80,63 @@ FullNoteQueue::pull(int)
 	return pull_failure();
 }
 
+void
+FullNoteQueue::push_batch(int, PacketBatch &batch)
+{
+    // Code taken from SimpleQueue::push_batch().
+    Storage::index_type h = _head, t = _tail, nt;
+    Storage::index_type ot = t;
+    while (!batch.empty() && (nt = next_i(t)) != h) {
+	_q[t] = batch.pop_front();
+	t = nt;
+    }
+
+    if (t != ot) {
+	packet_memory_barrier(_q[prev_i(t)], _tail);
+	_tail = t;
+
+	int s = size(h, t);
+	if (s > _highwater_length)
+	    _highwater_length = s;
+
+	_empty_note.wake();
+
+	if (s == capacity()) {
+	    _full_note.sleep();
+#if HAVE_MULTITHREAD
+	    // See push_success().
+	    if (size() < capacity())
+		_full_note.wake();
+#endif
+	}
+    }
+
+    while (Packet *p = batch.pop_front())
+	push_failure(p);
+}
+
+void
+FullNoteQueue::pull_batch(int, unsigned max, PacketBatch &batch)
+{
+    Storage::index_type h = _head, t = _tail;
+    if (max == 0)
+	return;
+    else if (h == t) {
+	(void) pull_failure();
+	return;
+    }
+
+    do {
+	batch.push_back(_q[h]);
+	h = next_i(h);
+    } while (--max > 0 && h != t);
+    packet_memory_barrier(_q[prev_i(h)], _head);
+    _head = h;
+
+    _sleepiness = 0;
+    _full_note.wake();
+}
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(NotifierQueue)
 EXPORT_ELEMENT(FullNoteQueue FullNoteQueue-FullNoteQueue)
@@ -78,6 +78,9 @@ class FullNoteQueue : public NotifierQueue { public:
 
     void push(int port, Packet *p);
     Packet *pull(int port);
+    const char *flags() const			{ return "B"; }
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, unsigned max, PacketBatch &batch);
 
   protected:
 
@@ -0,0 +1,215 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * mpmcqueue.{cc,hh} -- lock-free bounded ring queues
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "mpmcqueue.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+MPMCQueue::MPMCQueue()
+    : _ring(0), _mask(0), _capacity(1000), _input_stats(0),
+      _highwater_length(0), _sleepiness(0)
+{
+    _prod.head = _prod.tail = 0;
+    _cons.head = _cons.tail = 0;
+    _drops = 0;
+}
+
+MPMCQueue::~MPMCQueue()
+{
+}
+
+void *
+MPMCQueue::cast(const char *n)
+{
+    if (strcmp(n, "MPMCQueue") == 0)
+	return (MPMCQueue *)this;
+    else if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_empty_note);
+    else if (strcmp(n, Notifier::FULL_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_full_note);
+    else
+	return Element::cast(n);
+}
+
+int
+MPMCQueue::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    uint32_t capacity = 1000;
+    if (Args(conf, this, errh).read_p("CAPACITY", capacity).complete() < 0)
+	return -1;
+    if (capacity == 0 || capacity > 0x40000000)
+	return errh->error("CAPACITY out of range");
+    _capacity = capacity;
+    _empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
+    _full_note.initialize(Notifier::FULL_NOTIFIER, router());
+    _full_note.set_active(true, false);
+    return 0;
+}
+
+int
+MPMCQueue::initialize(ErrorHandler *errh)
+{
+    uint32_t ring_size = 1;
+    while (ring_size < _capacity)
+	ring_size <<= 1;
+    _mask = ring_size - 1;
+    _ring = (Packet **) CLICK_LALLOC(sizeof(Packet *) * ring_size);
+    _input_stats = new InputStats[ninputs() ? ninputs() : 1];
+    if (!_ring || !_input_stats)
+	return errh->error("out of memory");
+    for (int i = 0; i < ninputs(); ++i)
+	_input_stats[i].drops = 0;
+    return 0;
+}
+
+void
+MPMCQueue::cleanup(CleanupStage)
+{
+    if (_ring) {
+	for (uint32_t i = _cons.tail; i != _prod.tail; ++i)
+	    _ring[i & _mask]->kill();
+	CLICK_LFREE(_ring, sizeof(Packet *) * (_mask + 1));
+    }
+    delete[] _input_stats;
+    _ring = 0;
+    _input_stats = 0;
+}
+
+void
+MPMCQueue::push(int port, Packet *p)
+{
+    push_packets<false>(port, &p, 1);
+}
+
+Packet *
+MPMCQueue::pull(int)
+{
+    Packet *p;
+    return pull_packets<false>(&p, 1) ? p : 0;
+}
+
+void
+MPMCQueue::push_batch(int port, PacketBatch &batch)
+{
+    push_batch_packets<false>(port, batch);
+}
+
+void
+MPMCQueue::pull_batch(int, unsigned max, PacketBatch &batch)
+{
+    pull_batch_packets<false>(max, batch);
+}
+
+String
+MPMCQueue::read_handler(Element *e, void *thunk)
+{
+    MPMCQueue *q = static_cast<MPMCQueue *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case 0:
+	return String(q->size());
+    case 1:
+	return String(q->_highwater_length);
+    case 2:
+	return String(q->capacity());
+    case 3:
+	return String(q->_drops.value());
+    case 4: {
+	StringAccum sa;
+	for (int i = 0; i < q->ninputs(); ++i)
+	    sa << q->_input_stats[i].drops.value() << '\n';
+	return sa.take_string();
+    }
+    default:
+	return String();
+    }
+}
+
+int
+MPMCQueue::write_handler(const String &, Element *e, void *thunk, ErrorHandler *errh)
+{
+    MPMCQueue *q = static_cast<MPMCQueue *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case 0:
+	q->_drops = 0;
+	for (int i = 0; i < q->ninputs(); ++i)
+	    q->_input_stats[i].drops = 0;
+	q->_highwater_length = q->size();
+	return 0;
+    case 1:
+	while (Packet *p = q->pull(0))
+	    q->checked_output_push(1, p);
+	return 0;
+    default:
+	return errh->error("internal error");
+    }
+}
+
+void
+MPMCQueue::add_handlers()
+{
+    add_read_handler("length", read_handler, 0);
+    add_read_handler("highwater_length", read_handler, 1);
+    add_read_handler("capacity", read_handler, 2, Handler::CALM);
+    add_read_handler("drops", read_handler, 3);
+    add_read_handler("input_drops", read_handler, 4);
+    add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON | Handler::NONEXCLUSIVE);
+    add_write_handler("reset", write_handler, 1, Handler::BUTTON);
+}
+
+
+SPSCQueue::SPSCQueue()
+{
+}
+
+void *
+SPSCQueue::cast(const char *n)
+{
+    if (strcmp(n, "SPSCQueue") == 0)
+	return (SPSCQueue *)this;
+    else
+	return MPMCQueue::cast(n);
+}
+
+void
+SPSCQueue::push(int port, Packet *p)
+{
+    push_packets<true>(port, &p, 1);
+}
+
+Packet *
+SPSCQueue::pull(int)
+{
+    Packet *p;
+    return pull_packets<true>(&p, 1) ? p : 0;
+}
+
+void
+SPSCQueue::push_batch(int port, PacketBatch &batch)
+{
+    push_batch_packets<true>(port, batch);
+}
+
+void
+SPSCQueue::pull_batch(int, unsigned max, PacketBatch &batch)
+{
+    pull_batch_packets<true>(max, batch);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(MPMCQueue)
+EXPORT_ELEMENT(SPSCQueue)
@@ -0,0 +1,337 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_MPMCQUEUE_HH
+#define CLICK_MPMCQUEUE_HH
+#include <click/element.hh>
+#include <click/notifier.hh>
+#include <click/atomic.hh>
+CLICK_DECLS
+
+/*
+=c
+
+MPMCQueue
+MPMCQueue(CAPACITY)
+
+=s storage
+
+stores packets in a lock-free multi-producer, multi-consumer FIFO queue
+
+=d
+
+Stores incoming packets in a bounded first-in-first-out ring.  Drops incoming
+packets if the queue already holds CAPACITY packets, emitting them on output
+1 if it exists.  The default for CAPACITY is 1000.
+
+MPMCQueue supports any number of concurrent pushers and pullers without
+locks.  Producers reserve ring slots by advancing a shared head index with
+one compare-and-swap per batch, fill the slots, and then publish them in
+reservation order; consumers do the same on the other side.  The producer
+and consumer indices live on separate cache lines, so pushers and pullers
+do not contend for each other's index.  A pushed PacketBatch, or a batch
+pulled with pull_batch, costs one reservation rather than one per packet.
+
+Unlike ThreadSafeQueue, MPMCQueue accepts any number of inputs, and counts
+drops separately for each.  Connecting each producer (a FromDevice running
+on its own thread, for instance) to its own input separates their drop
+counts.
+
+MPMCQueue has the same non-empty and non-full notifiers as Queue.  Like
+NotifierQueue, it reports itself empty only after several consecutive
+pulls find no packets.
+
+=h length read-only
+
+Returns the current number of packets in the queue.
+
+=h highwater_length read-only
+
+Returns the maximum number of packets that have ever been in the queue at once.
+
+=h capacity read-only
+
+Returns the queue's capacity.
+
+=h drops read-only
+
+Returns the number of packets dropped by the queue so far.
+
+=h input_drops read-only
+
+Returns the number of packets dropped from each input, one line per input.
+
+=h reset_counts write-only
+
+When written, resets the C<drops>, C<input_drops>, and C<highwater_length>
+counters.
+
+=h reset write-only
+
+When written, drops all packets in the queue.
+
+=a SPSCQueue, ThreadSafeQueue, Queue */
+
+class MPMCQueue : public Element { public:
+
+    MPMCQueue();
+    ~MPMCQueue();
+
+    const char *class_name() const		{ return "MPMCQueue"; }
+    const char *port_count() const		{ return "-/1-2"; }
+    const char *processing() const		{ return "h/lh"; }
+    const char *flags() const			{ return "B"; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    inline int size() const;
+    int capacity() const			{ return _capacity; }
+
+    void push(int port, Packet *p);
+    Packet *pull(int port);
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, unsigned max, PacketBatch &batch);
+
+  protected:
+
+    enum { CACHE_LINE = 64, BURST = 32, SLEEPINESS_TRIGGER = 9 };
+
+    // A producer or consumer position.  'head' is the next index to
+    // reserve; 'tail' is the first index not yet published to the other
+    // side.  Both increase without bound and wrap at 2^32.
+    struct Index {
+	atomic_uint32_t head;
+	atomic_uint32_t tail;
+	char pad[CACHE_LINE - 2 * sizeof(atomic_uint32_t)];
+    };
+
+    // Per-input drop counter, padded so producers don't share lines.
+    struct InputStats {
+	atomic_uint32_t drops;
+	char pad[CACHE_LINE - sizeof(atomic_uint32_t)];
+    };
+
+    char _pad0[CACHE_LINE];
+    Index _prod;
+    Index _cons;
+
+    Packet **_ring;
+    uint32_t _mask;
+    uint32_t _capacity;
+    InputStats *_input_stats;
+    atomic_uint32_t _drops;
+    uint32_t _highwater_length;
+    int _sleepiness;
+
+    ActiveNotifier _empty_note;
+    ActiveNotifier _full_note;
+
+    template <bool single> inline uint32_t enqueue(Packet **p, uint32_t n);
+    template <bool single> inline uint32_t dequeue(Packet **p, uint32_t n);
+    template <bool single> inline void push_packets(int port, Packet **p, uint32_t n);
+    template <bool single> inline void push_batch_packets(int port, PacketBatch &batch);
+    template <bool single> inline uint32_t pull_packets(Packet **p, uint32_t n);
+    template <bool single> inline void pull_batch_packets(unsigned max, PacketBatch &batch);
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+/*
+=c
+
+SPSCQueue
+SPSCQueue(CAPACITY)
+
+=s storage
+
+stores packets in a lock-free single-producer, single-consumer FIFO queue
+
+=d
+
+Like MPMCQueue, but supports at most one concurrent pusher and at most one
+concurrent puller.  The pusher and puller may run on different threads.
+SPSCQueue reserves and publishes ring slots without compare-and-swap
+instructions, and so is cheaper than MPMCQueue for pipelines that hand
+packets from one thread to another.
+
+SPSCQueue has the same handlers and notifiers as MPMCQueue.  It accepts any
+number of inputs, but only one thread may push to the queue at a time.
+
+=a MPMCQueue, Queue */
+
+class SPSCQueue : public MPMCQueue { public:
+
+    SPSCQueue();
+
+    const char *class_name() const		{ return "SPSCQueue"; }
+    void *cast(const char *);
+
+    void push(int port, Packet *p);
+    Packet *pull(int port);
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, unsigned max, PacketBatch &batch);
+
+};
+
+
+inline int
+MPMCQueue::size() const
+{
+    return _prod.tail.value() - _cons.tail.value();
+}
+
+static inline void
+mpmcqueue_publish_fence()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    // x86 keeps stores in order, and loads in order with other loads.
+    click_compiler_fence();
+#else
+    click_fence();
+#endif
+}
+
+/* Reserve up to n free slots, store packets in them, and publish them to
+   consumers.  Returns the number of packets stored. */
+template <bool single> inline uint32_t
+MPMCQueue::enqueue(Packet **p, uint32_t n)
+{
+    uint32_t h, nh;
+    do {
+	h = _prod.head;
+	mpmcqueue_publish_fence();
+	uint32_t free = _capacity - (h - _cons.tail.value());
+	if (n > free)
+	    n = free;
+	if (n == 0)
+	    return 0;
+	nh = h + n;
+	if (single) {
+	    _prod.head = nh;
+	    break;
+	}
+    } while (_prod.head.compare_swap(h, nh) != h);
+
+    for (uint32_t i = 0; i < n; ++i)
+	_ring[(h + i) & _mask] = p[i];
+    mpmcqueue_publish_fence();
+    // Publish in reservation order: wait for earlier producers.
+    if (!single)
+	while (_prod.tail.value() != h)
+	    click_compiler_fence();
+    _prod.tail = nh;
+    return n;
+}
+
+/* Reserve up to n published slots, load their packets, and release the
+   slots to producers.  Returns the number of packets loaded. */
+template <bool single> inline uint32_t
+MPMCQueue::dequeue(Packet **p, uint32_t n)
+{
+    uint32_t h, nh;
+    do {
+	h = _cons.head;
+	mpmcqueue_publish_fence();
+	uint32_t avail = _prod.tail.value() - h;
+	if (n > avail)
+	    n = avail;
+	if (n == 0)
+	    return 0;
+	nh = h + n;
+	if (single) {
+	    _cons.head = nh;
+	    break;
+	}
+    } while (_cons.head.compare_swap(h, nh) != h);
+
+    mpmcqueue_publish_fence();
+    for (uint32_t i = 0; i < n; ++i)
+	p[i] = _ring[(h + i) & _mask];
+    mpmcqueue_publish_fence();
+    if (!single)
+	while (_cons.tail.value() != h)
+	    click_compiler_fence();
+    _cons.tail = nh;
+    return n;
+}
+
+template <bool single> inline void
+MPMCQueue::push_packets(int port, Packet **p, uint32_t n)
+{
+    uint32_t m = enqueue<single>(p, n);
+    if (m) {
+	uint32_t s = size();
+	if (s > _highwater_length)
+	    _highwater_length = s;
+	_empty_note.wake();
+	if (s >= _capacity) {
+	    _full_note.sleep();
+#if HAVE_MULTITHREAD
+	    // See FullNoteQueue::push_success().
+	    if ((uint32_t) size() < _capacity)
+		_full_note.wake();
+#endif
+	}
+    }
+    if (m < n) {
+	if (_drops.value() == 0)
+	    click_chatter("%{element}: overflow", this);
+	_drops += n - m;
+	_input_stats[port].drops += n - m;
+	for (; m < n; ++m)
+	    checked_output_push(1, p[m]);
+    }
+}
+
+template <bool single> inline void
+MPMCQueue::push_batch_packets(int port, PacketBatch &batch)
+{
+    Packet *p[BURST];
+    while (!batch.empty()) {
+	uint32_t n = 0;
+	while (n < BURST && !batch.empty())
+	    p[n++] = batch.pop_front();
+	push_packets<single>(port, p, n);
+    }
+}
+
+template <bool single> inline uint32_t
+MPMCQueue::pull_packets(Packet **p, uint32_t n)
+{
+    uint32_t m = dequeue<single>(p, n);
+    if (m) {
+	_sleepiness = 0;
+	_full_note.wake();
+    } else if (_sleepiness >= SLEEPINESS_TRIGGER) {
+	_empty_note.sleep();
+#if HAVE_MULTITHREAD
+	// See FullNoteQueue::pull_failure().
+	if (size())
+	    _empty_note.wake();
+#endif
+    } else
+	++_sleepiness;
+    return m;
+}
+
+template <bool single> inline void
+MPMCQueue::pull_batch_packets(unsigned max, PacketBatch &batch)
+{
+    Packet *p[BURST];
+    while (max > 0) {
+	uint32_t want = (max < (unsigned) BURST ? max : (unsigned) BURST);
+	uint32_t n = pull_packets<single>(p, want);
+	for (uint32_t i = 0; i < n; ++i)
+	    batch.push_back(p[i]);
+	if (n < want)
+	    break;
+	max -= n;
+    }
+}
+
+CLICK_ENDDECLS
+#endif
@@ -81,6 +81,16 @@ class NotifierQueue : public SimpleQueue { public:
     void push(int port, Packet *);
     Packet *pull(int port);
 
+    // SimpleQueue's batch functions would skip notification; transfer
+    // packets one at a time instead
+    const char *flags() const			{ return ""; }
+    void push_batch(int port, PacketBatch &batch) {
+	Element::push_batch(port, batch);
+    }
+    void pull_batch(int port, unsigned max, PacketBatch &batch) {
+	Element::pull_batch(port, max, batch);
+    }
+
 #if NOTIFIERQUEUE_DEBUG
     void add_handlers();
 #endif
@@ -170,6 +170,49 @@ SimpleQueue::pull(int)
     return deq();
 }
 
+void
+SimpleQueue::push_batch(int, PacketBatch &batch)
+{
+    // If you change this code, also change FullNoteQueue::push_batch().
+    // Fill free slots first, then publish the new tail once.
+    Storage::index_type h = _head, t = _tail, nt;
+    Storage::index_type ot = t;
+    while (!batch.empty() && (nt = next_i(t)) != h) {
+	_q[t] = batch.pop_front();
+	t = nt;
+    }
+
+    if (t != ot) {
+	packet_memory_barrier(_q[prev_i(t)], _tail);
+	_tail = t;
+
+	int s = size(h, t);
+	if (s > _highwater_length)
+	    _highwater_length = s;
+    }
+
+    if (!batch.empty()) {
+	if (_drops == 0 && _capacity > 0)
+	    click_chatter("%{element}: overflow", this);
+	_drops += batch.count();
+	checked_output_push_batch(1, batch);
+    }
+}
+
+void
+SimpleQueue::pull_batch(int, unsigned max, PacketBatch &batch)
+{
+    Storage::index_type h = _head, t = _tail;
+    if (h == t || max == 0)
+	return;
+    do {
+	batch.push_back(_q[h]);
+	h = next_i(h);
+    } while (--max > 0 && h != t);
+    packet_memory_barrier(_q[prev_i(h)], _head);
+    _head = h;
+}
+
 
 String
 SimpleQueue::read_handler(Element *e, void *thunk)
@@ -85,6 +85,7 @@ class SimpleQueue : public Element, public Storage { public:
     const char *class_name() const		{ return "SimpleQueue"; }
     const char *port_count() const		{ return PORTS_1_1X2; }
     const char *processing() const		{ return "h/lh"; }
+    const char *flags() const			{ return "B"; }
     void* cast(const char*);
 
     int configure(Vector<String>&, ErrorHandler*);
@@ -97,6 +98,8 @@ class SimpleQueue : public Element, public Storage { public:
 
     void push(int port, Packet*);
     Packet* pull(int port);
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, unsigned max, PacketBatch &batch);
 
   protected:
 
@@ -49,7 +49,7 @@ When written, resets the C<drops> and C<highwater_length> counters.
 
 When written, drops all packets in the queue.
 
-=a Queue, SimpleQueue, NotifierQueue, MixedQueue, FrontDropQueue */
+=a Queue, SimpleQueue, NotifierQueue, MixedQueue, FrontDropQueue, MPMCQueue */
 
 class ThreadSafeQueue : public FullNoteQueue { public:
 
@@ -64,6 +64,15 @@ class ThreadSafeQueue : public FullNoteQueue { public:
     void push(int port, Packet *);
     Packet *pull(int port);
 
+    // FullNoteQueue's batch functions are not safe for concurrent use
+    const char *flags() const			{ return ""; }
+    void push_batch(int port, PacketBatch &batch) {
+	Element::push_batch(port, batch);
+    }
+    void pull_batch(int port, unsigned max, PacketBatch &batch) {
+	Element::pull_batch(port, max, batch);
+    }
+
   private:
 
     atomic_uint32_t _xhead;
@@ -40,10 +40,15 @@ Unqueue::configure(Vector<String> &conf, ErrorHandler *errh)
     _burst = 1;
     _limit = -1;
     _active = true;
-    return Args(conf, this, errh)
+    bool migratable = false;
+    if (Args(conf, this, errh)
 	.read_p("BURST", _burst)
 	.read("ACTIVE", _active)
-	.read("LIMIT", _limit).complete();
+	.read("LIMIT", _limit)
+	.read("MIGRATABLE", migratable).complete() < 0)
+	return -1;
+    _task.set_migratable(migratable);
+    return 0;
 }
 
 int
@@ -72,16 +77,26 @@ Unqueue::run_task(Task *)
 	    return false;
     }
 
-    while (worked < limit && _active) {
-	if (Packet *p = input(0).pull()) {
-	    ++worked;
-	    ++_count;
-	    output(0).push(p);
-	} else if (!_signal)
+    if (input(0).batch() || output(0).batch()) {
+	PacketBatch batch;
+	input(0).pull_batch(limit, batch);
+	worked = batch.count();
+	_count += worked;
+	if (worked)
+	    output(0).push_batch(batch);
+	if (worked < limit && !_signal)
 	    goto out;
-	else
-	    break;
-    }
+    } else
+	while (worked < limit && _active) {
+	    if (Packet *p = input(0).pull()) {
+		++worked;
+		++_count;
+		output(0).push(p);
+	    } else if (!_signal)
+		goto out;
+	    else
+		break;
+	}
 
     _task.fast_reschedule();
   out:
@@ -8,7 +8,7 @@ CLICK_DECLS
 /*
 =c
 
-Unqueue([I<keywords> ACTIVE, LIMIT, BURST])
+Unqueue([I<keywords> ACTIVE, LIMIT, BURST, MIGRATABLE])
 
 =s shaping
 
@@ -37,6 +37,13 @@ The default value is true.
 If positive, then at most LIMIT packets are pulled.  The default is -1, which
 means there is no limit.
 
+=item MIGRATABLE
+
+Boolean. If true, then when the driver runs with work stealing (B<click>
+B<--work-stealing>), an idle thread may take over Unqueue's task. Only set
+this if the elements upstream and downstream of Unqueue are safe to use
+from any thread. The default is false.
+
 =back
 
 =h count read-only
@@ -29,12 +29,16 @@
 CLICK_DECLS
 
 IPRewriter::IPRewriter()
-    : _udp_map(0)
+    : _udp_maps(0)
 {
+    // TCP and UDP flows share each shard's allocator
+    if (sizeof(UDPFlow) > _flow_size)
+	_flow_size = sizeof(UDPFlow);
 }
 
 IPRewriter::~IPRewriter()
 {
+    delete[] _udp_maps;
 }
 
 void *
@@ -70,7 +74,10 @@ IPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
     _udp_timeouts[1] *= CLICK_HZ;
     _udp_streaming_timeout *= CLICK_HZ; // IPRewriterBase handles the others
 
-    return TCPRewriter::configure(conf, errh);
+    if (TCPRewriter::configure(conf, errh) < 0)
+	return -1;
+    _udp_maps = new Map[_nshards];
+    return 0;
 }
 
 inline IPRewriterEntry *
@@ -80,13 +87,16 @@ IPRewriter::get_entry(int ip_p, const IPFlowID &flowid, int input)
 	return TCPRewriter::get_entry(ip_p, flowid, input);
     if (ip_p != IP_PROTO_UDP)
 	return 0;
-    IPRewriterEntry *m = _udp_map.get(flowid);
+    int s = shard_index(flowid);
+    lock(_shards[s]);
+    IPRewriterEntry *m = _udp_maps[s].get(flowid);
     if (!m && (unsigned) input < (unsigned) _input_specs.size()) {
 	IPRewriterInput &is = _input_specs[input];
 	IPFlowID rewritten_flowid = IPFlowID::uninitialized_t();
 	if (is.rewrite_flowid(flowid, rewritten_flowid, 0, IPRewriterInput::mapid_iprewriter_udp) == rw_addmap)
 	    m = IPRewriter::add_flow(0, flowid, rewritten_flowid, input);
     }
+    unlock(_shards[s]);
     return m;
 }
 
@@ -97,8 +107,9 @@ IPRewriter::add_flow(int ip_p, const IPFlowID &flowid,
     if (ip_p == IP_PROTO_TCP)
 	return TCPRewriter::add_flow(ip_p, flowid, rewritten_flowid, input);
 
+    int s = shard_index(flowid);
     void *data;
-    if (!(data = _udp_allocator.allocate()))
+    if (!(data = _shards[s].allocator.allocate()))
 	return 0;
 
     IPRewriterInput *rwinput = &_input_specs[input];
@@ -106,7 +117,20 @@ IPRewriter::add_flow(int ip_p, const IPFlowID &flowid,
 	(rwinput, flowid, rewritten_flowid, ip_p,
 	 !!_udp_timeouts[1], click_jiffies() + relevant_timeout(_udp_timeouts));
 
-    return store_flow(flow, input, _udp_map, &reply_udp_map(rwinput));
+    return store_flow(flow, input, _udp_maps[s], &reply_udp_map(rwinput, s));
+}
+
+IPRewriterBase::Map *
+IPRewriter::batch_flowid(Packet *p, IPFlowID &flowid)
+{
+    const click_ip *iph = p->ip_header();
+    if ((iph->ip_p != IP_PROTO_TCP && iph->ip_p != IP_PROTO_UDP)
+	|| !IP_FIRSTFRAG(iph)
+	|| p->transport_length() < 8)
+	return 0;
+    flowid = IPFlowID(p);
+    int s = shard_index(flowid);
+    return iph->ip_p == IP_PROTO_TCP ? &_shards[s].map : &_udp_maps[s];
 }
 
 void
@@ -128,7 +152,10 @@ IPRewriter::push(int port, Packet *p_in)
     }
 
     IPFlowID flowid(p);
-    HashContainer<IPRewriterEntry> *map = (iph->ip_p == IP_PROTO_TCP ? &_map : &_udp_map);
+    int s = shard_index(flowid);
+    Shard &sh = _shards[s];
+    lock(sh);
+    Map *map = (iph->ip_p == IP_PROTO_TCP ? &sh.map : &_udp_maps[s]);
     IPRewriterEntry *m = map->get(flowid);
 
     if (!m) {			// create new mapping
@@ -138,6 +165,7 @@ IPRewriter::push(int port, Packet *p_in)
 	if (result == rw_addmap)
 	    m = IPRewriter::add_flow(iph->ip_p, flowid, rewritten_flowid, port);
 	if (!m) {
+	    unlock(sh);
 	    checked_output_push(result, p);
 	    return;
 	} else if (_annos & 2)
@@ -150,19 +178,21 @@ IPRewriter::push(int port, Packet *p_in)
 	TCPFlow *tcpmf = static_cast<TCPFlow *>(mf);
 	tcpmf->apply(p, m->direction(), _annos);
 	if (_timeouts[1])
-	    tcpmf->change_expiry(_heap, true, now_j + _timeouts[1]);
+	    tcpmf->change_expiry(sh.heap, true, now_j + _timeouts[1]);
 	else
-	    tcpmf->change_expiry(_heap, false, now_j + tcp_flow_timeout(tcpmf));
+	    tcpmf->change_expiry(sh.heap, false, now_j + tcp_flow_timeout(tcpmf));
     } else {
 	UDPFlow *udpmf = static_cast<UDPFlow *>(mf);
 	udpmf->apply(p, m->direction(), _annos);
 	if (_udp_timeouts[1])
-	    udpmf->change_expiry(_heap, true, now_j + _udp_timeouts[1]);
+	    udpmf->change_expiry(sh.heap, true, now_j + _udp_timeouts[1]);
 	else
-	    udpmf->change_expiry(_heap, false, now_j + udp_flow_timeout(udpmf));
+	    udpmf->change_expiry(sh.heap, false, now_j + udp_flow_timeout(udpmf));
     }
 
-    output(m->output()).push(p);
+    int output_port = m->output();
+    unlock(sh);
+    output(output_port).push(p);
 }
 
 String
@@ -171,9 +201,13 @@ IPRewriter::udp_mappings_handler(Element *e, void *)
     IPRewriter *rw = (IPRewriter *)e;
     click_jiffies_t now = click_jiffies();
     StringAccum sa;
-    for (Map::iterator iter = rw->_udp_map.begin(); iter.live(); ++iter) {
-	iter->flow()->unparse(sa, iter->direction(), now);
-	sa << '\n';
+    for (int s = 0; s < rw->_nshards; ++s) {
+	rw->lock(rw->_shards[s]);
+	for (Map::iterator iter = rw->_udp_maps[s].begin(); iter.live(); ++iter) {
+	    iter->flow()->unparse(sa, iter->direction(), now);
+	    sa << '\n';
+	}
+	rw->unlock(rw->_shards[s]);
     }
     return sa.take_string();
 }
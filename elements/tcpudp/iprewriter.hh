@@ -164,6 +164,16 @@ Set the maximum number of mappings this rewriter can hold to I<capacity>.
 I<Capacity> can either be an integer or the name of another rewriter-like
 element, in which case this element will share the other element's capacity.
 
+=item SHARDS I<n>
+
+Split the flow tables into I<n> shards, each with its own lock, so that
+several threads can push packets through the rewriter at once.  A flow's
+shard is chosen by a hash of its ports that gives both directions the same
+shard; patterns that vary ports allocate only ports that keep the rewritten
+flow in its shard.  The capacity is divided evenly among shards, and rewriters
+sharing a MAPPING_CAPACITY must have the same number of shards.  Typically
+I<n> is the number of threads.  Default is 1, which needs no locking.
+
 =item DST_ANNO
 
 Boolean. If true, then set the destination IP address annotation on passing
@@ -193,6 +203,19 @@ space-separated numbers, where the first is the capacity and the second is the
 short-term flow reservation.  When writing, the short-term reservation can be
 omitted; it is then set to the minimum of 50 and one-eighth the capacity.
 
+=h shards read-only
+
+Returns one line per shard: the shard number, followed by its current number
+of flows and the numbers of flows it has created, failed to create, and
+reaped after they expired.
+
+=h allocator read-only
+
+Returns one line per shard describing the memory that holds its flows: the
+number of flows allocated, the number of flows the allocator's memory can
+hold, and that memory's size in bytes.  Memory freed by expired flows is
+reused for new flows but not returned to the system.
+
 =h tcp_mappings read-only
 
 Returns a human-readable description of the IPRewriter's current set of TCP
@@ -220,11 +243,11 @@ class IPRewriter : public TCPRewriter { public:
     int configure(Vector<String> &, ErrorHandler *);
 
     IPRewriterEntry *get_entry(int ip_p, const IPFlowID &flowid, int input);
-    HashContainer<IPRewriterEntry> *get_map(int mapid) {
+    Map *get_map(int mapid, int shard) {
 	if (mapid == IPRewriterInput::mapid_default)
-	    return &_map;
+	    return &_shards[shard].map;
 	else if (mapid == IPRewriterInput::mapid_iprewriter_udp)
-	    return &_udp_map;
+	    return &_udp_maps[shard];
 	else
 	    return 0;
     }
@@ -244,11 +267,12 @@ class IPRewriter : public TCPRewriter { public:
 
   private:
 
-    Map _udp_map;
-    SizedHashAllocator<sizeof(UDPFlow)> _udp_allocator;
+    Map *_udp_maps;		// one per shard
     uint32_t _udp_timeouts[2];
     uint32_t _udp_streaming_timeout;
 
+    Map *batch_flowid(Packet *p, IPFlowID &flowid);
+
     int udp_flow_timeout(const UDPFlow *mf) const {
 	if (mf->streaming())
 	    return _udp_streaming_timeout;
@@ -256,9 +280,9 @@ class IPRewriter : public TCPRewriter { public:
 	    return _udp_timeouts[0];
     }
 
-    static inline Map &reply_udp_map(IPRewriterInput *rwinput) {
+    static inline Map &reply_udp_map(IPRewriterInput *rwinput, int shard) {
 	IPRewriter *x = static_cast<IPRewriter *>(rwinput->reply_element);
-	return x->_udp_map;
+	return x->_udp_maps[shard];
     }
     static String udp_mappings_handler(Element *e, void *user_data);
 
@@ -271,9 +295,10 @@ IPRewriter::destroy_flow(IPRewriterFlow *flow)
     if (flow->ip_p() == IP_PROTO_TCP)
 	TCPRewriter::destroy_flow(flow);
     else {
-	unmap_flow(flow, _udp_map, &reply_udp_map(flow->owner()));
+	int s = shard_index(flow->entry(false).flowid());
+	unmap_flow(flow, _udp_maps[s], &reply_udp_map(flow->owner(), s));
 	flow->~IPRewriterFlow();
-	_udp_allocator.deallocate(flow);
+	_shards[s].allocator.deallocate(flow);
     }
 }
 
@@ -236,6 +236,7 @@ TCPRewriter::TCPFlow::unparse(StringAccum &sa, bool direction, click_jiffies_t n
 
 TCPRewriter::TCPRewriter()
 {
+    _flow_size = sizeof(TCPFlow);
 }
 
 TCPRewriter::~TCPRewriter()
@@ -285,15 +286,28 @@ IPRewriterEntry *
 TCPRewriter::add_flow(int /*ip_p*/, const IPFlowID &flowid,
 		      const IPFlowID &rewritten_flowid, int input)
 {
+    Shard &sh = shard(flowid);
     void *data;
-    if (!(data = _allocator.allocate()))
+    if (!(data = sh.allocator.allocate()))
 	return 0;
 
     TCPFlow *flow = new(data) TCPFlow
 	(&_input_specs[input], flowid, rewritten_flowid,
 	 !!_timeouts[1], click_jiffies() + relevant_timeout(_timeouts));
 
-    return store_flow(flow, input, _map);
+    return store_flow(flow, input, sh.map);
+}
+
+IPRewriterBase::Map *
+TCPRewriter::batch_flowid(Packet *p, IPFlowID &flowid)
+{
+    const click_ip *iph = p->ip_header();
+    if (iph->ip_p != IP_PROTO_TCP
+	|| !IP_FIRSTFRAG(iph)
+	|| p->transport_length() < 8)
+	return 0;
+    flowid = IPFlowID(p);
+    return &shard(flowid).map;
 }
 
 void
@@ -315,7 +329,9 @@ TCPRewriter::push(int port, Packet *p_in)
     }
 
     IPFlowID flowid(p);
-    IPRewriterEntry *m = _map.get(flowid);
+    Shard &sh = shard(flowid);
+    lock(sh);
+    IPRewriterEntry *m = sh.map.get(flowid);
 
     if (!m) {			// create new mapping
 	IPRewriterInput &is = _input_specs.at_u(port);
@@ -324,6 +340,7 @@ TCPRewriter::push(int port, Packet *p_in)
 	if (result == rw_addmap)
 	    m = TCPRewriter::add_flow(IP_PROTO_TCP, flowid, rewritten_flowid, port);
 	if (!m) {
+	    unlock(sh);
 	    checked_output_push(result, p);
 	    return;
 	} else if (_annos & 2)
@@ -335,11 +352,13 @@ TCPRewriter::push(int port, Packet *p_in)
 
     click_jiffies_t now_j = click_jiffies();
     if (_timeouts[1])
-	mf->change_expiry(_heap, true, now_j + _timeouts[1]);
+	mf->change_expiry(sh.heap, true, now_j + _timeouts[1]);
     else
-	mf->change_expiry(_heap, false, now_j + tcp_flow_timeout(mf));
+	mf->change_expiry(sh.heap, false, now_j + tcp_flow_timeout(mf));
 
-    output(m->output()).push(p);
+    int output_port = m->output();
+    unlock(sh);
+    output(output_port).push(p);
 }
 
 
@@ -349,10 +368,15 @@ TCPRewriter::tcp_mappings_handler(Element *e, void *)
     TCPRewriter *rw = (TCPRewriter *)e;
     click_jiffies_t now = click_jiffies();
     StringAccum sa;
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); ++iter) {
-	TCPFlow *f = static_cast<TCPFlow *>(iter->flow());
-	f->unparse(sa, iter->direction(), now);
-	sa << '\n';
+    for (int s = 0; s < rw->_nshards; ++s) {
+	Shard &sh = rw->_shards[s];
+	rw->lock(sh);
+	for (Map::iterator iter = sh.map.begin(); iter.live(); ++iter) {
+	    TCPFlow *f = static_cast<TCPFlow *>(iter->flow());
+	    f->unparse(sa, iter->direction(), now);
+	    sa << '\n';
+	}
+	rw->unlock(sh);
     }
     return sa.take_string();
 }
@@ -68,6 +68,11 @@ Set the maximum number of mappings this rewriter can hold to I<capacity>.
 I<Capacity> can either be an integer or the name of another rewriter-like
 element, in which case this element will share the other element's capacity.
 
+=item SHARDS I<n>
+
+Split the flow tables into I<n> independently locked shards, so that several
+threads can share the rewriter.  See IPRewriter.  Default is 1.
+
 =item DST_ANNO
 
 Boolean. If true, then set the destination IP address annotation on passing
@@ -166,11 +171,12 @@ class TCPRewriter : public IPRewriterBase { public:
 
  protected:
 
-    SizedHashAllocator<sizeof(TCPFlow)> _allocator;
     unsigned _annos;
     uint32_t _tcp_data_timeout;
     uint32_t _tcp_done_timeout;
 
+    Map *batch_flowid(Packet *p, IPFlowID &flowid);
+
     int tcp_flow_timeout(const TCPFlow *mf) const {
 	if (mf->both_done())
 	    return _tcp_done_timeout;
@@ -187,9 +193,10 @@ class TCPRewriter : public IPRewriterBase { public:
 inline void
 TCPRewriter::destroy_flow(IPRewriterFlow *flow)
 {
-    unmap_flow(flow, _map);
+    Shard &sh = shard(flow);
+    unmap_flow(flow, sh.map);
     static_cast<TCPFlow *>(flow)->~TCPFlow();
-    _allocator.deallocate(flow);
+    sh.allocator.deallocate(flow);
 }
 
 inline tcp_seq_t
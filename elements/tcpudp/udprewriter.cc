@@ -68,6 +68,7 @@ UDPRewriter::UDPFlow::apply(WritablePacket *p, bool direction, unsigned annos)
 
 UDPRewriter::UDPRewriter()
 {
+    _flow_size = sizeof(UDPFlow);
 }
 
 UDPRewriter::~UDPRewriter()
@@ -116,15 +117,29 @@ IPRewriterEntry *
 UDPRewriter::add_flow(int ip_p, const IPFlowID &flowid,
 		      const IPFlowID &rewritten_flowid, int input)
 {
+    Shard &sh = shard(flowid);
     void *data;
-    if (!(data = _allocator.allocate()))
+    if (!(data = sh.allocator.allocate()))
 	return 0;
 
     UDPFlow *flow = new(data) UDPFlow
 	(&_input_specs[input], flowid, rewritten_flowid, ip_p,
 	 !!_timeouts[1], click_jiffies() + relevant_timeout(_timeouts));
 
-    return store_flow(flow, input, _map);
+    return store_flow(flow, input, sh.map);
+}
+
+IPRewriterBase::Map *
+UDPRewriter::batch_flowid(Packet *p, IPFlowID &flowid)
+{
+    const click_ip *iph = p->ip_header();
+    int ip_p = iph->ip_p;
+    if ((ip_p != IP_PROTO_TCP && ip_p != IP_PROTO_UDP && ip_p != IP_PROTO_DCCP)
+	|| !IP_FIRSTFRAG(iph)
+	|| p->transport_length() < 8)
+	return 0;
+    flowid = IPFlowID(p);
+    return &shard(flowid).map;
 }
 
 void
@@ -149,7 +164,9 @@ UDPRewriter::push(int port, Packet *p_in)
     }
 
     IPFlowID flowid(p);
-    IPRewriterEntry *m = _map.get(flowid);
+    Shard &sh = shard(flowid);
+    lock(sh);
+    IPRewriterEntry *m = sh.map.get(flowid);
 
     if (!m) {			// create new mapping
 	IPRewriterInput &is = _input_specs.at_u(port);
@@ -158,6 +175,7 @@ UDPRewriter::push(int port, Packet *p_in)
 	if (result == rw_addmap)
 	    m = UDPRewriter::add_flow(ip_p, flowid, rewritten_flowid, port);
 	if (!m) {
+	    unlock(sh);
 	    checked_output_push(result, p);
 	    return;
 	} else if (_annos & 2)
@@ -169,11 +187,13 @@ UDPRewriter::push(int port, Packet *p_in)
 
     click_jiffies_t now_j = click_jiffies();
     if (_timeouts[1])
-	mf->change_expiry(_heap, true, now_j + _timeouts[1]);
+	mf->change_expiry(sh.heap, true, now_j + _timeouts[1]);
     else
-	mf->change_expiry(_heap, false, now_j + udp_flow_timeout(mf));
+	mf->change_expiry(sh.heap, false, now_j + udp_flow_timeout(mf));
 
-    output(m->output()).push(p);
+    int output_port = m->output();
+    unlock(sh);
+    output(output_port).push(p);
 }
 
 
@@ -183,9 +203,14 @@ UDPRewriter::dump_mappings_handler(Element *e, void *)
     UDPRewriter *rw = (UDPRewriter *)e;
     click_jiffies_t now = click_jiffies();
     StringAccum sa;
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); ++iter) {
-	iter->flow()->unparse(sa, iter->direction(), now);
-	sa << '\n';
+    for (int s = 0; s < rw->_nshards; ++s) {
+	Shard &sh = rw->_shards[s];
+	rw->lock(sh);
+	for (Map::iterator iter = sh.map.begin(); iter.live(); ++iter) {
+	    iter->flow()->unparse(sa, iter->direction(), now);
+	    sa << '\n';
+	}
+	rw->unlock(sh);
     }
     return sa.take_string();
 }
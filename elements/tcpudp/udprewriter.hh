@@ -145,6 +145,11 @@ Set the maximum number of mappings this rewriter can hold to I<capacity>.
 I<Capacity> can either be an integer or the name of another rewriter-like
 element, in which case this element will share the other element's capacity.
 
+=item SHARDS I<n>
+
+Split the flow tables into I<n> independently locked shards, so that several
+threads can share the rewriter.  See IPRewriter.  Default is 1.
+
 =item DST_ANNO
 
 Boolean. If true, then set the destination IP address annotation on passing
@@ -200,10 +205,11 @@ class UDPRewriter : public IPRewriterBase { public:
 
   private:
 
-    SizedHashAllocator<sizeof(UDPFlow)> _allocator;
     unsigned _annos;
     uint32_t _udp_streaming_timeout;
 
+    Map *batch_flowid(Packet *p, IPFlowID &flowid);
+
     int udp_flow_timeout(const UDPFlow *mf) const {
 	if (mf->streaming())
 	    return _udp_streaming_timeout;
@@ -221,9 +227,10 @@ class UDPRewriter : public IPRewriterBase { public:
 inline void
 UDPRewriter::destroy_flow(IPRewriterFlow *flow)
 {
-    unmap_flow(flow, _map);
+    Shard &sh = shard(flow);
+    unmap_flow(flow, sh.map);
     flow->~IPRewriterFlow();
-    _allocator.deallocate(flow);
+    sh.allocator.deallocate(flow);
 }
 
 CLICK_ENDDECLS
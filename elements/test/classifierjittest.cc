@@ -0,0 +1,325 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * classifierjittest.{cc,hh} -- regression test and benchmark element for
+ * native classifier code
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "classifierjittest.hh"
+#include <click/glue.hh>
+#include <click/error.hh>
+#include <click/args.hh>
+#include <click/straccum.hh>
+#include <click/timestamp.hh>
+#include <click/ipaddress.hh>
+#include <clicknet/ether.h>
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+#include "elements/standard/classifier.hh"
+#include "elements/ip/ipfilter.hh"
+CLICK_DECLS
+
+static const int common_ports[] = {
+    22, 25, 53, 80, 110, 123, 143, 443, 993, 1194, 3306, 5432, 8080
+};
+
+// IPFilter's idea of a packet's length; see IPFilter::match().
+static int
+ipfilter_length(const Packet *p)
+{
+    int length = p->network_length();
+    if (length > (int) p->network_header_length())
+	return length - p->network_header_length() + IPFilter::offset_transp;
+    else
+	return length + IPFilter::offset_net;
+}
+
+ClassifierJITTest::ClassifierJITTest()
+    : _nrules(100), _npackets(1000), _benchmark(0), _seed(1)
+{
+}
+
+int
+ClassifierJITTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh)
+	.read("RULES", _nrules)
+	.read("PACKETS", _npackets)
+	.read("BENCHMARK", _benchmark)
+	.read("SEED", _seed)
+	.complete() < 0)
+	return -1;
+    if (_nrules <= 0 || _npackets <= 0)
+	return errh->error("RULES and PACKETS must be positive");
+    return 0;
+}
+
+#if CLICK_CLASSIFICATION_NATIVE
+void
+ClassifierJITTest::make_rules()
+{
+    _rules.clear();
+    for (int i = 0; i < _nrules; ++i) {
+	Rule r;
+	r.src_prefix = click_random(0, 3) ? 24 : 16;
+	r.src = (10U << 24) | (click_random(0, 255) << 16) | (click_random(0, 255) << 8);
+	if (r.src_prefix == 16)
+	    r.src &= 0xFFFF0000U;
+	r.dst = (192U << 24) | (168U << 16) | (click_random(0, 255) << 8) | click_random(1, 254);
+	int which = click_random(0, 9);
+	r.proto = which < 6 ? IP_PROTO_TCP : (which < 9 ? IP_PROTO_UDP : IP_PROTO_ICMP);
+	if (r.proto == IP_PROTO_ICMP)
+	    r.dport = -1;
+	else if (click_random(0, 3))
+	    r.dport = common_ports[click_random(0, sizeof(common_ports) / sizeof(common_ports[0]) - 1)];
+	else
+	    r.dport = click_random(1024, 65535);
+	_rules.push_back(r);
+    }
+}
+
+void
+ClassifierJITTest::make_packets()
+{
+    for (int i = 0; i < _npackets; ++i) {
+	uint32_t src = click_random(), dst = click_random();
+	int proto = click_random(0, 1) ? IP_PROTO_TCP : IP_PROTO_UDP;
+	int dport = click_random(0, 65535);
+	if (click_random(0, 1)) {
+	    const Rule &r = _rules[click_random(0, _rules.size() - 1)];
+	    src = r.src | (click_random() & ((1U << (32 - r.src_prefix)) - 1));
+	    dst = r.dst;
+	    proto = r.proto;
+	    if (r.dport >= 0)
+		dport = r.dport;
+	}
+
+	WritablePacket *p = Packet::make(2, 0, sizeof(click_ether) + sizeof(click_ip) + sizeof(click_tcp), 0);
+	if (!p)
+	    break;
+	memset(p->data(), 0, p->length());
+	click_ether *ethh = reinterpret_cast<click_ether *>(p->data());
+	ethh->ether_type = htons(ETHERTYPE_IP);
+	click_ip *iph = reinterpret_cast<click_ip *>(ethh + 1);
+	iph->ip_v = 4;
+	iph->ip_hl = sizeof(click_ip) >> 2;
+	iph->ip_len = htons(sizeof(click_ip) + sizeof(click_tcp));
+	iph->ip_ttl = 64;
+	iph->ip_p = proto;
+	iph->ip_src.s_addr = htonl(src);
+	iph->ip_dst.s_addr = htonl(dst);
+	click_tcp *tcph = reinterpret_cast<click_tcp *>(iph + 1);
+	tcph->th_sport = htons(click_random(1024, 65535));
+	tcph->th_dport = htons(dport);
+	p->set_mac_header(p->data(), sizeof(click_ether));
+	p->set_ip_header(iph, sizeof(click_ip));
+	// Some short packets exercise the matchers' length checks.
+	if (click_random(0, 15) == 0)
+	    p->take(click_random(1, 30));
+	_packets.push_back(p);
+    }
+}
+
+int
+ClassifierJITTest::test_ipfilter(ErrorHandler *errh)
+{
+    Vector<String> conf;
+    for (int i = 0; i < _rules.size(); ++i) {
+	const Rule &r = _rules[i];
+	StringAccum sa;
+	sa << (i % 2) << " src net " << IPAddress(htonl(r.src)) << '/' << r.src_prefix
+	   << " && dst host " << IPAddress(htonl(r.dst))
+	   << (r.proto == IP_PROTO_TCP ? " && tcp" : (r.proto == IP_PROTO_UDP ? " && udp" : " && icmp"));
+	if (r.dport >= 0)
+	    sa << " dst port " << r.dport;
+	conf.push_back(sa.take_string());
+    }
+
+    int before = errh->nerrors();
+    IPFilter::IPFilterProgram zprog;
+    IPFilter::parse_program(zprog, conf, 2, this, errh);
+    if (errh->nerrors() != before)
+	return -1;
+    Classification::Wordwise::NativeProgram native;
+    if (!native.compile(zprog, true))
+	return errh->error("IPFilter: cannot generate native code");
+
+    Classification::Wordwise::BatchProgram batch_prog;
+    batch_prog.compile(zprog, true);
+
+    int errors = 0;
+    Vector<int> expected;
+    for (int i = 0; i < _packets.size(); ++i) {
+	const Packet *p = _packets[i];
+	expected.push_back(IPFilter::match(zprog, p));
+	if (ipfilter_length(p) < (int) zprog.safe_length())
+	    continue;
+	int actual = native.match(p->mac_header() - 2, p->network_header(), p->transport_header());
+	if (expected[i] != actual && ++errors <= 5)
+	    errh->error("IPFilter: packet %d: native output %d, expected %d", i, actual, expected[i]);
+    }
+    errors += check_batch("IPFilter", batch_prog, expected, errh);
+
+    if (_benchmark > 0) {
+	unsigned sum = 0;
+	Timestamp t0 = Timestamp::now();
+	for (int k = 0; k < _benchmark; ++k)
+	    for (int i = 0; i < _packets.size(); ++i)
+		sum += IPFilter::match(zprog, _packets[i]);
+	Timestamp t1 = Timestamp::now();
+	for (int k = 0; k < _benchmark; ++k)
+	    for (int i = 0; i < _packets.size(); ++i) {
+		const Packet *p = _packets[i];
+		if (ipfilter_length(p) >= (int) zprog.safe_length())
+		    sum -= native.match(p->mac_header() - 2, p->network_header(), p->transport_header());
+		else
+		    sum -= IPFilter::match(zprog, p);
+	    }
+	Timestamp t2 = Timestamp::now();
+	double n = (double) _benchmark * _packets.size();
+	errh->message("IPFilter: %d rules, %d bytes of code: interpreter %.1f ns/packet, native %.1f ns/packet, %s%s",
+		      _rules.size(), (int) native.code_size(),
+		      (t1 - t0).nsecval() / n, (t2 - t1).nsecval() / n,
+		      benchmark_batch(batch_prog).c_str(),
+		      sum ? " (mismatch)" : "");
+    }
+    return errors ? -1 : 0;
+}
+
+int
+ClassifierJITTest::test_classifier(ErrorHandler *errh)
+{
+    Vector<String> conf;
+    for (int i = 0; i < _rules.size(); ++i) {
+	const Rule &r = _rules[i];
+	StringAccum sa;
+	sa.snprintf(40, "12/0800 23/%02x 26/%0*x", r.proto,
+		    r.src_prefix / 4, r.src >> (32 - r.src_prefix));
+	sa.snprintf(20, " 30/%08x", r.dst);
+	if (r.dport >= 0)
+	    sa.snprintf(20, " 36/%04x", r.dport);
+	conf.push_back(sa.take_string());
+    }
+
+    int before = errh->nerrors();
+    Classification::Wordwise::Program prog;
+    Classifier::parse_program(prog, conf, errh);
+    if (errh->nerrors() != before)
+	return -1;
+    Classification::Wordwise::CompressedProgram zprog;
+    zprog.compile(prog, false, 0);
+    Classification::Wordwise::NativeProgram native;
+    if (!native.compile(zprog, false))
+	return errh->error("Classifier: cannot generate native code");
+
+    Classification::Wordwise::BatchProgram batch_prog;
+    batch_prog.compile(zprog, false);
+
+    int errors = 0;
+    Vector<int> expected;
+    for (int i = 0; i < _packets.size(); ++i) {
+	const Packet *p = _packets[i];
+	expected.push_back(prog.match(p));
+	if (p->length() < prog.safe_length())
+	    continue;
+	int actual = native.match(p->data() - prog.align_offset(), 0, 0);
+	if (expected[i] != actual && ++errors <= 5)
+	    errh->error("Classifier: packet %d: native output %d, expected %d", i, actual, expected[i]);
+    }
+    errors += check_batch("Classifier", batch_prog, expected, errh);
+
+    if (_benchmark > 0) {
+	unsigned sum = 0;
+	Timestamp t0 = Timestamp::now();
+	for (int k = 0; k < _benchmark; ++k)
+	    for (int i = 0; i < _packets.size(); ++i)
+		sum += prog.match(_packets[i]);
+	Timestamp t1 = Timestamp::now();
+	for (int k = 0; k < _benchmark; ++k)
+	    for (int i = 0; i < _packets.size(); ++i) {
+		const Packet *p = _packets[i];
+		if (p->length() >= prog.safe_length())
+		    sum -= native.match(p->data() - prog.align_offset(), 0, 0);
+		else
+		    sum -= prog.match(p);
+	    }
+	Timestamp t2 = Timestamp::now();
+	double n = (double) _benchmark * _packets.size();
+	errh->message("Classifier: %d rules, %d bytes of code: interpreter %.1f ns/packet, native %.1f ns/packet, %s%s",
+		      _rules.size(), (int) native.code_size(),
+		      (t1 - t0).nsecval() / n, (t2 - t1).nsecval() / n,
+		      benchmark_batch(batch_prog).c_str(),
+		      sum ? " (mismatch)" : "");
+    }
+    return errors ? -1 : 0;
+}
+
+int
+ClassifierJITTest::check_batch(const char *name,
+			       const Classification::Wordwise::BatchProgram &batch_prog,
+			       const Vector<int> &expected, ErrorHandler *errh)
+{
+    int errors = 0;
+    Vector<int> outputs(_packets.size(), -1);
+    for (int isa = 0; batch_prog.isa_supported(isa); ++isa) {
+	batch_prog.match(_packets.begin(), _packets.size(), outputs.begin(), isa);
+	for (int i = 0; i < _packets.size(); ++i)
+	    if (outputs[i] != expected[i] && ++errors <= 5)
+		errh->error("%s: packet %d: %s batch output %d, expected %d",
+			    name, i, batch_prog.isa_name(isa), outputs[i], expected[i]);
+    }
+    return errors;
+}
+
+String
+ClassifierJITTest::benchmark_batch(const Classification::Wordwise::BatchProgram &batch_prog)
+{
+    StringAccum sa;
+    Vector<int> outputs(_packets.size(), -1);
+    for (int isa = 0; batch_prog.isa_supported(isa); ++isa) {
+	Timestamp t0 = Timestamp::now();
+	for (int k = 0; k < _benchmark; ++k)
+	    batch_prog.match(_packets.begin(), _packets.size(), outputs.begin(), isa);
+	Timestamp t1 = Timestamp::now();
+	sa << (isa ? ", " : "") << batch_prog.isa_name(isa) << " batch ";
+	sa.snprintf(20, "%.1f", (t1 - t0).nsecval() / ((double) _benchmark * _packets.size()));
+	sa << " ns/packet";
+    }
+    return sa.take_string();
+}
+#endif
+
+int
+ClassifierJITTest::initialize(ErrorHandler *errh)
+{
+#if CLICK_CLASSIFICATION_NATIVE
+    click_srandom(_seed);
+    make_rules();
+    make_packets();
+    int r = 0;
+    if (test_ipfilter(errh) < 0 || test_classifier(errh) < 0)
+	r = -1;
+    else if (_benchmark <= 0)
+	errh->message("All tests pass!");
+    for (int i = 0; i < _packets.size(); ++i)
+	_packets[i]->kill();
+    _packets.clear();
+    return r;
+#else
+    return errh->error("native classifier code not supported");
+#endif
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel Classifier IPFilter)
+EXPORT_ELEMENT(ClassifierJITTest)
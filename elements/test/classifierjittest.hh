@@ -0,0 +1,103 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_CLASSIFIERJITTEST_HH
+#define CLICK_CLASSIFIERJITTEST_HH
+#include <click/element.hh>
+#include "elements/standard/classification.hh"
+CLICK_DECLS
+
+/*
+=c
+
+ClassifierJITTest([I<keywords>])
+
+=s test
+
+runs regression tests and benchmarks for native and batch classifier code
+
+=d
+
+ClassifierJITTest checks the machine code that Classifier, IPClassifier, and
+IPFilter generate for their programs, and their batch matchers (see the
+C<simd> handler), against the program interpreters, at initialization time.
+Batch matchers are checked with every instruction set the processor
+supports. It does not route packets.
+
+ClassifierJITTest generates RULES random IPFilter rules, resembling an access
+control list of source networks, destination hosts, protocols, and ports,
+and RULES random Classifier patterns over the same Ethernet, IP, and
+transport header fields. It then classifies PACKETS random packets, about
+half of which are built to match a randomly chosen rule, with the
+interpreter, the native code, and the batch matchers, and reports an error
+if they disagree. A few packets are truncated to test length checks.
+
+Keyword arguments are:
+
+=over 8
+
+=item RULES
+
+Integer. Number of rules in each generated program. Default is 100.
+
+=item PACKETS
+
+Integer. Number of packets to classify. Default is 1000.
+
+=item BENCHMARK
+
+Integer. If set to a positive number, then ClassifierJITTest also classifies
+the packets BENCHMARK times with each matcher and prints the average time
+per packet. Default is 0 (don't benchmark).
+
+=item SEED
+
+Integer. Seed for the random rule and packet generator. Default is 1.
+
+=back
+
+ClassifierJITTest fails to initialize on drivers that can't generate native
+code.
+
+=a
+
+Classifier, IPFilter, IPClassifier */
+
+class ClassifierJITTest : public Element { public:
+
+    ClassifierJITTest();
+
+    const char *class_name() const		{ return "ClassifierJITTest"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+
+  private:
+
+    struct Rule {
+	uint32_t src;
+	int src_prefix;
+	uint32_t dst;
+	int proto;
+	int dport;
+    };
+
+    int _nrules;
+    int _npackets;
+    int _benchmark;
+    uint32_t _seed;
+
+    Vector<Rule> _rules;
+    Vector<Packet *> _packets;
+
+    void make_rules();
+    void make_packets();
+    int test_ipfilter(ErrorHandler *errh);
+    int test_classifier(ErrorHandler *errh);
+    int check_batch(const char *name,
+		    const Classification::Wordwise::BatchProgram &batch_prog,
+		    const Vector<int> &expected, ErrorHandler *errh);
+    String benchmark_batch(const Classification::Wordwise::BatchProgram &batch_prog);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -315,6 +315,12 @@ ConfParseTest::initialize(ErrorHandler *errh)
 	      && a.data32()[1] == 0
 	      && a.data32()[2] == 0
 	      && a.data32()[3] == 0);
+	IP6Address b;
+	CHECK(cp_ip6_address("2001:db8::", &a, this) == true
+	      && cp_ip6_address("2001:db9::", &b, this) == true
+	      && a.hashcode() != b.hashcode());
+	CHECK(cp_ip6_address("2001:db8:0:1::", &b, this) == true
+	      && a.hashcode() != b.hashcode());
     }
 #endif
 
@@ -0,0 +1,319 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * hypersplitfiltertest.{cc,hh} -- regression test and benchmark element for
+ * HyperSplitFilter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "hypersplitfiltertest.hh"
+#include <click/glue.hh>
+#include <click/error.hh>
+#include <click/args.hh>
+#include <click/straccum.hh>
+#include <click/timestamp.hh>
+#include <click/handlercall.hh>
+#include <click/ipaddress.hh>
+#include <clicknet/ether.h>
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+#include "elements/ip/hypersplitfilter.hh"
+#include "elements/ip/ipfilter.hh"
+CLICK_DECLS
+
+static const int well_known_ports[] = {
+    21, 22, 23, 25, 53, 80, 110, 123, 143, 161, 443, 993, 1433, 3306, 8080
+};
+
+static uint32_t
+random_in(uint32_t lo, uint32_t hi)
+{
+    if (lo == 0 && hi == 0xFFFFFFFFU)
+	return click_random();
+    return lo + click_random() % (hi - lo + 1);
+}
+
+HyperSplitFilterTest::HyperSplitFilterTest()
+    : _filter(0), _nrules(1000), _npackets(2000), _nupdates(-1),
+      _benchmark(0), _seed(1), _sink(0)
+{
+}
+
+int
+HyperSplitFilterTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh)
+	.read_mp("FILTER", ElementCastArg("HyperSplitFilter"), _filter)
+	.read("RULES", _nrules)
+	.read("PACKETS", _npackets)
+	.read("UPDATES", _nupdates)
+	.read("BENCHMARK", _benchmark)
+	.read("SEED", _seed)
+	.complete() < 0)
+	return -1;
+    if (_nrules <= 0 || _npackets <= 0)
+	return errh->error("RULES and PACKETS must be positive");
+    if (_nupdates < 0)
+	_nupdates = _nrules / 10;
+    return 0;
+}
+
+void
+HyperSplitFilterTest::make_networks()
+{
+    // Rules draw their prefixes from a few /16s, so that they nest and
+    // overlap like those of real access control lists.
+    _networks.clear();
+    for (int i = 0; i < 32; ++i)
+	_networks.push_back(click_random() & 0xFFFF0000U);
+}
+
+HyperSplitFilterTest::Rule
+HyperSplitFilterTest::make_rule()
+{
+    Rule r;
+    uint32_t max[5] = { 0xFFFFFFFFU, 0xFFFFFFFFU, 255, 65535, 65535 };
+    for (int d = 0; d < 5; ++d) {
+	r.lo[d] = 0;
+	r.hi[d] = max[d];
+    }
+
+    StringAccum sa;
+    int action = click_random(0, 2);
+    sa << (action == 0 ? "allow" : (action == 1 ? "1" : "drop"));
+    const char *sep = " ";
+
+    for (int d = 0; d < 2; ++d) {
+	int x = click_random(0, 9), len;
+	if (d == 0 && x < 3)
+	    continue;
+	else if (d == 1 && x < 1)
+	    continue;
+	else if (d == 0)
+	    len = x < 6 ? click_random(8, 16) : (x < 9 ? 24 : 32);
+	else
+	    len = x < 4 ? click_random(16, 24) : 32;
+	uint32_t mask = 0xFFFFFFFFU << (32 - len);
+	uint32_t addr = (_networks[click_random(0, _networks.size() - 1)]
+			 | (click_random() & 0xFFFF)) & mask;
+	r.lo[d] = addr;
+	r.hi[d] = addr | ~mask;
+	sa << sep << (d == 0 ? "src net " : "dst net ")
+	   << IPAddress(htonl(addr)) << '/' << len;
+	sep = " && ";
+    }
+
+    int x = click_random(0, 19);
+    if (x < 19) {
+	int proto = x < 12 ? IP_PROTO_TCP : (x < 17 ? IP_PROTO_UDP : IP_PROTO_ICMP);
+	r.lo[2] = r.hi[2] = proto;
+	sa << sep << (proto == IP_PROTO_TCP ? "tcp" : (proto == IP_PROTO_UDP ? "udp" : "icmp"));
+	sep = " && ";
+    }
+
+    if (x < 17)
+	for (int d = 3; d < 5; ++d) {
+	    const char *name = (d == 3 ? "src port" : "dst port");
+	    int y = click_random(0, 19);
+	    if (d == 3)
+		y = (y < 2 ? 4 : (y < 4 ? 14 : 0));
+	    if (y < 4)
+		continue;
+	    else if (y < 14)
+		r.lo[d] = r.hi[d] = well_known_ports[click_random(0, sizeof(well_known_ports) / sizeof(well_known_ports[0]) - 1)];
+	    else if (y < 17)
+		r.lo[d] = 1024, r.hi[d] = 65535;
+	    else {
+		r.lo[d] = click_random(0, 60000);
+		r.hi[d] = r.lo[d] + click_random(0, 1000);
+	    }
+	    if (r.lo[d] == r.hi[d])
+		sa << sep << name << ' ' << r.lo[d];
+	    else if (r.hi[d] == 65535)
+		sa << sep << name << " >= " << r.lo[d];
+	    else
+		sa << sep << name << " >= " << r.lo[d] << " && " << name << " <= " << r.hi[d];
+	}
+
+    if (sep[0] == ' ' && !sep[1])
+	sa << " all";
+    r.text = sa.take_string();
+    return r;
+}
+
+void
+HyperSplitFilterTest::make_packets()
+{
+    static const int protos[] = { IP_PROTO_TCP, IP_PROTO_UDP, IP_PROTO_ICMP, 47 };
+    for (int i = 0; i < _npackets; ++i) {
+	uint32_t v[5];
+	if (click_random(0, 1)) {
+	    const Rule &r = _rules[click_random(0, _rules.size() - 1)];
+	    for (int d = 0; d < 5; ++d)
+		v[d] = random_in(r.lo[d], r.hi[d]);
+	    if (r.lo[2] != r.hi[2])
+		v[2] = protos[click_random(0, 2)];
+	} else {
+	    for (int d = 0; d < 2; ++d) {
+		v[d] = click_random();
+		if (click_random(0, 1))
+		    v[d] = _networks[click_random(0, _networks.size() - 1)] | (v[d] & 0xFFFF);
+	    }
+	    v[2] = protos[click_random(0, 3)];
+	    v[3] = click_random(0, 65535);
+	    v[4] = click_random(0, 1) ? well_known_ports[click_random(0, sizeof(well_known_ports) / sizeof(well_known_ports[0]) - 1)] : click_random(0, 65535);
+	}
+
+	WritablePacket *p = Packet::make(2, 0, sizeof(click_ether) + sizeof(click_ip) + sizeof(click_tcp), 0);
+	if (!p)
+	    break;
+	memset(p->data(), 0, p->length());
+	click_ether *ethh = reinterpret_cast<click_ether *>(p->data());
+	ethh->ether_type = htons(ETHERTYPE_IP);
+	click_ip *iph = reinterpret_cast<click_ip *>(ethh + 1);
+	iph->ip_v = 4;
+	iph->ip_hl = sizeof(click_ip) >> 2;
+	iph->ip_len = htons(sizeof(click_ip) + sizeof(click_tcp));
+	iph->ip_ttl = 64;
+	iph->ip_p = v[2];
+	iph->ip_src.s_addr = htonl(v[0]);
+	iph->ip_dst.s_addr = htonl(v[1]);
+	// Later fragments have no ports.
+	if (click_random(0, 15) == 0)
+	    iph->ip_off = htons(click_random(1, 100));
+	click_tcp *tcph = reinterpret_cast<click_tcp *>(iph + 1);
+	tcph->th_sport = htons(v[3]);
+	tcph->th_dport = htons(v[4]);
+	p->set_mac_header(p->data(), sizeof(click_ether));
+	p->set_ip_header(iph, sizeof(click_ip));
+	_packets.push_back(p);
+    }
+}
+
+int
+HyperSplitFilterTest::check(const char *when, ErrorHandler *errh)
+{
+    Vector<String> conf;
+    for (int i = 0; i < _rules.size(); ++i)
+	conf.push_back(_rules[i].text);
+    int before = errh->nerrors(), noutputs = _filter->noutputs();
+    IPFilter::IPFilterProgram zprog;
+    Timestamp t0 = Timestamp::now();
+    IPFilter::parse_program(zprog, conf, noutputs, this, errh);
+    Timestamp t1 = Timestamp::now();
+    if (errh->nerrors() != before)
+	return -1;
+    if (_filter->nrules() != _rules.size())
+	return errh->error("%s: %d rules, expected %d", when, _filter->nrules(), _rules.size());
+
+    int errors = 0;
+    for (int i = 0; i < _packets.size(); ++i) {
+	const Packet *p = _packets[i];
+	int expected = IPFilter::match(zprog, p);
+	if (expected < 0 || expected >= noutputs)
+	    expected = -1;
+	int actual = _filter->match(p);
+	if (actual != expected && ++errors <= 5)
+	    errh->error("%s: packet %d: output %d, expected %d", when, i, actual, expected);
+    }
+
+    if (_benchmark > 0) {
+	unsigned sum = 0;
+	for (int k = 0; k < _benchmark; ++k)
+	    for (int i = 0; i < _packets.size(); ++i)
+		sum += IPFilter::match(zprog, _packets[i]);
+	Timestamp t2 = Timestamp::now();
+	_sink = sum;
+	errh->message("%s: IPFilter compile %.1f ms, %.1f ns/packet; HyperSplitFilter %.1f ns/packet",
+		      when, (t1 - t0).nsecval() / 1e6,
+		      (t2 - t1).nsecval() / ((double) _benchmark * _packets.size()),
+		      benchmark_filter());
+    }
+    return errors ? -1 : 0;
+}
+
+double
+HyperSplitFilterTest::benchmark_filter()
+{
+    unsigned sum = 0;
+    Timestamp t0 = Timestamp::now();
+    for (int k = 0; k < _benchmark; ++k)
+	for (int i = 0; i < _packets.size(); ++i)
+	    sum += _filter->match(_packets[i]);
+    Timestamp t1 = Timestamp::now();
+    _sink = sum;
+    return (t1 - t0).nsecval() / ((double) _benchmark * _packets.size());
+}
+
+int
+HyperSplitFilterTest::initialize(ErrorHandler *errh)
+{
+    if (_filter->noutputs() < 2)
+	return errh->error("%p{element} must have at least two outputs", _filter);
+
+    click_srandom(_seed);
+    make_networks();
+    _rules.clear();
+    for (int i = 0; i < _nrules; ++i)
+	_rules.push_back(make_rule());
+    make_packets();
+
+    int r = 0;
+    while (_filter->nrules())
+	_filter->remove_rule(_filter->nrules() - 1, errh);
+    Timestamp t0 = Timestamp::now();
+    for (int i = 0; i < _rules.size() && r >= 0; ++i)
+	r = _filter->insert_rule(i, _rules[i].text, errh);
+    Timestamp t1 = Timestamp::now();
+    if (r >= 0)
+	r = check("added", errh);
+
+    Timestamp t2 = Timestamp::now();
+    _filter->rebuild();
+    Timestamp t3 = Timestamp::now();
+    if (r >= 0)
+	r = check("rebuilt", errh);
+
+    Timestamp t4 = Timestamp::now();
+    for (int i = 0; i < _nupdates && r >= 0; ++i) {
+	int k = click_random(0, _rules.size() - 1);
+	_rules.erase(_rules.begin() + k);
+	r = _filter->remove_rule(k, errh);
+	if (r >= 0) {
+	    k = click_random(0, _rules.size());
+	    _rules.insert(_rules.begin() + k, make_rule());
+	    r = _filter->insert_rule(k, _rules[k].text, errh);
+	}
+    }
+    Timestamp t5 = Timestamp::now();
+    if (r >= 0)
+	r = check("updated", errh);
+
+    if (r >= 0 && _benchmark > 0) {
+	String stats = HandlerCall::call_read(_filter, "stats").trim_space();
+	errh->message("HyperSplitFilter: %d rules: add %.1f ms, rebuild %.1f ms, %d updates %.1f us each\n%s",
+		      _rules.size(), (t1 - t0).nsecval() / 1e6,
+		      (t3 - t2).nsecval() / 1e6, _nupdates,
+		      _nupdates ? (t5 - t4).nsecval() / (1e3 * _nupdates) : 0.,
+		      stats.c_str());
+    } else if (r >= 0)
+	errh->message("All tests pass!");
+
+    for (int i = 0; i < _packets.size(); ++i)
+	_packets[i]->kill();
+    _packets.clear();
+    return r;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel HyperSplitFilter IPFilter)
+EXPORT_ELEMENT(HyperSplitFilterTest)
@@ -0,0 +1,114 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_HYPERSPLITFILTERTEST_HH
+#define CLICK_HYPERSPLITFILTERTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+class HyperSplitFilter;
+
+/*
+=c
+
+HyperSplitFilterTest(FILTER [, I<keywords>])
+
+=s test
+
+runs regression tests and benchmarks for HyperSplitFilter
+
+=d
+
+HyperSplitFilterTest checks HyperSplitFilter against IPFilter at
+initialization time.  FILTER is a HyperSplitFilter element with at least two
+outputs, whose rules HyperSplitFilterTest replaces.  It does not route
+packets.
+
+HyperSplitFilterTest generates RULES random rules in the style of the
+ClassBench access control list seeds: nested source and destination
+prefixes of varying lengths, TCP, UDP, and ICMP protocols, and exact,
+well-known, and arbitrary port ranges.  It adds the rules to FILTER one at
+a time with the C<add> path, checks FILTER against an IPFilter program for
+the same rules on PACKETS random packets, then rebuilds FILTER's tree and
+checks again.  Finally it removes and inserts UPDATES random rules at random
+positions and checks a third time.  About half of the packets are built to
+match a randomly chosen rule; some are non-first fragments or ICMP packets,
+which have no ports.
+
+Keyword arguments are:
+
+=over 8
+
+=item RULES
+
+Integer. Number of rules.  Default is 1000.
+
+=item PACKETS
+
+Integer. Number of packets to classify.  Default is 2000.
+
+=item UPDATES
+
+Integer. Number of rules to remove and insert after the tree is built.
+Default is RULES/10.
+
+=item BENCHMARK
+
+Integer. If set to a positive number, then HyperSplitFilterTest also reports
+the time to build each classifier and classifies the packets BENCHMARK
+times with each, printing the average time per packet.  Default is 0 (don't
+benchmark).
+
+=item SEED
+
+Integer. Seed for the random rule and packet generator. Default is 1.
+
+=back
+
+=e
+
+  f :: HyperSplitFilter;
+  Idle -> f -> Discard;
+  f[1] -> Discard;
+  HyperSplitFilterTest(f, RULES 5000, BENCHMARK 20);
+
+=a
+
+HyperSplitFilter, IPFilter, ClassifierJITTest */
+
+class HyperSplitFilterTest : public Element { public:
+
+    HyperSplitFilterTest();
+
+    const char *class_name() const		{ return "HyperSplitFilterTest"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+
+  private:
+
+    struct Rule {
+	uint32_t lo[5];
+	uint32_t hi[5];
+	String text;
+    };
+
+    HyperSplitFilter *_filter;
+    int _nrules;
+    int _npackets;
+    int _nupdates;
+    int _benchmark;
+    uint32_t _seed;
+
+    Vector<uint32_t> _networks;
+    Vector<Rule> _rules;
+    Vector<Packet *> _packets;
+    volatile unsigned _sink;	// benchmark results, so the loops are kept
+
+    void make_networks();
+    Rule make_rule();
+    void make_packets();
+    int check(const char *when, ErrorHandler *errh);
+    double benchmark_filter();
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,308 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ip6lookupbenchmark.{cc,hh} -- measures IP6 routing table lookup throughput
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ip6lookupbenchmark.hh"
+#include <click/glue.hh>
+#include <click/error.hh>
+#include <click/args.hh>
+#include <click/ip6address.hh>
+#include <click/router.hh>
+#include <click/straccum.hh>
+#include <click/timestamp.hh>
+#include <click/userutils.hh>
+#include <click/packet_anno.hh>
+#include <click/algorithm.hh>
+#include <click/standard/scheduleinfo.hh>
+CLICK_DECLS
+
+IP6LookupBenchmark::IP6LookupBenchmark()
+    : _npackets(100000), _burst(32), _iterations(10), _nupdates(0), _seed(1),
+      _stop(true), _task(this), _errors(0)
+{
+}
+
+IP6LookupBenchmark::~IP6LookupBenchmark()
+{
+    for (int i = 0; i < _packets.size(); ++i)
+	if (_packets[i])
+	    _packets[i]->kill();
+}
+
+int
+IP6LookupBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(this, errh).bind(conf)
+	.read("ROUTES", FilenameArg(), _routes_file)
+	.read("PACKETS", _npackets)
+	.read("BURST", _burst)
+	.read("ITERATIONS", _iterations)
+	.read("UPDATES", _nupdates)
+	.read("SEED", _seed)
+	.read("STOP", _stop)
+	.consume() < 0)
+	return -1;
+    if (_npackets < 1 || _burst < 1 || _iterations < 1)
+	return errh->error("PACKETS, BURST, and ITERATIONS must be positive");
+
+    _tables.clear();
+    for (int i = 0; i < conf.size(); ++i) {
+	Element *e = cp_element(conf[i], this, errh);
+	if (!e)
+	    return -1;
+	IP6RouteTable *t = static_cast<IP6RouteTable *>(e->cast("IP6RouteTable"));
+	if (!t)
+	    return errh->error("%{element} is not an IP6RouteTable", e);
+	_tables.push_back(t);
+    }
+    if (_tables.size() != noutputs())
+	return errh->error("have %d tables, but %d outputs", _tables.size(), noutputs());
+    return 0;
+}
+
+int
+IP6LookupBenchmark::load_routes(ErrorHandler *errh)
+{
+    String text = file_string(_routes_file, errh);
+    if (!text && errh->nerrors())
+	return -1;
+
+    const char *s = text.begin(), *end = text.end();
+    int lineno = 0, errors = 0;
+    while (s != end) {
+	const char *eol = find(s, end, '\n');
+	String line = cp_uncomment(text.substring(s, eol));
+	s = (eol == end ? eol : eol + 1);
+	++lineno;
+	if (!line || line[0] == '#')
+	    continue;
+
+	Vector<String> words;
+	cp_spacevec(line, words);
+	Route r;
+	if ((words.size() != 2 && words.size() != 3)
+	    || !IP6PrefixArg(true).parse(words[0], r.addr, r.mask, this)
+	    || (words.size() == 3 && words[1] != "-"
+		&& !IP6AddressArg().parse(words[1], r.gw, this))
+	    || !IntArg().parse(words.back(), r.port)) {
+	    if (++errors <= 5)
+		errh->error("%s:%d: expected %<ADDR/PREFIX [GATEWAY] OUTPUT%>", _routes_file.c_str(), lineno);
+	    continue;
+	}
+	r.addr &= r.mask;
+	for (int t = 0; t < _tables.size(); ++t)
+	    if (r.port < 0 || r.port >= _tables[t]->noutputs()) {
+		if (++errors <= 5)
+		    errh->error("%s:%d: bad OUTPUT for %{element}", _routes_file.c_str(), lineno, _tables[t]);
+		break;
+	    }
+	_routes.push_back(r);
+    }
+    if (errors)
+	return -1;
+
+    for (int t = 0; t < _tables.size(); ++t) {
+	Timestamp t0 = Timestamp::now();
+	for (int i = 0; i < _routes.size(); ++i)
+	    if (_tables[t]->add_route(_routes[i].addr, _routes[i].mask, _routes[i].gw, _routes[i].port, errh) < 0)
+		return -1;
+	Timestamp t1 = Timestamp::now();
+	_load_msec.push_back((t1 - t0).doubleval() * 1000);
+    }
+    return 0;
+}
+
+void
+IP6LookupBenchmark::make_packets()
+{
+    click_srandom(_seed);
+    _dst.resize(_npackets);
+    _packets.resize(_burst, 0);
+    for (int i = 0; i < _npackets; ++i) {
+	uint32_t *a = _dst[i].data32();
+	for (int j = 0; j < 4; ++j)
+	    a[j] = click_random() ^ (click_random() << 16);
+	if (_routes.size() && (i & 3) != 3) {
+	    const Route &r = _routes[click_random(0, _routes.size() - 1)];
+	    const uint32_t *ra = r.addr.data32(), *rm = r.mask.data32();
+	    for (int j = 0; j < 4; ++j)
+		a[j] = ra[j] | (a[j] & ~rm[j]);
+	}
+    }
+}
+
+int
+IP6LookupBenchmark::initialize(ErrorHandler *errh)
+{
+    for (int t = 0; t < _tables.size(); ++t)
+	if (ninputs() < _tables[t]->noutputs())
+	    return errh->error("%{element} has %d outputs, but I have only %d inputs", _tables[t], _tables[t]->noutputs(), ninputs());
+    if (_routes_file && load_routes(errh) < 0)
+	return -1;
+    make_packets();
+    ScheduleInfo::initialize_task(this, &_task, errh);
+    return 0;
+}
+
+void
+IP6LookupBenchmark::collect(int port, Packet *p)
+{
+    uint32_t i = AGGREGATE_ANNO(p);
+    if (i < (uint32_t) _packets.size() && !_packets[i]) {
+	_packets[i] = p;
+	SET_PAINT_ANNO(p, port);
+    } else {
+	if (++_errors <= 5)
+	    click_chatter("%{element}: unexpected packet on input %d", this, port);
+	p->kill();
+    }
+}
+
+void
+IP6LookupBenchmark::push(int port, Packet *p)
+{
+    collect(port, p);
+}
+
+void
+IP6LookupBenchmark::push_batch(int port, PacketBatch &batch)
+{
+    while (Packet *p = batch.pop_front())
+	collect(port, p);
+}
+
+/* Remove UPDATES random routes from table t, the same routes for every
+   table, returning the average microseconds per removal. */
+double
+IP6LookupBenchmark::remove_routes(int t)
+{
+    click_srandom(_seed + 1);
+    Vector<int> order;
+    for (int i = 0; i < _routes.size(); ++i)
+	order.push_back(i);
+    int n = (_nupdates < _routes.size() ? _nupdates : _routes.size());
+    for (int i = 0; i < n; ++i)
+	click_swap(order[i], order[click_random(i, order.size() - 1)]);
+
+    Timestamp t0 = Timestamp::now();
+    for (int i = 0; i < n; ++i)
+	if (_tables[t]->remove_route(_routes[order[i]].addr, _routes[order[i]].mask, ErrorHandler::silent_handler()) < 0
+	    && ++_errors <= 5)
+	    click_chatter("%{element}: cannot remove %s/%d", _tables[t], _routes[order[i]].addr.unparse().c_str(), _routes[order[i]].mask.mask_to_prefix_len());
+    Timestamp t1 = Timestamp::now();
+    return n ? (t1 - t0).doubleval() * 1e6 / n : 0;
+}
+
+/* Route the PACKETS destinations through table t in chunks of BURST, one
+   packet at a time or as a batch, reusing a pool of BURST packets so that
+   the packets stay in cache.  If check, compare each chunk's results with
+   lookup_route(); otherwise return the average nanoseconds per packet over
+   ITERATIONS passes. */
+double
+IP6LookupBenchmark::run(int t, bool batch, bool check)
+{
+    Timestamp t0 = Timestamp::now();
+    int niterations = check ? 1 : _iterations;
+    for (int it = 0; it < niterations; ++it)
+	for (int i = 0; i < _npackets; i += _burst) {
+	    int n = (_npackets - i < _burst ? _npackets - i : _burst);
+	    PacketBatch b;
+	    for (int j = 0; j < n; ++j) {
+		Packet *p = _packets[j];
+		if (!p && !(p = Packet::make(64)))
+		    return -1;
+		_packets[j] = 0;
+		SET_DST_IP6_ANNO(p, _dst[i + j]);
+		SET_AGGREGATE_ANNO(p, j);
+		if (batch)
+		    b.push_back(p);
+		else
+		    output(t).push(p);
+	    }
+	    if (batch)
+		output(t).push_batch(b);
+	    if (check)
+		for (int j = 0; j < n; ++j)
+		    check_packet(t, batch, i + j, _packets[j]);
+	}
+    Timestamp t1 = Timestamp::now();
+    return (t1 - t0).nsecval() / ((double) niterations * _npackets);
+}
+
+void
+IP6LookupBenchmark::check_packet(int t, bool batch, int i, Packet *p)
+{
+    const IP6Address &dst = _dst[i];
+    IP6Address gw;
+    int port = _tables[t]->lookup_route(dst, gw);
+    bool ok;
+    if (port < 0)
+	ok = !p;
+    else
+	ok = p && PAINT_ANNO(p) == port
+	    && DST_IP6_ANNO(p) == (gw ? gw : dst);
+    if (!ok && ++_errors <= 5)
+	click_chatter("%{element}: %s: %s went to port %d, expected %d", _tables[t], batch ? "push_batch" : "push", dst.unparse().c_str(), p ? PAINT_ANNO(p) : -1, port);
+}
+
+void
+IP6LookupBenchmark::check_tables()
+{
+    for (int i = 0; i < _npackets; ++i) {
+	const IP6Address &dst = _dst[i];
+	IP6Address gw0;
+	int port0 = _tables[0]->lookup_route(dst, gw0);
+	for (int t = 1; t < _tables.size(); ++t) {
+	    IP6Address gw;
+	    int port = _tables[t]->lookup_route(dst, gw);
+	    if ((port != port0 || (port >= 0 && gw != gw0)) && ++_errors <= 5)
+		click_chatter("%s: %{element} says %d %s, %{element} says %d %s", dst.unparse().c_str(), _tables[0], port0, gw0.unparse().c_str(), _tables[t], port, gw.unparse().c_str());
+	}
+    }
+}
+
+bool
+IP6LookupBenchmark::run_task(Task *)
+{
+    ErrorHandler *errh = ErrorHandler::default_handler();
+    for (int t = 0; t < _tables.size(); ++t) {
+	double remove_usec = remove_routes(t);
+	run(t, false, true);
+	run(t, true, true);
+	double push_ns = run(t, false, false);
+	double batch_ns = run(t, true, false);
+	StringAccum sa;
+	sa << _tables[t]->declaration() << ": ";
+	if (_load_msec.size())
+	    sa.snprintf(64, "%d routes in %.1f ms, ", _routes.size(), _load_msec[t]);
+	if (_nupdates)
+	    sa.snprintf(64, "remove %.1f us/route, ", remove_usec);
+	sa.snprintf(128, "%d packets: push %.1f ns/packet, push_batch(%d) %.1f ns/packet, %.2fx",
+		    _npackets, push_ns, _burst, batch_ns, push_ns / batch_ns);
+	errh->message("%s", sa.c_str());
+    }
+    check_tables();
+    if (_errors)
+	errh->error("%d lookup errors", _errors);
+    else
+	errh->message("All lookups agree");
+    if (_stop)
+	router()->please_stop_driver();
+    return true;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel IP6RouteTable)
+EXPORT_ELEMENT(IP6LookupBenchmark)
@@ -0,0 +1,142 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IP6LOOKUPBENCHMARK_HH
+#define CLICK_IP6LOOKUPBENCHMARK_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include "elements/ip6/ip6routetable.hh"
+CLICK_DECLS
+
+/*
+=c
+
+IP6LookupBenchmark(TABLE1 [, TABLE2, ...] [, I<keywords>])
+
+=s test
+
+measures IP6 routing table lookup throughput
+
+=d
+
+IP6LookupBenchmark is the IPv6 version of IPLookupBenchmark.  It measures how
+quickly one or more IP6RouteTable elements, such as LookupIP6Route and
+PoptrieIP6Lookup, route packets, both one at a time with C<push> and in
+batches with C<push_batch>.  IP6LookupBenchmark's output I<k> must be
+connected to the input of TABLEI<k+1>, and each of the tables' outputs must be
+connected to the same-numbered input of IP6LookupBenchmark.
+
+IP6LookupBenchmark first adds the routes in the ROUTES file to each table,
+timing how long each takes.  It then chooses PACKETS random destination
+addresses, most from inside a random route's prefix.  Once the router is
+running, it removes UPDATES random routes from each table, timing the
+removals, and sends packets to the destinations through each table
+ITERATIONS times one by one, and ITERATIONS times in batches of BURST,
+reporting the average time per packet for each.
+
+Before measuring, IP6LookupBenchmark checks that every packet leaves each
+table on the port, and with the gateway annotation, that the table's
+C<lookup_route> method reports for its destination, and that all the tables
+agree.
+
+Keyword arguments are:
+
+=over 8
+
+=item ROUTES
+
+Filename.  File of routes to add to the tables, one per line, in
+'C<ADDR/PREFIX [GW] OUT>' format.  Blank lines and lines starting with
+'C<#>' are ignored.  Default is none.
+
+=item PACKETS
+
+Integer.  Number of packet destinations.  Default is 100000.
+
+=item BURST
+
+Integer.  Batch size for the batched measurement.  Default is 32.
+
+=item ITERATIONS
+
+Integer.  Number of times each measurement sends the packets.  Default is
+10.
+
+=item UPDATES
+
+Integer.  Number of ROUTES routes to remove before measuring.  Default is 0.
+
+=item SEED
+
+Integer.  Seed for the random destination generator.  Default is 1.
+
+=item STOP
+
+Boolean.  If true, stop the driver after the benchmark.  Default is true.
+
+=back
+
+=e
+
+  b :: IP6LookupBenchmark(r1, r2, ROUTES bgp6-routes.txt, PACKETS 100000);
+  b[0] -> r1 :: LookupIP6Route;
+  b[1] -> r2 :: PoptrieIP6Lookup;
+  r1[0], r2[0] -> [0]b;
+  r1[1], r2[1] -> [1]b;
+
+=a
+
+IPLookupBenchmark, LookupIP6Route, PoptrieIP6Lookup */
+
+class IP6LookupBenchmark : public Element { public:
+
+    IP6LookupBenchmark();
+    ~IP6LookupBenchmark();
+
+    const char *class_name() const	{ return "IP6LookupBenchmark"; }
+    const char *port_count() const	{ return "-/1-"; }
+    const char *processing() const	{ return PUSH; }
+    const char *flags() const		{ return "B"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+
+    void push(int port, Packet *p);
+    void push_batch(int port, PacketBatch &batch);
+    bool run_task(Task *task);
+
+  private:
+
+    struct Route {
+	IP6Address addr;
+	IP6Address mask;
+	IP6Address gw;
+	int port;
+    };
+
+    Vector<IP6RouteTable *> _tables;
+    String _routes_file;
+    int _npackets;
+    int _burst;
+    int _iterations;
+    int _nupdates;
+    uint32_t _seed;
+    bool _stop;
+    Task _task;
+
+    Vector<Route> _routes;
+    Vector<double> _load_msec;
+    Vector<IP6Address> _dst;
+    Vector<Packet *> _packets;	// pool of BURST packets
+    int _errors;
+
+    int load_routes(ErrorHandler *errh);
+    void make_packets();
+    double remove_routes(int t);
+    double run(int t, bool batch, bool check);
+    void check_packet(int t, bool batch, int i, Packet *p);
+    void check_tables();
+    void collect(int port, Packet *p);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,143 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPLOOKUPBENCHMARK_HH
+#define CLICK_IPLOOKUPBENCHMARK_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include "elements/ip/iproutetable.hh"
+CLICK_DECLS
+
+/*
+=c
+
+IPLookupBenchmark(TABLE1 [, TABLE2, ...] [, I<keywords>])
+
+=s test
+
+measures IP routing table lookup throughput
+
+=d
+
+IPLookupBenchmark measures how quickly one or more IPRouteTable elements, such
+as DirectIPLookup and PoptrieIPLookup, route packets, both one at a time with
+C<push> and in batches with C<push_batch>.  IPLookupBenchmark's output I<k>
+must be connected to the input of TABLEI<k+1>, and each of the tables'
+outputs must be connected to the same-numbered input of IPLookupBenchmark,
+which collects the packets the tables emit.
+
+IPLookupBenchmark first adds the routes in the ROUTES file to each table,
+timing how long each takes.  It then chooses PACKETS random destination
+addresses.  Most are chosen from inside a random route's prefix; the rest
+are uniformly random.  Once the router is running, IPLookupBenchmark
+removes UPDATES random routes from each table, timing the removals.  It then
+sends packets to the destinations through each table ITERATIONS times one
+by one, and ITERATIONS times in batches of BURST, and reports the average
+time per packet for each.  It reuses a pool of BURST packets, so the
+measurement reflects the tables' memory accesses rather than the packets'.
+
+Before measuring, IPLookupBenchmark checks that every packet leaves each
+table on the port, and with the gateway annotation, that the table's
+C<lookup_route> method reports for its destination, and that all the tables
+agree.
+
+Keyword arguments are:
+
+=over 8
+
+=item ROUTES
+
+Filename.  File of routes to add to the tables, one per line, in
+IPRouteTable's 'C<ADDR/MASK [GW] OUT>' format.  Blank lines and lines
+starting with 'C<#>' are ignored.  Routes for the same prefix replace earlier
+ones.  Default is none.
+
+=item PACKETS
+
+Integer.  Number of packet destinations.  Default is 100000.
+
+=item BURST
+
+Integer.  Batch size for the batched measurement.  Default is 32.
+
+=item ITERATIONS
+
+Integer.  Number of times each measurement sends the packets.  Default is
+10.
+
+=item UPDATES
+
+Integer.  Number of ROUTES routes to remove before measuring.  Default is 0.
+
+=item SEED
+
+Integer.  Seed for the random destination generator.  Default is 1.
+
+=item STOP
+
+Boolean.  If true, stop the driver after the benchmark.  Default is true.
+
+=back
+
+=e
+
+This configuration compares three routing tables on a BGP table whose routes
+use output ports 0 and 1.  conf/iplookup-benchmark.click is a longer version.
+
+  b :: IPLookupBenchmark(r1, r2, r3, ROUTES bgp-routes.txt, PACKETS 1000000);
+  b[0] -> r1 :: RadixIPLookup;
+  b[1] -> r2 :: DirectIPLookup;
+  b[2] -> r3 :: PoptrieIPLookup;
+  r1[0], r2[0], r3[0] -> [0]b;
+  r1[1], r2[1], r3[1] -> [1]b;
+
+=a
+
+IPRouteTable, DirectIPLookup, PoptrieIPLookup, RadixIPLookup,
+RangeIPLookup */
+
+class IPLookupBenchmark : public Element { public:
+
+    IPLookupBenchmark();
+    ~IPLookupBenchmark();
+
+    const char *class_name() const	{ return "IPLookupBenchmark"; }
+    const char *port_count() const	{ return "-/1-"; }
+    const char *processing() const	{ return PUSH; }
+    const char *flags() const		{ return "B"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+
+    void push(int port, Packet *p);
+    void push_batch(int port, PacketBatch &batch);
+    bool run_task(Task *task);
+
+  private:
+
+    Vector<IPRouteTable *> _tables;
+    String _routes_file;
+    int _npackets;
+    int _burst;
+    int _iterations;
+    int _nupdates;
+    uint32_t _seed;
+    bool _stop;
+    Task _task;
+
+    Vector<IPRoute> _routes;
+    Vector<double> _load_msec;
+    Vector<uint32_t> _dst;
+    Vector<Packet *> _packets;	// pool of BURST packets
+    int _errors;
+
+    int load_routes(ErrorHandler *errh);
+    void make_packets();
+    double remove_routes(int t);
+    double run(int t, bool batch, bool check);
+    void check_packet(int t, bool batch, int i, Packet *p);
+    void check_tables();
+    void collect(int port, Packet *p);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,212 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * timerwheeltest.{cc,hh} -- regression test and benchmark element for
+ * TimerSet implementations
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "timerwheeltest.hh"
+#include <click/glue.hh>
+#include <click/error.hh>
+#include <click/args.hh>
+#include <click/master.hh>
+CLICK_DECLS
+
+TimerWheelTest::TimerWheelTest()
+    : _tick_usec(1000), _benchmark(0), _spread(10, 0),
+      _timers(0), _ntimers(0), _errors(0), _nfired(0)
+{
+}
+
+TimerWheelTest::~TimerWheelTest()
+{
+    delete[] _timers;
+}
+
+int
+TimerWheelTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    Timestamp tick = Timestamp::make_usec(_tick_usec);
+    if (Args(conf, this, errh)
+	.read("TICK", tick)
+	.read("BENCHMARK", _benchmark)
+	.read("SPREAD", _spread)
+	.complete() < 0)
+	return -1;
+    _tick_usec = tick.usecval();
+    if (_tick_usec == 0)
+	return errh->error("TICK must be at least 1us");
+    if (_spread.msecval() <= 0)
+	return errh->error("SPREAD must be at least 1ms");
+    return 0;
+}
+
+void
+TimerWheelTest::fire_hook(Timer *t, void *user_data)
+{
+    TimerWheelTest *twt = static_cast<TimerWheelTest *>(user_data);
+    ++twt->_nfired;
+    if (twt->_expiry.empty())
+	return;
+    int i = t - twt->_timers;
+    if (!twt->_expiry[i] || twt->_fired[i] || t->scheduled()
+	|| twt->_now < t->expiry_steady() || t->expiry_steady() != twt->_expiry[i]) {
+	if (++twt->_errors <= 5)
+	    click_chatter("%{element}: timer %d (expiry %{timestamp}) bad fire at %{timestamp}", twt, i, &twt->_expiry[i], &twt->_now);
+    }
+    twt->_fired[i] = 1;
+}
+
+static int
+timestamp_compar(const void *a, const void *b, void *)
+{
+    const Timestamp *ta = static_cast<const Timestamp *>(a);
+    const Timestamp *tb = static_cast<const Timestamp *>(b);
+    return (*ta > *tb) - (*ta < *tb);
+}
+
+static Timestamp
+random_offset(int which)
+{
+    switch (which) {
+    case 0:			// level 0
+	return Timestamp::make_usec(click_random(0, 9999));
+    case 1:			// levels 0-1
+	return Timestamp::make_usec(0, click_random(0, 999999));
+    case 2:			// levels 1-2
+	return Timestamp::make_usec(click_random(0, 99), click_random(0, 999999));
+    case 3:			// levels 2-3
+	return Timestamp::make_usec(click_random(0, 99999), click_random(0, 999999));
+    case 4:			// beyond the wheel's range at 1ms ticks
+	return Timestamp::make_usec(click_random(0, 9999999), click_random(0, 999999));
+    default:
+	return Timestamp();
+    }
+}
+
+int
+TimerWheelTest::test(TimerSet *ts, const char *name, ErrorHandler *errh)
+{
+    RouterThread *thread = _timers[0].thread();
+    _errors = _nfired = 0;
+    _now = Timestamp::now_steady();
+    _expiry.assign(_ntimers, Timestamp());
+    _fired.assign(_ntimers, 0);
+
+    for (int i = 0; i < _ntimers; ++i) {
+	_expiry[i] = _now + random_offset(i % 6);
+	ts->schedule_timer(&_timers[i], _expiry[i]);
+    }
+    for (int i = 0; i < _ntimers; i += 3) {
+	_expiry[i] = _now + random_offset(click_random(0, 5));
+	ts->schedule_timer(&_timers[i], _expiry[i]);
+    }
+    int nexpected = _ntimers;
+    for (int i = 1; i < _ntimers; i += 7) {
+	ts->unschedule_timer(&_timers[i]);
+	_expiry[i] = Timestamp();
+	--nexpected;
+    }
+
+    Vector<Timestamp> order(_expiry);
+    click_qsort(order.begin(), order.size(), sizeof(Timestamp), timestamp_compar, 0);
+    Timestamp::value_type epsilon = 1;
+    for (Vector<Timestamp>::iterator it = order.begin(); it != order.end(); ++it) {
+	if (!*it || (it != order.begin() && *it == it[-1]))
+	    continue;
+	Timestamp runs[2] = { *it - Timestamp::make_usec(epsilon), *it };
+	for (int r = 0; r < 2; ++r) {
+	    _now = runs[r];
+	    ts->run_timers_until(thread, _now);
+	    int nlate = 0;
+	    for (int i = 0; i < _ntimers; ++i)
+		if (_expiry[i] && _expiry[i] <= _now && !_fired[i])
+		    ++nlate;
+	    if (nlate && ++_errors <= 5)
+		errh->error("%s: %d timers late at %{timestamp}", name, nlate, &_now);
+	}
+    }
+
+    if (ts->next_timer() && ++_errors <= 5)
+	errh->error("%s: timers left over", name);
+    if (_nfired != nexpected && ++_errors <= 5)
+	errh->error("%s: %d timers fired, expected %d", name, _nfired, nexpected);
+    for (int i = 0; i < _ntimers; ++i)
+	ts->unschedule_timer(&_timers[i]);
+    _expiry.clear();
+    _fired.clear();
+    return _errors ? -1 : 0;
+}
+
+void
+TimerWheelTest::benchmark(TimerSet *ts, const char *name, ErrorHandler *errh)
+{
+    RouterThread *thread = _timers[0].thread();
+    uint32_t spread_msec = _spread.msecval();
+    Timestamp start = Timestamp::now_steady();
+    Timestamp tick = Timestamp::make_usec(_tick_usec);
+    _nfired = 0;
+
+    Timestamp t0 = Timestamp::now();
+    for (int i = 0; i < _ntimers; ++i)
+	ts->schedule_timer(&_timers[i], start + Timestamp::make_msec(click_random(0, spread_msec)));
+    Timestamp t1 = Timestamp::now();
+    for (int i = 0; i < _ntimers; ++i)
+	ts->schedule_timer(&_timers[click_random(0, _ntimers - 1)],
+			   start + Timestamp::make_msec(click_random(0, spread_msec)));
+    Timestamp t2 = Timestamp::now();
+    for (_now = start; _now <= start + _spread + tick; _now += tick)
+	ts->run_timers_until(thread, _now);
+    Timestamp t3 = Timestamp::now();
+
+    if (_nfired != _ntimers)
+	errh->error("%s: %d timers fired, expected %d", name, _nfired, _ntimers);
+    errh->message("%s: %d timers: schedule %d ns, reschedule %d ns, fire %d ns",
+		  name, _ntimers,
+		  (int) ((t1 - t0).nsecval() / _ntimers),
+		  (int) ((t2 - t1).nsecval() / _ntimers),
+		  (int) ((t3 - t2).nsecval() / _ntimers));
+}
+
+int
+TimerWheelTest::initialize(ErrorHandler *errh)
+{
+    _ntimers = _benchmark > 0 ? _benchmark : 3000;
+    _timers = new Timer[_ntimers];
+    for (int i = 0; i < _ntimers; ++i) {
+	_timers[i].assign(fire_hook, this);
+	_timers[i].initialize(this);
+    }
+
+    TimerSet *heap = new TimerSet(0);
+    TimerSet *wheel = new TimerSet(_tick_usec);
+    int r = 0;
+    if (_benchmark > 0) {
+	benchmark(heap, "heap", errh);
+	benchmark(wheel, "wheel", errh);
+    } else {
+	if (test(heap, "heap", errh) < 0 || test(wheel, "wheel", errh) < 0)
+	    r = -1;
+	else
+	    errh->message("All tests pass!");
+    }
+    delete heap;
+    delete wheel;
+
+    delete[] _timers;
+    _timers = 0;
+    return r;
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(TimerWheelTest)
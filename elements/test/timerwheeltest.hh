@@ -0,0 +1,89 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_TIMERWHEELTEST_HH
+#define CLICK_TIMERWHEELTEST_HH
+#include <click/element.hh>
+#include <click/timer.hh>
+CLICK_DECLS
+class TimerSet;
+
+/*
+=c
+
+TimerWheelTest([I<keywords>])
+
+=s test
+
+runs regression tests and benchmarks for Timer storage
+
+=d
+
+TimerWheelTest checks Click's two TimerSet implementations, the binary heap
+and the hashed hierarchical timing wheel, at initialization time. It uses
+private TimerSets driven by a simulated clock, so the tests do not depend on
+the driver's own timer configuration, and it does not route packets.
+
+Without a BENCHMARK argument, TimerWheelTest schedules, reschedules, and
+unschedules timers spread over every level of the wheel, then advances the
+clock and checks that each timer runs exactly once, never before its
+expiration time, and no later than the first run after it.
+
+Keyword arguments are:
+
+=over 8
+
+=item TICK
+
+Timestamp. The timing wheel's tick. Default is 1ms.
+
+=item BENCHMARK
+
+Integer. If set to a positive number, then TimerWheelTest times BENCHMARK
+timers in each implementation instead of running regression tests: first
+scheduling them all, then rescheduling each once at random, then advancing
+the clock by TICK steps until every timer has fired. Results are printed as
+nanoseconds per operation. Default is 0 (don't benchmark).
+
+=item SPREAD
+
+Timestamp. Benchmark timers expire uniformly at random within SPREAD of the
+start time. Default is 10 seconds.
+
+=back
+
+=a
+
+TimerTest */
+
+class TimerWheelTest : public Element { public:
+
+    TimerWheelTest();
+    ~TimerWheelTest();
+
+    const char *class_name() const		{ return "TimerWheelTest"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+
+  private:
+
+    uint32_t _tick_usec;
+    int _benchmark;
+    Timestamp _spread;
+
+    Timer *_timers;
+    int _ntimers;
+    Vector<Timestamp> _expiry;
+    Vector<int> _fired;
+    Timestamp _now;
+    int _errors;
+    int _nfired;
+
+    static void fire_hook(Timer *t, void *user_data);
+
+    int test(TimerSet *ts, const char *name, ErrorHandler *errh);
+    void benchmark(TimerSet *ts, const char *name, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -38,6 +38,26 @@ StaticThreadSched::configure(Vector<String> &conf, ErrorHandler *errh)
     Element *e;
     int preference;
     for (int i = 0; i < conf.size(); i++) {
+#if CLICK_USERLEVEL
+	Vector<String> words;
+	cp_spacevec(conf[i], words);
+	if (words.size() == 3 && (words[1] == "NODE" || words[1] == "DEVICE")) {
+	    int node;
+	    if (Args(this, errh).push_back(words[0])
+		.read_mp("ELEMENT", e)
+		.complete() < 0)
+		return -1;
+	    if (words[1] == "DEVICE") {
+		if ((node = Master::device_numa_node(words[2])) < 0) {
+		    errh->warning("device %<%s%> has no NUMA node", words[2].c_str());
+		    continue;
+		}
+	    } else if (!IntArg().parse(words[2], node) || node < 0)
+		return errh->error("NODE should be a NUMA node number");
+	    if ((preference = node_thread(node, errh)) == THREAD_UNKNOWN)
+		continue;
+	} else
+#endif
 	if (Args(this, errh).push_back_words(conf[i])
 	    .read_mp("ELEMENT", e)
 	    .read_mp("THREAD", preference)
@@ -56,6 +76,22 @@ StaticThreadSched::configure(Vector<String> &conf, ErrorHandler *errh)
     return 0;
 }
 
+#if CLICK_USERLEVEL
+int
+StaticThreadSched::node_thread(int node, ErrorHandler *errh)
+{
+    Vector<int> threads;
+    master()->numa_node_threads(node, threads);
+    if (!threads.size()) {
+	errh->warning("no thread on NUMA node %d (run with --affinity or --cpus)", node);
+	return THREAD_UNKNOWN;
+    }
+    if (node >= _node_next.size())
+	_node_next.resize(node + 1, 0);
+    return threads[_node_next[node]++ % threads.size()];
+}
+#endif
+
 int
 StaticThreadSched::initial_home_thread_id(const Element *e)
 {
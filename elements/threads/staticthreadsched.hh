@@ -14,8 +14,19 @@ CLICK_DECLS
  * Statically binds elements to threads. If more than one StaticThreadSched
  * is specified, they will all run. The one that runs later may override an
  * earlier run.
+ *
+ * At user level, THREAD may also be "NODE N" or "DEVICE DEVNAME". These bind
+ * ELEMENT to a thread on NUMA node N, or on the NUMA node of network device
+ * DEVNAME, as read from sysfs. Elements bound to the same node are spread
+ * round-robin over that node's threads. Threads have a NUMA node only when
+ * the driver binds them to CPUs (see click(1)'s --affinity and --cpus
+ * options); if no thread is on the node, StaticThreadSched warns and leaves
+ * ELEMENT to other thread schedulers.
+ * =e
+ *   FromDevice(eth0, METHOD RING) -> ... ;
+ *   StaticThreadSched(fd0 DEVICE eth0, fd1 NODE 1);
  * =a
- * ThreadMonitor, BalancedThreadSched
+ * ThreadMonitor, BalancedThreadSched, click(1)
  */
 
 class StaticThreadSched : public Element, public ThreadSched { public:
@@ -32,6 +43,11 @@ class StaticThreadSched : public Element, public ThreadSched { public:
   private:
 
     Vector<int> _thread_preferences;
+#if CLICK_USERLEVEL
+    Vector<int> _node_next;		// round-robin position per NUMA node
+
+    int node_thread(int node, ErrorHandler *errh);
+#endif
     ThreadSched *_next_thread_sched;
 
 };
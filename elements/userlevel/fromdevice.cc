@@ -45,26 +45,40 @@
 
 #if FROMDEVICE_LINUX
 # include <sys/socket.h>
+# include <sys/mman.h>
 # include <net/if.h>
 # include <features.h>
 # if __GLIBC__ >= 2 && __GLIBC_MINOR__ >= 1
-#  include <netpacket/packet.h>
+/* <linux/if_packet.h> rather than <netpacket/packet.h>, for TPACKET_V3 */
+#  include <linux/if_packet.h>
 #  include <net/ethernet.h>
 # else
 #  include <net/if_packet.h>
 #  include <linux/if_packet.h>
 #  include <linux/if_ether.h>
 # endif
+# ifdef TPACKET3_HDRLEN	/* TPACKET_V3 is an enum, not a macro */
+#  define FROMDEVICE_RING 1
+# endif
 #endif
 
 CLICK_DECLS
 
+#if FROMDEVICE_LINUX
+FromDevice *FromDevice::ring_list;
+#endif
+
 FromDevice::FromDevice()
     :
 #if FROMDEVICE_PCAP
       _pcap(0), _pcap_task(this), _pcap_complaints(0),
 #endif
-      _datalink(-1), _count(0), _promisc(0), _snaplen(0)
+      _datalink(-1), _count(0),
+#if FROMDEVICE_LINUX
+      _ring(0), _ring_refs(0), _ring_task(this),
+      _ring_drops(0), _ring_freezes(0),
+#endif
+      _promisc(0), _snaplen(0)
 {
 #if FROMDEVICE_LINUX || FROMDEVICE_PCAP
     _fd = -1;
@@ -84,6 +98,10 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
     _headroom += (4 - (_headroom + 2) % 4) % 4; // default 4/2 alignment
     _force_ip = false;
     _burst = 1;
+#if FROMDEVICE_LINUX
+    _ring_block_size = 1 << 20;
+    _ring_frames = 4096;
+#endif
     String bpf_filter, capture, encap_type;
     bool has_encap;
     if (Args(conf, this, errh)
@@ -99,6 +117,10 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("HEADROOM", _headroom)
 	.read("ENCAP", WordArg(), encap_type).read_status(has_encap)
 	.read("BURST", _burst)
+#if FROMDEVICE_LINUX
+	.read("RING_BLOCK_SIZE", _ring_block_size)
+	.read("RING_FRAMES", _ring_frames)
+#endif
 	.complete() < 0)
 	return -1;
     if (_snaplen > 8190 || _snaplen < 14)
@@ -133,6 +155,10 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
     else if (capture == "LINUX")
 	_capture = CAPTURE_LINUX;
 #endif
+#if FROMDEVICE_RING
+    else if (capture == "RING")
+	_capture = CAPTURE_RING;
+#endif
 #if FROMDEVICE_PCAP
     else if (capture == "PCAP")
 	_capture = CAPTURE_PCAP;
@@ -142,6 +168,17 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
 
     if (bpf_filter && _capture != CAPTURE_PCAP)
 	errh->warning("not using METHOD PCAP, BPF filter ignored");
+#if FROMDEVICE_RING
+    if (_capture == CAPTURE_RING) {
+	unsigned pagesize = getpagesize();
+	if (_ring_block_size == 0 || _ring_block_size % pagesize != 0)
+	    return errh->error("RING_BLOCK_SIZE must be a multiple of the page size (%u)", pagesize);
+	if (TPACKET_ALIGN(TPACKET3_HDRLEN + _snaplen) > _ring_block_size)
+	    return errh->error("RING_BLOCK_SIZE too small for SNAPLEN");
+	if (_ring_frames == 0)
+	    return errh->error("RING_FRAMES out of range");
+    }
+#endif
 
     _sniffer = sniffer;
     _promisc = promisc;
@@ -221,6 +258,163 @@ FromDevice::set_promiscuous(int fd, String ifname, bool promisc)
 }
 #endif /* FROMDEVICE_LINUX */
 
+#if FROMDEVICE_RING
+int
+FromDevice::open_ring(ErrorHandler *errh)
+{
+    int version = TPACKET_V3;
+    if (setsockopt(_fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+	return errh->error("%s: PACKET_VERSION: %s", _ifname.c_str(), strerror(errno));
+
+    // With TPACKET_V3, packets are packed into blocks back to back, so the
+    // frame size only determines how many packets the ring must hold.
+    unsigned frame_size = TPACKET_ALIGN(TPACKET3_HDRLEN + _snaplen);
+    unsigned frames_per_block = _ring_block_size / frame_size;
+    _ring_block_nr = (_ring_frames + frames_per_block - 1) / frames_per_block;
+
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = _ring_block_size;
+    req.tp_block_nr = _ring_block_nr;
+    req.tp_frame_size = frame_size;
+    req.tp_frame_nr = frames_per_block * _ring_block_nr;
+    req.tp_retire_blk_tov = 1;	// msec
+    if (setsockopt(_fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0)
+	return errh->error("%s: PACKET_RX_RING: %s", _ifname.c_str(), strerror(errno));
+
+    _ring_size = (size_t) _ring_block_size * _ring_block_nr;
+    void *ring = mmap(0, _ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (ring == MAP_FAILED)
+	return errh->error("%s: mmap: %s", _ifname.c_str(), strerror(errno));
+    _ring = reinterpret_cast<unsigned char *>(ring);
+
+    _ring_refs = new atomic_uint32_t[_ring_block_nr];
+    for (unsigned b = 0; b < _ring_block_nr; ++b)
+	_ring_refs[b] = 0;
+    _ring_block = _ring_left = 0;
+    _ring_chain = ring_list;
+    ring_list = this;
+    return 0;
+}
+
+void
+FromDevice::close_ring()
+{
+    for (FromDevice **pprev = &ring_list; *pprev; pprev = &(*pprev)->_ring_chain)
+	if (*pprev == this) {
+	    *pprev = _ring_chain;
+	    break;
+	}
+
+    // Drop our reference to a partially read block.  If packets still point
+    // into the ring, leave it mapped; it is reclaimed when the process exits.
+    if (_ring_left)
+	_ring_refs[_ring_block]--;
+    bool busy = false;
+    for (unsigned b = 0; b < _ring_block_nr; ++b)
+	if (_ring_refs[b] != 0)
+	    busy = true;
+    if (!busy) {
+	munmap(_ring, _ring_size);
+	delete[] _ring_refs;
+    }
+    _ring = 0;
+    _ring_refs = 0;
+}
+
+inline void
+FromDevice::ring_release_block(unsigned b)
+{
+    struct tpacket_block_desc *bd = reinterpret_cast<struct tpacket_block_desc *>(_ring + (size_t) b * _ring_block_size);
+    click_fence();
+    bd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+}
+
+void
+FromDevice::ring_packet_destructor(unsigned char *data, size_t)
+{
+    for (FromDevice *fd = ring_list; fd; fd = fd->_ring_chain)
+	if (data >= fd->_ring && data < fd->_ring + fd->_ring_size) {
+	    unsigned b = (data - fd->_ring) / fd->_ring_block_size;
+	    if (fd->_ring_refs[b].dec_and_test())
+		fd->ring_release_block(b);
+	    return;
+	}
+}
+
+void
+FromDevice::ring_read()
+{
+    PacketBatch batch;
+    int n = 0;
+
+    while (n < _burst) {
+	if (!_ring_left) {
+	    // A block from the previous lap may still be referenced by live
+	    // packets.  Its status is still TP_STATUS_USER, so check refs too.
+	    struct tpacket_block_desc *bd = reinterpret_cast<struct tpacket_block_desc *>(_ring + (size_t) _ring_block * _ring_block_size);
+	    if (!(bd->hdr.bh1.block_status & TP_STATUS_USER)
+		|| _ring_refs[_ring_block] != 0)
+		break;
+	    click_fence();
+	    _ring_left = bd->hdr.bh1.num_pkts;
+	    _ring_next = reinterpret_cast<unsigned char *>(bd) + bd->hdr.bh1.offset_to_first_pkt;
+	    _ring_refs[_ring_block] = _ring_left + 1;
+	}
+
+	if (_ring_left) {
+	    struct tpacket3_hdr *h = reinterpret_cast<struct tpacket3_hdr *>(_ring_next);
+	    const struct sockaddr_ll *sa = reinterpret_cast<const struct sockaddr_ll *>(_ring_next + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+	    _ring_next += h->tp_next_offset;
+	    --_ring_left;
+
+	    uint32_t len = h->tp_snaplen;
+	    if (len > (uint32_t) _snaplen)
+		len = _snaplen;
+	    WritablePacket *p = 0;
+	    if (sa->sll_pkttype != PACKET_OUTGOING || _outbound)
+		p = Packet::make(reinterpret_cast<unsigned char *>(h) + h->tp_mac, len, ring_packet_destructor);
+	    if (p) {
+		p->set_packet_type_anno((Packet::PacketType) sa->sll_pkttype);
+		p->timestamp_anno() = Timestamp::make_nsec(h->tp_sec, h->tp_nsec);
+		p->set_mac_header(p->data());
+		SET_EXTRA_LENGTH_ANNO(p, h->tp_len - len);
+		++n;
+		++_count;
+		if (!_force_ip || fake_pcap_force_ip(p, _datalink))
+		    batch.push_back(p);
+		else
+		    checked_output_push(1, p);
+	    } else
+		_ring_refs[_ring_block]--;
+	}
+
+	if (!_ring_left) {
+	    if (_ring_refs[_ring_block].dec_and_test())
+		ring_release_block(_ring_block);
+	    _ring_block = (_ring_block + 1 == _ring_block_nr ? 0 : _ring_block + 1);
+	}
+    }
+
+    if (!batch.empty())
+	output(0).push_batch(batch);
+    if (n == _burst)
+	_ring_task.reschedule();
+}
+
+void
+FromDevice::ring_stats()
+{
+    // PACKET_STATISTICS resets the kernel's counters, so accumulate them.
+    struct tpacket_stats_v3 st;
+    socklen_t len = sizeof(st);
+    if (_fd >= 0 && getsockopt(_fd, SOL_PACKET, PACKET_STATISTICS, &st, &len) >= 0) {
+	_ring_drops += st.tp_drops;
+	_ring_freezes += st.tp_freeze_q_cnt;
+    }
+}
+#endif /* FROMDEVICE_RING */
+
 #if FROMDEVICE_PCAP
 const char *
 FromDevice::pcap_error(pcap_t *pcap, const char *ebuf)
@@ -356,6 +550,29 @@ FromDevice::initialize(ErrorHandler *errh)
     }
 #endif
 
+#if FROMDEVICE_RING
+    if (_capture == CAPTURE_RING) {
+	_fd = open_packet_socket(_ifname, errh);
+	if (_fd < 0)
+	    return -1;
+	if (open_ring(errh) < 0)
+	    return -1;
+
+	int promisc_ok = set_promiscuous(_fd, _ifname, _promisc);
+	if (promisc_ok < 0) {
+	    if (_promisc)
+		errh->warning("cannot set promiscuous mode");
+	    _was_promisc = -1;
+	} else
+	    _was_promisc = promisc_ok;
+
+	add_select(_fd, SELECT_READ);
+	ScheduleInfo::initialize_task(this, &_ring_task, false, errh);
+
+	_datalink = FAKE_DLT_EN10MB;
+    }
+#endif
+
     if (!_sniffer)
 	if (KernelFilter::device_filter(_ifname, true, errh) < 0)
 	    _sniffer = true;
@@ -368,8 +585,12 @@ FromDevice::cleanup(CleanupStage stage)
 {
     if (stage >= CLEANUP_INITIALIZED && !_sniffer)
 	KernelFilter::device_filter(_ifname, false, ErrorHandler::default_handler());
+#if FROMDEVICE_RING
+    if (_ring)
+	close_ring();
+#endif
 #if FROMDEVICE_LINUX
-    if (_fd >= 0 && _capture == CAPTURE_LINUX) {
+    if (_fd >= 0 && (_capture == CAPTURE_LINUX || _capture == CAPTURE_RING)) {
 	if (_was_promisc >= 0)
 	    set_promiscuous(_fd, _ifname, _was_promisc);
 	close(_fd);
@@ -413,7 +634,7 @@ FromDevice_get_packet(u_char* clientdata,
     SET_EXTRA_LENGTH_ANNO(p, pkthdr->len - length);
 
     if (!fd->_force_ip || fake_pcap_force_ip(p, fd->_datalink))
-	fd->output(0).push(p);
+	fd->_pcap_batch.push_back(p);
     else
 	fd->checked_output_push(1, p);
 }
@@ -426,8 +647,10 @@ FromDevice::selected(int, int)
 {
 #if FROMDEVICE_PCAP
     if (_capture == CAPTURE_PCAP) {
-	// Read and push() at most one packet.
+	// Read and push() at most _burst packets.
 	int r = pcap_dispatch(_pcap, _burst, FromDevice_get_packet, (u_char *) this);
+	if (!_pcap_batch.empty())
+	    output(0).push_batch(_pcap_batch);
 	if (r > 0) {
 	    _count += r;
 	    _pcap_task.reschedule();
@@ -436,6 +659,7 @@ FromDevice::selected(int, int)
     }
 #endif
 #if FROMDEVICE_LINUX
+    PacketBatch batch;
     int nlinux = 0;
     while (_capture == CAPTURE_LINUX && nlinux < _burst) {
 	struct sockaddr_ll sa;
@@ -454,7 +678,7 @@ FromDevice::selected(int, int)
 	    ++nlinux;
 	    ++_count;
 	    if (!_force_ip || fake_pcap_force_ip(p, _datalink))
-		output(0).push(p);
+		batch.push_back(p);
 	    else
 		checked_output_push(1, p);
 	} else {
@@ -464,21 +688,40 @@ FromDevice::selected(int, int)
 	    break;
 	}
     }
+    if (!batch.empty())
+	output(0).push_batch(batch);
+#endif
+#if FROMDEVICE_RING
+    if (_capture == CAPTURE_RING)
+	ring_read();
 #endif
 }
 
-#if FROMDEVICE_PCAP
+#if FROMDEVICE_PCAP || FROMDEVICE_LINUX
 bool
 FromDevice::run_task(Task *)
 {
-    // Read and push() at most one packet.
+# if FROMDEVICE_RING
+    if (_capture == CAPTURE_RING) {
+	counter_t count = _count;
+	ring_read();
+	return _count != count;
+    }
+# endif
+# if FROMDEVICE_PCAP
+    // Read and push() at most _burst packets.
     int r = pcap_dispatch(_pcap, _burst, FromDevice_get_packet, (u_char *) this);
+    if (!_pcap_batch.empty())
+	output(0).push_batch(_pcap_batch);
     if (r > 0) {
 	_count += r;
 	_pcap_task.fast_reschedule();
     } else if (r < 0 && ++_pcap_complaints < 5)
 	ErrorHandler::default_handler()->error("%{element}: %s", this, pcap_geterr(_pcap));
     return r > 0;
+# else
+    return false;
+# endif
 }
 #endif
 
@@ -490,6 +733,10 @@ FromDevice::kernel_drops(bool& known, int& max_drops) const
     // but for now, we just give up.
 #endif
     known = false, max_drops = -1;
+#if FROMDEVICE_RING
+    if (_capture == CAPTURE_RING)
+	known = true, max_drops = _ring_drops;
+#endif
 #if FROMDEVICE_PCAP
     if (_capture == CAPTURE_PCAP) {
 	struct pcap_stat stats;
@@ -503,6 +750,10 @@ String
 FromDevice::read_handler(Element* e, void *thunk)
 {
     FromDevice* fd = static_cast<FromDevice*>(e);
+#if FROMDEVICE_RING
+    if (fd->_capture == CAPTURE_RING)
+	fd->ring_stats();
+#endif
     if (thunk == (void *) 0) {
 	int max_drops;
 	bool known;
@@ -515,6 +766,10 @@ FromDevice::read_handler(Element* e, void *thunk)
 	    return "??";
     } else if (thunk == (void *) 1)
 	return String(fake_pcap_unparse_dlt(fd->_datalink));
+#if FROMDEVICE_LINUX
+    else if (thunk == (void *) 3)
+	return String(fd->_ring_freezes);
+#endif
     else
 	return String(fd->_count);
 }
@@ -533,6 +788,10 @@ FromDevice::add_handlers()
     add_read_handler("kernel_drops", read_handler, (void *) 0);
     add_read_handler("encap", read_handler, (void *) 1);
     add_read_handler("count", read_handler, (void *) 2);
+#if FROMDEVICE_RING
+    if (_capture == CAPTURE_RING)
+	add_read_handler("ring_freezes", read_handler, (void *) 3);
+#endif
     add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON);
 }
 
@@ -5,9 +5,11 @@
 #ifdef __linux__
 # define FROMDEVICE_LINUX 1
 #endif
+#if FROMDEVICE_LINUX || HAVE_PCAP
+# include <click/task.hh>
+#endif
 #if HAVE_PCAP
 # define FROMDEVICE_PCAP 1
-# include <click/task.hh>
 extern "C" {
 # include <pcap.h>
 /* Prototype pcap_setnonblock if we have it, but not the prototype. */
@@ -82,8 +84,17 @@ but the IP header annotation has been set appropriately.) Default is false.
 =item METHOD
 
 Word.  Defines the capture method FromDevice will use to read packets from the
-device.  Linux targets generally support PCAP and LINUX; other targets support
-only PCAP.  Defaults to PCAP.
+device.  Linux targets generally support PCAP, LINUX, and RING; other targets
+support only PCAP.  Defaults to PCAP.
+
+METHOD RING reads packets from a memory-mapped TPACKET_V3 receive ring shared
+with the kernel.  Packets are not copied: each packet FromDevice emits points
+directly into ring memory, and the kernel cannot reuse a ring block until
+every packet from that block has been killed.  Configurations that hold
+packets for a long time, for example in a large Queue, can therefore cause
+kernel drops; see the RING_BLOCK_SIZE and RING_FRAMES keywords.  Packets
+have no headroom, so prepending data (EtherEncap, for example) copies the
+packet.  HEADROOM is ignored.
 
 =item BPF_FILTER
 
@@ -110,6 +121,20 @@ to roughly 28.
 =item BURST
 
 Integer. Maximum number of packets to read per scheduling. Defaults to 1.
+Packets read together are pushed downstream as a single batch to elements
+that support batch transfer.
+
+=item RING_BLOCK_SIZE
+
+Unsigned.  METHOD RING only.  Size in bytes of each receive ring block; must
+be a multiple of the page size.  The kernel hands blocks to FromDevice once
+they fill up or after 1 ms.  Defaults to 1048576.
+
+=item RING_FRAMES
+
+Unsigned.  METHOD RING only.  Minimum number of SNAPLEN-sized packets the
+receive ring can hold.  Together with RING_BLOCK_SIZE, this determines the
+number of ring blocks.  Defaults to 4096.
 
 =back
 
@@ -136,6 +161,11 @@ constraints, before FromDevice could get them. This may be an integer; the
 notation C<"<I<d>">, meaning at most C<I<d>> drops; or C<"??">, meaning the
 number of drops is not known.
 
+=h ring_freezes read-only
+
+METHOD RING only.  Returns the number of times the kernel found the receive
+ring full and stopped filling it until FromDevice released a block.
+
 =h encap read-only
 
 Returns a string indicating the encapsulation type on this link. Can be
@@ -163,9 +193,11 @@ class FromDevice : public Element { public:
     inline int fd() const		{ return _fd; }
 
     void selected(int fd, int mask);
+#if FROMDEVICE_PCAP || FROMDEVICE_LINUX
+    bool run_task(Task *);
+#endif
 #if FROMDEVICE_PCAP
     pcap_t *pcap() const		{ return _pcap; }
-    bool run_task(Task *);
     static const char *pcap_error(pcap_t *pcap, const char *ebuf);
     static pcap_t *open_pcap(String ifname, int snaplen, bool promisc, ErrorHandler *errh);
 #endif
@@ -190,6 +222,7 @@ class FromDevice : public Element { public:
     pcap_t *_pcap;
     Task _pcap_task;
     int _pcap_complaints;
+    PacketBatch _pcap_batch;
     friend void FromDevice_get_packet(u_char*, const struct pcap_pkthdr*,
 				      const u_char*);
     const char *pcap_error(const char *ebuf) {
@@ -207,6 +240,31 @@ class FromDevice : public Element { public:
 #endif
     counter_t _count;
 
+#if FROMDEVICE_LINUX
+    // METHOD RING state
+    unsigned char *_ring;
+    size_t _ring_size;
+    unsigned _ring_block_size;
+    unsigned _ring_block_nr;
+    unsigned _ring_frames;
+    atomic_uint32_t *_ring_refs;	// live packets per block, +1 while reading
+    unsigned _ring_block;		// block being read
+    unsigned _ring_left;		// packets left to read in _ring_block
+    unsigned char *_ring_next;		// next packet header in _ring_block
+    Task _ring_task;
+    counter_t _ring_drops;
+    counter_t _ring_freezes;
+    FromDevice *_ring_chain;		// next element in ring_list
+
+    static FromDevice *ring_list;
+    int open_ring(ErrorHandler *errh);
+    void close_ring();
+    void ring_read();
+    void ring_stats();
+    void ring_release_block(unsigned b);
+    static void ring_packet_destructor(unsigned char *data, size_t length);
+#endif
+
     String _ifname;
     bool _sniffer : 1;
     bool _promisc : 1;
@@ -214,7 +272,7 @@ class FromDevice : public Element { public:
     int _was_promisc : 2;
     int _snaplen;
     unsigned _headroom;
-    enum { CAPTURE_PCAP, CAPTURE_LINUX };
+    enum { CAPTURE_PCAP, CAPTURE_LINUX, CAPTURE_RING };
     int _capture;
 #if FROMDEVICE_PCAP
     String _bpf_filter;
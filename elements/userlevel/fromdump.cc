@@ -28,6 +28,7 @@
 #include <click/handlercall.hh>
 #include <click/packet_anno.hh>
 #include <click/userutils.hh>
+#include <click/integers.hh>
 #if CLICK_NS
 # include <click/master.hh>
 #endif
@@ -47,8 +48,14 @@ CLICK_DECLS
 	( (((y)&0xff)<<8) | ((u_short)((y)&0xff00)>>8) )
 
 FromDump::FromDump()
-    : _packet(0), _end_h(0), _count(0), _timer(this), _task(this)
+    : _packet(0), _end_h(0), _count(0), _timer(this), _task(this),
+      _prefetch(0)
 {
+#if HAVE_USER_MULTITHREAD
+    _pf_ring = 0;
+    _pf_started = false;
+    _pf_starved = false;
+#endif
 }
 
 FromDump::~FromDump()
@@ -79,6 +86,7 @@ int
 FromDump::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     bool timing = false, stop = false, active = true, force_ip = false;
+    bool use_index = false;
     Timestamp first_time, first_time_off, last_time, last_time_off, interval;
     HandlerCall end_h;
     _sampling_prob = (1 << SAMPLING_SHIFT);
@@ -106,9 +114,24 @@ FromDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("PER_NODE", per_node)
 #endif
 	.read("FILEPOS", _packet_filepos)
+	.read("PREFETCH", _prefetch)
+	.read("INDEX", use_index)
 	.complete() < 0)
 	return -1;
 
+#if HAVE_USER_MULTITHREAD
+    // a power of two, so ring positions can wrap
+    if (_prefetch > 0x10000000)
+	return errh->error("PREFETCH too large");
+    if (_prefetch & (_prefetch - 1))
+	_prefetch = 1 << (32 - ffs_msb(_prefetch) + 1);
+#else
+    if (_prefetch) {
+	errh->warning("PREFETCH requires multithreading, ignored");
+	_prefetch = 0;
+    }
+#endif
+
     // check sampling rate
     if (_sampling_prob > (1 << SAMPLING_SHIFT)) {
 	errh->warning("SAMPLE probability reduced to 1");
@@ -153,6 +176,7 @@ FromDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _have_any_times = false;
     _timing = timing;
     _force_ip = force_ip;
+    _use_index = use_index;
 
 #if CLICK_NS
     if (per_node) {
@@ -191,9 +215,12 @@ swap_packet_header(const fake_pcap_pkthdr *hp, fake_pcap_pkthdr *outp)
 FromDump *
 FromDump::hotswap_element() const
 {
+    // a prefetching FromDump's file position is ahead of its output
+    if (_prefetch)
+	return 0;
     if (Element *e = Element::hotswap_element())
 	if (FromDump *fd = static_cast<FromDump *>(e->cast("FromDump")))
-	    if (fd->_ff.filename() == _ff.filename())
+	    if (fd->_ff.filename() == _ff.filename() && !fd->_prefetch)
 		return fd;
     return 0;
 }
@@ -252,13 +279,55 @@ FromDump::initialize(ErrorHandler *errh)
 	// force FORCE_IP.
 	_force_ip = true;
 
+    // maybe use the index to skip to the START time
+    if (_use_index && open_index(errh) < 0)
+	return -1;
+    if (_index.ok() && !_index.empty() && _have_first_time && !_packet_filepos) {
+	prepare_times(_index.first_timestamp());
+	off_t pos = _index.lookup(_first_time);
+	if (pos > _ff.file_pos() && _ff.seek(pos, errh) < 0)
+	    return -1;
+    }
+
     // maybe skip ahead in the file
     if (_packet_filepos != 0) {
 	int result = _ff.seek(_packet_filepos, errh);
 	_packet_filepos = 0;
-	return result;
-    } else
-	return 0;
+	if (result < 0)
+	    return result;
+    }
+
+#if HAVE_USER_MULTITHREAD
+    if (_prefetch) {
+	_pf_ring = new PrefetchSlot[_prefetch];
+	_pf_head = _pf_tail = _pf_read = _pf_limit = 0;
+	_pf_done = _pf_stop = _pf_wake = _pf_starved = false;
+	_pf_waiting = 0;
+	pthread_mutex_init(&_pf_lock, 0);
+	pthread_cond_init(&_pf_cond, 0);
+	if (int err = pthread_create(&_pf_thread, 0, prefetch_thread, this))
+	    return errh->error("cannot start thread: %s", strerror(err));
+	_pf_started = true;
+    }
+#endif
+    return 0;
+}
+
+/* Load FromDump's cached index, building and caching a new one if
+   necessary. */
+int
+FromDump::open_index(ErrorHandler *errh)
+{
+    if (_ff.filename() == "-")
+	return _ff.error(errh, "cannot index standard input");
+    int r = _index.load(_ff.filename(), errh);
+    if (r == 0) {
+	if (_index.build(_ff.filename(), PcapIndex::DEFAULT_INTERVAL, errh) < 0)
+	    return -1;
+	if (int err = _index.save())
+	    _ff.warning(errh, "cannot write index: %s; keeping it in memory", strerror(-err));
+    }
+    return r < 0 ? -1 : 0;
 }
 
 void
@@ -288,7 +357,24 @@ FromDump::take_state(Element *e, ErrorHandler *errh)
 void
 FromDump::cleanup(CleanupStage)
 {
+#if HAVE_USER_MULTITHREAD
+    if (_pf_started) {
+	pthread_mutex_lock(&_pf_lock);
+	_pf_stop = true;
+	pthread_cond_broadcast(&_pf_cond);
+	pthread_mutex_unlock(&_pf_lock);
+	pthread_join(_pf_thread, 0);
+	for (; _pf_read != _pf_tail; ++_pf_read)
+	    _pf_ring[_pf_read & (_prefetch - 1)].p->kill();
+	pthread_mutex_destroy(&_pf_lock);
+	pthread_cond_destroy(&_pf_cond);
+	_pf_started = false;
+    }
+    delete[] _pf_ring;
+    _pf_ring = 0;
+#endif
     _ff.cleanup();
+    _index.clear();
     if (_packet)
 	_packet->kill();
     _packet = 0;
@@ -320,18 +406,14 @@ FromDump::prepare_times(const Timestamp &ts)
     _have_any_times = true;
 }
 
+/* Read the next packet header, leaving the file positioned at the packet
+   data.  Returns false at end of file or on error. */
 bool
-FromDump::read_packet(ErrorHandler *errh)
+FromDump::read_packet_header(Timestamp &ts, int &len, int &caplen,
+			     int &skiplen, ErrorHandler *errh)
 {
     fake_pcap_pkthdr swapped_ph;
     const fake_pcap_pkthdr *ph;
-    Timestamp ts = Timestamp::uninitialized_t();
-    int len, caplen, skiplen = 0;
-    Packet *p;
-    assert(!_packet);
-
-    // record file position
-    _packet_filepos = _ff.file_pos();
 
     // read the packet header
     if (!(ph = reinterpret_cast<const fake_pcap_pkthdr *>(_ff.get_aligned(sizeof(*ph), &swapped_ph))))
@@ -355,6 +437,7 @@ FromDump::read_packet(ErrorHandler *errh)
     // tcpdump files store an incorrect caplen. It's only off by one. Tcptrace
     // should be fixed, but we hack around the problem here, as does
     // tcpdump itself.
+    skiplen = 0;
     if (caplen > 65535) {
 	_ff.error(errh, "bad packet header; giving up");
 	return false;
@@ -366,48 +449,195 @@ FromDump::read_packet(ErrorHandler *errh)
     // compensate for modified pcap versions
     _ff.shift_pos(_extra_pkthdr_crap);
 
-    // check times
-  check_times:
     ts = fake_bpf_timeval_union::make_timestamp(&ph->ts);
+    return true;
+}
+
+Packet *
+FromDump::read_packet_data(const Timestamp &ts, int len, int caplen,
+			   int skiplen, ErrorHandler *errh)
+{
+    Packet *p = _ff.get_packet(caplen, ts.sec(), ts.subsec(), errh);
+    if (!p)
+	return 0;
+    SET_EXTRA_LENGTH_ANNO(p, len - caplen);
+    _ff.shift_pos(skiplen);
+    p->set_mac_header(p->data());
+    return p;
+}
+
+/* Apply START, END, and SAMPLE to a packet with timestamp ts.  Returns 1 if
+   the packet should be emitted, 0 if it should be skipped, and -1 if
+   FromDump should stop. */
+int
+FromDump::check_packet_times(const Timestamp &ts, ErrorHandler *errh)
+{
     if (!_have_any_times)
 	prepare_times(ts);
     if (_have_first_time) {
-	if (ts < _first_time) {
-	    _ff.shift_pos(caplen + skiplen);
-	    return true;
-	} else
+	if (ts < _first_time)
+	    return 0;
+	else
 	    _have_first_time = false;
     }
-    if (_have_last_time && ts >= _last_time) {
+    // retry _last_time in case the end call changed it
+    while (_have_last_time && ts >= _last_time) {
 	_have_last_time = false;
 	(void) _end_h->call_write(errh);
-	if (!_active) {
-	    _ff.shift_pos(caplen + skiplen);
-	    return false;
-	}
-	// retry _last_time in case someone changed it
-	goto check_times;
+	if (!_active)
+	    return -1;
     }
 
     // checking sampling probability
     if (_sampling_prob < (1 << SAMPLING_SHIFT)
-	&& (click_random() & ((1<<SAMPLING_SHIFT)-1)) >= _sampling_prob) {
+	&& (click_random() & ((1<<SAMPLING_SHIFT)-1)) >= _sampling_prob)
+	return 0;
+
+    return 1;
+}
+
+bool
+FromDump::read_packet(ErrorHandler *errh)
+{
+    Timestamp ts = Timestamp::uninitialized_t();
+    int len, caplen, skiplen;
+    assert(!_packet);
+
+#if HAVE_USER_MULTITHREAD
+    if (_prefetch) {
+	Packet *p = prefetch_take();
+	if (!p)
+	    return _pf_starved;
+	int result = check_packet_times(p->timestamp_anno(), errh);
+	if (result > 0)
+	    _packet = p;
+	else
+	    p->kill();
+	return result >= 0;
+    }
+#endif
+
+    // record file position
+    _packet_filepos = _ff.file_pos();
+
+    if (!read_packet_header(ts, len, caplen, skiplen, errh))
+	return false;
+
+    if (int result = check_packet_times(ts, errh)) {
+	if (result < 0) {
+	    _ff.shift_pos(caplen + skiplen);
+	    return false;
+	}
+    } else {
 	_ff.shift_pos(caplen + skiplen);
 	return true;
     }
 
-    // create packet
-    p = _ff.get_packet(caplen, ts.sec(), ts.subsec(), errh);
-    if (!p)
-	return false;
-    SET_EXTRA_LENGTH_ANNO(p, len - caplen);
-    _ff.shift_pos(skiplen);
+    _packet = read_packet_data(ts, len, caplen, skiplen, errh);
+    return _packet != 0;
+}
 
-    p->set_mac_header(p->data());
-    _packet = p;
-    return true;
+#if HAVE_USER_MULTITHREAD
+void *
+FromDump::prefetch_thread(void *thunk)
+{
+#if HAVE___THREAD_STORAGE_CLASS
+    // This is not a RouterThread.  The default ID of 0 would make
+    // Task::reschedule() think we were running thread 0's task list.
+    click_current_thread_id = -1;
+#endif
+    static_cast<FromDump *>(thunk)->prefetch_fill();
+    return 0;
 }
 
+/* Decoding thread: fill the ring until end of file or until cleanup. */
+void
+FromDump::prefetch_fill()
+{
+    uint32_t batch = (_prefetch + 3) / 4;
+    uint32_t tail = 0, published = 0, limit = _prefetch;
+    Timestamp ts = Timestamp::uninitialized_t();
+    int len, caplen, skiplen;
+
+    while (1) {
+	if (tail == limit || tail - published >= batch) {
+	    pthread_mutex_lock(&_pf_lock);
+	    _pf_tail = published = tail;
+	    bool wake = _pf_wake;
+	    _pf_wake = false;
+	    while (tail - _pf_head == _prefetch && !_pf_stop) {
+		++_pf_waiting;
+		pthread_cond_wait(&_pf_cond, &_pf_lock);
+		--_pf_waiting;
+	    }
+	    limit = _pf_head + _prefetch;
+	    bool stop = _pf_stop;
+	    pthread_mutex_unlock(&_pf_lock);
+	    if (stop)
+		return;
+	    if (wake)
+		prefetch_wake();
+	}
+
+	off_t filepos = _ff.file_pos();
+	Packet *p;
+	if (!read_packet_header(ts, len, caplen, skiplen, 0)
+	    || !(p = read_packet_data(ts, len, caplen, skiplen, 0)))
+	    break;
+	PrefetchSlot &slot = _pf_ring[tail & (_prefetch - 1)];
+	slot.p = p;
+	slot.filepos = filepos;
+	++tail;
+    }
+
+    pthread_mutex_lock(&_pf_lock);
+    _pf_tail = tail;
+    _pf_done = true;
+    bool wake = _pf_wake;
+    _pf_wake = false;
+    pthread_mutex_unlock(&_pf_lock);
+    if (wake)
+	prefetch_wake();
+}
+
+/* Decoding thread: the element ran dry and is waiting for new packets. */
+void
+FromDump::prefetch_wake()
+{
+    if (output_is_push(0))
+	_task.reschedule();
+    else
+	_notifier.wake();
+}
+
+/* Return the next decoded packet, or null.  Null with _pf_starved set means
+   the decoding thread has fallen behind; rather than block the router
+   thread, we return and let the decoding thread wake us when it publishes
+   more packets.  Null with _pf_starved clear means end of file. */
+Packet *
+FromDump::prefetch_take()
+{
+    _pf_starved = false;
+    if (_pf_read == _pf_limit || _pf_read - _pf_head >= (_prefetch + 3) / 4) {
+	pthread_mutex_lock(&_pf_lock);
+	_pf_head = _pf_read;
+	if (_pf_waiting)
+	    pthread_cond_broadcast(&_pf_cond);
+	_pf_limit = _pf_tail;
+	if (_pf_read == _pf_limit && !_pf_done)
+	    _pf_starved = _pf_wake = true;
+	pthread_mutex_unlock(&_pf_lock);
+	if (_pf_read == _pf_limit)
+	    return 0;
+    }
+
+    PrefetchSlot &slot = _pf_ring[_pf_read & (_prefetch - 1)];
+    ++_pf_read;
+    _packet_filepos = slot.filepos;
+    return slot.p;
+}
+#endif
+
 bool
 FromDump::check_timing(Packet *p)
 {
@@ -452,6 +682,11 @@ FromDump::run_task(Task *)
 	    _end_h->call_write(ErrorHandler::default_handler());
 	return false;
     }
+#if HAVE_USER_MULTITHREAD
+    // the decoding thread reschedules us once it catches up
+    if (!_packet && _pf_starved)
+	return false;
+#endif
     if (_packet && _timing && !check_timing(_packet))
 	return false;
     if (_packet && _force_ip && !fake_pcap_force_ip(_packet, _linktype)) {
@@ -482,6 +717,12 @@ FromDump::pull(int)
     bool more = true;
     if (!_packet)
 	more = read_packet(0);
+#if HAVE_USER_MULTITHREAD
+    // the decoding thread is behind; more packets are on the way, so leave
+    // the notifier awake
+    if (!_packet && _pf_starved)
+	return 0;
+#endif
     if (_packet && _timing && !check_timing(_packet))
 	return 0;
     if (_packet && _force_ip && !fake_pcap_force_ip(_packet, _linktype)) {
@@ -504,7 +745,7 @@ FromDump::pull(int)
 
 enum {
     H_SAMPLING_PROB, H_ACTIVE, H_ENCAP, H_STOP, H_PACKET_FILEPOS,
-    H_EXTEND_INTERVAL, H_COUNT, H_RESET_COUNTS, H_RESET_TIMING
+    H_EXTEND_INTERVAL, H_COUNT, H_RESET_COUNTS, H_RESET_TIMING, H_SEEK_TIME
 };
 
 String
@@ -557,6 +798,21 @@ FromDump::write_handler(const String &s_in, Element *e, void *thunk, ErrorHandle
 	fd->_last_time_relative = fd->_last_time_interval = false;
 	fd->_have_any_times = false;
 	return 0;
+      case H_SEEK_TIME: {
+	  Timestamp ts;
+	  if (!cp_time(s, &ts))
+	      return errh->error("'seek_time' takes a timestamp");
+	  // without an index, lookup() returns the first packet's offset
+	  if (fd->_ff.seek(fd->_index.lookup(ts), errh) < 0)
+	      return -1;
+	  if (fd->_packet)
+	      fd->_packet->kill();
+	  fd->_packet = 0;
+	  fd->_first_time = ts;
+	  fd->_first_time_relative = false;
+	  fd->_have_first_time = true;
+	  return 0;
+      }
       default:
 	return -EINVAL;
     }
@@ -565,7 +821,7 @@ FromDump::write_handler(const String &s_in, Element *e, void *thunk, ErrorHandle
 void
 FromDump::add_handlers()
 {
-    _ff.add_handlers(this, true);
+    _ff.add_handlers(this, !_prefetch);
     add_read_handler("sampling_prob", read_handler, (void *)H_SAMPLING_PROB);
     add_data_handlers("active", Handler::OP_READ | Handler::CHECKBOX, &_active);
     add_write_handler("active", write_handler, (void *)H_ACTIVE);
@@ -576,6 +832,8 @@ FromDump::add_handlers()
     add_data_handlers("count", Handler::OP_READ, &_count);
     add_write_handler("reset_counts", write_handler, (void *)H_RESET_COUNTS, Handler::BUTTON);
     add_write_handler("reset_timing", write_handler, (void *)H_RESET_TIMING, Handler::BUTTON);
+    if (!_prefetch)
+	add_write_handler("seek_time", write_handler, (void *)H_SEEK_TIME);
     if (output_is_push(0))
 	add_task_handlers(&_task);
 }
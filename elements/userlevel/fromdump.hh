@@ -6,13 +6,17 @@
 #include <click/timer.hh>
 #include <click/notifier.hh>
 #include <click/fromfile.hh>
+#include <click/pcapindex.hh>
+#if HAVE_USER_MULTITHREAD
+# include <pthread.h>
+#endif
 CLICK_DECLS
 class HandlerCall;
 
 /*
 =c
 
-FromDump(FILENAME [, I<keywords> STOP, TIMING, SAMPLE, FORCE_IP, START, START_AFTER, END, END_AFTER, INTERVAL, END_CALL, FILEPOS, MMAP])
+FromDump(FILENAME [, I<keywords> STOP, TIMING, SAMPLE, FORCE_IP, START, START_AFTER, END, END_AFTER, INTERVAL, END_CALL, FILEPOS, MMAP, PREFETCH, INDEX])
 
 =s traces
 
@@ -24,8 +28,10 @@ Reads packets from a file produced by `tcpdump -w FILENAME' or ToDump and
 emits them from the output, optionally stopping the driver when there are no
 more packets.
 
-FromDump also transparently reads gzip- and bzip2-compressed tcpdump files, if
-you have zcat(1) and bzcat(1) installed.
+FromDump also transparently reads gzip-, bzip2-, and zstd-compressed tcpdump
+files.  When Click was built with zlib or libzstd, it decompresses gzip and
+zstd files itself, using a read-ahead thread in multithreaded drivers;
+otherwise, and for bzip2 files, it runs zcat(1), bzcat(1), or zstd(1).
 
 Keyword arguments are:
 
@@ -108,6 +114,33 @@ This can result in slightly better performance on some machines. FromDump's
 regular file discipline is pretty optimized, so the difference is often small
 in practice. Default is true on most operating systems, but false on Linux.
 
+=item DECOMPRESS_PIPE
+
+Boolean. If true, then FromDump always decompresses compressed files by
+running an external program, rather than in-process. Default is false.
+
+=item PREFETCH
+
+Integer. If nonzero, then FromDump reads and decodes the file on a separate
+thread, which keeps up to PREFETCH packets ready for output.  This overlaps
+file reading and decompression with packet processing; several FromDumps
+feeding a TimeSortedSched can then decode their files in parallel.  FromDump
+still emits packets in file order.  When the decoding thread falls behind,
+FromDump returns no packet rather than wait, and the decoding thread wakes
+FromDump's task (or downstream puller) when more packets are ready.  The
+C<filepos> handler is read-only when PREFETCH is set.  Requires
+multithreading support.  Default is 0.
+
+=item INDEX
+
+Boolean. If true, then FromDump uses a sparse index of packet timestamps to
+find the START or START_AFTER time without reading every packet before it.
+The index is cached beside the trace in a file named FILENAME.idx, and is
+built (or rebuilt, if the trace has changed) when FromDump first opens the
+file; if that file cannot be written, FromDump keeps the index in memory.
+The click-pcapindex(1) tool builds indexes ahead of time.  Only uncompressed
+regular files can be indexed.  Default is false.
+
 =back
 
 You can supply at most one of START and START_AFTER, and at most one of END,
@@ -163,6 +196,13 @@ cannot be determined (because the file was compressed, for example).
 
 Returns or sets FromDump's position in the (uncompressed) file, in bytes.
 
+=h seek_time write-only
+
+Text is an absolute timestamp.  Moves to the first packet at or after that
+time, as if it were the START time.  With INDEX, FromDump jumps near that
+packet; otherwise it reads forward from the beginning of the file.  Not
+available when PREFETCH is set.
+
 =h packet_filepos read-only
 
 Returns the (uncompressed) file position of the last packet emitted, in bytes.
@@ -183,8 +223,8 @@ the file by writing C<filepos>.
 
 =a
 
-ToDump, FromDevice.u, ToDevice.u, tcpdump(1), mmap(2), AggregateIPFlows,
-FromTcpdump */
+ToDump, FromDevice.u, ToDevice.u, tcpdump(1), mmap(2), click-pcapindex(1),
+AggregateIPFlows, FromTcpdump */
 
 class FromDump : public Element { public:
 
@@ -215,6 +255,7 @@ class FromDump : public Element { public:
     enum { BUFFER_SIZE = 32768, SAMPLING_SHIFT = 28 };
 
     FromFile _ff;
+    PcapIndex _index;
 
     Packet *_packet;
 
@@ -228,6 +269,7 @@ class FromDump : public Element { public:
     bool _last_time_relative : 1;
     bool _last_time_interval : 1;
     bool _active;
+    bool _use_index;
     unsigned _extra_pkthdr_crap;
     unsigned _sampling_prob;
     int _minor_version;
@@ -251,7 +293,43 @@ class FromDump : public Element { public:
     Timestamp _timing_offset;
     off_t _packet_filepos;
 
+    uint32_t _prefetch;
+#if HAVE_USER_MULTITHREAD
+    // Ring of decoded packets.  The decoding thread fills slots and the
+    // element empties them; each side publishes its position under
+    // _pf_lock once per batch, not once per packet.
+    struct PrefetchSlot {
+	Packet *p;
+	off_t filepos;
+    };
+    PrefetchSlot *_pf_ring;
+    uint32_t _pf_head;		// published by the element
+    uint32_t _pf_tail;		// published by the decoding thread
+    uint32_t _pf_read;		// element's next slot
+    uint32_t _pf_limit;		// element's known end of decoded slots
+    bool _pf_done;
+    bool _pf_stop;
+    bool _pf_started;
+    bool _pf_wake;		// element ran dry; decoding thread should wake it
+    bool _pf_starved;		// element's last prefetch_take() found no packet
+    int _pf_waiting;		// decoding thread is blocked on _pf_cond
+    pthread_mutex_t _pf_lock;
+    pthread_cond_t _pf_cond;
+    pthread_t _pf_thread;
+
+    static void *prefetch_thread(void *);
+    void prefetch_fill();
+    void prefetch_wake();
+    Packet *prefetch_take();
+#endif
+
+    bool read_packet_header(Timestamp &ts, int &len, int &caplen,
+			    int &skiplen, ErrorHandler *errh);
+    Packet *read_packet_data(const Timestamp &ts, int len, int caplen,
+			     int skiplen, ErrorHandler *errh);
+    int check_packet_times(const Timestamp &ts, ErrorHandler *errh);
     bool read_packet(ErrorHandler *);
+    int open_index(ErrorHandler *);
 
     void prepare_times(const Timestamp &);
     bool check_timing(Packet *p);
@@ -45,20 +45,24 @@
 #if TODEVICE_ALLOW_LINUX
 # include <sys/socket.h>
 # include <sys/ioctl.h>
+# include <sys/mman.h>
 # include <net/if.h>
-# include <net/if_packet.h>
 # include <features.h>
-# if __GLIBC__ >= 2 && __GLIBC_MINOR__ >= 1
-#  include <netpacket/packet.h>
-# else
-#  include <linux/if_packet.h>
+/* <linux/if_packet.h> rather than <netpacket/packet.h>, for TPACKET_V2 */
+# include <linux/if_packet.h>
+# ifdef TPACKET2_HDRLEN		/* TPACKET_V2 is an enum, not a macro */
+#  define TODEVICE_RING 1
+# endif
+# if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 14)
+#  define TODEVICE_SENDMMSG 1
 # endif
 #endif
 
 CLICK_DECLS
 
 ToDevice::ToDevice()
-    : _task(this), _timer(&_task), _q(0), _pulls(0)
+    : _task(this), _timer(&_task), _pulls(0),
+      _full_events(0), _nsends(0), _nsent(0)
 {
 #if TODEVICE_ALLOW_PCAP
     _pcap = 0;
@@ -68,6 +72,9 @@ ToDevice::ToDevice()
     _fd = -1;
     _my_fd = false;
 #endif
+#if TODEVICE_ALLOW_LINUX
+    _ring = 0;
+#endif
 }
 
 ToDevice::~ToDevice()
@@ -79,11 +86,19 @@ ToDevice::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     String method;
     _burst = 1;
+#if TODEVICE_ALLOW_LINUX
+    _ring_frames = 1024;
+    _ring_frame_size = 2048;
+#endif
     if (Args(conf, this, errh)
 	.read_mp("DEVNAME", _ifname)
 	.read("DEBUG", _debug)
 	.read("METHOD", WordArg(), method)
 	.read("BURST", _burst)
+#if TODEVICE_ALLOW_LINUX
+	.read("RING_FRAMES", _ring_frames)
+	.read("RING_FRAME_SIZE", _ring_frame_size)
+#endif
 	.complete() < 0)
 	return -1;
     if (!_ifname)
@@ -116,6 +131,8 @@ ToDevice::configure(Vector<String> &conf, ErrorHandler *errh)
 #if TODEVICE_ALLOW_LINUX
     else if (method == "LINUX")
 	_method = method_linux;
+    else if (method == "RING")
+	_method = method_ring;
 #endif
 #if TODEVICE_ALLOW_DEVBPF
     else if (method == "DEVBPF")
@@ -128,6 +145,18 @@ ToDevice::configure(Vector<String> &conf, ErrorHandler *errh)
     else
 	return errh->error("bad METHOD");
 
+#if TODEVICE_ALLOW_LINUX
+    if (_method == method_ring) {
+	if (_ring_frames == 0)
+	    return errh->error("RING_FRAMES out of range");
+# if TODEVICE_RING
+	if (_ring_frame_size < TPACKET_ALIGN(TPACKET2_HDRLEN + 14)
+	    || _ring_frame_size % TPACKET_ALIGNMENT != 0)
+	    return errh->error("RING_FRAME_SIZE out of range");
+# endif
+    }
+#endif
+
     return 0;
 }
 
@@ -186,7 +215,23 @@ ToDevice::initialize(ErrorHandler *errh)
 #endif
 
 #if TODEVICE_ALLOW_LINUX
-    if (_method == method_linux) {
+    if (_method == method_ring) {
+	_fd = FromDevice::open_packet_socket(_ifname, errh);
+	if (_fd < 0)
+	    return -1;
+	_my_fd = true;
+	if (open_ring(errh) < 0) {
+	    // Start over on a fresh socket.  The failed setup may have left
+	    // a TX ring attached, and the kernel would then send from the
+	    // (unmapped) ring instead of from send()'s buffer.
+	    close(_fd);
+	    _fd = FromDevice::open_packet_socket(_ifname, errh);
+	    if (_fd < 0)
+		return -1;
+	    errh->warning("falling back to METHOD LINUX");
+	    _method = method_linux;
+	}
+    } else if (_method == method_linux) {
 	FromDevice *fd = find_fromdevice();
 	if (fd && fd->linux_fd() >= 0)
 	    _fd = fd->linux_fd();
@@ -223,6 +268,12 @@ ToDevice::initialize(ErrorHandler *errh)
 void
 ToDevice::cleanup(CleanupStage)
 {
+    _q.kill();
+#if TODEVICE_ALLOW_LINUX
+    if (_ring)
+	munmap(_ring, _ring_size);
+    _ring = 0;
+#endif
 #if TODEVICE_ALLOW_PCAP
     if (_pcap && _my_pcap)
 	pcap_close(_pcap);
@@ -285,31 +336,170 @@ ToDevice::send_packet(Packet *p)
 	return errno ? -errno : -EINVAL;
 }
 
+#if TODEVICE_ALLOW_LINUX
+int
+ToDevice::open_ring(ErrorHandler *errh)
+{
+# if TODEVICE_RING
+    int version = TPACKET_V2;
+    if (setsockopt(_fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+	return errh->error("%s: PACKET_VERSION: %s", _ifname.c_str(), strerror(errno));
+    // Let the kernel skip malformed frames instead of stopping the ring.
+    int loss = 1;
+    if (setsockopt(_fd, SOL_PACKET, PACKET_LOSS, &loss, sizeof(loss)) < 0)
+	return errh->error("%s: PACKET_LOSS: %s", _ifname.c_str(), strerror(errno));
+
+    _ring_block_size = getpagesize();
+    while (_ring_block_size < _ring_frame_size)
+	_ring_block_size *= 2;
+    unsigned frames_per_block = _ring_block_size / _ring_frame_size;
+    unsigned block_nr = (_ring_frames + frames_per_block - 1) / frames_per_block;
+    _ring_frames = frames_per_block * block_nr;
+
+    struct tpacket_req req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = _ring_block_size;
+    req.tp_block_nr = block_nr;
+    req.tp_frame_size = _ring_frame_size;
+    req.tp_frame_nr = _ring_frames;
+    if (setsockopt(_fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0)
+	return errh->error("%s: PACKET_TX_RING: %s", _ifname.c_str(), strerror(errno));
+
+    _ring_size = (size_t) _ring_block_size * block_nr;
+    void *ring = mmap(0, _ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (ring == MAP_FAILED)
+	return errh->error("%s: mmap: %s", _ifname.c_str(), strerror(errno));
+    _ring = reinterpret_cast<unsigned char *>(ring);
+    _ring_frame = 0;
+    return 0;
+# else
+    return errh->error("TX rings not supported on this platform");
+# endif
+}
+
+int
+ToDevice::ring_send(PacketBatch &sent, int max)
+{
+# if TODEVICE_RING
+    unsigned frames_per_block = _ring_block_size / _ring_frame_size;
+    unsigned data_offset = TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+    int n = 0, r = 0;
+
+    while (n < max && !_q.empty()) {
+	unsigned char *frame = _ring + (size_t) (_ring_frame / frames_per_block) * _ring_block_size
+	    + (_ring_frame % frames_per_block) * _ring_frame_size;
+	struct tpacket2_hdr *h = reinterpret_cast<struct tpacket2_hdr *>(frame);
+	if (h->tp_status != TP_STATUS_AVAILABLE) {
+	    r = -ENOBUFS;
+	    break;
+	}
+	Packet *p = _q.front();
+	if (p->length() > _ring_frame_size - data_offset) {
+	    r = -EMSGSIZE;
+	    break;
+	}
+	memcpy(frame + data_offset, p->data(), p->length());
+	h->tp_len = p->length();
+	h->tp_status = TP_STATUS_SEND_REQUEST;
+	_ring_frame = (_ring_frame + 1 == _ring_frames ? 0 : _ring_frame + 1);
+	sent.push_back(_q.pop_front());
+	++n;
+    }
+
+    // The kernel reads the ring only from within send(), so one call
+    // transmits the whole burst.
+    if (n && send(_fd, 0, 0, MSG_DONTWAIT) < 0
+	&& errno != EAGAIN && errno != ENOBUFS && _debug)
+	click_chatter("%{element}: send: %s", this, strerror(errno));
+    return n ? n : r;
+# else
+    (void) sent, (void) max;
+    return -EINVAL;
+# endif
+}
+
+int
+ToDevice::mmsg_send(PacketBatch &sent, int max)
+{
+# if TODEVICE_SENDMMSG
+    enum { max_mmsg = 64 };
+    struct mmsghdr msgs[max_mmsg];
+    struct iovec iovs[max_mmsg];
+    if (max > max_mmsg)
+	max = max_mmsg;
+
+    int n = 0;
+    for (Packet *p = _q.front(); p && n < max; p = p->next(), ++n) {
+	iovs[n].iov_base = const_cast<unsigned char *>(p->data());
+	iovs[n].iov_len = p->length();
+	memset(&msgs[n].msg_hdr, 0, sizeof(msgs[n].msg_hdr));
+	msgs[n].msg_hdr.msg_iov = &iovs[n];
+	msgs[n].msg_hdr.msg_iovlen = 1;
+    }
+
+    int r = sendmmsg(_fd, msgs, n, 0);
+    if (r <= 0)
+	return errno ? -errno : -EINVAL;
+    for (int i = 0; i < r; ++i)
+	sent.push_back(_q.pop_front());
+    return r;
+# else
+    (void) sent, (void) max;
+    return -EINVAL;
+# endif
+}
+#endif
+
+/* Send packets from the front of _q, at most max.  Returns the number of
+   packets sent, or a negative errno if the first packet could not be sent;
+   that packet stays at the front of _q. */
+int
+ToDevice::send_batch(PacketBatch &sent, int max)
+{
+#if TODEVICE_ALLOW_LINUX
+    if (_method == method_ring)
+	return ring_send(sent, max);
+# if TODEVICE_SENDMMSG
+    if (_method == method_linux && max > 1 && _q.count() > 1) {
+	errno = 0;
+	return mmsg_send(sent, max);
+    }
+# endif
+#endif
+    int r = send_packet(_q.front());
+    if (r < 0)
+	return r;
+    sent.push_back(_q.pop_front());
+    return 1;
+}
+
 bool
 ToDevice::run_task(Task *)
 {
-    Packet *p = _q;
-    _q = 0;
+    PacketBatch sent;
     int count = 0, r = 0;
 
     do {
-	if (!p) {
+	if (_q.empty()) {
 	    ++_pulls;
-	    if (!(p = input(0).pull()))
+	    input(0).pull_batch(_burst - count, _q);
+	    if (_q.empty())
 		break;
 	}
-	if ((r = send_packet(p)) >= 0) {
+	if ((r = send_batch(sent, _burst - count)) > 0) {
 	    _backoff = 0;
-	    checked_output_push(0, p);
-	    ++count;
+	    count += r;
+	    ++_nsends;
+	    _nsent += r;
 	} else
 	    break;
     } while (count < _burst);
 
-    if (r == -ENOBUFS || r == -EAGAIN) {
-	assert(!_q);
-	_q = p;
+    if (!sent.empty())
+	checked_output_push_batch(0, sent);
 
+    if (r == -ENOBUFS || r == -EAGAIN) {
+	++_full_events;
 	if (!_backoff) {
 	    _backoff = 1;
 	    add_select(_fd, SELECT_WRITE);
@@ -325,10 +515,10 @@ ToDevice::run_task(Task *)
 	return count > 0;
     } else if (r < 0) {
 	click_chatter("ToDevice(%s): %s", _ifname.c_str(), strerror(-r));
-	checked_output_push(1, p);
+	checked_output_push(1, _q.pop_front());
     }
 
-    if (p || _signal)
+    if (r < 0 || count == _burst || !_q.empty() || _signal)
 	_task.fast_reschedule();
     return count > 0;
 }
@@ -353,7 +543,11 @@ ToDevice::read_param(Element *e, void *thunk)
     case h_pulls:
 	return String(td->_pulls);
     case h_q:
-	return String((bool) td->_q);
+	return String(!td->_q.empty());
+    case h_full_events:
+	return String(td->_full_events);
+    case h_avg_burst:
+	return String(td->_nsends ? (double) td->_nsent / td->_nsends : 0.);
     default:
 	return String();
     }
@@ -385,6 +579,8 @@ ToDevice::add_handlers()
     add_read_handler("pulls", read_param, h_pulls);
     add_read_handler("signal", read_param, h_signal);
     add_read_handler("q", read_param, h_q);
+    add_read_handler("full_events", read_param, h_full_events);
+    add_read_handler("avg_burst", read_param, h_avg_burst);
     add_write_handler("debug", write_param, h_debug);
 }
 
@@ -29,12 +29,33 @@ CLICK_DECLS
  * =item BURST
  *
  * Integer. Maximum number of packets to pull per scheduling. Defaults to 1.
+ * If the upstream element supports batch transfer (for example, Queue),
+ * up to BURST packets are pulled with a single call.  With METHOD LINUX,
+ * the packets are sent with a single sendmmsg() system call where
+ * available; with METHOD RING, they are copied into the transmit ring and
+ * the kernel is kicked once.
  *
  * =item METHOD
  *
  * Word. Defines the method ToDevice will use to write packets to the
- * device. Linux targets generally support PCAP and LINUX; other targets
- * support PCAP or, occasionally, other methods. Generally defaults to PCAP.
+ * device. Linux targets generally support PCAP, LINUX, and RING; other
+ * targets support PCAP or, occasionally, other methods. Generally defaults
+ * to PCAP.
+ *
+ * METHOD RING copies packets into a memory-mapped PACKET_TX_RING (TPACKET_V2)
+ * shared with the kernel.  If the ring cannot be set up, ToDevice warns and
+ * falls back to METHOD LINUX.
+ *
+ * =item RING_FRAMES
+ *
+ * Unsigned.  METHOD RING only.  Number of frames in the transmit ring.
+ * Defaults to 1024.
+ *
+ * =item RING_FRAME_SIZE
+ *
+ * Unsigned.  METHOD RING only.  Size of each transmit ring frame, including
+ * a small header; longer packets are emitted on output 1 (if it exists).
+ * Defaults to 2048.
  *
  * =item DEBUG
  *
@@ -44,6 +65,16 @@ CLICK_DECLS
  *
  * This element is only available at user level.
  *
+ * =h full_events read-only
+ *
+ * Returns the number of times ToDevice had to wait for the device because
+ * its transmit ring or socket buffer was full.
+ *
+ * =h avg_burst read-only
+ *
+ * Returns the average number of packets handed to the kernel per send
+ * system call (or transmit ring kick).
+ *
  * =n
  *
  * Packets sent via ToDevice should already have a link-level
@@ -113,11 +144,12 @@ class ToDevice : public Element { public:
 #if TODEVICE_ALLOW_LINUX || TODEVICE_ALLOW_DEVBPF || TODEVICE_ALLOW_PCAPFD
     int _fd;
 #endif
-    enum { method_linux, method_pcap, method_devbpf, method_pcapfd };
+    enum { method_linux, method_pcap, method_devbpf, method_pcapfd,
+	   method_ring };
     int _method;
     NotifierSignal _signal;
 
-    Packet *_q;
+    PacketBatch _q;
     int _burst;
 
     bool _debug;
@@ -129,10 +161,26 @@ class ToDevice : public Element { public:
 #endif
     int _backoff;
     int _pulls;
+    uint32_t _full_events;
+    uint32_t _nsends;
+    uint32_t _nsent;
+
+#if TODEVICE_ALLOW_LINUX
+    unsigned char *_ring;
+    size_t _ring_size;
+    unsigned _ring_frames;
+    unsigned _ring_frame_size;
+    unsigned _ring_block_size;
+    unsigned _ring_frame;
+    int open_ring(ErrorHandler *errh);
+    int ring_send(PacketBatch &sent, int max);
+    int mmsg_send(PacketBatch &sent, int max);
+#endif
 
-    enum { h_debug, h_signal, h_pulls, h_q };
+    enum { h_debug, h_signal, h_pulls, h_q, h_full_events, h_avg_burst };
     FromDevice *find_fromdevice() const;
     int send_packet(Packet *p);
+    int send_batch(PacketBatch &sent, int max);
     static int write_param(const String &in_s, Element *e, void *vparam, ErrorHandler *errh);
     static String read_param(Element *e, void *thunk);
 
@@ -31,15 +31,539 @@
 #include <click/packet_anno.hh>
 #include "fakepcap.hh"
 #include <click/userutils.hh>
+#include <click/straccum.hh>
+#include <unistd.h>
+#include <fcntl.h>
+#if HAVE_ZLIB
+# include <zlib.h>
+#endif
+#if HAVE_USER_MULTITHREAD
+# include <pthread.h>
+#endif
 CLICK_DECLS
 
+static void
+make_file_header(unsigned snaplen, int linktype, struct fake_pcap_file_header &h)
+{
+    h.magic = FAKE_PCAP_MAGIC;
+    h.version_major = FAKE_PCAP_VERSION_MAJOR;
+    h.version_minor = FAKE_PCAP_VERSION_MINOR;
+
+    h.thiszone = 0;		// timestamps are in GMT
+    h.sigfigs = 0;		// XXX accuracy of timestamps?
+    h.snaplen = snaplen;
+    h.linktype = linktype;
+}
+
+static uint32_t
+make_pkthdr(Packet *p, unsigned snaplen, bool extra_length,
+	    struct fake_pcap_pkthdr &ph)
+{
+    const Timestamp& ts = p->timestamp_anno();
+    if (!ts) {
+	Timestamp now = Timestamp::now();
+	ph.ts.tv.tv_sec = now.sec();
+	ph.ts.tv.tv_usec = now.usec();
+    } else {
+	ph.ts.tv.tv_sec = ts.sec();
+	ph.ts.tv.tv_usec = ts.usec();
+    }
+
+    unsigned to_write = p->length();
+    ph.len = to_write + (extra_length ? EXTRA_LENGTH_ANNO(p) : 0);
+    if (snaplen && to_write > snaplen)
+	to_write = snaplen;
+    ph.caplen = to_write;
+    return to_write;
+}
+
+
+/* ToDump::Writer is ToDump's buffered writer.  It formats records into a
+   large aligned buffer and writes the buffer with one write(2), optionally
+   through O_DIRECT or zlib, and rotates files by size or age.  In
+   multithreaded drivers with ASYNC, packets reach it through a bounded
+   queue of packet references drained by a writer thread. */
+
+class ToDump::Writer { public:
+
+    Writer(const ToDump *td);
+    ~Writer();
+
+    int open(ErrorHandler *errh);
+    void close();
+
+    int queue(Packet *p);
+    uint32_t queue_depth();
+
+  private:
+
+    enum { DIRECT_ALIGN = 4096 };
+
+    String _filename;
+    unsigned _snaplen;
+    int _linktype;
+    bool _extra_length;
+    bool _direct;
+    bool _async;
+    uint32_t _queue_size;
+#if HAVE_INT64_TYPES
+    uint64_t _rotate_size;
+    uint64_t _file_size;
+#else
+    uint32_t _rotate_size;
+    uint32_t _file_size;
+#endif
+    Timestamp _rotate_interval;
+
+    int _fd;
+    FILE *_pipe;
+    bool _direct_on;
+    int _file_index;
+    Timestamp _file_opened;
+    volatile bool _failed;
+
+    uint8_t *_buf;
+    uint32_t _buf_len;
+    uint32_t _cap;
+#if HAVE_ZLIB
+    bool _compress;
+    bool _z_init;
+    z_stream _z;
+    uint8_t *_zbuf;
+    uint32_t _zbuf_len;
+#endif
+
+#if HAVE_USER_MULTITHREAD
+    Packet **_ring;
+    uint32_t _head;
+    uint32_t _tail;
+    bool _stop;
+    bool _started;
+    bool _dirty;		// records written since the last flush
+    int _waiting;
+    pthread_mutex_t _lock;
+    pthread_cond_t _cond;
+    pthread_t _thread;
+
+    static void *writer_thread(void *);
+    void run();
+#endif
+
+    String file_name(int index) const;
+    int open_file(ErrorHandler *errh);
+    void close_file();
+    void record(Packet *p, const Timestamp &now);
+    void append(const void *data, uint32_t len);
+    void drain(bool finish, bool sync = false);
+    void output(uint8_t *data, uint32_t &len, bool finish);
+    void fail(const char *msg);
+
+};
+
+ToDump::Writer::Writer(const ToDump *td)
+    : _filename(td->_filename), _snaplen(td->_snaplen),
+      _linktype(td->_linktype), _extra_length(td->_extra_length),
+      _direct(td->_direct), _async(td->_async), _queue_size(td->_queue_size),
+      _rotate_size(td->_rotate_size), _file_size(0),
+      _rotate_interval(td->_rotate_interval), _fd(-1), _pipe(0),
+      _direct_on(false), _file_index(0), _failed(false), _buf(0), _buf_len(0)
+{
+    // whole aligned blocks, at least 64 KB
+    _cap = td->_buffer_size < 65536 ? 65536 : td->_buffer_size;
+    _cap = (_cap + DIRECT_ALIGN - 1) & ~(DIRECT_ALIGN - 1);
+#if HAVE_ZLIB
+    _compress = _z_init = false;
+    _zbuf = 0;
+    _zbuf_len = 0;
+#endif
+#if HAVE_USER_MULTITHREAD
+    _ring = 0;
+    _started = false;
+    pthread_mutex_init(&_lock, 0);
+    pthread_cond_init(&_cond, 0);
+#endif
+}
+
+ToDump::Writer::~Writer()
+{
+    close();
+    free(_buf);
+#if HAVE_ZLIB
+    free(_zbuf);
+    if (_z_init)
+	deflateEnd(&_z);
+#endif
+#if HAVE_USER_MULTITHREAD
+    delete[] _ring;
+    pthread_mutex_destroy(&_lock);
+    pthread_cond_destroy(&_cond);
+#endif
+}
+
+String
+ToDump::Writer::file_name(int index) const
+{
+    if (!_rotate_size && !_rotate_interval)
+	return _filename;
+    // number the file before its compression extension
+    int ext = _filename.length();
+    if (compressed_filename(_filename) > 0)
+	ext = _filename.find_right('.');
+    StringAccum sa;
+    sa << _filename.substring(0, ext) << '.' << index
+       << _filename.substring(ext);
+    return sa.take_string();
+}
+
+int
+ToDump::Writer::open_file(ErrorHandler *errh)
+{
+    String name = file_name(_file_index);
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#if HAVE_ZLIB
+    _compress = name.length() >= 3
+	&& memcmp(name.end() - 3, ".gz", 3) == 0;
+#endif
+    _direct_on = false;
+
+    if (_filename == "-")
+	_fd = STDOUT_FILENO;
+#if HAVE_ZLIB
+    else if (_compress)
+	_fd = ::open(name.c_str(), flags, 0666);
+#endif
+    else if (compressed_filename(name) > 0) {
+	if (!(_pipe = open_compress_pipe(name, errh)))
+	    return -1;
+	_fd = fileno(_pipe);
+    } else {
+#ifdef O_DIRECT
+	if (_direct) {
+	    // not every file system supports O_DIRECT
+	    if ((_fd = ::open(name.c_str(), flags | O_DIRECT, 0666)) >= 0)
+		_direct_on = true;
+	    else if (errno != EINVAL)
+		return errh->error("%s: %s", name.c_str(), strerror(errno));
+	}
+	if (_fd < 0)
+#endif
+	_fd = ::open(name.c_str(), flags, 0666);
+    }
+    if (_fd < 0)
+	return errh->error("%s: %s", name.c_str(), strerror(errno));
+
+#if HAVE_ZLIB
+    if (_compress && !_z_init) {
+	memset(&_z, 0, sizeof(_z));
+	if (deflateInit2(&_z, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	    return errh->error("%s: %s", name.c_str(), strerror(ENOMEM));
+	_z_init = true;
+    } else if (_compress)
+	deflateReset(&_z);
+#endif
+
+    _file_size = 0;
+    _file_opened = Timestamp::now();
+    struct fake_pcap_file_header h;
+    make_file_header(_snaplen, _linktype, h);
+    append(&h, sizeof(h));
+    _file_size += sizeof(h);
+    return 0;
+}
+
+void
+ToDump::Writer::close_file()
+{
+    if (_fd < 0)
+	return;
+    drain(true);
+    if (_pipe)
+	pclose(_pipe);
+    else if (_fd != STDOUT_FILENO)
+	::close(_fd);
+    _pipe = 0;
+    _fd = -1;
+}
+
+int
+ToDump::Writer::open(ErrorHandler *errh)
+{
+    void *buf;
+    if (posix_memalign(&buf, DIRECT_ALIGN, _cap) != 0)
+	return errh->error("out of memory");
+    _buf = reinterpret_cast<uint8_t *>(buf);
+#if HAVE_ZLIB
+    if (posix_memalign(&buf, DIRECT_ALIGN, _cap) != 0)
+	return errh->error("out of memory");
+    _zbuf = reinterpret_cast<uint8_t *>(buf);
+#endif
+
+    if (open_file(errh) < 0)
+	return -1;
+
+#if HAVE_USER_MULTITHREAD
+    if (_async) {
+	uint32_t n = 1;
+	while (n < _queue_size)
+	    n *= 2;
+	_queue_size = n;
+	_ring = new Packet *[n];
+	_head = _tail = 0;
+	_stop = _dirty = false;
+	_waiting = 0;
+	if (int err = pthread_create(&_thread, 0, writer_thread, this))
+	    return errh->error("pthread_create: %s", strerror(err));
+	_started = true;
+    }
+#endif
+    return 0;
+}
+
+/** @brief Write out every queued packet, stop the writer thread, and close
+ * the file. */
+void
+ToDump::Writer::close()
+{
+#if HAVE_USER_MULTITHREAD
+    if (_started) {
+	pthread_mutex_lock(&_lock);
+	_stop = true;
+	pthread_cond_signal(&_cond);
+	pthread_mutex_unlock(&_lock);
+	pthread_join(_thread, 0);
+	_started = false;
+    }
+#endif
+    close_file();
+}
+
+void
+ToDump::Writer::fail(const char *msg)
+{
+    if (!_failed)
+	click_chatter("ToDump(%s): %s", _filename.c_str(), msg);
+    _failed = true;
+}
+
+void
+ToDump::Writer::output(uint8_t *data, uint32_t &len, bool finish)
+{
+    uint32_t n = len;
+#ifdef O_DIRECT
+    if (_direct_on && !finish)
+	n &= ~(DIRECT_ALIGN - 1);
+    else if (_direct_on && (n & (DIRECT_ALIGN - 1))) {
+	// the final partial block cannot be written with O_DIRECT
+	int flags = fcntl(_fd, F_GETFL);
+	if (flags != -1)
+	    (void) fcntl(_fd, F_SETFL, flags & ~O_DIRECT);
+	_direct_on = false;
+    }
+#endif
+
+    uint32_t pos = 0;
+    while (pos < n && !_failed) {
+	ssize_t w = ::write(_fd, data + pos, n - pos);
+	if (w > 0)
+	    pos += w;
+	else if (w < 0 && errno != EINTR && errno != EAGAIN)
+	    fail(strerror(errno));
+    }
+
+    if (_failed)
+	len = 0;
+    else if (pos < len) {
+	memmove(data, data + pos, len - pos);
+	len -= pos;
+    } else
+	len = 0;
+}
+
+/* Write out the buffer.  Unless finish is true, data that cannot yet be
+   written, such as an O_DIRECT partial block, stays buffered.  If sync is
+   true, also flush the compressor, so the file ends with every record. */
+void
+ToDump::Writer::drain(bool finish, bool sync)
+{
+#if HAVE_ZLIB
+    if (_compress) {
+	int mode = (finish ? Z_FINISH : (sync ? Z_SYNC_FLUSH : Z_NO_FLUSH));
+	_z.next_in = _buf;
+	_z.avail_in = _buf_len;
+	int r;
+	do {
+	    _z.next_out = _zbuf + _zbuf_len;
+	    _z.avail_out = _cap - _zbuf_len;
+	    r = deflate(&_z, mode);
+	    _zbuf_len = _cap - _z.avail_out;
+	    if (_zbuf_len == _cap || r == Z_STREAM_END)
+		output(_zbuf, _zbuf_len, r == Z_STREAM_END);
+	} while (!_failed
+		 && (_z.avail_in || (finish && r != Z_STREAM_END)
+		     || (sync && _z.avail_out == 0)));
+	if (sync)
+	    output(_zbuf, _zbuf_len, false);
+	_buf_len = 0;
+	return;
+    }
+#else
+    (void) sync;
+#endif
+    output(_buf, _buf_len, finish);
+}
+
+void
+ToDump::Writer::append(const void *data, uint32_t len)
+{
+    const uint8_t *d = reinterpret_cast<const uint8_t *>(data);
+    while (len && !_failed) {
+	uint32_t n = _cap - _buf_len;
+	if (n > len)
+	    n = len;
+	memcpy(_buf + _buf_len, d, n);
+	_buf_len += n;
+	d += n;
+	len -= n;
+	if (_buf_len == _cap)
+	    drain(false);
+    }
+}
+
+void
+ToDump::Writer::record(Packet *p, const Timestamp &now)
+{
+    struct fake_pcap_pkthdr ph;
+    uint32_t to_write = make_pkthdr(p, _snaplen, _extra_length, ph);
+    uint32_t reclen = sizeof(ph) + to_write;
+
+    if ((_rotate_size && _file_size > sizeof(struct fake_pcap_file_header)
+	 && _file_size + reclen > _rotate_size)
+	|| (_rotate_interval && now - _file_opened >= _rotate_interval)) {
+	close_file();
+	++_file_index;
+	if (open_file(ErrorHandler::default_handler()) < 0) {
+	    fail("cannot open next file");
+	    return;
+	}
+    }
+
+    append(&ph, sizeof(ph));
+    append(p->data(), to_write);
+    _file_size += reclen;
+}
+
+/** @brief Queue @a p for writing, or write it now if there is no writer
+ * thread.
+ * @return 1 if the writer took @a p, 0 if the queue is full, or -1 if the
+ * writer has failed */
+int
+ToDump::Writer::queue(Packet *p)
+{
+    if (_failed)
+	return -1;
+#if HAVE_USER_MULTITHREAD
+    if (_started) {
+	pthread_mutex_lock(&_lock);
+	if (_tail - _head == _queue_size) {
+	    pthread_mutex_unlock(&_lock);
+	    return 0;
+	}
+	_ring[_tail & (_queue_size - 1)] = p;
+	++_tail;
+	if (_waiting)
+	    pthread_cond_signal(&_cond);
+	pthread_mutex_unlock(&_lock);
+	return 1;
+    }
+    pthread_mutex_lock(&_lock);
+#endif
+    record(p, _rotate_interval ? Timestamp::now() : Timestamp());
+#if HAVE_USER_MULTITHREAD
+    pthread_mutex_unlock(&_lock);
+#endif
+    p->kill();
+    return 1;
+}
+
+uint32_t
+ToDump::Writer::queue_depth()
+{
+#if HAVE_USER_MULTITHREAD
+    if (_started) {
+	pthread_mutex_lock(&_lock);
+	uint32_t depth = _tail - _head;
+	pthread_mutex_unlock(&_lock);
+	return depth;
+    }
+#endif
+    return 0;
+}
+
+#if HAVE_USER_MULTITHREAD
+void *
+ToDump::Writer::writer_thread(void *thunk)
+{
+    static_cast<Writer *>(thunk)->run();
+    return 0;
+}
+
+/* Write queued packets in batches.  When the queue stays empty for a
+   second, write out the buffer so that the file does not lag far behind
+   the capture.  Exits once stopped and drained. */
+void
+ToDump::Writer::run()
+{
+    while (1) {
+	pthread_mutex_lock(&_lock);
+	bool timed_out = false;
+	while (_head == _tail && !_stop && !timed_out) {
+	    ++_waiting;
+	    if (_dirty) {
+		struct timespec ts = (Timestamp::now() + Timestamp(1)).timespec();
+		timed_out = pthread_cond_timedwait(&_cond, &_lock, &ts) == ETIMEDOUT;
+	    } else
+		pthread_cond_wait(&_cond, &_lock);
+	    --_waiting;
+	}
+	uint32_t head = _head, tail = _tail;
+	bool stop = _stop;
+	pthread_mutex_unlock(&_lock);
+
+	if (head == tail) {
+	    if (stop)
+		return;
+	    drain(false, true);
+	    _dirty = false;
+	    continue;
+	}
+
+	Timestamp now = _rotate_interval ? Timestamp::now() : Timestamp();
+	for (; head != tail; ++head) {
+	    Packet *p = _ring[head & (_queue_size - 1)];
+	    if (!_failed)
+		record(p, now);
+	    p->kill();
+	}
+	_dirty = true;
+
+	pthread_mutex_lock(&_lock);
+	_head = tail;
+	pthread_mutex_unlock(&_lock);
+    }
+}
+#endif
+
+
 ToDump::ToDump()
-    : _fp(0), _count(0), _task(this), _use_encap_from(0)
+    : _fp(0), _writer(0), _count(0), _drops(0), _task(this),
+      _use_encap_from(0)
 {
 }
 
 ToDump::~ToDump()
 {
+    delete _writer;
 }
 
 int
@@ -50,6 +574,11 @@ ToDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _snaplen = 2000;
     _extra_length = true;
     _unbuffered = false;
+    _async = _direct = false;
+    _queue_size = 4096;
+    _buffer_size = 1048576;
+    _rotate_size = 0;
+    _rotate_interval = Timestamp();
 #if CLICK_NS
     bool per_node = false;
 #endif
@@ -61,6 +590,12 @@ ToDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("USE_ENCAP_FROM", AnyArg(), use_encap_from)
 	.read("EXTRA_LENGTH", _extra_length)
 	.read("UNBUFFERED", _unbuffered)
+	.read("ASYNC", _async)
+	.read("QUEUE", _queue_size)
+	.read("BUFFER", _buffer_size)
+	.read("DIRECT", _direct)
+	.read("ROTATE_SIZE", _rotate_size)
+	.read("ROTATE_INTERVAL", _rotate_interval)
 #if CLICK_NS
 	.read("PER_NODE", per_node)
 #endif
@@ -69,6 +604,12 @@ ToDump::configure(Vector<String> &conf, ErrorHandler *errh)
 
     if (_snaplen == 0)
 	_snaplen = 0xFFFFFFFFU;
+    if (use_writer() && _unbuffered)
+	return errh->error("UNBUFFERED is incompatible with the buffered writer");
+    if (_queue_size == 0 || _queue_size > 0x10000000)
+	return errh->error("QUEUE out of range");
+    if ((_rotate_size || _rotate_interval) && _filename == "-")
+	return errh->error("cannot rotate the standard output");
 
     if (use_encap_from && encap_type)
 	return errh->error("specify at most one of 'ENCAP' and 'USE_ENCAP_FROM'");
@@ -105,7 +646,8 @@ ToDump::hotswap_element() const
     if (Element *e = Element::hotswap_element())
 	if (ToDump *td = (ToDump *)e->cast("ToDump"))
 	    if (td->_filename == _filename
-		&& td->_linktype == _linktype)
+		&& td->_linktype == _linktype
+		&& td->use_writer() == use_writer())
 		return td;
     return 0;
 }
@@ -140,7 +682,15 @@ ToDump::initialize(ErrorHandler *errh)
     }
 
     // skip initialization if we're hotswapping later
-    if (!hotswap_element()) {
+    if (hotswap_element())
+	/* nothing */;
+    else if (use_writer()) {
+	_writer = new Writer(this);
+	if (_writer->open(errh) < 0)
+	    return -1;
+	if (_filename == "-")
+	    _filename = "<stdout>";
+    } else {
 
 	// prepare files
 	assert(!_fp);
@@ -160,15 +710,7 @@ ToDump::initialize(ErrorHandler *errh)
 	    setvbuf(_fp, (char *) 0, _IONBF, 0);
 
 	struct fake_pcap_file_header h;
-
-	h.magic = FAKE_PCAP_MAGIC;
-	h.version_major = FAKE_PCAP_VERSION_MAJOR;
-	h.version_minor = FAKE_PCAP_VERSION_MINOR;
-
-	h.thiszone = 0;		// timestamps are in GMT
-	h.sigfigs = 0;		// XXX accuracy of timestamps?
-	h.snaplen = _snaplen;
-	h.linktype = _linktype;
+	make_file_header(_snaplen, _linktype, h);
 
 	size_t wrote_header = fwrite(&h, sizeof(h), 1, _fp);
 	if (wrote_header != 1)
@@ -189,6 +731,8 @@ ToDump::take_state(Element *e, ErrorHandler *)
     ToDump *td = static_cast<ToDump *>(e); // result of hotswap_element()
     _fp = td->_fp;
     td->_fp = 0;
+    _writer = td->_writer;
+    td->_writer = 0;
 }
 
 void
@@ -197,28 +741,39 @@ ToDump::cleanup(CleanupStage)
     if (_fp && _fp != stdout)
 	fclose(_fp);
     _fp = 0;
+    delete _writer;
+    _writer = 0;
 }
 
+/* Hand p, which the writer may keep, to the buffered writer. */
 void
-ToDump::write_packet(Packet *p)
+ToDump::queue_packet(Packet *p)
 {
-    struct fake_pcap_pkthdr ph;
+    if (p && !p->timestamp_anno())
+	p->timestamp_anno().assign_now();
+    int r = (p ? _writer->queue(p) : 0);
+    if (r > 0)
+	_count++;
+    else {
+	if (r < 0)
+	    _active = false;
+	else
+	    _drops++;
+	if (p)
+	    p->kill();
+    }
+}
 
-    const Timestamp& ts = p->timestamp_anno();
-    if (!ts) {
-	Timestamp now = Timestamp::now();
-	ph.ts.tv.tv_sec = now.sec();
-	ph.ts.tv.tv_usec = now.usec();
-    } else {
-	ph.ts.tv.tv_sec = ts.sec();
-	ph.ts.tv.tv_usec = ts.usec();
+void
+ToDump::write_packet(Packet *p)
+{
+    if (_writer) {
+	queue_packet(p->clone());
+	return;
     }
 
-    unsigned to_write = p->length();
-    ph.len = to_write + (_extra_length ? EXTRA_LENGTH_ANNO(p) : 0);
-    if (_snaplen && to_write > _snaplen)
-	to_write = _snaplen;
-    ph.caplen = to_write;
+    struct fake_pcap_pkthdr ph;
+    unsigned to_write = make_pkthdr(p, _snaplen, _extra_length, ph);
 
     // XXX writing to pipe?
     if (fwrite(&ph, sizeof(ph), 1, _fp) == 0
@@ -234,9 +789,14 @@ ToDump::write_packet(Packet *p)
 void
 ToDump::push(int, Packet *p)
 {
-    if (_active)
-	write_packet(p);
-    checked_output_push(0, p);
+    if (_active && _writer && noutputs() == 0)
+	// the writer can have the packet itself
+	queue_packet(p);
+    else {
+	if (_active)
+	    write_packet(p);
+	checked_output_push(0, p);
+    }
 }
 
 Packet *
@@ -254,7 +814,9 @@ ToDump::run_task(Task *)
     if (!_active)
 	return false;
     Packet *p = input(0).pull();
-    if (p) {
+    if (p && _writer)
+	queue_packet(p);
+    else if (p) {
 	write_packet(p);
 	p->kill();
     } else if (!_signal)
@@ -263,7 +825,8 @@ ToDump::run_task(Task *)
     return p != 0;
 }
 
-enum { H_FILENAME = 0, H_COUNT = 1, H_RESET_COUNTS = 2 };
+enum { H_FILENAME = 0, H_COUNT = 1, H_RESET_COUNTS = 2, H_QUEUE_DEPTH = 3,
+       H_DROPS = 4 };
 
 String
 ToDump::read_handler(Element *e, void *thunk)
@@ -274,6 +837,10 @@ ToDump::read_handler(Element *e, void *thunk)
 	return td->_filename;
     case H_COUNT:
 	return String(td->_count);
+    case H_QUEUE_DEPTH:
+	return String(td->_writer ? td->_writer->queue_depth() : 0);
+    case H_DROPS:
+	return String(td->_drops);
     default:
 	return "<error>";
     }
@@ -283,7 +850,7 @@ int
 ToDump::write_handler(const String &, Element *e, void *, ErrorHandler *)
 {
     ToDump *td = static_cast<ToDump *>(e);
-    td->_count = 0;
+    td->_count = td->_drops = 0;
     return 0;
 }
 
@@ -292,6 +859,8 @@ ToDump::add_handlers()
 {
     add_read_handler("filename", read_handler, (void *)H_FILENAME);
     add_read_handler("count", read_handler, (void *)H_COUNT);
+    add_read_handler("queue_depth", read_handler, (void *)H_QUEUE_DEPTH);
+    add_read_handler("drops", read_handler, (void *)H_DROPS);
     add_write_handler("reset_counts", write_handler, (void *)H_RESET_COUNTS, Handler::BUTTON);
     if (input_is_pull(0) && noutputs() == 0)
 	add_task_handlers(&_task);
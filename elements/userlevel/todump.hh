@@ -11,7 +11,8 @@ CLICK_DECLS
 /*
 =c
 
-ToDump(FILENAME [, I<keywords> SNAPLEN, ENCAP, USE_ENCAP_FROM, EXTRA_LENGTH])
+ToDump(FILENAME [, I<keywords> SNAPLEN, ENCAP, USE_ENCAP_FROM, EXTRA_LENGTH,
+ASYNC, QUEUE, ROTATE_SIZE, ROTATE_INTERVAL, ...])
 
 =s traces
 
@@ -66,8 +67,52 @@ Boolean. Set to true if you want ToDump to use unbuffered IO when saving data to
 a file.  This is unlikely to work with compressed dump formats. Default is
 false.
 
+=item ASYNC
+
+Boolean. If true, ToDump hands packets to a writer thread instead of writing
+them itself, so a slow disk does not stall the threads that push packets to
+ToDump. Packets are queued by reference, not copied. The writer collects
+records into BUFFER-sized buffers and writes each with a single write(2).
+Requires a multithreaded driver (--enable-user-multithread); otherwise ToDump
+writes synchronously, but with the same buffering. Default is false.
+
+=item QUEUE
+
+Unsigned. With ASYNC, the number of packets that may wait for the writer
+thread. When the queue is full, ToDump does not record the packet, but
+counts it in the "drops" handler; the packet itself is still emitted.
+Default is 4096.
+
+=item BUFFER
+
+Unsigned. The size of the writer's buffer in bytes. Default is 1048576.
+
+=item DIRECT
+
+Boolean. If true, open the file with O_DIRECT, bypassing the page cache. Only
+whole buffer-aligned blocks are written this way; the final partial block is
+written normally. Ignored on file systems and platforms that do not support
+O_DIRECT. Default is false.
+
+=item ROTATE_SIZE
+
+Unsigned. If nonzero, start a new file when the current one would exceed this
+many bytes of (uncompressed) capture data. Default is 0.
+
+=item ROTATE_INTERVAL
+
+Timestamp. If nonzero, start a new file when the current one has been open
+this long. Default is 0.
+
 =back
 
+Setting any of ASYNC, DIRECT, ROTATE_SIZE, and ROTATE_INTERVAL selects
+ToDump's buffered writer. With rotation, the files are named by inserting a
+sequence number before FILENAME's compression extension, if any: for
+example, "trace.pcap.gz" becomes "trace.pcap.0.gz", "trace.pcap.1.gz", and so
+on. The buffered writer compresses ".gz" files in-process if Click was built
+with zlib, and pipes other compressed formats through an external program.
+
 This element is only available at user level.
 
 =n
@@ -80,7 +125,16 @@ Returns the number of packets emitted so far.
 
 =h reset_counts write-only
 
-Resets "count" to 0.
+Resets "count" and "drops" to 0.
+
+=h queue_depth read-only
+
+Returns the number of packets waiting for the writer thread.
+
+=h drops read-only
+
+Returns the number of packets not recorded because the writer's queue was
+full.
 
 =h filename read-only
 
@@ -123,12 +177,26 @@ class ToDump : public Element { public:
     bool _extra_length;
     bool _unbuffered;
 
+    class Writer;
+    Writer *_writer;
+    bool _async;
+    bool _direct;
+    uint32_t _queue_size;
+    uint32_t _buffer_size;
+#if HAVE_INT64_TYPES
+    uint64_t _rotate_size;
+#else
+    uint32_t _rotate_size;
+#endif
+    Timestamp _rotate_interval;
+
 #if HAVE_INT64_TYPES
     typedef uint64_t counter_t;
 #else
     typedef uint32_t counter_t;
 #endif
     counter_t _count;
+    counter_t _drops;
 
     Task _task;
     NotifierSignal _signal;
@@ -136,7 +204,11 @@ class ToDump : public Element { public:
 
     static String read_handler(Element *, void *);
     static int write_handler(const String &, Element *, void *, ErrorHandler *);
+    bool use_writer() const {
+	return _async || _direct || _rotate_size || _rotate_interval;
+    }
     void write_packet(Packet *);
+    void queue_packet(Packet *);
 
 };
 
@@ -26,6 +26,12 @@ class EtherAddress;
 # define CLICK_ELEMENT_DEPRECATED CLICK_DEPRECATED
 #endif
 
+// Userlevel drivers can profile port transfers at run time; see
+// Router::set_port_profiling().  CLICK_STATS >= 2 profiles every transfer.
+#if CLICK_USERLEVEL && !(CLICK_STATS >= 2)
+# define CLICK_PORT_PROFILE 1
+#endif
+
 class Element { public:
 
     Element();
@@ -36,6 +42,8 @@ class Element { public:
     virtual void push(int port, Packet *p);
     virtual Packet *pull(int port) CLICK_WARN_UNUSED_RESULT;
     virtual Packet *simple_action(Packet *p);
+    virtual void push_batch(int port, PacketBatch &batch);
+    virtual void pull_batch(int port, unsigned max, PacketBatch &batch);
 
     virtual bool run_task(Task *task);	// return true iff did useful work
     virtual void run_timer(Timer *timer);
@@ -46,6 +54,7 @@ class Element { public:
 #endif
 
     inline void checked_output_push(int port, Packet *p) const;
+    inline void checked_output_push_batch(int port, PacketBatch &batch) const;
 
     // ELEMENT CHARACTERISTICS
     virtual const char *class_name() const = 0;
@@ -207,6 +216,26 @@ class Element { public:
     virtual int llrpc(unsigned command, void* arg);
     int local_llrpc(unsigned command, void* arg);
 
+#if CLICK_PORT_PROFILE
+    /** @brief Transfer statistics for one port, collected while port
+     * profiling is on.
+     *
+     * Pushes are attributed to the receiving element's input port and pulls
+     * to the sending element's output port.  Cycle counts are measured for
+     * a sample of transfers and exclude cycles spent in nested transfers to
+     * other elements. */
+    struct PortProfile {
+	uint64_t calls;			///< push or pull calls
+	uint64_t packets;		///< packets transferred
+	uint64_t sampled_calls;		///< calls whose cycles were measured
+	uint64_t sampled_packets;	///< packets in sampled calls
+	uint64_t sampled_cycles;	///< own cycles in sampled calls
+    };
+
+    inline const PortProfile *port_profile(bool isoutput, int port) const;
+    static unsigned port_profile_interval;	// measure 1 in N transfers
+#endif
+
     class Port { public:
 
 	inline bool active() const;
@@ -216,6 +245,10 @@ class Element { public:
 	inline void push(Packet* p) const;
 	inline Packet* pull() const;
 
+	inline bool batch() const;
+	inline void push_batch(PacketBatch &batch) const;
+	inline void pull_batch(unsigned max, PacketBatch &batch) const;
+
 #if CLICK_STATS >= 1
 	unsigned npackets() const	{ return _packets; }
 #endif
@@ -224,6 +257,7 @@ class Element { public:
 
 	Element* _e;
 	int _port;
+	bool _batch;
 #if HAVE_BOUND_PORT_TRANSFER
 	union {
 	    void (*push)(Element *e, int port, Packet *p);
@@ -237,11 +271,19 @@ class Element { public:
 #if CLICK_STATS >= 2
 	Element* _owner;		// Whose input or output are we?
 #endif
+#if CLICK_PORT_PROFILE
+	PortProfile *_profile;		// Nonnull iff profiling: where to count
+	void profile_push(PortProfile *pp, Packet *p) const;
+	Packet *profile_pull(PortProfile *pp) const;
+	void profile_push_batch(PortProfile *pp, PacketBatch &batch) const;
+	void profile_pull_batch(PortProfile *pp, unsigned max, PacketBatch &batch) const;
+#endif
 
 	inline Port();
 	inline void assign(Element *owner, Element *e, int port, bool isoutput);
 
 	friend class Element;
+	friend class Router;
 
     };
 
@@ -262,6 +304,9 @@ class Element { public:
 
     Router* _router;
     int _eindex;
+#if CLICK_PORT_PROFILE
+    PortProfile *_port_profiles;	// inputs, then outputs; or null
+#endif
 
 #if CLICK_STATS >= 2
     // STATISTICS
@@ -509,17 +554,39 @@ Element::input_is_push(int port) const
 	&& !_ports[0][port].active();
 }
 
+#if CLICK_PORT_PROFILE
+/** @brief Return the profile of port @a port, or null.
+ *
+ * Returns null unless port profiling has been turned on at least once for
+ * this element's router.  Push inputs and pull outputs collect statistics;
+ * the profiles of other ports stay zero.
+ *
+ * @sa Router::set_port_profiling */
+inline const Element::PortProfile *
+Element::port_profile(bool isoutput, int port) const
+{
+    if (_port_profiles && (unsigned) port < (unsigned) nports(isoutput))
+	return &_port_profiles[port + (isoutput ? nports(false) : 0)];
+    else
+	return 0;
+}
+#endif
+
 #if CLICK_STATS >= 2
 # define PORT_ASSIGN(o) _packets = 0; _owner = (o)
+#elif CLICK_STATS >= 1 && CLICK_PORT_PROFILE
+# define PORT_ASSIGN(o) _packets = 0; _profile = 0; (void) (o)
 #elif CLICK_STATS >= 1
 # define PORT_ASSIGN(o) _packets = 0; (void) (o)
+#elif CLICK_PORT_PROFILE
+# define PORT_ASSIGN(o) _profile = 0; (void) (o)
 #else
 # define PORT_ASSIGN(o) (void) (o)
 #endif
 
 inline
 Element::Port::Port()
-    : _e(0), _port(-2)
+    : _e(0), _port(-2), _batch(false)
 {
     PORT_ASSIGN(0);
 }
@@ -530,6 +597,7 @@ Element::Port::assign(Element *owner, Element *e, int port, bool isoutput)
     PORT_ASSIGN(owner);
     _e = e;
     _port = port;
+    _batch = e && e->flag_value('B') > 0;
     (void) isoutput;
 #if HAVE_BOUND_PORT_TRANSFER
     if (e) {
@@ -615,6 +683,12 @@ Element::Port::push(Packet* p) const
     _e->_xfer_own_cycles += own_delta;
     _owner->_child_cycles += all_delta;
 #else
+# if CLICK_PORT_PROFILE
+    if (PortProfile *pp = _profile) {
+	profile_push(pp, p);
+	return;
+    }
+# endif
 # if HAVE_BOUND_PORT_TRANSFER
     _bound.push(_e, _port, p);
 # else
@@ -659,6 +733,16 @@ Element::Port::pull() const
     _e->_xfer_own_cycles += own_delta;
     _owner->_child_cycles += all_delta;
 #else
+# if CLICK_PORT_PROFILE
+    if (PortProfile *pp = _profile) {
+	Packet *p = profile_pull(pp);
+#  if CLICK_STATS >= 1
+	if (p)
+	    ++_packets;
+#  endif
+	return p;
+    }
+# endif
 # if HAVE_BOUND_PORT_TRANSFER
     Packet *p = _bound.pull(_e, _port);
 # else
@@ -672,6 +756,92 @@ Element::Port::pull() const
     return p;
 }
 
+/** @brief Returns whether the connected element processes batches natively.
+ *
+ * True iff this port is active() and the element it connects to declares the
+ * <tt>B</tt> flag, meaning it overrides Element::push_batch() or
+ * Element::pull_batch().  This is determined when the router is
+ * initialized.  Sources can check batch() to decide whether collecting
+ * packets into a PacketBatch is worthwhile.
+ *
+ * @sa push_batch, pull_batch */
+inline bool
+Element::Port::batch() const
+{
+    return _batch;
+}
+
+/** @brief Push the packets in @a batch over this port.
+ *
+ * If the connected element processes batches natively (see batch()), passes
+ * the whole batch to its @link Element::push_batch() push_batch() @endlink
+ * function.  Otherwise pushes the packets one at a time, in order, as if by
+ * push().  Either way, @a batch is empty on return.
+ *
+ * When CLICK_STATS >= 2, packets are always transferred one at a time so
+ * that per-element cycle counts stay accurate.
+ *
+ * This port must be an active() push output port. */
+inline void
+Element::Port::push_batch(PacketBatch &batch) const
+{
+    assert(_e);
+#if CLICK_STATS < 2
+    if (_batch) {
+# if CLICK_STATS >= 1
+	_packets += batch.count();
+# endif
+# if CLICK_PORT_PROFILE
+	if (PortProfile *pp = _profile) {
+	    profile_push_batch(pp, batch);
+	    return;
+	}
+# endif
+	_e->push_batch(_port, batch);
+	return;
+    }
+#endif
+    while (Packet *p = batch.pop_front())
+	push(p);
+}
+
+/** @brief Pull up to @a max packets over this port, appending them to
+ * @a batch.
+ *
+ * If the connected element processes batches natively (see batch()), calls
+ * its @link Element::pull_batch() pull_batch() @endlink function.  Otherwise
+ * calls pull() until it returns null or @a max packets have been received.
+ * Fewer than @a max packets, including none, may be appended.
+ *
+ * This port must be an active() pull input port. */
+inline void
+Element::Port::pull_batch(unsigned max, PacketBatch &batch) const
+{
+    assert(_e);
+#if CLICK_STATS < 2
+    if (_batch) {
+# if CLICK_STATS >= 1
+	unsigned old_count = batch.count();
+# endif
+# if CLICK_PORT_PROFILE
+	if (PortProfile *pp = _profile)
+	    profile_pull_batch(pp, max, batch);
+	else
+# endif
+	_e->pull_batch(_port, max, batch);
+# if CLICK_STATS >= 1
+	_packets += batch.count() - old_count;
+# endif
+	return;
+    }
+#endif
+    for (; max > 0; --max)
+	if (Packet *p = pull())
+	    batch.push_back(p);
+	else
+	    break;
+}
+
 /** @brief Push packet @a p to output @a port, or kill it if @a port is out of
  * range.
  *
@@ -693,6 +863,26 @@ Element::checked_output_push(int port, Packet* p) const
 	p->kill();
 }
 
+/** @brief Push the packets in @a batch to output @a port, or kill them if
+ * @a port is out of range.
+ *
+ * @param port output port number
+ * @param batch packets to push
+ *
+ * The batch analogue of checked_output_push().  @a batch is empty on return.
+ *
+ * @note It is invalid to call checked_output_push_batch() on a pull output
+ * @a port.
+ */
+inline void
+Element::checked_output_push_batch(int port, PacketBatch &batch) const
+{
+    if ((unsigned) port < (unsigned) noutputs())
+	_ports[1][port].push_batch(batch);
+    else
+	batch.kill();
+}
+
 #undef PORT_ASSIGN
 CLICK_ENDDECLS
 #endif
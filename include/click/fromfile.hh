@@ -54,6 +54,10 @@ class FromFile { public:
 
     enum { BUFFER_SIZE = 32768 };
 
+#if HAVE_ZLIB || HAVE_ZSTD
+    class Decompressor;
+#endif
+
     int _fd;
     const uint8_t *_buffer;
     uint32_t _pos;
@@ -73,12 +77,19 @@ class FromFile { public:
 
     String _filename;
     FILE *_pipe;
+    bool _decompress_pipe;
+#if HAVE_ZLIB || HAVE_ZSTD
+    Decompressor *_decompress;
+#endif
     off_t _file_offset;
     String _landmark_pattern;
     int _lineno;
 
 #ifdef ALLOW_MMAP
     int read_buffer_mmap(ErrorHandler *);
+#endif
+#if HAVE_ZLIB || HAVE_ZSTD
+    int read_buffer_decompress(ErrorHandler *);
 #endif
     int read_buffer(ErrorHandler *);
     bool read_packet(ErrorHandler *);
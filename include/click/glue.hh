@@ -236,6 +236,16 @@ template <typename T> int click_qsort(T *base, size_t n)
 
 // OTHER
 
+/** @brief Hint that the cache line containing @a p will soon be read. */
+inline void click_prefetch(const void *p)
+{
+#if __GNUC__
+    __builtin_prefetch(p);
+#else
+    (void) p;
+#endif
+}
+
 #if CLICK_LINUXMODULE
 
 extern "C" {
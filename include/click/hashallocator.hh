@@ -21,6 +21,14 @@ class HashAllocator { public:
 
     void swap(HashAllocator &x);
 
+    // Occupancy statistics.  Memory is never returned to the system, so
+    // capacity() - nallocated() slots sit idle after a burst of objects.
+    size_t nallocated() const {
+	return _nallocated;
+    }
+    size_t capacity() const;
+    size_t memory_usage() const;
+
   private:
 
     struct link {
@@ -46,6 +54,7 @@ class HashAllocator { public:
     link *_free;
     buffer *_buffer;
     size_t _size;
+    size_t _nallocated;
 
     void *hard_allocate();
 
@@ -76,10 +85,12 @@ inline void *HashAllocator::allocate()
 #ifdef VALGRIND_MAKE_MEM_DEFINED
 	VALGRIND_MAKE_MEM_UNDEFINED(&l->next, sizeof(l->next));
 #endif
+	++_nallocated;
 	return l;
     } else if (_buffer && _buffer->pos < _buffer->maxpos) {
 	void *data = reinterpret_cast<char *>(_buffer) + _buffer->pos;
 	_buffer->pos += _size;
+	++_nallocated;
 #ifdef VALGRIND_MEMPOOL_ALLOC
 	VALGRIND_MEMPOOL_ALLOC(this, data, _size);
 #endif
@@ -93,6 +104,7 @@ inline void HashAllocator::deallocate(void *p)
     if (p) {
 	reinterpret_cast<link *>(p)->next = _free;
 	_free = reinterpret_cast<link *>(p);
+	--_nallocated;
 #ifdef VALGRIND_MEMPOOL_FREE
 	VALGRIND_MEMPOOL_FREE(this, p);
 #endif
@@ -277,7 +277,9 @@ IP6Address::operator=(const click_in6_addr &a)
 inline uint32_t
 IP6Address::hashcode() const
 {
-    return (data32()[2] << 1) + data32()[3];
+    // Include the network half: routing prefixes rarely reach the host half.
+    const uint32_t *ai = data32();
+    return (ai[0] << 3) + (ai[1] << 2) + (ai[2] << 1) + ai[3];
 }
 
 #if !CLICK_TOOL
@@ -37,10 +37,19 @@ class Master { public:
     int remove_signal_handler(int signo, Router *router, String handler);
     void process_signals(RouterThread *thread);
     static void signal_handler(int signo);	// not really public
+
+    int set_thread_cpus(const Vector<int> &cpus, ErrorHandler *errh);
+    void numa_node_threads(int node, Vector<int> &threads) const;
+    static int available_cpus(Vector<int> &cpus);
+    static int cpu_numa_node(int cpu);
+    static int device_numa_node(const String &ifname);
 #endif
 
     void kill_router(Router*);
 
+    inline uint32_t start_grace_period();
+    bool grace_period_elapsed(uint32_t gp) const;
+
 #if CLICK_NS
     void initialize_ns(simclick_node_t *simnode);
     simclick_node_t *simnode() const		{ return _simnode; }
@@ -76,6 +85,7 @@ class Master { public:
     Spinlock _master_lock;
 #endif
     atomic_uint32_t _master_paused;
+    atomic_uint32_t _rcu_epoch;		// even; see start_grace_period()
     inline void lock_master();
     inline void unlock_master();
 
@@ -139,6 +149,27 @@ Master::wake_somebody()
     _threads[1]->wake();
 }
 
+inline void
+RouterThread::rcu_quiescent()
+{
+    uint32_t epoch = _master->_rcu_epoch.value();
+    if (_rcu_epoch != epoch) {
+	// finish this iteration's reads before announcing the new epoch
+	click_fence();
+	_rcu_epoch = epoch;
+    }
+}
+
+inline void
+RouterThread::rcu_online()
+{
+    if (_rcu_epoch & 1) {
+	_rcu_epoch = _master->_rcu_epoch.value();
+	// announce the epoch before reading any shared structure
+	click_fence();
+    }
+}
+
 #if CLICK_USERLEVEL
 inline void
 RouterThread::run_signals()
@@ -217,6 +248,23 @@ Master::unlock_master()
 #endif
 }
 
+/** @brief Start a read-copy-update grace period.
+ * @return grace period token for grace_period_elapsed()
+ *
+ * Call this after unlinking an object that RouterThreads might still be
+ * reading without locks.  Once grace_period_elapsed() returns true for the
+ * token, every thread has passed through a quiescent state -- the top of its
+ * driver loop, or blocking in the operating system -- so no thread can still
+ * hold a reference to the object and it may be freed. */
+inline uint32_t
+Master::start_grace_period()
+{
+    click_fence();
+    uint32_t gp = _rcu_epoch.fetch_and_add(2) + 2;
+    click_fence();
+    return gp;
+}
+
 inline void
 Master::unpause()
 {
@@ -28,6 +28,10 @@ CLICK_DECLS
 
 class IP6Address;
 class WritablePacket;
+class StringAccum;
+#if HAVE_CLICK_PACKET_POOL && HAVE_MULTITHREAD
+struct PacketPool;
+#endif
 
 class Packet { public:
 
@@ -61,6 +65,14 @@ class Packet { public:
 
     static void static_cleanup();
 
+#if HAVE_CLICK_PACKET_POOL
+    static void set_pool_size(unsigned size, bool prewarm = false);
+    static void prewarm_pool();
+    static void flush_pool_returns();
+    static void set_pool_numa_node(int node);
+    static void pool_report(StringAccum &sa);
+#endif
+
     inline void kill();
 
     inline bool shared() const;
@@ -682,6 +694,9 @@ class Packet { public:
 # if CLICK_NS
     SimPacketinfoWrapper _sim_packetinfo;
 # endif
+# if HAVE_CLICK_PACKET_POOL && HAVE_MULTITHREAD
+    PacketPool *_pool;	/* per-thread pool that allocated this header */
+# endif
 #endif
 
     inline Packet() {
@@ -2351,5 +2366,128 @@ WritablePacket::buffer_data() const
 }
 /** @endcond never */
 
+/** @class PacketBatch
+ * @brief A list of packets transferred as a unit.
+ *
+ * A PacketBatch chains packets together through their next() annotations,
+ * letting Element::push_batch() and Element::pull_batch() move many packets
+ * with one function call.  A batch owns the packets it contains: whoever
+ * holds the batch must eventually push, kill, or otherwise account for each
+ * of them.  PacketBatch objects are usually allocated on the stack.
+ *
+ * Packets in a batch must not be in any other list, since the batch uses
+ * their next() annotations.  Packets removed from a batch have their next()
+ * annotations cleared.
+ *
+ * @sa Element::push_batch, Element::pull_batch */
+class PacketBatch { public:
+
+    /** @brief Construct an empty batch. */
+    PacketBatch()
+	: _head(0), _tail(0), _count(0) {
+    }
+
+    /** @brief Return true iff the batch contains no packets. */
+    bool empty() const {
+	return !_head;
+    }
+    /** @brief Return the number of packets in the batch. */
+    unsigned count() const {
+	return _count;
+    }
+    /** @brief Return the first packet in the batch, or null if empty. */
+    Packet *front() const {
+	return _head;
+    }
+    /** @brief Return the last packet in the batch, or null if empty. */
+    Packet *back() const {
+	return _tail;
+    }
+
+    inline void push_back(Packet *p);
+    inline void push_front(Packet *p);
+    inline Packet *pop_front();
+    inline void append(PacketBatch &x);
+    inline void kill();
+
+  private:
+
+    Packet *_head;
+    Packet *_tail;
+    unsigned _count;
+
+    PacketBatch(const PacketBatch &x);
+    PacketBatch &operator=(const PacketBatch &x);
+
+};
+
+/** @brief Add packet @a p to the end of the batch.
+ * @pre @a p is not null and not part of any other list */
+inline void
+PacketBatch::push_back(Packet *p)
+{
+    p->set_next(0);
+    if (_tail)
+	_tail->set_next(p);
+    else
+	_head = p;
+    _tail = p;
+    ++_count;
+}
+
+/** @brief Add packet @a p to the front of the batch.
+ * @pre @a p is not null and not part of any other list */
+inline void
+PacketBatch::push_front(Packet *p)
+{
+    p->set_next(_head);
+    _head = p;
+    if (!_tail)
+	_tail = p;
+    ++_count;
+}
+
+/** @brief Remove and return the first packet in the batch.
+ *
+ * Returns null if the batch is empty. */
+inline Packet *
+PacketBatch::pop_front()
+{
+    Packet *p = _head;
+    if (p) {
+	_head = p->next();
+	p->set_next(0);
+	if (!_head)
+	    _tail = 0;
+	--_count;
+    }
+    return p;
+}
+
+/** @brief Move all packets from @a x to the end of this batch.
+ * @post @a x.empty() */
+inline void
+PacketBatch::append(PacketBatch &x)
+{
+    if (!x._head)
+	return;
+    if (_tail)
+	_tail->set_next(x._head);
+    else
+	_head = x._head;
+    _tail = x._tail;
+    _count += x._count;
+    x._head = x._tail = 0;
+    x._count = 0;
+}
+
+/** @brief Kill all packets in the batch, leaving it empty. */
+inline void
+PacketBatch::kill()
+{
+    while (Packet *p = pop_front())
+	p->kill();
+}
+
 CLICK_ENDDECLS
 #endif
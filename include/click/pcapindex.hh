@@ -0,0 +1,81 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PCAPINDEX_HH
+#define CLICK_PCAPINDEX_HH
+#include <click/string.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+class ErrorHandler;
+
+/** @class PcapIndex
+ * @brief Sparse timestamp index of a tcpdump file.
+ *
+ * A PcapIndex records, about once every interval() bytes of an uncompressed
+ * tcpdump file, the offset of a packet record and the largest timestamp of
+ * any packet before that record.  Those timestamps never decrease, so
+ * lookup() can binary-search for the record from which a reader should scan
+ * to find the first packet at or after a given time; every packet it skips
+ * is earlier than that time, even if the trace is not quite sorted.
+ *
+ * Indexes are cached beside their traces, in the file named by
+ * index_filename().  The cached file records the trace's size and
+ * modification time, and load() ignores an index whose trace has changed.
+ * Loaded indexes are mapped into memory rather than read when possible. */
+class PcapIndex { public:
+
+    enum { DEFAULT_INTERVAL = 1048576 };
+
+    PcapIndex();
+    ~PcapIndex()			{ clear(); }
+
+    bool ok() const			{ return _hdr != 0; }
+    bool empty() const			{ return !_hdr || !_hdr->nentries; }
+    int nentries() const		{ return _hdr ? _hdr->nentries : 0; }
+    uint32_t interval() const		{ return _hdr ? _hdr->interval : 0; }
+    Timestamp first_timestamp() const;
+
+    static String index_filename(const String &filename) {
+	return filename + ".idx";
+    }
+
+    int load(const String &filename, ErrorHandler *errh);
+    int build(const String &filename, uint32_t interval, ErrorHandler *errh);
+    int save();
+    void clear();
+
+    off_t lookup(const Timestamp &ts) const;
+
+  private:
+
+    struct Header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t trace_size;
+	int64_t trace_mtime;
+	uint32_t interval;
+	uint32_t nentries;
+	int32_t first_sec;
+	uint32_t first_usec;
+    };
+
+    struct Entry {
+	uint64_t offset;
+	int32_t sec;		// largest timestamp before offset
+	uint32_t usec;
+    };
+
+    enum { MAGIC = 0x58494350, VERSION = 1 };
+
+    String _filename;
+    const Header *_hdr;
+    const Entry *_entries;
+    uint64_t *_mem;
+    void *_mmap;
+    size_t _mmap_len;
+
+    PcapIndex(const PcapIndex &);
+    PcapIndex &operator=(const PcapIndex &);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,161 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_RCU_HH
+#define CLICK_RCU_HH
+#include <click/master.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/** @file <click/rcu.hh>
+ * @brief Deferred reclamation for read-copy-update data structures.
+ */
+
+/** @class RCUCollector
+ * @brief Reclaims objects once no RouterThread can still be reading them.
+ *
+ * In a read-copy-update (RCU) data structure, readers on RouterThreads take no
+ * locks.  A writer never changes memory a reader might be using; it builds
+ * new objects, publishes them with a single pointer or index store, and hands
+ * the objects they replace to defer().  The collector calls the reclaim
+ * function for each deferred object after a grace period, once every running
+ * RouterThread has passed through a quiescent state.  (See
+ * Master::start_grace_period().)  A reclaim function may free memory or
+ * return space to a free list for reuse.
+ *
+ * Objects are reclaimed in the order they were deferred.  Until initialize()
+ * is called, defer() reclaims objects immediately: an element that is still
+ * being configured has no concurrent readers.
+ *
+ * RCUCollector does no locking of its own.  Writers must serialize calls to
+ * defer(), collect(), and flush(), typically with the lock they use to
+ * serialize updates.
+ */
+class RCUCollector { public:
+
+    typedef void (*reclaim_function)(void *thunk, uintptr_t arg);
+
+    RCUCollector()
+	: _master(0), _head(0) {
+    }
+
+    /** @brief Destroy the collector, reclaiming all deferred objects. */
+    ~RCUCollector() {
+	flush();
+    }
+
+    /** @brief Start deferring reclamation to grace periods on @a master. */
+    void initialize(Master *master) {
+	_master = master;
+    }
+
+    /** @brief Return true iff no reclamation is pending. */
+    bool empty() const {
+	return _head == _items.size();
+    }
+
+    inline void defer(reclaim_function f, void *thunk, uintptr_t arg = 0);
+
+    /** @brief Delete @a x after a grace period. */
+    template <typename T> void defer_delete(T *x) {
+	defer(delete_hook<T>, x);
+    }
+
+    /** @brief Delete[] @a x after a grace period. */
+    template <typename T> void defer_delete_array(T *x) {
+	defer(delete_array_hook<T>, x);
+    }
+
+    inline bool collect();
+    inline void flush();
+
+  private:
+
+    struct Item {
+	uint32_t gp;
+	reclaim_function f;
+	void *thunk;
+	uintptr_t arg;
+    };
+
+    Master *_master;
+    Vector<Item> _items;
+    int _head;
+
+    inline void reclaim_front();
+
+    template <typename T> static void delete_hook(void *thunk, uintptr_t) {
+	delete static_cast<T *>(thunk);
+    }
+    template <typename T> static void delete_array_hook(void *thunk, uintptr_t) {
+	delete[] static_cast<T *>(thunk);
+    }
+
+};
+
+/** @brief Call @a f(@a thunk, @a arg) after a grace period.
+ *
+ * The caller must already have unpublished whatever @a f reclaims, so that
+ * threads starting new reads cannot find it. */
+inline void
+RCUCollector::defer(reclaim_function f, void *thunk, uintptr_t arg)
+{
+    if (!_master) {
+	f(thunk, arg);
+	return;
+    }
+    Item it;
+    it.gp = _master->start_grace_period();
+    it.f = f;
+    it.thunk = thunk;
+    it.arg = arg;
+    _items.push_back(it);
+}
+
+inline void
+RCUCollector::reclaim_front()
+{
+    // f may call defer(), so copy the item before calling it
+    Item it = _items[_head];
+    ++_head;
+    it.f(it.thunk, it.arg);
+}
+
+/** @brief Reclaim the deferred objects whose grace periods have elapsed.
+ * @return true iff reclamation is still pending */
+inline bool
+RCUCollector::collect()
+{
+    // Grace periods elapse in order, so if the newest has elapsed, all have.
+    if (_head < _items.size()
+	&& _master->grace_period_elapsed(_items.back().gp)) {
+	for (int n = _items.size(); _head < n; )
+	    reclaim_front();
+    } else
+	while (_head < _items.size()
+	       && _master->grace_period_elapsed(_items[_head].gp))
+	    reclaim_front();
+
+    if (_head == _items.size()) {
+	_items.clear();
+	_head = 0;
+    } else if (_head > 64 && _head > _items.size() / 2) {
+	_items.erase(_items.begin(), _items.begin() + _head);
+	_head = 0;
+    }
+    return !empty();
+}
+
+/** @brief Reclaim all deferred objects now.
+ *
+ * Only call flush() when no thread can be reading the objects, for instance
+ * from Element::cleanup(). */
+inline void
+RCUCollector::flush()
+{
+    while (_head < _items.size())
+	reclaim_front();
+    _items.clear();
+    _head = 0;
+}
+
+CLICK_ENDDECLS
+#endif
@@ -103,6 +103,14 @@ class Router { public:
     void unparse_connections(StringAccum& sa, const String& indent = String()) const;
 
     String element_ports_string(const Element *e) const;
+
+#if CLICK_PORT_PROFILE
+    // PORT PROFILING
+    void set_port_profiling(bool on);
+    bool port_profiling() const			{ return _port_profiling; }
+    void reset_port_profiles();
+    void port_profile_report(StringAccum &sa, bool json) const;
+#endif
     //@}
 
     // INITIALIZATION
@@ -231,6 +239,9 @@ class Router { public:
     mutable bool _conn_sorted : 1;
     bool _have_configuration : 1;
     volatile int _running;
+#if CLICK_PORT_PROFILE
+    bool _port_profiling;
+#endif
 
     atomic_uint32_t _refcount;
 
@@ -78,7 +78,30 @@ class RouterThread : private TaskLink { public:
 
 #if CLICK_USERLEVEL
     inline void run_signals();
+
+    /** @brief Return the CPU this thread is bound to, or -1 if unbound. */
+    int cpu() const			{ return _cpu; }
+    /** @brief Return the NUMA node of cpu(), or -1 if unknown. */
+    int numa_node() const		{ return _numa_node; }
+    /** @brief Return the CPUs the kernel lets this thread run on.
+     *
+     * The set is read back from the kernel when the driver starts, so it
+     * reflects the placement actually in effect.  Returns an empty string
+     * before the driver starts or if the system cannot report affinity. */
+    const String &cpu_affinity() const	{ return _cpu_affinity; }
+#endif
+
+#if HAVE_MULTITHREAD
+    static void set_work_stealing(bool on)	{ work_stealing = on; }
+    static bool work_stealing_enabled()	{ return work_stealing; }
 #endif
+    /** @brief Return the number of tasks this thread has stolen. */
+    uint32_t steals() const		{ return _steals.value(); }
+    /** @brief Return the number of tasks stolen from this thread. */
+    uint32_t tasks_stolen() const	{ return _tasks_stolen; }
+    /** @brief Return the number of steal requests this thread has made. */
+    uint32_t steal_requests() const	{ return _steal_requests; }
+    Timestamp idle_time() const;
 
     enum { S_PAUSED, S_BLOCKED, S_TIMERWAIT,
 	   S_LOCKSELECT, S_LOCKTASKS,
@@ -127,6 +150,7 @@ class RouterThread : private TaskLink { public:
 
     Master *_master;
     int _id;
+    volatile uint32_t _rcu_epoch;	// last Master epoch seen; odd if offline
 
 #if CLICK_LINUXMODULE
     struct task_struct *_linux_task;
@@ -138,9 +162,29 @@ class RouterThread : private TaskLink { public:
     atomic_uint32_t _task_blocker;
     atomic_uint32_t _task_blocker_waiting;
 
+    // work stealing
+    atomic_uint32_t _steals;
+    uint32_t _tasks_stolen;
+    uint32_t _steal_requests;
+    Timestamp _idle_time;
+    Timestamp _idle_start;
+#if HAVE_MULTITHREAD
+    atomic_uint32_t _steal_request;	// thief's thread ID + 1, or 0
+    RouterThread *_steal_victim;	// thread we asked for a task
+    unsigned _migratable_load;		// migratable task runs in last pass
+    volatile bool _idle;
+    static bool work_stealing;
+    static atomic_uint32_t idle_threads;
+#endif
+
     TimerSet _timers;
 #if CLICK_USERLEVEL
     SelectSet _selects;
+
+    // placement
+    int _cpu;
+    int _numa_node;
+    String _cpu_affinity;
 #endif
 
 #if CLICK_LINUXMODULE
@@ -208,6 +252,11 @@ class RouterThread : private TaskLink { public:
     inline void run_tasks(int ntasks);
     inline void process_pending();
     inline void run_os();
+#if HAVE_MULTITHREAD
+    void try_steal();
+    void check_steal();
+    Task *steal_candidate();
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     void client_set_tickets(int client, int tickets);
     inline void client_update_pass(int client, const Timestamp &before);
@@ -216,6 +265,12 @@ class RouterThread : private TaskLink { public:
     void task_reheapify_from(int pos, Task*);
 #endif
     inline bool current_thread_is_running() const;
+    inline void rcu_quiescent();
+    inline void rcu_offline();
+    inline void rcu_online();
+#if CLICK_USERLEVEL
+    void bind_cpu();
+#endif
     void request_stop();
     inline void request_go();
 
@@ -456,9 +511,19 @@ RouterThread::set_thread_state(int state)
 #endif
 }
 
+inline void
+RouterThread::rcu_offline()
+{
+    click_fence();
+    _rcu_epoch |= 1;
+}
+
 inline void
 RouterThread::set_thread_state_for_blocking(int delay_type)
 {
+    // a thread that may sleep holds no RCU-protected references
+    if (delay_type)
+	rcu_offline();
     if (delay_type < 0)
 	set_thread_state(S_BLOCKED);
     else
@@ -28,6 +28,9 @@
 #  error "kqueue is not supported on this system, try --enable-select"
 # endif
 #endif
+#if !HAVE_SYS_EPOLL_H
+# undef HAVE_ALLOW_EPOLL
+#endif
 CLICK_DECLS
 class Element;
 class Router;
@@ -53,6 +56,9 @@ class SelectSet { public:
 
     inline void fence();
 
+    enum { epoll_off = 0, epoll_level = 1, epoll_edge = 2 };
+    static void set_epoll_mode(int mode);
+
   private:
 
     struct SelectorInfo {
@@ -70,6 +76,11 @@ class SelectSet { public:
 #if HAVE_ALLOW_KQUEUE
     int _kqueue;
 #endif
+#if HAVE_ALLOW_EPOLL
+    int _epoll;
+    bool _epoll_edge;
+    static int epoll_mode;
+#endif
 #if !HAVE_ALLOW_POLL
     struct pollfd {
 	int fd;
@@ -93,6 +104,10 @@ class SelectSet { public:
 #if HAVE_ALLOW_KQUEUE
     void run_selects_kqueue(RouterThread *thread);
 #endif
+#if HAVE_ALLOW_EPOLL
+    void update_epoll(int fd, int old_events, int new_events);
+    void run_selects_epoll(RouterThread *thread);
+#endif
 #if HAVE_ALLOW_POLL
     void run_selects_poll(RouterThread *thread);
 #else
@@ -250,6 +250,24 @@ class Task : private TaskLink { public:
      */
     void move_thread(int new_thread_id);
 
+    /** @brief Return true iff the task may be stolen by other threads.
+     * @sa set_migratable */
+    inline bool migratable() const {
+	return _migratable;
+    }
+
+    /** @brief Set whether the task may be stolen by other threads.
+     *
+     * When the driver runs with work stealing enabled, a thread with no
+     * runnable tasks may take a migratable task from a busy sibling; the
+     * task's home thread changes to the thief as if by move_thread().  Only
+     * mark a task migratable if its callback, and everything the callback
+     * reaches, is safe to run on any thread.  Tasks are not migratable by
+     * default. */
+    inline void set_migratable(bool migratable) {
+	_migratable = migratable;
+    }
+
 
 #if HAVE_STRIDE_SCHED
     inline int tickets() const;
@@ -298,6 +316,7 @@ class Task : private TaskLink { public:
 
     TaskCallback _hook;
     void *_thunk;
+    bool _migratable;
 
 #if HAVE_ADAPTIVE_SCHEDULER
     unsigned _runs;
@@ -368,7 +387,7 @@ Task::Task(TaskCallback f, void *user_data)
 #if HAVE_STRIDE_SCHED
       _stride(0), _tickets(-1),
 #endif
-      _hook(f), _thunk(user_data),
+      _hook(f), _thunk(user_data), _migratable(false),
 #if HAVE_ADAPTIVE_SCHEDULER
       _runs(0), _work_done(0),
 #endif
@@ -390,7 +409,7 @@ Task::Task(Element* e)
 #if HAVE_STRIDE_SCHED
       _stride(0), _tickets(-1),
 #endif
-      _hook(0), _thunk(e),
+      _hook(0), _thunk(e), _migratable(false),
 #if HAVE_ADAPTIVE_SCHEDULER
       _runs(0), _work_done(0),
 #endif
@@ -12,6 +12,18 @@ class Timer;
 class TimerSet { public:
 
     TimerSet();
+    explicit TimerSet(uint32_t wheel_tick_usec);
+    ~TimerSet();
+
+    /** @brief Set the timer structure used by new TimerSets.
+     * @param tick_usec timing wheel tick in microseconds, or 0 for the heap
+     *
+     * Must be called before the Master is created. */
+    static void set_default_wheel_tick(uint32_t tick_usec);
+
+    /** @brief Return this TimerSet's timing wheel tick in microseconds, or
+     * 0 if it stores timers in a heap. */
+    uint32_t wheel_tick_usec() const		{ return _wheel_tick_usec; }
 
     Timestamp timer_expiry_steady() const	{ return _timer_expiry; }
     inline Timestamp timer_expiry_steady_adjusted() const;
@@ -20,6 +32,9 @@ class TimerSet { public:
 #endif
 
     Timer *next_timer();			// useful for benchmarking
+    bool schedule_timer(Timer *t, const Timestamp &when);
+    void unschedule_timer(Timer *t);
+    void run_timers_until(RouterThread *thread, const Timestamp &now);
 
     unsigned max_timer_stride() const		{ return _max_timer_stride; }
     unsigned timer_stride() const		{ return _timer_stride; }
@@ -71,10 +86,37 @@ class TimerSet { public:
     Timestamp _timer_check;
     uint32_t _timer_check_reports;
 
+    // hashed hierarchical timing wheel, used instead of _timer_heap when
+    // _wheel_tick_usec != 0
+    enum { wheel_bits = 8, wheel_size = 1 << wheel_bits,
+	   wheel_mask = wheel_size - 1, wheel_levels = 4 };
+    Timer **_wheel;
+    uint64_t _wheel_base;
+    uint32_t _wheel_tick_usec;
+    uint32_t _wheel_level_count[wheel_levels];
+    uint32_t _wheel_count;
+
+    static uint32_t default_wheel_tick_usec;
+
+    void initialize(uint32_t wheel_tick_usec);
+
+    inline uint64_t wheel_tick(const Timestamp &ts) const;
+    inline Timestamp wheel_time(uint64_t tick) const;
+    void wheel_place(Timer *t);
+    void wheel_remove(Timer *t);
+    void wheel_cascade(int level, unsigned slot);
+    Timer *wheel_first() const;
+    void set_wheel_expiry();
+
     inline void run_one_timer(Timer *);
+    void run_heap_timers(RouterThread *thread);
+    void run_wheel_timers(RouterThread *thread);
+    void run_timers_locked(RouterThread *thread, const Timestamp &now);
 
     void set_timer_expiry() {
-	if (_timer_heap.size())
+	if (_wheel)
+	    set_wheel_expiry();
+	else if (_timer_heap.size())
 	    _timer_expiry = _timer_heap.at_u(0).expiry_s;
 	else
 	    _timer_expiry = Timestamp();
@@ -108,6 +150,18 @@ TimerSet::timer_expiry_steady_adjusted() const
     return e;
 }
 
+inline uint64_t
+TimerSet::wheel_tick(const Timestamp &ts) const
+{
+    return int_divide((uint64_t) ts.usecval(), _wheel_tick_usec);
+}
+
+inline Timestamp
+TimerSet::wheel_time(uint64_t tick) const
+{
+    return Timestamp::make_usec((Timestamp::value_type) (tick * _wheel_tick_usec));
+}
+
 inline void
 TimerSet::lock_timers()
 {
@@ -153,7 +207,11 @@ inline Timer *
 TimerSet::next_timer()
 {
     lock_timers();
-    Timer *t = _timer_heap.empty() ? 0 : _timer_heap.at_u(0).t;
+    Timer *t;
+    if (_wheel)
+	t = wheel_first();
+    else
+	t = _timer_heap.empty() ? 0 : _timer_heap.at_u(0).t;
     unlock_timers();
     return t;
 }
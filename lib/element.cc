@@ -418,6 +418,9 @@ void BetterIPCounter3::push(int port, Packet *p) {
 /** @brief Construct an Element. */
 Element::Element()
     : _router(0), _eindex(-1)
+#if CLICK_PORT_PROFILE
+    , _port_profiles(0)
+#endif
 {
     nelements_allocated++;
     _ports[0] = _ports[1] = &_inline_ports[0];
@@ -435,6 +438,9 @@ Element::~Element()
 	delete[] _ports[0];
     if (_ports[1] < _inline_ports || _ports[1] > _inline_ports + INLINE_PORTS)
 	delete[] _ports[1];
+#if CLICK_PORT_PROFILE
+    delete[] _port_profiles;
+#endif
 }
 
 // CHARACTERISTICS
@@ -1208,6 +1214,11 @@ Element::processing_vector(int* in_v, int* out_v, ErrorHandler* errh) const
  * RoundRobinSched has 0 inputs, are idle rather than busy, and waste no
  * CPU time.</dd>
  *
+ * <dt><tt>B</tt></dt> <dd>This element processes packet batches natively:
+ * it overrides push_batch() and/or pull_batch().  Ports connected to a
+ * <tt>B</tt>-flagged element pass whole PacketBatch objects to it; other
+ * ports split batches into individual push() or pull() calls.</dd>
+ *
  * </dl>
  */
 const char*
@@ -1226,7 +1237,10 @@ int
 Element::flag_value(int flag) const
 {
     assert(flag > 0 && flag < 256);
-    for (const unsigned char *data = reinterpret_cast<const unsigned char *>(flags()); *data; ++data)
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(flags());
+    while (isspace(*data))
+	++data;
+    while (*data) {
 	if (*data == flag) {
 	    if (data[1] && isdigit(data[1])) {
 		int value = 0;
@@ -1235,9 +1249,13 @@ Element::flag_value(int flag) const
 		return value;
 	    } else
 		return 1;
-	} else
-	    while (isspace(*data))
-		++data;
+	}
+	// skip to the next flag setting
+	while (*data && !isspace(*data))
+	    ++data;
+	while (isspace(*data))
+	    ++data;
+    }
     return -1;
 }
 
@@ -2866,6 +2884,56 @@ Element::pull(int port)
     return p;
 }
 
+/** @brief Push a batch of packets onto push input @a port.
+ *
+ * @param port the input port number on which the packets arrive
+ * @param batch the packets
+ *
+ * An upstream element transferred the packets in @a batch to this element
+ * over a push connection.  push_batch() must account for every packet in the
+ * batch, just as push() accounts for a single packet, and must leave @a
+ * batch empty.  Packets are in arrival order.
+ *
+ * The default implementation calls push() on each packet in turn.  Elements
+ * that override push_batch() should also declare the <tt>B</tt> flag (see
+ * flags()); otherwise upstream ports will deliver packets one at a time and
+ * the override will not be called.
+ *
+ * @sa Port::push_batch, PacketBatch
+ */
+void
+Element::push_batch(int port, PacketBatch &batch)
+{
+    while (Packet *p = batch.pop_front())
+	push(port, p);
+}
+
+/** @brief Pull up to @a max packets from pull output @a port.
+ *
+ * @param port the output port number receiving the pull request
+ * @param max maximum number of packets to return
+ * @param batch batch to which packets are appended
+ *
+ * A downstream element requested up to @a max packets from this element over
+ * a pull connection.  This element should append between 0 and @a max
+ * packets to @a batch.  Packets already in @a batch must not be touched.
+ *
+ * The default implementation calls pull() until it returns null or @a max
+ * packets have been appended.  As with push_batch(), elements that override
+ * pull_batch() should declare the <tt>B</tt> flag.
+ *
+ * @sa Port::pull_batch, PacketBatch
+ */
+void
+Element::pull_batch(int port, unsigned max, PacketBatch &batch)
+{
+    for (; max > 0; --max)
+	if (Packet *p = pull(port))
+	    batch.push_back(p);
+	else
+	    break;
+}
+
 /** @brief Process a packet for a simple packet filter.
  *
  * @param p the input packet
@@ -2953,4 +3021,118 @@ Element::run_timer(Timer *timer)
     (void) timer;
 }
 
+
+// PORT PROFILING
+
+#if CLICK_PORT_PROFILE
+/* Each thread measures one transfer in every 'port_profile_interval', plus
+   every transfer nested inside a measured one, so that a measured transfer's
+   own cycles can exclude its children's.  'profile_child' accumulates the
+   cycles of nested measured transfers.  The gap between measurements is
+   random, with mean 'port_profile_interval', so that periodic call patterns
+   (a source alternating between two outputs, say) can't hide a port. */
+# if HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+#  define PROFILE_THREAD_LOCAL __thread
+# else
+#  define PROFILE_THREAD_LOCAL
+# endif
+static PROFILE_THREAD_LOCAL unsigned profile_countdown;
+static PROFILE_THREAD_LOCAL unsigned profile_depth;
+static PROFILE_THREAD_LOCAL click_cycles_t profile_child;
+unsigned Element::port_profile_interval = 64;
+
+namespace {
+struct ProfileSample {
+    click_cycles_t start;
+    click_cycles_t saved_child;
+
+    inline bool begin() {
+	if (!profile_depth) {
+	    if (profile_countdown > 1) {
+		--profile_countdown;
+		return false;
+	    }
+	    unsigned interval = Element::port_profile_interval;
+	    profile_countdown = 1 + click_random() % (2 * interval - 1);
+	}
+	++profile_depth;
+	saved_child = profile_child;
+	profile_child = 0;
+	start = click_get_cycles();
+	return true;
+    }
+
+    inline void end(Element::PortProfile *pp, unsigned npackets) {
+	click_cycles_t all = click_get_cycles() - start;
+	pp->sampled_cycles += all - profile_child;
+	++pp->sampled_calls;
+	pp->sampled_packets += npackets;
+	profile_child = saved_child + all;
+	--profile_depth;
+    }
+};
+}
+
+void
+Element::Port::profile_push(PortProfile *pp, Packet *p) const
+{
+    ++pp->calls;
+    ++pp->packets;
+    ProfileSample s;
+    bool sampled = s.begin();
+# if HAVE_BOUND_PORT_TRANSFER
+    _bound.push(_e, _port, p);
+# else
+    _e->push(_port, p);
+# endif
+    if (sampled)
+	s.end(pp, 1);
+}
+
+Packet *
+Element::Port::profile_pull(PortProfile *pp) const
+{
+    ProfileSample s;
+    bool sampled = s.begin();
+# if HAVE_BOUND_PORT_TRANSFER
+    Packet *p = _bound.pull(_e, _port);
+# else
+    Packet *p = _e->pull(_port);
+# endif
+    if (sampled)
+	s.end(pp, p ? 1 : 0);
+    ++pp->calls;
+    if (p)
+	++pp->packets;
+    return p;
+}
+
+void
+Element::Port::profile_push_batch(PortProfile *pp, PacketBatch &batch) const
+{
+    unsigned n = batch.count();
+    ++pp->calls;
+    pp->packets += n;
+    ProfileSample s;
+    bool sampled = s.begin();
+    _e->push_batch(_port, batch);
+    if (sampled)
+	s.end(pp, n);
+}
+
+void
+Element::Port::profile_pull_batch(PortProfile *pp, unsigned max, PacketBatch &batch) const
+{
+    unsigned old_count = batch.count();
+    ProfileSample s;
+    bool sampled = s.begin();
+    _e->pull_batch(_port, max, batch);
+    unsigned n = batch.count() - old_count;
+    if (sampled)
+	s.end(pp, n);
+    ++pp->calls;
+    pp->packets += n;
+}
+#endif
+
 CLICK_ENDDECLS
@@ -31,6 +31,15 @@
 #ifdef ALLOW_MMAP
 # include <sys/mman.h>
 #endif
+#if HAVE_ZLIB
+# include <zlib.h>
+#endif
+#if HAVE_ZSTD
+# include <zstd.h>
+#endif
+#if (HAVE_ZLIB || HAVE_ZSTD) && HAVE_USER_MULTITHREAD
+# include <pthread.h>
+#endif
 CLICK_DECLS
 
 FromFile::FromFile()
@@ -38,7 +47,11 @@ FromFile::FromFile()
 #ifdef ALLOW_MMAP
       _mmap(true),
 #endif
-      _filename(), _pipe(0), _landmark_pattern("%f"), _lineno(0)
+      _filename(), _pipe(0), _decompress_pipe(false),
+#if HAVE_ZLIB || HAVE_ZSTD
+      _decompress(0),
+#endif
+      _landmark_pattern("%f"), _lineno(0)
 {
 }
 
@@ -52,6 +65,7 @@ FromFile::configure_keywords(Vector<String> &conf, Element *e, ErrorHandler *err
 #endif
     if (Args(e, errh).bind(conf)
 	.read("MMAP", mmap)
+	.read("DECOMPRESS_PIPE", _decompress_pipe)
 	.consume() < 0)
 	return -1;
 #ifdef ALLOW_MMAP
@@ -116,6 +130,391 @@ FromFile::warning(ErrorHandler *errh, const char *format, ...) const
     return r;
 }
 
+#if HAVE_ZLIB || HAVE_ZSTD
+/* FromFile::Decompressor decodes gzip and zstd files in-process, so reading
+   a compressed trace costs neither a zcat process nor a copy through a pipe.
+   In multithreaded drivers a read-ahead thread decompresses the next buffer
+   while FromFile consumes the current one. */
+
+class FromFile::Decompressor { public:
+
+    enum { f_gzip = 1, f_zstd = 2 };
+
+    static int format(const uint8_t *data, uint32_t len);
+
+    Decompressor(int fd, int format);
+    ~Decompressor();
+
+    int start(const uint8_t *data, uint32_t len, String &error);
+    void stop();
+    int rewind(String &error);
+
+    int next(WritablePacket *&p, uint32_t &len, String &error);
+
+  private:
+
+    enum { IN_SIZE = 65536, OUT_SIZE = 262144 };
+
+    int _fd;
+    int _format;
+    bool _stream_init;
+#if HAVE_ZLIB
+    z_stream _z;
+#endif
+#if HAVE_ZSTD
+    ZSTD_DStream *_zstd;
+#endif
+
+    uint8_t *_in;
+    uint32_t _in_pos;
+    uint32_t _in_len;
+    bool _in_eof;
+    bool _frame_done;
+    bool _next_member;		// no output yet from a later gzip member
+    String _error;
+
+#if HAVE_USER_MULTITHREAD
+    struct Slot {
+	WritablePacket *p;
+	int len;		// < 0 on error, 0 at end of file
+    };
+    Slot _slot[2];
+    bool _full[2];
+    int _fill;			// slot the thread is filling
+    int _take;			// slot next() takes
+    bool _stop;
+    bool _started;
+    pthread_mutex_t _lock;
+    pthread_cond_t _cond;
+    pthread_t _thread;
+
+    static void *read_ahead_thread(void *);
+    void read_ahead();
+#endif
+
+    int init_stream();
+    int refill();
+    int decompress(uint8_t *out, uint32_t cap);
+    WritablePacket *make_buffer(int &len);
+
+};
+
+int
+FromFile::Decompressor::format(const uint8_t *data, uint32_t len)
+{
+#if HAVE_ZLIB
+    if (len >= 3 && data[0] == 037 && data[1] == 0213)
+	return f_gzip;
+#endif
+#if HAVE_ZSTD
+    if (len >= 4 && data[0] == 0x28 && data[1] == 0xB5 && data[2] == 0x2F
+	&& data[3] == 0xFD)
+	return f_zstd;
+#endif
+    (void) data, (void) len;
+    return 0;
+}
+
+FromFile::Decompressor::Decompressor(int fd, int format)
+    : _fd(fd), _format(format), _stream_init(false),
+#if HAVE_ZSTD
+      _zstd(0),
+#endif
+      _in(new uint8_t[IN_SIZE]), _in_pos(0), _in_len(0), _in_eof(false),
+      _frame_done(false), _next_member(false)
+{
+#if HAVE_USER_MULTITHREAD
+    _started = false;
+#endif
+}
+
+FromFile::Decompressor::~Decompressor()
+{
+    stop();
+#if HAVE_ZLIB
+    if (_format == f_gzip && _stream_init)
+	inflateEnd(&_z);
+#endif
+#if HAVE_ZSTD
+    if (_zstd)
+	ZSTD_freeDStream(_zstd);
+#endif
+    delete[] _in;
+}
+
+int
+FromFile::Decompressor::init_stream()
+{
+#if HAVE_ZLIB
+    if (_format == f_gzip) {
+	if (_stream_init)
+	    return inflateReset(&_z) == Z_OK ? 0 : -1;
+	memset(&_z, 0, sizeof(_z));
+	if (inflateInit2(&_z, 16 + MAX_WBITS) != Z_OK)
+	    return -1;
+    }
+#endif
+#if HAVE_ZSTD
+    if (_format == f_zstd) {
+	if (!_zstd && !(_zstd = ZSTD_createDStream()))
+	    return -1;
+	if (ZSTD_isError(ZSTD_initDStream(_zstd)))
+	    return -1;
+    }
+#endif
+    _stream_init = true;
+    return 0;
+}
+
+/** @brief Start decompressing.
+ * @param data compressed data already read from the file descriptor
+ * @param len length of @a data */
+int
+FromFile::Decompressor::start(const uint8_t *data, uint32_t len, String &error)
+{
+    if (init_stream() < 0) {
+	error = "out of memory";
+	return -1;
+    }
+    assert(len <= IN_SIZE);
+    if (len)
+	memcpy(_in, data, len);
+    _in_pos = 0;
+    _in_len = len;
+    _in_eof = _frame_done = _next_member = false;
+    _error = String();
+
+#if HAVE_USER_MULTITHREAD
+    _full[0] = _full[1] = false;
+    _fill = _take = 0;
+    _stop = false;
+    pthread_mutex_init(&_lock, 0);
+    pthread_cond_init(&_cond, 0);
+    if (int err = pthread_create(&_thread, 0, read_ahead_thread, this)) {
+	pthread_mutex_destroy(&_lock);
+	pthread_cond_destroy(&_cond);
+	error = strerror(err);
+	return -1;
+    }
+    _started = true;
+#endif
+    return 0;
+}
+
+/** @brief Stop the read-ahead thread, if any, and free its buffers. */
+void
+FromFile::Decompressor::stop()
+{
+#if HAVE_USER_MULTITHREAD
+    if (_started) {
+	pthread_mutex_lock(&_lock);
+	_stop = true;
+	pthread_cond_broadcast(&_cond);
+	pthread_mutex_unlock(&_lock);
+	pthread_join(_thread, 0);
+	for (int i = 0; i < 2; ++i)
+	    if (_full[i] && _slot[i].p)
+		_slot[i].p->kill();
+	pthread_mutex_destroy(&_lock);
+	pthread_cond_destroy(&_cond);
+	_started = false;
+    }
+#endif
+}
+
+/** @brief Restart decompression from the beginning of the file. */
+int
+FromFile::Decompressor::rewind(String &error)
+{
+    stop();
+    if (lseek(_fd, 0, SEEK_SET) == (off_t) -1) {
+	error = strerror(errno);
+	return -1;
+    }
+    return start(0, 0, error);
+}
+
+int
+FromFile::Decompressor::refill()
+{
+    while (1) {
+	ssize_t got = ::read(_fd, _in, IN_SIZE);
+	if (got >= 0) {
+	    _in_pos = 0;
+	    _in_len = got;
+	    _in_eof = (got == 0);
+	    return got;
+	} else if (errno != EINTR && errno != EAGAIN) {
+	    _error = strerror(errno);
+	    return -1;
+	}
+    }
+}
+
+/* Decompress up to cap bytes into out.  Returns the number of bytes
+   produced, which is less than cap only at the end of the file, or -1 on
+   error.  An error after some output is reported by the next call. */
+int
+FromFile::Decompressor::decompress(uint8_t *out, uint32_t cap)
+{
+    if (_error)
+	return -1;
+
+    uint32_t len = 0;
+    while (len < cap) {
+	if (_in_pos == _in_len && !_in_eof && refill() < 0)
+	    break;
+	if (_frame_done) {
+	    // another gzip member or zstd frame may follow
+	    if (_in_pos == _in_len)
+		break;
+	    if (_format == f_gzip && init_stream() < 0) {
+		_error = "out of memory";
+		break;
+	    }
+	    _frame_done = false;
+	    _next_member = true;
+	}
+
+	uint32_t old_len = len, old_pos = _in_pos;
+#if HAVE_ZLIB
+	if (_format == f_gzip) {
+	    _z.next_in = _in + _in_pos;
+	    _z.avail_in = _in_len - _in_pos;
+	    _z.next_out = out + len;
+	    _z.avail_out = cap - len;
+	    int r = inflate(&_z, Z_NO_FLUSH);
+	    _in_pos = _in_len - _z.avail_in;
+	    len = cap - _z.avail_out;
+	    if (r == Z_STREAM_END)
+		_frame_done = true;
+	    else if (r == Z_DATA_ERROR && _next_member) {
+		// ignore trailing garbage after a gzip member, as gzip does
+		_in_pos = _in_len;
+		_in_eof = _frame_done = true;
+		break;
+	    } else if (r != Z_OK && r != Z_BUF_ERROR) {
+		_error = (_z.msg ? _z.msg : "zlib error");
+		break;
+	    }
+	}
+#endif
+#if HAVE_ZSTD
+	if (_format == f_zstd) {
+	    ZSTD_inBuffer ib = { _in + _in_pos, _in_len - _in_pos, 0 };
+	    ZSTD_outBuffer ob = { out + len, cap - len, 0 };
+	    size_t r = ZSTD_decompressStream(_zstd, &ob, &ib);
+	    if (ZSTD_isError(r)) {
+		_error = ZSTD_getErrorName(r);
+		break;
+	    }
+	    _in_pos += ib.pos;
+	    len += ob.pos;
+	    _frame_done = (r == 0);
+	}
+#endif
+
+	if (len != old_len)
+	    _next_member = false;
+	else if (_in_pos == old_pos && _in_pos == _in_len && _in_eof) {
+	    if (!_frame_done)
+		_error = "truncated compressed data";
+	    break;
+	}
+    }
+
+    if (_error && len == 0)
+	return -1;
+    return len;
+}
+
+WritablePacket *
+FromFile::Decompressor::make_buffer(int &len)
+{
+    WritablePacket *p = Packet::make(0, 0, OUT_SIZE, 0);
+    if (!p) {
+	_error = strerror(ENOMEM);
+	len = -1;
+    } else if ((len = decompress(p->data(), OUT_SIZE)) <= 0) {
+	p->kill();
+	p = 0;
+    }
+    return p;
+}
+
+#if HAVE_USER_MULTITHREAD
+void *
+FromFile::Decompressor::read_ahead_thread(void *thunk)
+{
+    static_cast<Decompressor *>(thunk)->read_ahead();
+    return 0;
+}
+
+/* Fill the two slots alternately, waiting while the next slot is still
+   full.  Stops after publishing end of file or an error. */
+void
+FromFile::Decompressor::read_ahead()
+{
+    int len;
+    do {
+	pthread_mutex_lock(&_lock);
+	while (_full[_fill] && !_stop)
+	    pthread_cond_wait(&_cond, &_lock);
+	bool stop = _stop;
+	pthread_mutex_unlock(&_lock);
+	if (stop)
+	    return;
+
+	WritablePacket *p = make_buffer(len);
+
+	pthread_mutex_lock(&_lock);
+	_slot[_fill].p = p;
+	_slot[_fill].len = len;
+	_full[_fill] = true;
+	_fill ^= 1;
+	pthread_cond_broadcast(&_cond);
+	pthread_mutex_unlock(&_lock);
+    } while (len > 0);
+}
+#endif
+
+/** @brief Return the next buffer of decompressed data.
+ * @return 1 if @a p holds @a len > 0 bytes, 0 at end of file, or -1 on
+ * error, with @a error set */
+int
+FromFile::Decompressor::next(WritablePacket *&p, uint32_t &len, String &error)
+{
+    int l;
+#if HAVE_USER_MULTITHREAD
+    if (_started) {
+	pthread_mutex_lock(&_lock);
+	while (!_full[_take])
+	    pthread_cond_wait(&_cond, &_lock);
+	p = _slot[_take].p;
+	l = _slot[_take].len;
+	if (l > 0) {
+	    // after end of file or an error, leave the slot full so later
+	    // calls return the same result
+	    _full[_take] = false;
+	    _take ^= 1;
+	    pthread_cond_broadcast(&_cond);
+	} else
+	    _slot[_take].p = 0;
+	if (l < 0)
+	    error = _error;
+	pthread_mutex_unlock(&_lock);
+    } else
+#endif
+    {
+	p = make_buffer(l);
+	error = _error;
+    }
+
+    len = (l > 0 ? l : 0);
+    return (l > 0 ? 1 : l);
+}
+#endif
+
 #ifdef ALLOW_MMAP
 static void
 munmap_destructor(unsigned char *data, size_t amount)
@@ -170,6 +569,21 @@ FromFile::read_buffer_mmap(ErrorHandler *errh)
 }
 #endif
 
+#if HAVE_ZLIB || HAVE_ZSTD
+int
+FromFile::read_buffer_decompress(ErrorHandler *errh)
+{
+    String err;
+    int result = _decompress->next(_data_packet, _len, err);
+    if (!_data_packet && !(_data_packet = Packet::make(0, 0, 0, 0)))
+	return error(errh, strerror(ENOMEM));
+    _buffer = _data_packet->data();
+    if (result < 0)
+	return error(errh, "%s", err.c_str());
+    return _len;
+}
+#endif
+
 int
 FromFile::read_buffer(ErrorHandler *errh)
 {
@@ -185,6 +599,11 @@ FromFile::read_buffer(ErrorHandler *errh)
     if (_fd < 0)
 	return -EBADF;
 
+#if HAVE_ZLIB || HAVE_ZSTD
+    if (_decompress)
+	return read_buffer_decompress(errh);
+#endif
+
 #ifdef ALLOW_MMAP
     if (_mmap) {
 	int result = read_buffer_mmap(errh);
@@ -316,7 +735,7 @@ int
 FromFile::seek(off_t want, ErrorHandler* errh)
 {
     if (want >= _file_offset && want < (off_t) (_file_offset + _len)) {
-	_pos = want;
+	_pos = want - _file_offset;
 	return 0;
     }
 
@@ -328,6 +747,32 @@ FromFile::seek(off_t want, ErrorHandler* errh)
     }
 #endif
 
+#if HAVE_ZLIB || HAVE_ZSTD
+    // decompressed data can only be read forward; start over to go back
+    if (_decompress) {
+	if (want < _file_offset) {
+	    String err;
+	    if (_decompress->rewind(err) < 0)
+		return error(errh, "%s", err.c_str());
+	    if (_data_packet)
+		_data_packet->kill();
+	    _data_packet = 0;
+	    _file_offset = _pos = _len = 0;
+	}
+	while ((off_t) (_file_offset + _len) <= want) {
+	    int r = read_buffer(errh);
+	    if (r < 0)
+		return -1;
+	    else if (r == 0 && (off_t) _file_offset == want)
+		break;
+	    else if (r == 0)
+		return errh->error("FILEPOS out of range");
+	}
+	_pos = want - _file_offset;
+	return 0;
+    }
+#endif
+
     // check length of file
     struct stat statbuf;
     if (fstat(_fd, &statbuf) < 0)
@@ -382,9 +827,35 @@ FromFile::initialize(ErrorHandler *errh, bool allow_nonexistent)
 	return -ENOENT;
     }
 
-    // check for a gziped or bzip2d dump
-    if (_fd == STDIN_FILENO || _pipe)
-	/* cannot handle gzip or bzip2 */;
+    // check for a gziped, bzip2d, or zstd dump
+#if HAVE_ZLIB || HAVE_ZSTD
+    int format;
+    if (_pipe || _decompress)
+	/* already decompressing */;
+    else if (!_decompress_pipe
+	     && (format = Decompressor::format(_buffer, _len))) {
+	// decompress in-process, starting over from the beginning of the
+	// file if we can
+	_decompress = new Decompressor(_fd, format);
+	String err;
+	int r;
+	if (lseek(_fd, 0, SEEK_SET) == 0)
+	    r = _decompress->start(0, 0, err);
+	else
+	    r = _decompress->start(_buffer, _len, err);
+	if (r < 0)
+	    return error(errh, "%s", err.c_str());
+# ifdef ALLOW_MMAP
+	_mmap = false;
+# endif
+	goto retry_file;
+    }
+#else
+    if (_pipe)
+	/* already decompressing */;
+#endif
+    else if (_fd == STDIN_FILENO)
+	/* cannot handle gzip or bzip2 through a pipe */;
     else if (compressed_data(_buffer, _len)) {
 	close(_fd);
 	_fd = -1;
@@ -404,6 +875,10 @@ FromFile::take_state(FromFile &o, ErrorHandler *errh)
     o._fd = -1;
     _pipe = o._pipe;
     o._pipe = 0;
+#if HAVE_ZLIB || HAVE_ZSTD
+    _decompress = o._decompress;
+    o._decompress = 0;
+#endif
 
     _buffer = o._buffer;
     _pos = o._pos;
@@ -426,6 +901,11 @@ FromFile::take_state(FromFile &o, ErrorHandler *errh)
 void
 FromFile::cleanup()
 {
+#if HAVE_ZLIB || HAVE_ZSTD
+    // stop the read-ahead thread before closing its file descriptor
+    delete _decompress;
+    _decompress = 0;
+#endif
     if (_pipe)
 	pclose(_pipe);
     else if (_fd >= 0 && _fd != STDIN_FILENO)
@@ -555,6 +1035,10 @@ FromFile::filesize_handler(Element *e, void *thunk)
 {
     FromFile *fd = reinterpret_cast<FromFile *>((uint8_t *)e + (intptr_t)thunk);
     struct stat s;
+#if HAVE_ZLIB || HAVE_ZSTD
+    if (fd->_decompress)
+	return "-";
+#endif
     if (fd->_fd >= 0 && fstat(fd->_fd, &s) >= 0 && S_ISREG(s.st_mode))
 	return String(s.st_size);
     else
@@ -23,7 +23,7 @@
 CLICK_DECLS
 
 HashAllocator::HashAllocator(size_t size)
-    : _free(0), _buffer(0), _size(size)
+    : _free(0), _buffer(0), _size(size), _nallocated(0)
 {
 #ifdef VALGRIND_CREATE_MEMPOOL
     VALGRIND_CREATE_MEMPOOL(this, 0, 0);
@@ -67,6 +67,7 @@ void *HashAllocator::hard_allocate()
 #ifdef VALGRIND_MEMPOOL_ALLOC
 	VALGRIND_MEMPOOL_ALLOC(this, data, _size);
 #endif
+	++_nallocated;
 	return data;
     } else
 	return 0;
@@ -86,6 +87,10 @@ void HashAllocator::swap(HashAllocator &x)
     _buffer = x._buffer;
     x._buffer = xbuffer;
 
+    size_t xnallocated = _nallocated;
+    _nallocated = x._nallocated;
+    x._nallocated = xnallocated;
+
 #ifdef VALGRIND_MOVE_MEMPOOL
     VALGRIND_MOVE_MEMPOOL(this, reinterpret_cast<HashAllocator *>(100));
     VALGRIND_MOVE_MEMPOOL(&x, this);
@@ -93,4 +98,23 @@ void HashAllocator::swap(HashAllocator &x)
 #endif
 }
 
+/** @brief Return the number of objects the allocator's buffers can hold,
+ * whether allocated, free, or not yet handed out. */
+size_t HashAllocator::capacity() const
+{
+    size_t n = 0;
+    for (buffer *b = _buffer; b; b = b->next)
+	n += (b->maxpos - sizeof(buffer)) / _size;
+    return n;
+}
+
+/** @brief Return the number of bytes held in the allocator's buffers. */
+size_t HashAllocator::memory_usage() const
+{
+    size_t n = 0;
+    for (buffer *b = _buffer; b; b = b->next)
+	n += b->maxpos;
+    return n;
+}
+
 CLICK_ENDDECLS
@@ -27,7 +27,12 @@
 #include <click/heap.hh>
 #if CLICK_USERLEVEL
 # include <fcntl.h>
+# include <dirent.h>
 # include <click/userutils.hh>
+# include <click/args.hh>
+# if HAVE_SCHED_SETAFFINITY
+#  include <sched.h>
+# endif
 #endif
 CLICK_DECLS
 
@@ -43,6 +48,7 @@ Master::Master(int nthreads)
 {
     _refcount = 0;
     _master_paused = 0;
+    _rcu_epoch = 2;
 
     _nthreads = nthreads + 1;
     _threads = new RouterThread *[_nthreads];
@@ -146,6 +152,25 @@ Master::unblock_all()
 
 // ROUTERS
 
+/** @brief Test whether the grace period @a gp has elapsed.
+ * @param gp grace period token returned by start_grace_period()
+ *
+ * Returns true once every RouterThread that was running the driver when @a gp
+ * started has since reached a quiescent state.  Threads that are blocked, or
+ * not running the driver at all, never delay a grace period. */
+bool
+Master::grace_period_elapsed(uint32_t gp) const
+{
+    for (int i = 1; i < _nthreads; ++i) {
+	uint32_t seen = _threads[i]->_rcu_epoch;
+	if (!(seen & 1) && (int32_t) (seen - gp) < 0)
+	    return false;
+    }
+    // order the caller's reclamation after the threads' reads
+    click_fence();
+    return true;
+}
+
 void
 Master::register_router(Router *router)
 {
@@ -449,6 +474,108 @@ Master::process_signals(RouterThread *thread)
 #endif
 
 
+// PLACEMENT
+
+#if CLICK_USERLEVEL
+
+/** @brief Assign CPUs to this master's threads.
+ * @param cpus CPU numbers
+ * @param errh error handler
+ *
+ * Thread @e i is assigned CPU <tt>cpus[i % cpus.size()]</tt> and that CPU's
+ * NUMA node.  Each thread binds itself to its CPU when its driver starts, so
+ * call this before running the router.  An empty @a cpus unbinds every
+ * thread.  Returns 0 on success, or a negative error if binding is not
+ * supported on this system. */
+int
+Master::set_thread_cpus(const Vector<int> &cpus, ErrorHandler *errh)
+{
+# if !HAVE_SCHED_SETAFFINITY
+    if (cpus.size())
+	return errh->error("CPU affinity is not supported on this system");
+# else
+    (void) errh;
+# endif
+    for (int i = 0; i < nthreads(); ++i) {
+	RouterThread *t = thread(i);
+	t->_cpu = cpus.size() ? cpus[i % cpus.size()] : -1;
+	t->_numa_node = t->_cpu >= 0 ? cpu_numa_node(t->_cpu) : -1;
+    }
+    return 0;
+}
+
+/** @brief Append the CPUs this process may run on to @a cpus.
+ *
+ * Returns the number of CPUs appended, which is 0 if the system cannot
+ * report affinity. */
+int
+Master::available_cpus(Vector<int> &cpus)
+{
+    int n = 0;
+# if HAVE_SCHED_SETAFFINITY
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+	for (int c = 0; c < CPU_SETSIZE; ++c)
+	    if (CPU_ISSET(c, &set)) {
+		cpus.push_back(c);
+		++n;
+	    }
+# else
+    (void) cpus;
+# endif
+    return n;
+}
+
+/** @brief Append the IDs of threads on NUMA node @a node to @a threads.
+ *
+ * Only threads assigned a CPU with set_thread_cpus() have a known node. */
+void
+Master::numa_node_threads(int node, Vector<int> &threads) const
+{
+    for (int i = 0; i < nthreads(); ++i)
+	if (thread(i)->numa_node() == node)
+	    threads.push_back(i);
+}
+
+/** @brief Return the NUMA node containing CPU @a cpu, or -1 if unknown.
+ *
+ * Reads the Linux sysfs CPU topology. */
+int
+Master::cpu_numa_node(int cpu)
+{
+    String dirname = "/sys/devices/system/cpu/cpu" + String(cpu);
+    DIR *dir = opendir(dirname.c_str());
+    if (!dir)
+	return -1;
+    int node = -1;
+    while (struct dirent *d = readdir(dir))
+	if (memcmp(d->d_name, "node", 4) == 0
+	    && IntArg().parse(d->d_name + 4, node))
+	    break;
+    closedir(dir);
+    return node;
+}
+
+/** @brief Return the NUMA node of network device @a ifname, or -1 if
+ * unknown.
+ *
+ * Reads the Linux sysfs device attributes.  Virtual devices, and machines
+ * without NUMA, have no node. */
+int
+Master::device_numa_node(const String &ifname)
+{
+    if (!ifname || ifname.find_left('/') >= 0 || ifname[0] == '.')
+	return -1;
+    String s = file_string("/sys/class/net/" + ifname + "/device/numa_node");
+    int node;
+    if (IntArg().parse(cp_uncomment(s), node) && node >= 0)
+	return node;
+    return -1;
+}
+
+#endif
+
+
 // NS
 
 #if CLICK_NS
@@ -23,6 +23,7 @@
 #include <click/packet_anno.hh>
 #include <click/glue.hh>
 #include <click/sync.hh>
+#include <click/straccum.hh>
 #if CLICK_USERLEVEL
 # include <unistd.h>
 #endif
@@ -228,6 +229,9 @@ Packet::~Packet()
 #  define CLICK_PACKET_POOL_BUFSIZ		2048
 #  define CLICK_PACKET_POOL_SIZE		1000
 #  define CLICK_GLOBAL_PACKET_POOL_COUNT	16
+#  define CLICK_PACKET_POOL_RING_SIZE		256	/* power of 2 */
+#  define CLICK_PACKET_POOL_REMOTE_BATCH	32
+#  define CLICK_PACKET_POOL_NODES		8
 namespace {
 struct PacketData {
     PacketData *next;
@@ -235,20 +239,54 @@ struct PacketData {
     PacketData *pool_next;
 #  endif
 };
+#  if HAVE_MULTITHREAD
+// A destroyed packet header on its way back to the pool that allocated it.
+// Overlays the header's leading fields, which are disjoint from the
+// _aa.next and _aa.prev fields used by pool lists.
+struct PacketReturn {
+    PacketReturn *next;
+    unsigned char *data;
+};
+#  endif
+}
+
 struct PacketPool {
     WritablePacket *p;
     unsigned pcount;
     PacketData *pd;
     unsigned pdcount;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long refills;
 #  if HAVE_MULTITHREAD
     PacketPool *chain;
+    int thread_id;
+    int node;			// index into global_packet_pools
+    unsigned long remote_frees;
+    unsigned long returns;
+    unsigned long ring_full;
+    // Packets freed here that belong to pool 'remote', batched for return.
+    PacketPool *remote;
+    PacketReturn *remote_head;
+    unsigned remote_count;
+    // Single-consumer return ring: other threads reserve a slot by
+    // advancing ring_tail, then store a chain of PacketReturns in it.  The
+    // owning thread empties slots in order and advances ring_head.
+    volatile uint32_t ring_head;
+    volatile uint32_t ring_tail;
+    PacketReturn * volatile ring[CLICK_PACKET_POOL_RING_SIZE];
 #  endif
 };
-}
+
+static unsigned packet_pool_size = CLICK_PACKET_POOL_SIZE;
+static bool packet_pool_prewarm;
+
 #  if HAVE_MULTITHREAD
 static __thread PacketPool *thread_packet_pool;
 static PacketPool *all_thread_packet_pools;
-static PacketPool global_packet_pool;
+// Full free lists spill to, and refill from, the global pool for the
+// owning thread's NUMA node, so buffers stay near the CPUs that use them.
+static PacketPool global_packet_pools[CLICK_PACKET_POOL_NODES];
 static volatile uint32_t global_packet_pool_lock;
 
 static inline PacketPool *
@@ -257,6 +295,9 @@ get_packet_pool()
     PacketPool *pp = thread_packet_pool;
     if (!pp && (pp = new PacketPool)) {
 	memset(pp, 0, sizeof(PacketPool));
+#   if CLICK_USERLEVEL && HAVE___THREAD_STORAGE_CLASS
+	pp->thread_id = click_current_thread_id;
+#   endif
 	while (atomic_uint32_t::swap(global_packet_pool_lock, 1) == 1)
 	    /* do nothing */;
 	pp->chain = all_thread_packet_pools;
@@ -271,11 +312,169 @@ get_packet_pool()
 static PacketPool packet_pool;
 #  endif
 
+/* Return a destroyed packet header, and possibly its data buffer, to the
+   local free lists of 'packet_pool', spilling a full list to the global
+   pool. */
+static void
+pool_put(PacketPool &packet_pool, WritablePacket *p, unsigned char *data)
+{
+#  if HAVE_MULTITHREAD
+    if ((packet_pool.p && packet_pool.pcount >= packet_pool_size)
+	|| (data && packet_pool.pd && packet_pool.pdcount >= packet_pool_size)) {
+	while (atomic_uint32_t::swap(global_packet_pool_lock, 1) == 1)
+	    /* do nothing */;
+	PacketPool &global_packet_pool = global_packet_pools[packet_pool.node];
+
+	if (packet_pool.p && packet_pool.pcount >= packet_pool_size) {
+	    if (global_packet_pool.pcount == CLICK_GLOBAL_PACKET_POOL_COUNT) {
+		while (WritablePacket *p = packet_pool.p) {
+		    packet_pool.p = static_cast<WritablePacket *>(p->next());
+		    ::operator delete((void *) p);
+		}
+	    } else {
+		packet_pool.p->set_prev(global_packet_pool.p);
+		global_packet_pool.p = packet_pool.p;
+		++global_packet_pool.pcount;
+		packet_pool.p = 0;
+	    }
+	    packet_pool.pcount = 0;
+	}
+
+	if (data && packet_pool.pd && packet_pool.pdcount >= packet_pool_size) {
+	    if (global_packet_pool.pdcount == CLICK_GLOBAL_PACKET_POOL_COUNT) {
+		while (PacketData *pd = packet_pool.pd) {
+		    packet_pool.pd = pd->next;
+		    delete[] reinterpret_cast<unsigned char *>(pd);
+		}
+	    } else {
+		packet_pool.pd->pool_next = global_packet_pool.pd;
+		global_packet_pool.pd = packet_pool.pd;
+		++global_packet_pool.pdcount;
+		packet_pool.pd = 0;
+	    }
+	    packet_pool.pdcount = 0;
+	}
+
+	click_compiler_fence();
+	global_packet_pool_lock = 0;
+    }
+#  else
+    if (packet_pool.pcount >= packet_pool_size) {
+	::operator delete((void *) p);
+	p = 0;
+    }
+    if (data && packet_pool.pdcount >= packet_pool_size) {
+	delete[] data;
+	data = 0;
+    }
+#  endif
+
+    if (p) {
+	p->set_next(packet_pool.p);
+	packet_pool.p = p;
+	++packet_pool.pcount;
+    }
+    if (data) {
+	PacketData *pd = reinterpret_cast<PacketData *>(data);
+	pd->next = packet_pool.pd;
+	packet_pool.pd = pd;
+	++packet_pool.pdcount;
+    }
+}
+
+#  if HAVE_MULTITHREAD
+/* The return ring is shared between threads, so its slots and ring_head
+   need release/acquire ordering, not just compiler fences: a slot's chain
+   must be visible before the slot, and a cleared slot before ring_head. */
+template <typename T>
+static inline T
+ring_load_acquire(T volatile &x)
+{
+#   if defined(__ATOMIC_ACQUIRE)
+    return __atomic_load_n(&x, __ATOMIC_ACQUIRE);
+#   else
+    T v = x;
+    click_fence();
+    return v;
+#   endif
+}
+
+template <typename T>
+static inline void
+ring_store_release(T volatile &x, T v)
+{
+#   if defined(__ATOMIC_RELEASE)
+    __atomic_store_n(&x, v, __ATOMIC_RELEASE);
+#   else
+    click_fence();
+    x = v;
+#   endif
+}
+
+static void
+pool_put_returns(PacketPool &packet_pool, PacketReturn *r)
+{
+    while (r) {
+	PacketReturn *next = r->next;
+	pool_put(packet_pool, reinterpret_cast<WritablePacket *>(r), r->data);
+	r = next;
+    }
+}
+
+/* Move the packets other threads have returned to us onto our free lists.
+   Only the owning thread calls this. */
+static void
+pool_drain_ring(PacketPool &packet_pool)
+{
+    uint32_t h = packet_pool.ring_head;
+    PacketReturn *r;
+    while ((r = ring_load_acquire(packet_pool.ring[h & (CLICK_PACKET_POOL_RING_SIZE - 1)]))) {
+	packet_pool.ring[h & (CLICK_PACKET_POOL_RING_SIZE - 1)] = 0;
+	ring_store_release(packet_pool.ring_head, ++h);
+	for (PacketReturn *next; r; r = next) {
+	    next = r->next;
+	    pool_put(packet_pool, reinterpret_cast<WritablePacket *>(r), r->data);
+	    ++packet_pool.returns;
+	}
+    }
+}
+
+/* Hand the batched remote frees back to their owner.  If the owner's ring
+   is full, adopt the packets instead; they are retagged on reuse. */
+static void
+pool_flush_remote(PacketPool &packet_pool)
+{
+    PacketReturn *r = packet_pool.remote_head;
+    if (!r)
+	return;
+    PacketPool *owner = packet_pool.remote;
+    uint32_t t;
+    do {
+	t = owner->ring_tail;
+	if (t - ring_load_acquire(owner->ring_head) >= CLICK_PACKET_POOL_RING_SIZE) {
+	    ++packet_pool.ring_full;
+	    pool_put_returns(packet_pool, r);
+	    goto done;
+	}
+    } while (atomic_uint32_t::compare_swap(owner->ring_tail, t, t + 1) != t);
+    ring_store_release(owner->ring[t & (CLICK_PACKET_POOL_RING_SIZE - 1)], r);
+ done:
+    packet_pool.remote_head = 0;
+    packet_pool.remote_count = 0;
+}
+#  endif
+
 WritablePacket *
 WritablePacket::pool_allocate(bool with_data)
 {
 #  if HAVE_MULTITHREAD
     PacketPool &packet_pool = *get_packet_pool();
+    if (!packet_pool.p || (with_data && !packet_pool.pd)) {
+	pool_drain_ring(packet_pool);
+	if (!packet_pool.p && packet_pool.remote_head)
+	    pool_flush_remote(packet_pool);
+    }
+    PacketPool &global_packet_pool = global_packet_pools[packet_pool.node];
     if ((!packet_pool.p && global_packet_pool.p)
 	|| (with_data && !packet_pool.pd && global_packet_pool.pd)) {
 	while (atomic_uint32_t::swap(global_packet_pool_lock, 1) == 1)
@@ -286,7 +485,8 @@ WritablePacket::pool_allocate(bool with_data)
 	    global_packet_pool.p = static_cast<WritablePacket *>(pp->prev());
 	    --global_packet_pool.pcount;
 	    packet_pool.p = pp;
-	    packet_pool.pcount = CLICK_PACKET_POOL_SIZE;
+	    packet_pool.pcount = packet_pool_size;
+	    ++packet_pool.refills;
 	}
 
 	PacketData *pd;
@@ -294,7 +494,8 @@ WritablePacket::pool_allocate(bool with_data)
 	    global_packet_pool.pd = pd->pool_next;
 	    --global_packet_pool.pdcount;
 	    packet_pool.pd = pd;
-	    packet_pool.pdcount = CLICK_PACKET_POOL_SIZE;
+	    packet_pool.pdcount = packet_pool_size;
+	    ++packet_pool.refills;
 	}
 
 	click_compiler_fence();
@@ -308,8 +509,15 @@ WritablePacket::pool_allocate(bool with_data)
     if (p) {
 	packet_pool.p = static_cast<WritablePacket *>(p->next());
 	--packet_pool.pcount;
-    } else
+	++packet_pool.hits;
+    } else {
 	p = new WritablePacket;
+	++packet_pool.misses;
+    }
+#  if HAVE_MULTITHREAD
+    if (p)
+	p->_pool = &packet_pool;
+#  endif
     return p;
 }
 
@@ -356,67 +564,29 @@ WritablePacket::recycle(WritablePacket *p)
 
 #  if HAVE_MULTITHREAD
     PacketPool &packet_pool = *get_packet_pool();
-    if ((packet_pool.p && packet_pool.pcount == CLICK_PACKET_POOL_SIZE)
-	|| (data && packet_pool.pd && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE)) {
-	while (atomic_uint32_t::swap(global_packet_pool_lock, 1) == 1)
-	    /* do nothing */;
-
-	if (packet_pool.p && packet_pool.pcount == CLICK_PACKET_POOL_SIZE) {
-	    if (global_packet_pool.pcount == CLICK_GLOBAL_PACKET_POOL_COUNT) {
-		while (WritablePacket *p = packet_pool.p) {
-		    packet_pool.p = static_cast<WritablePacket *>(p->next());
-		    ::operator delete((void *) p);
-		}
-	    } else {
-		packet_pool.p->set_prev(global_packet_pool.p);
-		global_packet_pool.p = packet_pool.p;
-		++global_packet_pool.pcount;
-		packet_pool.p = 0;
-	    }
-	    packet_pool.pcount = 0;
+    PacketPool *owner = p->_pool;
+    p->~WritablePacket();
+    if (owner && owner != &packet_pool) {
+	// Return the packet to the thread that allocated it, in batches, so
+	// producer/consumer pipelines do not drain one pool into another.
+	if (owner != packet_pool.remote
+	    || packet_pool.remote_count >= CLICK_PACKET_POOL_REMOTE_BATCH) {
+	    pool_flush_remote(packet_pool);
+	    packet_pool.remote = owner;
 	}
-
-	if (data && packet_pool.pd && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE) {
-	    if (global_packet_pool.pdcount == CLICK_GLOBAL_PACKET_POOL_COUNT) {
-		while (PacketData *pd = packet_pool.pd) {
-		    packet_pool.pd = pd->next;
-		    delete[] reinterpret_cast<unsigned char *>(pd);
-		}
-	    } else {
-		packet_pool.pd->pool_next = global_packet_pool.pd;
-		global_packet_pool.pd = packet_pool.pd;
-		++global_packet_pool.pdcount;
-		packet_pool.pd = 0;
-	    }
-	    packet_pool.pdcount = 0;
-	}
-
-	click_compiler_fence();
-	global_packet_pool_lock = 0;
+	PacketReturn *r = reinterpret_cast<PacketReturn *>(p);
+	r->next = packet_pool.remote_head;
+	r->data = data;
+	packet_pool.remote_head = r;
+	++packet_pool.remote_count;
+	++packet_pool.remote_frees;
+	return;
     }
 #  else
-    if (packet_pool.pcount == CLICK_PACKET_POOL_SIZE) {
-	delete p;
-	p = 0;
-    }
-    if (data && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE) {
-	delete[] data;
-	data = 0;
-    }
+    p->~WritablePacket();
 #  endif
 
-    if (p) {
-	p->~WritablePacket();
-	p->set_next(packet_pool.p);
-	packet_pool.p = p;
-	++packet_pool.pcount;
-    }
-    if (data) {
-	PacketData *pd = reinterpret_cast<PacketData *>(data);
-	pd->next = packet_pool.pd;
-	packet_pool.pd = pd;
-	++packet_pool.pdcount;
-    }
+    pool_put(packet_pool, p, data);
 }
 
 #endif
@@ -612,6 +782,9 @@ Packet::clone()
     if (!p)
 	return 0;
     memcpy(p, this, sizeof(Packet));
+# if HAVE_CLICK_PACKET_POOL && HAVE_MULTITHREAD
+    p->_pool = thread_packet_pool;
+# endif
     p->_use_count = 1;
     p->_data_packet = this;
 # if CLICK_USERLEVEL
@@ -904,6 +1077,19 @@ Packet::shift_data(int offset, bool free_on_failure)
 
 
 #if HAVE_CLICK_PACKET_POOL
+# if HAVE_MULTITHREAD
+static void
+cleanup_returns(PacketReturn *r)
+{
+    while (r) {
+	PacketReturn *next = r->next;
+	delete[] r->data;
+	::operator delete((void *) r);
+	r = next;
+    }
+}
+# endif
+
 static void
 cleanup_pool(PacketPool *pp)
 {
@@ -915,6 +1101,146 @@ cleanup_pool(PacketPool *pp)
 	pp->pd = pd->next;
 	delete[] reinterpret_cast<unsigned char *>(pd);
     }
+# if HAVE_MULTITHREAD
+    cleanup_returns(pp->remote_head);
+    pp->remote_head = 0;
+    for (int i = 0; i < CLICK_PACKET_POOL_RING_SIZE; ++i) {
+	cleanup_returns(pp->ring[i]);
+	pp->ring[i] = 0;
+    }
+# endif
+}
+
+/** @brief Set the size of each thread's packet pool.
+ * @param size maximum number of free packet headers (and, separately, data
+ *   buffers) cached per thread, or 0 to keep the current size
+ * @param prewarm if true, prewarm_pool() fills the pool in advance
+ *
+ * Call this before any packets are allocated, typically while parsing
+ * options.  The default size is 1000. */
+void
+Packet::set_pool_size(unsigned size, bool prewarm)
+{
+    if (size)
+	packet_pool_size = size;
+    packet_pool_prewarm = prewarm;
+}
+
+/** @brief Set the NUMA node of the calling thread's packet pool.
+ * @param node NUMA node number, or -1 if unknown
+ *
+ * When the thread's pool overflows, it spills free lists to a global pool
+ * kept for @a node, and it refills only from that global pool.  This keeps
+ * buffers allocated on one node from migrating to threads on another.
+ * RouterThread calls this after binding itself to a CPU.  Nodes beyond the
+ * supported range share a global pool. */
+void
+Packet::set_pool_numa_node(int node)
+{
+# if HAVE_MULTITHREAD
+    PacketPool &packet_pool = *get_packet_pool();
+    packet_pool.node = (node < 0 ? 0 : node % CLICK_PACKET_POOL_NODES);
+# else
+    (void) node;
+# endif
+}
+
+/** @brief Fill the calling thread's packet pool.
+ *
+ * Does nothing unless prewarming was requested with set_pool_size().
+ * Otherwise allocates packet headers and default-sized data buffers until
+ * the calling thread's pool is full, so that the first packets the thread
+ * handles do not go to the system allocator.  Each RouterThread calls this
+ * as its driver starts. */
+void
+Packet::prewarm_pool()
+{
+    if (!packet_pool_prewarm)
+	return;
+# if HAVE_MULTITHREAD
+    PacketPool &packet_pool = *get_packet_pool();
+# endif
+    while (packet_pool.pcount < packet_pool_size) {
+	WritablePacket *p = (WritablePacket *) ::operator new(sizeof(WritablePacket));
+	p->set_next(packet_pool.p);
+	packet_pool.p = p;
+	++packet_pool.pcount;
+    }
+    while (packet_pool.pdcount < packet_pool_size) {
+	PacketData *pd = reinterpret_cast<PacketData *>(new unsigned char[CLICK_PACKET_POOL_BUFSIZ]);
+	pd->next = packet_pool.pd;
+	packet_pool.pd = pd;
+	++packet_pool.pdcount;
+    }
+}
+
+/** @brief Settle the calling thread's cross-thread packet returns.
+ *
+ * Hands any partial batch of packets freed here, but allocated by another
+ * thread, back to that thread, and moves packets other threads have
+ * returned onto this thread's free lists.  Without this, a partial batch
+ * waits for the next remote free, which may never come once traffic stops.
+ * Each RouterThread calls this before it waits for work. */
+void
+Packet::flush_pool_returns()
+{
+# if HAVE_MULTITHREAD
+    if (PacketPool *pp = thread_packet_pool) {
+	pool_flush_remote(*pp);
+	pool_drain_ring(*pp);
+    }
+# endif
+}
+
+static void
+pool_report_one(StringAccum &sa, const PacketPool *pp)
+{
+    sa << "packets " << pp->pcount << " data " << pp->pdcount
+       << " hits " << pp->hits << " misses " << pp->misses
+       << " refills " << pp->refills;
+# if HAVE_MULTITHREAD
+    sa << " remote_frees " << pp->remote_frees << " returns " << pp->returns
+       << " ring_full " << pp->ring_full << " node " << pp->node;
+# endif
+    sa << '\n';
+}
+
+/** @brief Report packet pool statistics.
+ * @param sa report destination
+ *
+ * Writes one line per thread pool, giving the number of cached headers and
+ * data buffers, pool hits and misses, and refills from the global pool.  In
+ * multithreaded drivers, each line also counts packets freed by a thread
+ * other than their allocator ("remote_frees"), packets received back from
+ * other threads ("returns"), and batches that could not be returned because
+ * the owner's return ring was full ("ring_full").  The counters are read
+ * without synchronization.  Multithreaded drivers also report each pool's
+ * NUMA node, and the global pool for every node that holds free lists. */
+void
+Packet::pool_report(StringAccum &sa)
+{
+    sa << "size " << packet_pool_size << '\n';
+# if HAVE_MULTITHREAD
+    while (atomic_uint32_t::swap(global_packet_pool_lock, 1) == 1)
+	/* do nothing */;
+    for (PacketPool *pp = all_thread_packet_pools; pp; pp = pp->chain) {
+	sa << "thread " << pp->thread_id << ": ";
+	pool_report_one(sa, pp);
+    }
+    for (int n = 0; n < CLICK_PACKET_POOL_NODES; ++n)
+	if (n == 0 || global_packet_pools[n].pcount || global_packet_pools[n].pdcount) {
+	    sa << "global";
+	    if (n)
+		sa << " node " << n;
+	    sa << ": lists " << global_packet_pools[n].pcount
+	       << " data_lists " << global_packet_pools[n].pdcount << '\n';
+	}
+    click_compiler_fence();
+    global_packet_pool_lock = 0;
+# else
+    sa << "thread 0: ";
+    pool_report_one(sa, &packet_pool);
+# endif
 }
 #endif
 
@@ -928,14 +1254,17 @@ Packet::static_cleanup()
 	cleanup_pool(pp);
 	delete pp;
     }
-    while (global_packet_pool.p || global_packet_pool.pd) {
-	WritablePacket *next_p = global_packet_pool.p;
-	next_p = (next_p ? static_cast<WritablePacket *>(next_p->prev()) : 0);
-	PacketData *next_pd = global_packet_pool.pd;
-	next_pd = (next_pd ? next_pd->pool_next : 0);
-	cleanup_pool(&global_packet_pool);
-	global_packet_pool.p = next_p;
-	global_packet_pool.pd = next_pd;
+    for (int n = 0; n < CLICK_PACKET_POOL_NODES; ++n) {
+	PacketPool &global_packet_pool = global_packet_pools[n];
+	while (global_packet_pool.p || global_packet_pool.pd) {
+	    WritablePacket *next_p = global_packet_pool.p;
+	    next_p = (next_p ? static_cast<WritablePacket *>(next_p->prev()) : 0);
+	    PacketData *next_pd = global_packet_pool.pd;
+	    next_pd = (next_pd ? next_pd->pool_next : 0);
+	    cleanup_pool(&global_packet_pool);
+	    global_packet_pool.p = next_p;
+	    global_packet_pool.pd = next_pd;
+	}
     }
 # else
     cleanup_pool(&packet_pool);
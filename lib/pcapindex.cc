@@ -0,0 +1,359 @@
+// -*- c-basic-offset: 4; related-file-name: "../include/click/pcapindex.hh" -*-
+/*
+ * pcapindex.{cc,hh} -- sparse timestamp index of a tcpdump file
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include <click/pcapindex.hh>
+#include <click/error.hh>
+#include <click/userutils.hh>
+#include <click/vector.hh>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#ifdef ALLOW_MMAP
+# include <sys/mman.h>
+#endif
+CLICK_DECLS
+
+// tcpdump file format; see elements/userlevel/fakepcap.hh
+#define PCAP_MAGIC		0xA1B2C3D4
+#define PCAP_MODIFIED_MAGIC	0xA1B2CD34
+#define PCAP_FILE_HEADER_SIZE	24
+#define PCAP_PKTHDR_SIZE	16
+#define PCAP_MODIFIED_EXTRA	8
+#define	SWAPLONG(y) \
+	((((y)&0xff)<<24) | (((y)&0xff00)<<8) | (((y)&0xff0000)>>8) | (((y)>>24)&0xff))
+
+PcapIndex::PcapIndex()
+    : _hdr(0), _entries(0), _mem(0), _mmap(0), _mmap_len(0)
+{
+}
+
+void
+PcapIndex::clear()
+{
+#ifdef ALLOW_MMAP
+    if (_mmap)
+	munmap(_mmap, _mmap_len);
+#endif
+    delete[] _mem;
+    _hdr = 0;
+    _entries = 0;
+    _mem = 0;
+    _mmap = 0;
+    _mmap_len = 0;
+}
+
+Timestamp
+PcapIndex::first_timestamp() const
+{
+    if (!_hdr)
+	return Timestamp();
+    return Timestamp::make_usec(_hdr->first_sec, _hdr->first_usec);
+}
+
+/** @brief Load the cached index of the tcpdump file @a filename.
+ * @return 1 if the index was loaded, 0 if there is no usable cached index,
+ * or -1 if @a filename cannot be examined
+ *
+ * An index is unusable if it is corrupt, was written on a machine of
+ * different byte order, or records a different size or modification time
+ * than @a filename now has. */
+int
+PcapIndex::load(const String &filename, ErrorHandler *errh)
+{
+    clear();
+    _filename = filename;
+
+    struct stat tst;
+    if (stat(filename.c_str(), &tst) < 0)
+	return errh->error("%s: %s", filename.c_str(), strerror(errno));
+
+    String idxname = index_filename(filename);
+    int fd = open(idxname.c_str(), O_RDONLY);
+    if (fd < 0)
+	return 0;
+    struct stat ist;
+    if (fstat(fd, &ist) < 0 || ist.st_size < (off_t) sizeof(Header)) {
+	close(fd);
+	return 0;
+    }
+
+    size_t len = ist.st_size;
+    const void *data = 0;
+#ifdef ALLOW_MMAP
+    void *m = mmap(0, len, PROT_READ, MAP_SHARED, fd, 0);
+    if (m != MAP_FAILED) {
+	_mmap = m;
+	_mmap_len = len;
+	data = m;
+    }
+#endif
+    if (!data) {
+	_mem = new uint64_t[(len + 7) / 8];
+	size_t pos = 0;
+	while (pos < len) {
+	    ssize_t r = read(fd, reinterpret_cast<char *>(_mem) + pos, len - pos);
+	    if (r <= 0 && errno != EINTR)
+		break;
+	    else if (r > 0)
+		pos += r;
+	}
+	if (pos < len)
+	    len = 0;
+	data = _mem;
+    }
+    close(fd);
+
+    const Header *h = reinterpret_cast<const Header *>(data);
+    if (len < sizeof(Header)
+	|| h->magic != MAGIC || h->version != VERSION
+	|| h->trace_size != (uint64_t) tst.st_size
+	|| h->trace_mtime != (int64_t) tst.st_mtime
+	|| len != sizeof(Header) + h->nentries * sizeof(Entry)) {
+	clear();
+	return 0;
+    }
+    _hdr = h;
+    _entries = reinterpret_cast<const Entry *>(h + 1);
+    return 1;
+}
+
+/** @brief Index the tcpdump file @a filename, keeping the index in memory.
+ * @param interval approximate distance between index entries, in bytes
+ * @return 0 on success, -1 on error
+ *
+ * The trace must be an uncompressed tcpdump file.  Indexing stops at a
+ * truncated or corrupt packet record, as FromDump does. */
+int
+PcapIndex::build(const String &filename, uint32_t interval, ErrorHandler *errh)
+{
+    enum { BUFSIZE = 1048576 };
+
+    clear();
+    _filename = filename;
+    if (interval < PCAP_PKTHDR_SIZE)
+	interval = PCAP_PKTHDR_SIZE;
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+	return errh->error("%s: %s", filename.c_str(), strerror(errno));
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+	close(fd);
+	return errh->error("%s: not a regular file", filename.c_str());
+    }
+
+    unsigned char *buf = new unsigned char[BUFSIZE];
+    off_t bufoff = 0;
+    size_t buflen = 0;
+    bool eof = false;
+    int result = 0;
+    Vector<Entry> entries;
+    Timestamp first_ts, max_ts;
+    bool swapped, modified;
+    int minor_version;
+
+    // read the file header
+    ssize_t r;
+    while ((r = read(fd, buf + buflen, PCAP_FILE_HEADER_SIZE - buflen)) > 0
+	   || (r < 0 && errno == EINTR))
+	if (r > 0 && (buflen += r) == PCAP_FILE_HEADER_SIZE)
+	    break;
+    {
+	uint32_t magic;
+	uint16_t minor;
+	memcpy(&magic, buf, 4);
+	memcpy(&minor, buf + 6, 2);
+	swapped = (magic != PCAP_MAGIC && magic != PCAP_MODIFIED_MAGIC);
+	if (swapped) {
+	    magic = SWAPLONG(magic);
+	    minor = (minor >> 8) | (minor << 8);
+	}
+	if (buflen == PCAP_FILE_HEADER_SIZE
+	    && (magic == PCAP_MAGIC || magic == PCAP_MODIFIED_MAGIC)) {
+	    modified = (magic == PCAP_MODIFIED_MAGIC);
+	    minor_version = minor;
+	} else if (compressed_data(buf, buflen)) {
+	    result = errh->error("%s: cannot index compressed file", filename.c_str());
+	    goto done;
+	} else {
+	    result = errh->error("%s: not a tcpdump file", filename.c_str());
+	    goto done;
+	}
+    }
+
+    // scan packet headers, skipping data
+    {
+	size_t hdrsize = PCAP_PKTHDR_SIZE + (modified ? PCAP_MODIFIED_EXTRA : 0);
+	off_t pos = PCAP_FILE_HEADER_SIZE, next_entry = pos;
+	bufoff = pos;
+	buflen = 0;
+	while (1) {
+	    if (pos < bufoff || pos + (off_t) hdrsize > bufoff + (off_t) buflen) {
+		if (eof)
+		    break;
+		// refill the buffer at pos, keeping any bytes we have
+		size_t keep = 0;
+		if (pos >= bufoff && pos < bufoff + (off_t) buflen) {
+		    keep = bufoff + buflen - pos;
+		    memmove(buf, buf + (pos - bufoff), keep);
+		} else if (pos != bufoff + (off_t) buflen
+			   && lseek(fd, pos, SEEK_SET) != pos) {
+		    result = errh->error("%s: %s", filename.c_str(), strerror(errno));
+		    goto done;
+		}
+		bufoff = pos;
+		buflen = keep;
+		while (buflen < BUFSIZE) {
+		    r = read(fd, buf + buflen, BUFSIZE - buflen);
+		    if (r > 0)
+			buflen += r;
+		    else if (r == 0) {
+			eof = true;
+			break;
+		    } else if (errno != EINTR) {
+			result = errh->error("%s: %s", filename.c_str(), strerror(errno));
+			goto done;
+		    }
+		}
+		continue;
+	    }
+
+	    if (pos >= next_entry) {
+		Entry e;
+		e.offset = pos;
+		e.sec = max_ts.sec();
+		e.usec = max_ts.usec();
+		entries.push_back(e);
+		next_entry = pos + interval;
+	    }
+
+	    const unsigned char *ph = buf + (pos - bufoff);
+	    uint32_t sec, usec, caplen, len;
+	    memcpy(&sec, ph, 4);
+	    memcpy(&usec, ph + 4, 4);
+	    memcpy(&caplen, ph + 8, 4);
+	    memcpy(&len, ph + 12, 4);
+	    if (swapped) {
+		sec = SWAPLONG(sec);
+		usec = SWAPLONG(usec);
+		caplen = SWAPLONG(caplen);
+		len = SWAPLONG(len);
+	    }
+	    // old versions may have swapped 'caplen' and 'len'
+	    if (minor_version < 3 || (minor_version == 3 && caplen > len))
+		caplen = len;
+	    if (caplen > 65535)
+		break;
+
+	    Timestamp ts = Timestamp::make_usec((int32_t) sec, usec);
+	    if (pos == PCAP_FILE_HEADER_SIZE)
+		first_ts = ts;
+	    if (ts > max_ts)
+		max_ts = ts;
+	    pos += hdrsize + caplen;
+	    if (pos > st.st_size)
+		break;
+	}
+    }
+
+    {
+	size_t len = sizeof(Header) + entries.size() * sizeof(Entry);
+	_mem = new uint64_t[(len + 7) / 8];
+	Header *h = reinterpret_cast<Header *>(_mem);
+	h->magic = MAGIC;
+	h->version = VERSION;
+	h->trace_size = st.st_size;
+	h->trace_mtime = st.st_mtime;
+	h->interval = interval;
+	h->nentries = entries.size();
+	h->first_sec = first_ts.sec();
+	h->first_usec = first_ts.usec();
+	if (entries.size())
+	    memcpy(h + 1, entries.begin(), entries.size() * sizeof(Entry));
+	_hdr = h;
+	_entries = reinterpret_cast<const Entry *>(h + 1);
+    }
+
+  done:
+    delete[] buf;
+    close(fd);
+    return result;
+}
+
+/** @brief Write the index beside its trace.
+ * @return 0 on success, or a negative errno value on error
+ *
+ * The index is written to a temporary file and renamed into place, so
+ * concurrent readers never see a partial index. */
+int
+PcapIndex::save()
+{
+    assert(_hdr);
+    String idxname = index_filename(_filename);
+    String tmpname = idxname + ".XXXXXX";
+    int fd = mkstemp(tmpname.mutable_c_str());
+    if (fd < 0)
+	return -errno;
+    (void) fchmod(fd, 0644);
+
+    const char *data = reinterpret_cast<const char *>(_hdr);
+    size_t len = sizeof(Header) + _hdr->nentries * sizeof(Entry), pos = 0;
+    int err = 0;
+    while (pos < len && !err) {
+	ssize_t r = write(fd, data + pos, len - pos);
+	if (r > 0)
+	    pos += r;
+	else if (r == 0)
+	    err = EIO;
+	else if (errno != EINTR)
+	    err = errno;
+    }
+    if (close(fd) < 0 && !err)
+	err = errno;
+    if (!err && rename(tmpname.c_str(), idxname.c_str()) < 0)
+	err = errno;
+    if (err)
+	unlink(tmpname.c_str());
+    return -err;
+}
+
+/** @brief Return the file offset from which to scan for time @a ts.
+ *
+ * Every packet between the file header and the returned offset has a
+ * timestamp earlier than @a ts.  Returns the offset of the first packet
+ * record if the index is empty. */
+off_t
+PcapIndex::lookup(const Timestamp &ts) const
+{
+    if (empty())
+	return PCAP_FILE_HEADER_SIZE;
+    // find the last entry whose prefix maximum is less than ts
+    uint32_t l = 0, r = _hdr->nentries;
+    while (r - l > 1) {
+	uint32_t m = l + (r - l) / 2;
+	if (Timestamp::make_usec(_entries[m].sec, _entries[m].usec) < ts)
+	    l = m;
+	else
+	    r = m;
+    }
+    return _entries[l].offset;
+}
+
+CLICK_ENDDECLS
@@ -85,6 +85,9 @@ Router::Router(const String &configuration, Master *master)
       _arena_factory(new HashMap_ArenaFactory),
       _hotswap_router(0), _thread_sched(0), _name_info(0), _next_router(0)
 {
+#if CLICK_PORT_PROFILE
+    _port_profiling = false;
+#endif
     _refcount = 0;
     _runcount = 0;
     _root_element = new ErrorElement;
@@ -1242,6 +1245,200 @@ Router::set_hotswap_router(Router *r)
 }
 
 
+// PORT PROFILING
+
+#if CLICK_PORT_PROFILE
+/** @brief Turn port profiling on or off.
+ *
+ * While profiling is on, every push and pull between this router's elements
+ * counts calls and packets, and a sample of transfers also counts CPU cycles
+ * (see Element::port_profile_interval).  Statistics are attributed to the
+ * receiving element's input for pushes and to the sending element's output
+ * for pulls.  Turning profiling off stops collection but keeps the
+ * statistics.  Profiling may be turned on and off while the router runs;
+ * the profile memory is kept until the router is destroyed, so threads
+ * concurrently transferring packets never see it freed. */
+void
+Router::set_port_profiling(bool on)
+{
+    if (on)
+	for (int i = 0; i < nelements(); ++i) {
+	    Element *e = _elements[i];
+	    if (!e->_port_profiles) {
+		int n = e->ninputs() + e->noutputs();
+		e->_port_profiles = new Element::PortProfile[n ? n : 1];
+		memset(e->_port_profiles, 0, sizeof(Element::PortProfile) * (n ? n : 1));
+	    }
+	}
+    click_fence();
+    for (int i = 0; i < nelements(); ++i) {
+	Element *e = _elements[i];
+	for (int isoutput = 0; isoutput < 2; ++isoutput)
+	    for (int p = 0; p < e->nports(isoutput); ++p) {
+		const Element::Port &port = e->port(isoutput, p);
+		Element *peer = port.element();
+		Element::PortProfile *pp = 0;
+		if (on && port.active() && peer)
+		    pp = const_cast<Element::PortProfile *>(peer->port_profile(isoutput ? false : true, port.port()));
+		const_cast<Element::Port &>(port)._profile = pp;
+	    }
+    }
+    _port_profiling = on;
+}
+
+/** @brief Zero all port profiles. */
+void
+Router::reset_port_profiles()
+{
+    for (int i = 0; i < nelements(); ++i)
+	if (Element *e = _elements[i])
+	    if (e->_port_profiles)
+		memset(e->_port_profiles, 0, sizeof(Element::PortProfile) * (e->ninputs() + e->noutputs()));
+}
+
+namespace {
+struct ProfileLine {
+    int eindex;
+    int isoutput;
+    int port;
+    uint64_t calls;
+    uint64_t packets;
+    uint64_t samples;
+    uint64_t sampled_packets;
+    uint64_t sampled_cycles;
+    double cycles;		// estimated own cycles over all calls
+    int pfirst, plast;		// element lines: range of port lines
+
+    void add(const Element::PortProfile &pp) {
+	calls += pp.calls;
+	packets += pp.packets;
+	samples += pp.sampled_calls;
+	sampled_packets += pp.sampled_packets;
+	sampled_cycles += pp.sampled_cycles;
+	if (pp.sampled_calls)
+	    cycles += (double) pp.sampled_cycles * pp.calls / pp.sampled_calls;
+    }
+};
+
+int
+profile_line_compar(const void *a, const void *b, void *)
+{
+    const ProfileLine *la = static_cast<const ProfileLine *>(a);
+    const ProfileLine *lb = static_cast<const ProfileLine *>(b);
+    if (la->cycles != lb->cycles)
+	return la->cycles > lb->cycles ? -1 : 1;
+    return la->eindex - lb->eindex;
+}
+
+void
+profile_unparse_port(StringAccum &sa, const ProfileLine &l)
+{
+    if (l.port < 0)
+	sa << '-';
+    else
+	sa << (l.isoutput ? "out" : "in") << l.port;
+}
+
+void
+profile_unparse_json(StringAccum &sa, const ProfileLine &l)
+{
+    sa << "\"calls\":" << l.calls << ",\"packets\":" << l.packets
+       << ",\"samples\":" << l.samples
+       << ",\"sampled_cycles\":" << l.sampled_cycles
+       << ",\"cycles\":" << (uint64_t) l.cycles
+       << ",\"cycles_per_call\":" << (l.samples ? l.sampled_cycles / l.samples : 0)
+       << ",\"cycles_per_packet\":" << (l.sampled_packets ? l.sampled_cycles / l.sampled_packets : 0);
+}
+}
+
+/** @brief Report the port profiles.
+ * @param sa report destination
+ * @param json if true, report JSON, otherwise a text table
+ *
+ * Elements appear in decreasing order of estimated own cycles.  Each
+ * element's line, which sums its ports, is followed by one line per port
+ * that transferred packets.  Estimated cycles scale the sampled cycles up to
+ * all calls.  The counters are read without synchronization. */
+void
+Router::port_profile_report(StringAccum &sa, bool json) const
+{
+    Vector<ProfileLine> elines, plines;
+    double total = 0;
+    for (int i = 0; i < nelements(); ++i) {
+	Element *e = _elements[i];
+	ProfileLine el;
+	memset(&el, 0, sizeof(el));
+	el.eindex = i;
+	el.port = -1;
+	el.pfirst = plines.size();
+	for (int isoutput = 0; isoutput < 2; ++isoutput)
+	    for (int p = 0; p < e->nports(isoutput); ++p)
+		if (const Element::PortProfile *pp = e->port_profile(isoutput, p))
+		    if (pp->calls) {
+			ProfileLine pl;
+			memset(&pl, 0, sizeof(pl));
+			pl.eindex = i;
+			pl.isoutput = isoutput;
+			pl.port = p;
+			pl.add(*pp);
+			plines.push_back(pl);
+			el.add(*pp);
+		    }
+	el.plast = plines.size();
+	if (el.calls) {
+	    elines.push_back(el);
+	    total += el.cycles;
+	}
+    }
+    if (elines.size())
+	click_qsort(elines.begin(), elines.size(), sizeof(ProfileLine), profile_line_compar, 0);
+
+    if (json)
+	sa << "{\"profiling\":" << (_port_profiling ? "true" : "false")
+	   << ",\"interval\":" << Element::port_profile_interval
+	   << ",\"elements\":[";
+    else
+	sa << "# profiling " << (_port_profiling ? "true" : "false")
+	   << " interval " << Element::port_profile_interval << '\n'
+	   << "# element port calls packets samples cycles cycles/call cycles/packet percent\n";
+    for (int i = 0; i < elines.size(); ++i) {
+	const ProfileLine &el = elines[i];
+	if (json) {
+	    sa << (i ? "," : "") << "\n{\"name\":\"" << ename(el.eindex)
+	       << "\",\"class\":\"" << _elements[el.eindex]->class_name()
+	       << "\",";
+	    profile_unparse_json(sa, el);
+	    sa << ",\"ports\":[";
+	}
+	for (int j = el.pfirst - 1; j < el.plast; ++j) {
+	    const ProfileLine &l = (j < el.pfirst ? el : plines[j]);
+	    if (json && j >= el.pfirst) {
+		sa << (j > el.pfirst ? "," : "") << "{\"port\":\"";
+		profile_unparse_port(sa, l);
+		sa << "\",";
+		profile_unparse_json(sa, l);
+		sa << '}';
+	    } else if (!json) {
+		sa << ename(el.eindex) << ' ';
+		profile_unparse_port(sa, l);
+		sa << ' ' << l.calls << ' ' << l.packets << ' ' << l.samples
+		   << ' ' << (uint64_t) l.cycles
+		   << ' ' << (l.samples ? l.sampled_cycles / l.samples : 0)
+		   << ' ' << (l.sampled_packets ? l.sampled_cycles / l.sampled_packets : 0)
+		   << ' ';
+		sa.snprintf(16, "%.1f", total > 0 ? 100 * l.cycles / total : 0.);
+		sa << '\n';
+	    }
+	}
+	if (json)
+	    sa << "]}";
+    }
+    if (json)
+	sa << "]}\n";
+}
+#endif
+
+
 // HANDLERS
 
 /** @class Handler
@@ -2151,7 +2348,9 @@ Router::configuration_string() const
 enum { GH_VERSION, GH_CONFIG, GH_FLATCONFIG, GH_LIST, GH_REQUIREMENTS,
        GH_DRIVER, GH_ACTIVE_PORTS, GH_ACTIVE_PORT_STATS, GH_STRING_PROFILE,
        GH_STRING_PROFILE_LONG, GH_SCHEDULING_PROFILE, GH_STOP,
-       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES };
+       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES, GH_PACKET_POOL,
+       GH_THREAD_STATS, GH_THREAD_PLACEMENT, GH_PROFILE, GH_PROFILE_JSON,
+       GH_PROFILING, GH_PROFILE_INTERVAL, GH_RESET_PROFILE };
 
 #if CLICK_STATS >= 2
 struct stats_info {
@@ -2245,6 +2444,64 @@ Router::router_read_handler(Element *e, void *thunk)
 	break;
 #endif
 
+#if HAVE_CLICK_PACKET_POOL
+    case GH_PACKET_POOL:
+	Packet::pool_report(sa);
+	break;
+#endif
+
+    case GH_THREAD_STATS:
+	if (r) {
+	    Master *m = r->master();
+	    for (int i = 0; i < m->nthreads(); ++i) {
+		RouterThread *t = m->thread(i);
+		sa << "thread " << i << ": steals " << t->steals()
+		   << " stolen " << t->tasks_stolen()
+		   << " requests " << t->steal_requests()
+		   << " idle " << t->idle_time() << '\n';
+	    }
+	}
+	break;
+
+#if CLICK_USERLEVEL
+    case GH_THREAD_PLACEMENT:
+	if (r) {
+	    Master *m = r->master();
+	    for (int i = 0; i < m->nthreads(); ++i) {
+		RouterThread *t = m->thread(i);
+		sa << "thread " << i << ": cpu ";
+		if (t->cpu() >= 0)
+		    sa << t->cpu();
+		else
+		    sa << '-';
+		sa << " node ";
+		if (t->numa_node() >= 0)
+		    sa << t->numa_node();
+		else
+		    sa << '-';
+		sa << " affinity " << (t->cpu_affinity() ? t->cpu_affinity() : String::make_stable("-")) << '\n';
+	    }
+	}
+	break;
+#endif
+
+#if CLICK_PORT_PROFILE
+    case GH_PROFILE:
+    case GH_PROFILE_JSON:
+	if (r)
+	    r->port_profile_report(sa, reinterpret_cast<intptr_t>(thunk) == GH_PROFILE_JSON);
+	break;
+
+    case GH_PROFILING:
+	if (r)
+	    sa << r->port_profiling();
+	break;
+
+    case GH_PROFILE_INTERVAL:
+	sa << Element::port_profile_interval;
+	break;
+#endif
+
 #if CLICK_DEBUG_MASTER || CLICK_DEBUG_SCHEDULING
     case GH_SCHEDULING_PROFILE:
 	if (r)
@@ -2361,6 +2618,25 @@ Router::router_write_handler(const String &s, Element *e, void *thunk, ErrorHand
 	for (int i = 0; i < (r ? r->nelements() : 0); i++)
 	    r->_elements[i]->reset_cycles();
 	break;
+#endif
+#if CLICK_PORT_PROFILE
+    case GH_PROFILING: {
+	bool on;
+	if (!BoolArg().parse(cp_uncomment(s), on))
+	    return errh->error("expected boolean");
+	r->set_port_profiling(on);
+	break;
+    }
+    case GH_PROFILE_INTERVAL: {
+	unsigned interval;
+	if (!IntArg().parse(cp_uncomment(s), interval) || interval == 0)
+	    return errh->error("expected positive integer");
+	Element::port_profile_interval = interval;
+	break;
+    }
+    case GH_RESET_PROFILE:
+	r->reset_port_profiles();
+	break;
 #endif
     default:
 	break;
@@ -2391,6 +2667,22 @@ Router::static_initialize()
 	add_read_handler(0, "string_profile_long", router_read_handler, (void *) GH_STRING_PROFILE_LONG);
 # endif
 #endif
+#if HAVE_CLICK_PACKET_POOL
+	add_read_handler(0, "packet_pool", router_read_handler, (void *) GH_PACKET_POOL);
+#endif
+	add_read_handler(0, "thread_stats", router_read_handler, (void *) GH_THREAD_STATS);
+#if CLICK_USERLEVEL
+	add_read_handler(0, "thread_placement", router_read_handler, (void *) GH_THREAD_PLACEMENT);
+#endif
+#if CLICK_PORT_PROFILE
+	add_read_handler(0, "profile", router_read_handler, (void *) GH_PROFILE);
+	add_read_handler(0, "profile_json", router_read_handler, (void *) GH_PROFILE_JSON);
+	add_read_handler(0, "profiling", router_read_handler, (void *) GH_PROFILING);
+	add_write_handler(0, "profiling", router_write_handler, (void *) GH_PROFILING);
+	add_read_handler(0, "profile_interval", router_read_handler, (void *) GH_PROFILE_INTERVAL);
+	add_write_handler(0, "profile_interval", router_write_handler, (void *) GH_PROFILE_INTERVAL);
+	add_write_handler(0, "reset_profile", router_write_handler, (void *) GH_RESET_PROFILE, Handler::BUTTON);
+#endif
 #if CLICK_DEBUG_MASTER || CLICK_DEBUG_SCHEDULING
 	add_read_handler(0, "scheduling_profile", router_read_handler, (void *) GH_SCHEDULING_PROFILE);
 #endif
@@ -24,6 +24,7 @@
 #include <click/router.hh>
 #include <click/routerthread.hh>
 #include <click/master.hh>
+#include <click/straccum.hh>
 #if CLICK_LINUXMODULE
 # include <click/cxxprotect.h>
 CLICK_CXX_PROTECT
@@ -39,6 +40,9 @@ CLICK_CXX_UNPROTECT
 # include <click/cxxunprotect.h>
 #elif CLICK_USERLEVEL
 # include <fcntl.h>
+# if HAVE_SCHED_SETAFFINITY
+#  include <sched.h>
+# endif
 #endif
 CLICK_DECLS
 
@@ -57,6 +61,11 @@ CLICK_DECLS
 static unsigned long greedy_schedule_jiffies;
 #endif
 
+#if HAVE_MULTITHREAD
+bool RouterThread::work_stealing = false;
+atomic_uint32_t RouterThread::idle_threads;
+#endif
+
 /** @file routerthread.hh
  * @brief The RouterThread class implementing the Click driver loop.
  */
@@ -67,7 +76,7 @@ static unsigned long greedy_schedule_jiffies;
 
 RouterThread::RouterThread(Master *m, int id)
     : _stop_flag(0), _pending_head(0), _pending_tail(&_pending_head),
-      _master(m), _id(id)
+      _master(m), _id(id), _rcu_epoch(1)
 {
 #if !HAVE_TASK_HEAP
     _prev = _next = this;
@@ -80,6 +89,17 @@ RouterThread::RouterThread(Master *m, int id)
 
     _task_blocker = 0;
     _task_blocker_waiting = 0;
+    _steals = 0;
+    _tasks_stolen = _steal_requests = 0;
+#if HAVE_MULTITHREAD
+    _steal_request = 0;
+    _steal_victim = 0;
+    _migratable_load = 0;
+    _idle = false;
+#endif
+#if CLICK_USERLEVEL
+    _cpu = _numa_node = -1;
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     _max_click_share = 80 * Task::MAX_UTILIZATION / 100;
     _min_click_share = Task::MAX_UTILIZATION / 200;
@@ -169,6 +189,56 @@ RouterThread::scheduled_tasks(Router *router, Vector<Task *> &x)
     unlock_tasks();
 }
 
+/** @brief Return the total time this thread has spent waiting with no
+ * runnable tasks, including any wait in progress.
+ *
+ * The result is read without synchronization. */
+Timestamp
+RouterThread::idle_time() const
+{
+    Timestamp idle = _idle_time, start = _idle_start;
+    if (start)
+	idle += Timestamp::now_steady() - start;
+    return idle;
+}
+
+#if CLICK_USERLEVEL
+/* Bind the calling thread to cpu(), if one was assigned, and record the
+   affinity the kernel actually applied.  Called by the thread itself as
+   its driver starts, so per-thread memory allocated afterwards is local to
+   the thread's NUMA node. */
+void
+RouterThread::bind_cpu()
+{
+# if HAVE_SCHED_SETAFFINITY
+    cpu_set_t set;
+    if (_cpu >= 0 && _cpu < CPU_SETSIZE) {
+	CPU_ZERO(&set);
+	CPU_SET(_cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0)
+	    click_chatter("thread %d: cannot bind to CPU %d: %s", _id, _cpu, strerror(errno));
+    }
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+	StringAccum sa;
+	for (int c = 0; c < CPU_SETSIZE; ++c)
+	    if (CPU_ISSET(c, &set)) {
+		int last = c;
+		while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &set))
+		    ++last;
+		sa << (sa.length() ? "," : "") << c;
+		if (last > c)
+		    sa << '-' << last;
+		c = last;
+	    }
+	_cpu_affinity = sa.take_string();
+    }
+# endif
+# if HAVE_CLICK_PACKET_POOL
+    Packet::set_pool_numa_node(_numa_node);
+# endif
+}
+#endif
+
 void
 RouterThread::request_stop()
 {
@@ -388,6 +458,7 @@ RouterThread::run_tasks(int ntasks)
     Task *t;
 #if HAVE_MULTITHREAD
     int runs;
+    unsigned migratable_load = 0;
 #endif
     bool work_done;
 
@@ -417,6 +488,8 @@ RouterThread::run_tasks(int ntasks)
 	    unsigned delta = click_get_cycles() - cycles;
 	    t->update_cycles(delta/32 + (t->cycles()*31)/32);
 	}
+	if (t->_migratable && work_done)
+	    ++migratable_load;
 #endif
 
 	// fix task list
@@ -479,8 +552,92 @@ RouterThread::run_tasks(int ntasks)
 #if HAVE_ADAPTIVE_SCHEDULER
     client_update_pass(C_CLICK, t_before);
 #endif
+#if HAVE_MULTITHREAD
+    _migratable_load = migratable_load;
+#endif
 }
 
+#if HAVE_MULTITHREAD
+/* Work stealing.
+
+   A thread's scheduled task list belongs to its driver, so a thief cannot
+   unlink tasks from a running sibling directly.  Instead an idle thread
+   posts a request to the sibling that most recently ran the most
+   migratable tasks; the victim answers at its next driver iteration by
+   moving one migratable task to the thief with Task::move_thread(), which
+   wakes the thief through its pending list.  A busy thread that has a task
+   to give wakes idle siblings so they can ask for it. */
+
+Task *
+RouterThread::steal_candidate()
+{
+    // must be called by the running thread with its lock held
+    Task *candidate = 0;
+    int nscheduled = 0;
+    for (Task *t = task_begin(); t != task_end(); t = task_next(t))
+	if (t->_status.is_scheduled
+	    && t->_status.home_thread_id == thread_id()) {
+	    ++nscheduled;
+	    if (t->_migratable)
+		candidate = t;
+	}
+    // never give away our only task
+    return nscheduled >= 2 ? candidate : 0;
+}
+
+void
+RouterThread::try_steal()
+{
+    if (RouterThread *victim = _steal_victim) {
+	uint32_t me = _id + 1;
+	if (victim->_steal_request.value() != me)
+	    _steal_victim = 0;	// answered
+	else if (!victim->_migratable_load
+		 && victim->_steal_request.compare_swap(me, 0) == me)
+	    _steal_victim = 0;	// victim went quiet; withdraw
+	else
+	    return;
+    }
+
+    RouterThread *victim = 0;
+    unsigned best_load = 0;
+    for (int i = 0; i < _master->nthreads(); ++i) {
+	RouterThread *t = _master->thread(i);
+	if (t != this && t->_migratable_load > best_load && !t->_idle) {
+	    victim = t;
+	    best_load = t->_migratable_load;
+	}
+    }
+    if (victim && victim->_steal_request.compare_swap(0, _id + 1) == 0) {
+	_steal_victim = victim;
+	++_steal_requests;
+    }
+}
+
+void
+RouterThread::check_steal()
+{
+    // must be called by the running thread with its lock held
+    if (uint32_t request = _steal_request.value()) {
+	RouterThread *thief = _master->thread(request - 1);
+	if (Task *t = steal_candidate()) {
+	    t->move_thread(thief->thread_id());
+	    ++_tasks_stolen;
+	    ++thief->_steals;
+	}
+	_steal_request.compare_swap(request, 0);
+    } else if (idle_threads.value() && _migratable_load && steal_candidate()) {
+	for (int i = 0; i < _master->nthreads(); ++i) {
+	    RouterThread *t = _master->thread(i);
+	    if (t != this && t->_idle) {
+		t->wake();
+		break;
+	    }
+	}
+    }
+}
+#endif
+
 inline void
 RouterThread::run_os()
 {
@@ -492,8 +649,26 @@ RouterThread::run_os()
 #if HAVE_ADAPTIVE_SCHEDULER
     Timestamp t_before = Timestamp::now();
 #endif
+    if (!active()) {
+	_idle_start = Timestamp::now_steady();
+#if HAVE_CLICK_PACKET_POOL
+	Packet::flush_pool_returns();
+#endif
+#if HAVE_MULTITHREAD
+	if (work_stealing) {
+	    try_steal();
+	    _idle = true;
+	    ++idle_threads;
+	}
+#endif
+    }
+
+#if !CLICK_USERLEVEL
+    rcu_offline();
+#endif
 
 #if CLICK_USERLEVEL
+    // run_selects() takes the thread offline only while it blocks
     select_set().run_selects(this);
 #elif CLICK_LINUXMODULE		/* Linux kernel module */
     if (_greedy) {
@@ -537,9 +712,22 @@ RouterThread::run_os()
 # error "Compiling for unknown target."
 #endif
 
+#if !CLICK_USERLEVEL
+    rcu_online();
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     client_update_pass(C_KERNEL, t_before);
 #endif
+    if (_idle_start) {
+	_idle_time += Timestamp::now_steady() - _idle_start;
+	_idle_start = Timestamp();
+#if HAVE_MULTITHREAD
+	if (_idle) {
+	    _idle = false;
+	    --idle_threads;
+	}
+#endif
+    }
     driver_lock_tasks();
 }
 
@@ -579,10 +767,15 @@ RouterThread::driver()
 #  if HAVE___THREAD_STORAGE_CLASS
     click_current_thread_id = _id;
 #  endif
+# endif
+    bind_cpu();
+# if HAVE_CLICK_PACKET_POOL
+    Packet::prewarm_pool();
 # endif
 #endif
 
     driver_lock_tasks();
+    rcu_online();
 
 #if HAVE_ADAPTIVE_SCHEDULER
     client_set_tickets(C_CLICK, DRIVER_TOTAL_TICKETS / 2);
@@ -596,6 +789,8 @@ RouterThread::driver()
 #if CLICK_DEBUG_SCHEDULING
 	_driver_epoch++;
 #endif
+	// no element code is running, so no RCU-protected reads are in flight
+	rcu_quiescent();
 
 #if !BSD_NETISRSCHED
 	// check to see if driver is stopped
@@ -624,6 +819,12 @@ RouterThread::driver()
 	    run_tasks(_tasks_per_iter);
 	} while (0);
 
+#if HAVE_MULTITHREAD
+	// answer steal requests, or offer work to idle threads
+	if (work_stealing)
+	    check_steal();
+#endif
+
 #if CLICK_USERLEVEL
 	// run signals
 	run_signals();
@@ -671,6 +872,7 @@ RouterThread::driver()
 #endif
     }
 
+    rcu_offline();
     driver_unlock_tasks();
 
 #if HAVE_ADAPTIVE_SCHEDULER
@@ -707,9 +909,11 @@ RouterThread::driver_once()
 # endif
 #endif
     driver_lock_tasks();
+    rcu_online();
 
     run_tasks(1);
 
+    rcu_offline();
     driver_unlock_tasks();
 #if CLICK_LINUXMODULE
     _linux_task = 0;
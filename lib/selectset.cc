@@ -33,6 +33,9 @@
 #  define EV_SET_UDATA_CAST	/* nothing */
 # endif
 #endif
+#if HAVE_ALLOW_EPOLL
+# include <sys/epoll.h>
+#endif
 CLICK_DECLS
 
 namespace {
@@ -42,6 +45,29 @@ enum { POLLIN = Element::SELECT_READ, POLLOUT = Element::SELECT_WRITE };
 #endif
 }
 
+#if HAVE_ALLOW_EPOLL
+int SelectSet::epoll_mode = SelectSet::epoll_level;
+#endif
+
+/** @brief Set how SelectSets created later use epoll.
+ * @param mode epoll_off, epoll_level, or epoll_edge
+ *
+ * With epoll_off, SelectSets use poll() or select() even where epoll is
+ * available.  The default, epoll_level, uses level-triggered epoll.
+ * epoll_edge registers file descriptors edge-triggered, which saves
+ * system calls but requires every element to drain its file descriptors
+ * completely each time selected() is called.  Has no effect if Click was
+ * built without epoll support. */
+void
+SelectSet::set_epoll_mode(int mode)
+{
+#if HAVE_ALLOW_EPOLL
+    epoll_mode = mode;
+#else
+    (void) mode;
+#endif
+}
+
 SelectSet::SelectSet()
 {
     _wake_pipe_pending = false;
@@ -58,6 +84,13 @@ SelectSet::SelectSet()
 # endif
 #endif
 
+#if HAVE_ALLOW_EPOLL
+    _epoll = (epoll_mode == epoll_off ? -1 : epoll_create(256));
+    _epoll_edge = (epoll_mode == epoll_edge);
+    if (_epoll >= 0)
+	fcntl(_epoll, F_SETFD, FD_CLOEXEC);
+#endif
+
 #if !HAVE_ALLOW_POLL
     FD_ZERO(&_read_select_fd_set);
     FD_ZERO(&_write_select_fd_set);
@@ -85,6 +118,10 @@ SelectSet::~SelectSet()
 #if HAVE_ALLOW_KQUEUE
     if (_kqueue >= 0)
 	close(_kqueue);
+#endif
+#if HAVE_ALLOW_EPOLL
+    if (_epoll >= 0)
+	close(_epoll);
 #endif
     if (_wake_pipe[0] >= 0) {
 	close(_wake_pipe[0]);
@@ -138,6 +175,9 @@ SelectSet::register_select(int fd, bool add_read, bool add_write)
 	_pollfds.back().events = 0;
     }
     int pi = _selinfo[fd].pollfd;
+#if HAVE_ALLOW_EPOLL
+    int old_events = _pollfds[pi].events;
+#endif
 
     // add the elements
     if (add_read)
@@ -145,6 +185,10 @@ SelectSet::register_select(int fd, bool add_read, bool add_write)
     if (add_write)
 	_pollfds[pi].events |= POLLOUT;
 
+#if HAVE_ALLOW_EPOLL
+    update_epoll(fd, old_events, _pollfds[pi].events);
+#endif
+
 #if HAVE_ALLOW_KQUEUE
     if (_kqueue >= 0) {
 	// Add events to the kqueue
@@ -252,12 +296,19 @@ SelectSet::remove_pollfd(int pi, int event)
 
     // remove event
     int fd = _pollfds[pi].fd;
+#if HAVE_ALLOW_EPOLL
+    int old_events = _pollfds[pi].events;
+#endif
     _pollfds[pi].events &= ~event;
     if (event == POLLIN)
 	_selinfo[fd].read = 0;
     else
 	_selinfo[fd].write = 0;
 
+#if HAVE_ALLOW_EPOLL
+    update_epoll(fd, old_events, _pollfds[pi].events);
+#endif
+
 #if HAVE_ALLOW_KQUEUE
     // remove event from kqueue
     if (_kqueue >= 0) {
@@ -297,6 +348,36 @@ SelectSet::remove_pollfd(int pi, int event)
 #endif
 }
 
+#if HAVE_ALLOW_EPOLL
+void
+SelectSet::update_epoll(int fd, int old_events, int new_events)
+{
+    if (_epoll < 0 || old_events == new_events)
+	return;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = 0;
+    if (new_events & POLLIN)
+	ev.events |= EPOLLIN;
+    if (new_events & POLLOUT)
+	ev.events |= EPOLLOUT;
+    if (_epoll_edge && fd != _wake_pipe[0])
+	ev.events |= EPOLLET;
+    ev.data.fd = fd;
+    int op = (!old_events ? EPOLL_CTL_ADD : !new_events ? EPOLL_CTL_DEL : EPOLL_CTL_MOD);
+    if (epoll_ctl(_epoll, op, fd, &ev) < 0) {
+	// A file descriptor closed before remove_select() has already left
+	// the epoll set.
+	if (op == EPOLL_CTL_DEL && (errno == EBADF || errno == ENOENT))
+	    return;
+	// Not all file descriptors are epollable (regular files are not).
+	// So if we encounter a problem, fall back to select() or poll().
+	close(_epoll);
+	_epoll = -1;
+    }
+}
+#endif
+
 int
 SelectSet::remove_select(int fd, Element *element, int mask)
 {
@@ -338,6 +419,9 @@ SelectSet::post_select(RouterThread *thread, bool acquire)
     (void) acquire;
 #endif
 
+    // selected() methods may read RCU-protected structures
+    thread->rcu_online();
+
     if (_wake_pipe_pending) {
 	_wake_pipe_pending = false;
 	char crap[64];
@@ -424,6 +508,48 @@ SelectSet::run_selects_kqueue(RouterThread *thread)
 }
 #endif /* HAVE_ALLOW_KQUEUE */
 
+#if HAVE_ALLOW_EPOLL
+void
+SelectSet::run_selects_epoll(RouterThread *thread)
+{
+# if HAVE_MULTITHREAD
+    click_fence();
+    _select_lock.release();
+# endif
+
+    // Decide how long to wait.
+    int timeout;
+    Timestamp t;
+    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    if (delay_type == 0)
+	timeout = 0;
+    else if (delay_type > 0)
+	timeout = (t.sec() >= INT_MAX / 1000 ? INT_MAX - 1000 : t.msecval());
+    else
+	timeout = -1;
+    thread->set_thread_state_for_blocking(delay_type);
+
+    struct epoll_event ev[256];
+    int n = epoll_wait(_epoll, &ev[0], 256, timeout);
+    int was_errno = errno;
+
+    if (post_select(thread, true))
+	return;
+
+    thread->set_thread_state(RouterThread::S_RUNSELECT);
+    if (n < 0 && was_errno != EINTR)
+	perror("epoll_wait");
+    else
+	// call_selected() looks up the current selectors, so fds removed by
+	// earlier callbacks in this batch are skipped
+	for (struct epoll_event *p = &ev[0]; p < &ev[n]; ++p) {
+	    int mask = (p->events & ~EPOLLOUT ? Element::SELECT_READ : 0)
+		+ (p->events & ~EPOLLIN ? Element::SELECT_WRITE : 0);
+	    call_selected(p->data.fd, mask);
+	}
+}
+#endif /* HAVE_ALLOW_EPOLL */
+
 #if HAVE_ALLOW_POLL
 void
 SelectSet::run_selects_poll(RouterThread *thread)
@@ -577,6 +703,12 @@ SelectSet::run_selects(RouterThread *thread)
 	    break;
 	}
 #endif
+#if HAVE_ALLOW_EPOLL
+	if (_epoll >= 0) {
+	    run_selects_epoll(thread);
+	    break;
+	}
+#endif
 #if HAVE_ALLOW_POLL
 	run_selects_poll(thread);
 #else
@@ -24,7 +24,6 @@
 #include <click/master.hh>
 #include <click/routerthread.hh>
 #include <click/task.hh>
-#include <click/heap.hh>
 CLICK_DECLS
 
 /** @file timer.hh
@@ -163,7 +162,10 @@ CLICK_DECLS
 
  The Click core stores timers in a heap, so most timer operations (including
  scheduling and unscheduling) take @e O(log @e n) time and Click can handle
- very large numbers of timers.
+ very large numbers of timers.  At user level, the <tt>--timer-wheel</tt>
+ option selects a hashed hierarchical timing wheel instead, which schedules
+ and unschedules in @e O(1) time; timers that expire within the same wheel
+ tick then run in no particular order.
 
  Timers generally run in increasing order by expiration time.  That is, if
  timer @a a's expiry() is less than timer @a b's expiry(), then @a a will
@@ -258,38 +260,10 @@ Timer::home_thread_id() const
 void
 Timer::schedule_at_steady(const Timestamp &when)
 {
-    // acquire lock, unschedule
     assert(_owner && initialized());
-    TimerSet &ts = _thread->timer_set();
-    ts.lock_timers();
-
-    // set expiration timer
-    _expiry_s = when;
-    ts.check_timer_expiry(this);
-
-    // manipulate list; this is essentially a "decrease-key" operation
-    // any reschedule removes a timer from the runchunk (XXX -- even backwards
-    // reschedulings)
-    int old_schedpos1 = _schedpos1;
-    if (_schedpos1 <= 0) {
-	if (_schedpos1 < 0)
-	    ts._timer_runchunk[-_schedpos1 - 1] = 0;
-	_schedpos1 = ts._timer_heap.size() + 1;
-	ts._timer_heap.push_back(TimerSet::heap_element(this));
-    } else
-	ts._timer_heap.at_u(_schedpos1 - 1).expiry_s = _expiry_s;
-    change_heap<4>(ts._timer_heap.begin(), ts._timer_heap.end(),
-		   ts._timer_heap.begin() + _schedpos1 - 1,
-		   TimerSet::heap_less(), TimerSet::heap_place());
-    if (old_schedpos1 == 1 || _schedpos1 == 1)
-	ts.set_timer_expiry();
-
     // if we changed the timeout, wake up the thread
-    if (_schedpos1 == 1)
+    if (_thread->timer_set().schedule_timer(this, when))
 	_thread->wake();
-
-    // done
-    ts.unlock_timers();
 }
 
 void
@@ -303,20 +277,7 @@ Timer::unschedule()
 {
     if (!scheduled())
 	return;
-    TimerSet &ts = _thread->timer_set();
-    ts.lock_timers();
-    int old_schedpos1 = _schedpos1;
-    if (_schedpos1 > 0) {
-	remove_heap<4>(ts._timer_heap.begin(), ts._timer_heap.end(),
-		       ts._timer_heap.begin() + _schedpos1 - 1,
-		       TimerSet::heap_less(), TimerSet::heap_place());
-	ts._timer_heap.pop_back();
-	if (old_schedpos1 == 1)
-	    ts.set_timer_expiry();
-    } else if (_schedpos1 < 0)
-	ts._timer_runchunk[-_schedpos1 - 1] = 0;
-    _schedpos1 = 0;
-    ts.unlock_timers();
+    _thread->timer_set().unschedule_timer(this);
 }
 
 // list-related functions in master.cc
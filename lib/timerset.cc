@@ -24,9 +24,28 @@
 #include <click/routerthread.hh>
 #include <click/heap.hh>
 #include <click/master.hh>
+#include <click/integers.hh>
 CLICK_DECLS
 
+uint32_t TimerSet::default_wheel_tick_usec = 0;
+
 TimerSet::TimerSet()
+{
+    initialize(default_wheel_tick_usec);
+}
+
+TimerSet::TimerSet(uint32_t wheel_tick_usec)
+{
+    initialize(wheel_tick_usec);
+}
+
+TimerSet::~TimerSet()
+{
+    delete[] _wheel;
+}
+
+void
+TimerSet::initialize(uint32_t wheel_tick_usec)
 {
 #if CLICK_NS
     _max_timer_stride = 1;
@@ -48,6 +67,24 @@ TimerSet::TimerSet()
 #endif
     _timer_check = Timestamp::now_steady();
     _timer_check_reports = 0;
+
+    _wheel = 0;
+    _wheel_tick_usec = 0;
+    _wheel_count = 0;
+    for (int level = 0; level < wheel_levels; ++level)
+	_wheel_level_count[level] = 0;
+    if (wheel_tick_usec
+	&& (_wheel = new Timer *[wheel_levels * wheel_size])) {
+	memset(_wheel, 0, sizeof(Timer *) * wheel_levels * wheel_size);
+	_wheel_tick_usec = wheel_tick_usec;
+	_wheel_base = wheel_tick(_timer_check);
+    }
+}
+
+void
+TimerSet::set_default_wheel_tick(uint32_t tick_usec)
+{
+    default_wheel_tick_usec = tick_usec;
 }
 
 void
@@ -55,6 +92,17 @@ TimerSet::kill_router(Router *router)
 {
     lock_timers();
     assert(!_timer_runchunk.size());
+    if (_wheel) {
+	for (int pos = 0; pos < wheel_levels * wheel_size; ++pos)
+	    for (Timer *t = _wheel[pos], *next; t; t = next) {
+		next = t->_wheel_next;
+		if (t->router() == router) {
+		    wheel_remove(t);
+		    t->_owner = 0;
+		    t->_schedpos1 = 0;
+		}
+	    }
+    }
     for (heap_element *thp = _timer_heap.end();
 	 thp > _timer_heap.begin(); ) {
 	--thp;
@@ -91,6 +139,187 @@ TimerSet::check_timer_expiry(Timer *t)
     }
 }
 
+bool
+TimerSet::schedule_timer(Timer *t, const Timestamp &when)
+{
+    lock_timers();
+
+    // set expiration timer
+    t->_expiry_s = when;
+    check_timer_expiry(t);
+
+    // any reschedule removes a timer from the runchunk (XXX -- even backwards
+    // reschedulings)
+    int old_schedpos1 = t->_schedpos1;
+    bool changed;
+    if (_wheel) {
+	// the wheel keeps _timer_expiry as a lower bound on the next expiry,
+	// so only a new earliest timer changes it
+	if (old_schedpos1 > 0)
+	    wheel_remove(t);
+	else if (old_schedpos1 < 0)
+	    _timer_runchunk[-old_schedpos1 - 1] = 0;
+	wheel_place(t);
+	changed = !_timer_expiry || t->_expiry_s < _timer_expiry;
+	if (changed)
+	    _timer_expiry = t->_expiry_s;
+    } else {
+	// manipulate list; this is essentially a "decrease-key" operation
+	if (old_schedpos1 <= 0) {
+	    if (old_schedpos1 < 0)
+		_timer_runchunk[-old_schedpos1 - 1] = 0;
+	    t->_schedpos1 = _timer_heap.size() + 1;
+	    _timer_heap.push_back(heap_element(t));
+	} else
+	    _timer_heap.at_u(t->_schedpos1 - 1).expiry_s = t->_expiry_s;
+	change_heap<4>(_timer_heap.begin(), _timer_heap.end(),
+		       _timer_heap.begin() + t->_schedpos1 - 1,
+		       heap_less(), heap_place());
+	if (old_schedpos1 == 1 || t->_schedpos1 == 1)
+	    set_timer_expiry();
+	changed = t->_schedpos1 == 1;
+    }
+
+    unlock_timers();
+    return changed;
+}
+
+void
+TimerSet::unschedule_timer(Timer *t)
+{
+    lock_timers();
+    int old_schedpos1 = t->_schedpos1;
+    if (old_schedpos1 > 0 && _wheel) {
+	wheel_remove(t);
+	if (!_wheel_count)
+	    _timer_expiry = Timestamp();
+    } else if (old_schedpos1 > 0) {
+	remove_heap<4>(_timer_heap.begin(), _timer_heap.end(),
+		       _timer_heap.begin() + old_schedpos1 - 1,
+		       heap_less(), heap_place());
+	_timer_heap.pop_back();
+	if (old_schedpos1 == 1)
+	    set_timer_expiry();
+    } else if (old_schedpos1 < 0)
+	_timer_runchunk[-old_schedpos1 - 1] = 0;
+    t->_schedpos1 = 0;
+    unlock_timers();
+}
+
+/* The timing wheel is a hashed hierarchical wheel in the style of Varghese
+   and Lauck. Level 0 has one slot per tick; a level-L slot covers
+   wheel_size^L ticks. A timer is placed in the lowest level whose span
+   covers its distance from _wheel_base, and is cascaded into lower levels
+   as _wheel_base reaches the start of its slot. Timers expiring before
+   _wheel_base live in the current level-0 slot. Scheduling and
+   unscheduling are O(1); _timer_expiry is a lower bound on the next
+   expiry rather than its exact value. */
+
+void
+TimerSet::wheel_place(Timer *t)
+{
+    uint64_t expires = wheel_tick(t->_expiry_s);
+    if (expires < _wheel_base)
+	expires = _wheel_base;
+    uint64_t delta = expires - _wheel_base;
+    int level = 0;
+    while (level < wheel_levels - 1
+	   && (delta >> (wheel_bits * (level + 1))) != 0)
+	++level;
+    if (level == wheel_levels - 1
+	&& (delta >> (wheel_bits * level)) > (uint64_t) wheel_mask) {
+	// beyond the wheel's reach: park in the farthest slot, which will
+	// cascade it back up until it comes within range
+	expires = _wheel_base + (((uint64_t) wheel_mask) << (wheel_bits * level));
+    }
+    int pos = level * wheel_size
+	+ ((expires >> (wheel_bits * level)) & wheel_mask);
+    Timer *head = _wheel[pos];
+    t->_wheel_prev = 0;
+    t->_wheel_next = head;
+    if (head)
+	head->_wheel_prev = t;
+    _wheel[pos] = t;
+    t->_schedpos1 = pos + 1;
+    ++_wheel_level_count[level];
+    ++_wheel_count;
+}
+
+void
+TimerSet::wheel_remove(Timer *t)
+{
+    int pos = t->_schedpos1 - 1;
+    if (t->_wheel_prev)
+	t->_wheel_prev->_wheel_next = t->_wheel_next;
+    else
+	_wheel[pos] = t->_wheel_next;
+    if (t->_wheel_next)
+	t->_wheel_next->_wheel_prev = t->_wheel_prev;
+    --_wheel_level_count[pos >> wheel_bits];
+    --_wheel_count;
+}
+
+void
+TimerSet::wheel_cascade(int level, unsigned slot)
+{
+    int pos = level * wheel_size + slot;
+    Timer *t = _wheel[pos];
+    _wheel[pos] = 0;
+    while (t) {
+	Timer *next = t->_wheel_next;
+	--_wheel_level_count[level];
+	--_wheel_count;
+	wheel_place(t);
+	t = next;
+    }
+}
+
+Timer *
+TimerSet::wheel_first() const
+{
+    for (int level = 0; level < wheel_levels; ++level)
+	if (_wheel_level_count[level]) {
+	    unsigned start = _wheel_base >> (wheel_bits * level);
+	    Timer **slots = _wheel + level * wheel_size;
+	    for (unsigned i = 0; i < wheel_size; ++i)
+		if (Timer *t = slots[(start + i) & wheel_mask])
+		    return t;
+	}
+    return 0;
+}
+
+void
+TimerSet::set_wheel_expiry()
+{
+    if (!_wheel_count) {
+	_timer_expiry = Timestamp();
+	return;
+    }
+
+    // Level-0 slots up to the next cascade hold the earliest timers.
+    unsigned start = _wheel_base & wheel_mask;
+    unsigned n = wheel_size;
+    if (_wheel_count != _wheel_level_count[0])
+	n -= start;
+    if (_wheel_level_count[0])
+	for (unsigned i = 0; i < n; ++i)
+	    if (Timer *t = _wheel[(start + i) & wheel_mask]) {
+		Timestamp e = t->_expiry_s;
+		for (t = t->_wheel_next; t; t = t->_wheel_next)
+		    if (t->_expiry_s < e)
+			e = t->_expiry_s;
+		_timer_expiry = e;
+		return;
+	    }
+
+    // Otherwise wake up for the next cascade that might produce timers.
+    int level = 1;
+    while (!_wheel_level_count[0] && !_wheel_level_count[level])
+	++level;
+    uint64_t mask = ((uint64_t) 1 << (wheel_bits * level)) - 1;
+    _timer_expiry = wheel_time((_wheel_base | mask) + 1);
+}
+
 inline void
 TimerSet::run_one_timer(Timer *t)
 {
@@ -111,89 +340,195 @@ TimerSet::run_one_timer(Timer *t)
 }
 
 void
-TimerSet::run_timers(RouterThread *thread, Master *master)
+TimerSet::run_heap_timers(RouterThread *thread)
 {
-    if (!_timer_lock.attempt())
-	return;
-    if (!master->paused() && _timer_heap.size() > 0 && !thread->stop_flag()) {
-	thread->set_thread_state(RouterThread::S_RUNTIMER);
-#if CLICK_LINUXMODULE
-	_timer_task = current;
-#elif HAVE_MULTITHREAD
-	_timer_processor = click_current_processor();
-#endif
-	_timer_check = Timestamp::now_steady();
-	heap_element *th = _timer_heap.begin();
-
-	if (th->expiry_s <= _timer_check) {
-	    // potentially adjust timer stride
-	    Timestamp adj_expiry = th->expiry_s + Timer::adjustment();
-	    if (adj_expiry <= _timer_check) {
-		_timer_count = 0;
-		if (_timer_stride > 1)
-		    _timer_stride = (_timer_stride * 4) / 5;
-	    } else if (++_timer_count >= 12) {
-		_timer_count = 0;
-		if (++_timer_stride >= _max_timer_stride)
-		    _timer_stride = _max_timer_stride;
-	    }
+    heap_element *th = _timer_heap.begin();
 
-	    // actually run timers
-	    int max_timers = 64;
+    if (th->expiry_s <= _timer_check) {
+	// potentially adjust timer stride
+	Timestamp adj_expiry = th->expiry_s + Timer::adjustment();
+	if (adj_expiry <= _timer_check) {
+	    _timer_count = 0;
+	    if (_timer_stride > 1)
+		_timer_stride = (_timer_stride * 4) / 5;
+	} else if (++_timer_count >= 12) {
+	    _timer_count = 0;
+	    if (++_timer_stride >= _max_timer_stride)
+		_timer_stride = _max_timer_stride;
+	}
+
+	// actually run timers
+	int max_timers = 64;
+	do {
+	    Timer *t = th->t;
+	    assert(t->expiry_steady() == th->expiry_s);
+	    pop_heap<4>(_timer_heap.begin(), _timer_heap.end(), heap_less(), heap_place());
+	    _timer_heap.pop_back();
+	    set_timer_expiry();
+	    t->_schedpos1 = 0;
+
+	    run_one_timer(t);
+	} while (_timer_heap.size() > 0 && !thread->stop_flag()
+		 && (th = _timer_heap.begin(), th->expiry_s <= _timer_check)
+		 && --max_timers >= 0);
+
+	// If we ran out of timers to run, then perhaps there's an
+	// infinite timer loop or one timer is very far behind system
+	// time.  Eventually the system would catch up and run all timers,
+	// but in the meantime other timers could starve.  We detect this
+	// case and run ALL expired timers, reducing possible damage.
+	if (max_timers < 0 && !thread->stop_flag()) {
+	    _timer_runchunk.reserve(32);
 	    do {
 		Timer *t = th->t;
-		assert(t->expiry_steady() == th->expiry_s);
 		pop_heap<4>(_timer_heap.begin(), _timer_heap.end(), heap_less(), heap_place());
 		_timer_heap.pop_back();
-		set_timer_expiry();
-		t->_schedpos1 = 0;
-
-		run_one_timer(t);
-	    } while (_timer_heap.size() > 0 && !thread->stop_flag()
-		     && (th = _timer_heap.begin(), th->expiry_s <= _timer_check)
-		     && --max_timers >= 0);
-
-	    // If we ran out of timers to run, then perhaps there's an
-	    // infinite timer loop or one timer is very far behind system
-	    // time.  Eventually the system would catch up and run all timers,
-	    // but in the meantime other timers could starve.  We detect this
-	    // case and run ALL expired timers, reducing possible damage.
-	    if (max_timers < 0 && !thread->stop_flag()) {
-		_timer_runchunk.reserve(32);
-		do {
-		    Timer *t = th->t;
-		    pop_heap<4>(_timer_heap.begin(), _timer_heap.end(), heap_less(), heap_place());
-		    _timer_heap.pop_back();
-		    t->_schedpos1 = -_timer_runchunk.size() - 1;
-
-		    _timer_runchunk.push_back(t);
-		} while (_timer_heap.size() > 0
-			 && (th = _timer_heap.begin(), th->expiry_s <= _timer_check));
-		set_timer_expiry();
-
-		Vector<Timer*>::iterator i = _timer_runchunk.begin();
-		for (; !thread->stop_flag() && i != _timer_runchunk.end(); ++i)
-		    if (*i) {
-			(*i)->_schedpos1 = 0;
-			run_one_timer(*i);
-		    }
-
-		// reschedule unrun timers if stopped early
-		for (; i != _timer_runchunk.end(); ++i)
-		    if (*i) {
-			(*i)->_schedpos1 = 0;
-			(*i)->schedule_at_steady((*i)->_expiry_s);
-		    }
-		_timer_runchunk.clear();
+		t->_schedpos1 = -_timer_runchunk.size() - 1;
+
+		_timer_runchunk.push_back(t);
+	    } while (_timer_heap.size() > 0
+		     && (th = _timer_heap.begin(), th->expiry_s <= _timer_check));
+	    set_timer_expiry();
+
+	    Vector<Timer*>::iterator i = _timer_runchunk.begin();
+	    for (; !thread->stop_flag() && i != _timer_runchunk.end(); ++i)
+		if (*i) {
+		    (*i)->_schedpos1 = 0;
+		    run_one_timer(*i);
+		}
+
+	    // reschedule unrun timers if stopped early
+	    for (; i != _timer_runchunk.end(); ++i)
+		if (*i) {
+		    (*i)->_schedpos1 = 0;
+		    schedule_timer(*i, (*i)->_expiry_s);
+		}
+	    _timer_runchunk.clear();
+	}
+    }
+}
+
+void
+TimerSet::run_wheel_timers(RouterThread *thread)
+{
+    // Move every expired timer onto the runchunk, advancing _wheel_base to
+    // the current tick. Empty stretches of the wheel are skipped a whole
+    // slot span at a time.
+    uint64_t now_tick = wheel_tick(_timer_check);
+    Timestamp first_expiry;
+    _timer_runchunk.reserve(32);
+    while (1) {
+	Timer **slotp = &_wheel[_wheel_base & wheel_mask];
+	for (Timer *t = *slotp, *next; t; t = next) {
+	    next = t->_wheel_next;
+	    if (t->_expiry_s <= _timer_check) {
+		wheel_remove(t);
+		t->_schedpos1 = -_timer_runchunk.size() - 1;
+		_timer_runchunk.push_back(t);
+		if (!first_expiry || t->_expiry_s < first_expiry)
+		    first_expiry = t->_expiry_s;
 	    }
 	}
+	if (_wheel_base >= now_tick)
+	    break;
+	if (!_wheel_count) {
+	    _wheel_base = now_tick;
+	    break;
+	}
+
+	int level = 0;
+	while (!_wheel_level_count[level])
+	    ++level;
+	uint64_t mask = ((uint64_t) 1 << (wheel_bits * level)) - 1;
+	uint64_t next_base = (_wheel_base | mask) + 1;
+	if (next_base > now_tick)
+	    _wheel_base = now_tick;
+	else {
+	    _wheel_base = next_base;
+	    for (level = 1; level < wheel_levels
+		     && !(next_base & ((uint64_t) wheel_mask << (wheel_bits * (level - 1))));
+		 ++level)
+		wheel_cascade(level, (next_base >> (wheel_bits * level)) & wheel_mask);
+	}
+    }
+    set_wheel_expiry();
+
+    if (!_timer_runchunk.size())
+	return;
+
+    // potentially adjust timer stride
+    if (first_expiry + Timer::adjustment() <= _timer_check) {
+	_timer_count = 0;
+	if (_timer_stride > 1)
+	    _timer_stride = (_timer_stride * 4) / 5;
+    } else if (++_timer_count >= 12) {
+	_timer_count = 0;
+	if (++_timer_stride >= _max_timer_stride)
+	    _timer_stride = _max_timer_stride;
+    }
 
+    // Timers within a tick run in no particular order.
+    Vector<Timer*>::iterator i = _timer_runchunk.begin();
+    for (; !thread->stop_flag() && i != _timer_runchunk.end(); ++i)
+	if (*i) {
+	    (*i)->_schedpos1 = 0;
+	    run_one_timer(*i);
+	}
+
+    // reschedule unrun timers if stopped early
+    for (; i != _timer_runchunk.end(); ++i)
+	if (*i) {
+	    (*i)->_schedpos1 = 0;
+	    schedule_timer(*i, (*i)->_expiry_s);
+	}
+    _timer_runchunk.clear();
+}
+
+void
+TimerSet::run_timers_locked(RouterThread *thread, const Timestamp &now)
+{
+    thread->set_thread_state(RouterThread::S_RUNTIMER);
 #if CLICK_LINUXMODULE
-	_timer_task = 0;
+    _timer_task = current;
 #elif HAVE_MULTITHREAD
-	_timer_processor = click_invalid_processor();
+    _timer_processor = click_current_processor();
 #endif
-    }
+    _timer_check = now;
+
+    if (_wheel)
+	run_wheel_timers(thread);
+    else
+	run_heap_timers(thread);
+
+#if CLICK_LINUXMODULE
+    _timer_task = 0;
+#elif HAVE_MULTITHREAD
+    _timer_processor = click_invalid_processor();
+#endif
+}
+
+void
+TimerSet::run_timers(RouterThread *thread, Master *master)
+{
+    if (!_timer_lock.attempt())
+	return;
+    if (!master->paused() && (_timer_heap.size() > 0 || _wheel_count > 0)
+	&& !thread->stop_flag())
+	run_timers_locked(thread, Timestamp::now_steady());
+    _timer_lock.release();
+}
+
+/** @brief Run the timers that expire at or before @a now.
+ *
+ * Like run_timers(), but against a caller-supplied clock. Useful for
+ * benchmarking a TimerSet that does not belong to a running thread. */
+void
+TimerSet::run_timers_until(RouterThread *thread, const Timestamp &now)
+{
+    if (!_timer_lock.attempt())
+	return;
+    if ((_timer_heap.size() > 0 || _wheel_count > 0) && !thread->stop_flag())
+	run_timers_locked(thread, now);
     _timer_lock.release();
 }
 
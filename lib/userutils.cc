@@ -750,6 +750,10 @@ compressed_data(const unsigned char *buf, int len)
 	if (len >= 10 && memcmp(buf + 4, "1AY&SY", 6) == 0)
 	    return true;
     }
+    // check for zstd signature
+    if (len >= 4 && buf[0] == 0x28 && buf[1] == 0xB5 && buf[2] == 0x2F
+	&& buf[3] == 0xFD)
+	return true;
     // otherwise unknown
     return false;
 }
@@ -761,6 +765,8 @@ open_uncompress_pipe(const String &filename, const unsigned char *buf, int len,
     StringAccum cmd;
     if (buf[0] == 'B')
 	cmd << "bzcat";
+    else if (buf[0] == 0x28)
+	cmd << "zstd -dc";
     else if (access("/usr/bin/gzcat", X_OK) >= 0)
 	cmd << "/usr/bin/gzcat";
     else
@@ -775,7 +781,7 @@ open_uncompress_pipe(const String &filename, const unsigned char *buf, int len,
 }
 
 enum {
-    COMP_COMPRESS = 1, COMP_GZIP = 2, COMP_BZ2 = 3
+    COMP_COMPRESS = 1, COMP_GZIP = 2, COMP_BZ2 = 3, COMP_ZSTD = 4
 };
 
 int
@@ -787,6 +793,8 @@ compressed_filename(const String &filename)
 	return COMP_GZIP;
     else if (filename.length() >= 4 && memcmp(filename.end() - 4, ".bz2", 4) == 0)
 	return COMP_BZ2;
+    else if (filename.length() >= 4 && memcmp(filename.end() - 4, ".zst", 4) == 0)
+	return COMP_ZSTD;
     else
 	return 0;
 }
@@ -806,6 +814,9 @@ open_compress_pipe(const String &filename, ErrorHandler *errh)
       case COMP_BZ2:
 	cmd << "bzip2";
 	break;
+      case COMP_ZSTD:
+	cmd << "zstd -q";
+	break;
       default:
 	errh->error("%s: unknown compression extension", filename.c_str());
 	errno = EINVAL;
@@ -0,0 +1,159 @@
+/*
+ * click-pcapindex.cc -- build FromDump's timestamp indexes ahead of time
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+
+#include <click/error.hh>
+#include <click/driver.hh>
+#include <click/pcapindex.hh>
+#include <click/clp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define HELP_OPT		300
+#define VERSION_OPT		301
+#define INTERVAL_OPT		302
+#define FORCE_OPT		303
+#define VERBOSE_OPT		304
+
+static const Clp_Option options[] = {
+  { "force", 'f', FORCE_OPT, 0, Clp_Negate },
+  { "help", 0, HELP_OPT, 0, 0 },
+  { "interval", 'i', INTERVAL_OPT, Clp_ValUnsigned, 0 },
+  { "verbose", 'V', VERBOSE_OPT, 0, Clp_Negate },
+  { "version", 'v', VERSION_OPT, 0, 0 },
+};
+
+static const char *program_name;
+
+void
+short_usage()
+{
+  fprintf(stderr, "Usage: %s [OPTION]... TRACEFILE...\n\
+Try '%s --help' for more information.\n",
+	  program_name, program_name);
+}
+
+void
+usage()
+{
+  printf("\
+'Click-pcapindex' builds the timestamp indexes that FromDump(INDEX true) uses\n\
+to seek in tcpdump files, and stores each beside its trace as TRACEFILE.idx.\n\
+Up-to-date indexes are left alone.\n\
+\n\
+Usage: %s [OPTION]... TRACEFILE...\n\
+\n\
+Options:\n\
+  -i, --interval BYTES      Index a packet about every BYTES bytes.\n\
+                            Default is %d.\n\
+  -f, --force               Rebuild indexes even if they are up to date.\n\
+  -V, --verbose             Report on each index.\n\
+      --help                Print this message and exit.\n\
+  -v, --version             Print version number and exit.\n\
+\n\
+Report bugs to <click@pdos.lcs.mit.edu>.\n", program_name, (int) PcapIndex::DEFAULT_INTERVAL);
+}
+
+int
+main(int argc, char **argv)
+{
+  click_static_initialize();
+  ErrorHandler *errh = ErrorHandler::default_handler();
+  ErrorHandler *p_errh = new PrefixErrorHandler(errh, "click-pcapindex: ");
+
+  // read command line arguments
+  Clp_Parser *clp =
+    Clp_NewParser(argc, argv, sizeof(options) / sizeof(options[0]), options);
+  program_name = Clp_ProgramName(clp);
+
+  Vector<String> files;
+  unsigned interval = PcapIndex::DEFAULT_INTERVAL;
+  bool force = false;
+  bool verbose = false;
+
+  while (1) {
+    int opt = Clp_Next(clp);
+    switch (opt) {
+
+     case HELP_OPT:
+      usage();
+      exit(0);
+      break;
+
+     case VERSION_OPT:
+      printf("click-pcapindex (Click) %s\n", CLICK_VERSION);
+      printf("This is free software; see the source for copying conditions.\n\
+There is NO warranty, not even for merchantability or fitness for a\n\
+particular purpose.\n");
+      exit(0);
+      break;
+
+     case INTERVAL_OPT:
+      interval = clp->val.u;
+      break;
+
+     case FORCE_OPT:
+      force = !clp->negated;
+      break;
+
+     case VERBOSE_OPT:
+      verbose = !clp->negated;
+      break;
+
+     case Clp_NotOption:
+      files.push_back(clp->vstr);
+      break;
+
+     case Clp_BadOption:
+      short_usage();
+      exit(1);
+      break;
+
+     case Clp_Done:
+      goto done;
+
+    }
+  }
+
+ done:
+  if (!files.size()) {
+    p_errh->error("no trace files specified");
+    short_usage();
+    exit(1);
+  }
+
+  for (int i = 0; i < files.size(); i++) {
+    PcapIndex index;
+    int r = (force ? 0 : index.load(files[i], errh));
+    if (r < 0)
+      continue;
+    else if (r == 0) {
+      if (index.build(files[i], interval, errh) < 0)
+	continue;
+      if (int err = index.save()) {
+	errh->error("%s: %s", PcapIndex::index_filename(files[i]).c_str(), strerror(-err));
+	continue;
+      }
+    }
+    if (verbose)
+      fprintf(stderr, "%s: %s, %d entries\n",
+	      PcapIndex::index_filename(files[i]).c_str(),
+	      r ? "up to date" : "written", index.nentries());
+  }
+
+  return (errh->nerrors() > 0 ? 1 : 0);
+}
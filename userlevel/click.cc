@@ -73,26 +73,40 @@ CLICK_USING_DECLS
 #define THREADS_OPT		316
 #define SIMTIME_OPT		317
 #define SOCKET_OPT		318
+#define PACKET_POOL_SIZE_OPT	319
+#define PREWARM_POOL_OPT	320
+#define EPOLL_OPT		321
+#define TIMER_WHEEL_OPT		322
+#define WORK_STEALING_OPT	323
+#define CPUS_OPT		324
+#define AFFINITY_OPT		325
 
 static const Clp_Option options[] = {
+    { "affinity", 0, AFFINITY_OPT, 0, Clp_Negate },
     { "allow-reconfigure", 'R', ALLOW_RECONFIG_OPT, 0, Clp_Negate },
     { "clickpath", 'C', CLICKPATH_OPT, Clp_ValString, 0 },
+    { "cpus", 0, CPUS_OPT, Clp_ValString, 0 },
     { "expression", 'e', EXPRESSION_OPT, Clp_ValString, 0 },
     { "file", 'f', ROUTER_OPT, Clp_ValString, 0 },
     { "handler", 'h', HANDLER_OPT, Clp_ValString, 0 },
     { "help", 0, HELP_OPT, 0, 0 },
     { "output", 'o', OUTPUT_OPT, Clp_ValString, 0 },
+    { "packet-pool-size", 0, PACKET_POOL_SIZE_OPT, Clp_ValUnsigned, 0 },
     { "socket", 0, SOCKET_OPT, Clp_ValInt, 0 },
     { "port", 'p', PORT_OPT, Clp_ValString, 0 },
+    { "prewarm-packet-pool", 0, PREWARM_POOL_OPT, 0, Clp_Negate },
     { "quit", 'q', QUIT_OPT, 0, 0 },
     { "simtime", 0, SIMTIME_OPT, Clp_ValDouble, Clp_Optional },
     { "simulation-time", 0, SIMTIME_OPT, Clp_ValDouble, Clp_Optional },
     { "threads", 'j', THREADS_OPT, Clp_ValInt, 0 },
     { "time", 't', TIME_OPT, 0, 0 },
+    { "timer-wheel", 0, TIMER_WHEEL_OPT, Clp_ValString, Clp_Optional | Clp_Negate },
     { "unix-socket", 'u', UNIX_SOCKET_OPT, Clp_ValString, 0 },
     { "version", 'v', VERSION_OPT, 0, 0 },
     { "warnings", 0, WARNINGS_OPT, 0, Clp_Negate },
+    { "work-stealing", 0, WORK_STEALING_OPT, 0, Clp_Negate },
     { "exit-handler", 'x', EXIT_HANDLER_OPT, Clp_ValString, 0 },
+    { "epoll", 0, EPOLL_OPT, Clp_ValString, Clp_Optional | Clp_Negate },
     { 0, 'w', NO_WARNINGS_OPT, 0, Clp_Negate },
 };
 
@@ -120,6 +134,19 @@ Options:\n\
   -f, --file FILE               Read router configuration from FILE.\n\
   -e, --expression EXPR         Use EXPR as router configuration.\n\
   -j, --threads N               Start N threads (default 1).\n\
+      --work-stealing           Let idle threads take migratable tasks from\n\
+                                busy threads.\n\
+      --affinity                Bind each thread to its own CPU.\n\
+      --cpus LIST               Bind threads to the CPUs in LIST, such as\n\
+                                0-3,8 (implies --affinity).\n\
+      --packet-pool-size N      Cache up to N free packets per thread.\n\
+      --prewarm-packet-pool     Fill packet pools when threads start.\n\
+      --epoll[=edge], --no-epoll\n\
+                                Wait for file descriptors with epoll (the\n\
+                                default where available), optionally\n\
+                                edge-triggered.\n\
+      --timer-wheel[=TICK]      Keep timers in a timing wheel with TICK\n\
+                                granularity (default 1ms) instead of a heap.\n\
   -p, --port PORT               Listen for control connections on TCP port.\n\
   -u, --unix-socket FILE        Listen for control connections on Unix socket.\n\
       --socket FD               Add a file descriptor control connection.\n\
@@ -295,6 +322,10 @@ static Vector<String> cs_ports;
 static Vector<String> cs_sockets;
 static bool warnings = true;
 static int nthreads = 1;
+static unsigned packet_pool_size = 0;
+static bool prewarm_packet_pool = false;
+static bool thread_affinity = false;
+static Vector<int> thread_cpus;
 
 static String
 click_driver_control_socket_name(int number)
@@ -314,6 +345,14 @@ parse_configuration(const String &text, bool text_is_expr, bool hotswap,
 	master = router->master();
     else
 	master = new_master = new Master(nthreads);
+    if (new_master && thread_affinity) {
+	if (!thread_cpus.size() && !Master::available_cpus(thread_cpus))
+	    errh->warning("cannot determine available CPUs, threads not bound");
+	if (new_master->set_thread_cpus(thread_cpus, errh) < 0) {
+	    delete new_master;
+	    return 0;
+	}
+    }
 
     Router *r = click_read_router(text, text_is_expr, errh, false, master);
     if (!r) {
@@ -564,6 +603,86 @@ main(int argc, char **argv)
 #endif
       break;
 
+     case PACKET_POOL_SIZE_OPT:
+      if (clp->val.u == 0)
+	  goto bad_option;
+      packet_pool_size = clp->val.u;
+      break;
+
+     case PREWARM_POOL_OPT:
+      prewarm_packet_pool = !clp->negated;
+      break;
+
+     case EPOLL_OPT:
+      if (clp->negated)
+	  SelectSet::set_epoll_mode(SelectSet::epoll_off);
+      else if (!clp->have_val || strcmp(clp->vstr, "level") == 0)
+	  SelectSet::set_epoll_mode(SelectSet::epoll_level);
+      else if (strcmp(clp->vstr, "edge") == 0)
+	  SelectSet::set_epoll_mode(SelectSet::epoll_edge);
+      else {
+	  errh->error("%<--epoll%> should be %<level%> or %<edge%>");
+	  goto bad_option;
+      }
+      break;
+
+     case TIMER_WHEEL_OPT: {
+      uint32_t tick_usec = 1000;
+      if (clp->negated)
+	  tick_usec = 0;
+      else if (clp->have_val
+	       && (!SecondsArg(6).parse(clp->vstr, tick_usec) || tick_usec == 0)) {
+	  errh->error("%<--timer-wheel%> should be a positive time");
+	  goto bad_option;
+      }
+      TimerSet::set_default_wheel_tick(tick_usec);
+      break;
+     }
+
+     case AFFINITY_OPT:
+      thread_affinity = !clp->negated;
+      break;
+
+     case CPUS_OPT: {
+      // LIST is a comma-separated list of CPU numbers and ranges.
+      thread_cpus.clear();
+      const char *s = clp->vstr;
+      while (1) {
+	  char *end;
+	  long first = strtol(s, &end, 10), last = first;
+	  if (end == s || first < 0 || first > 65535)
+	      break;
+	  if (*end == '-') {
+	      s = end + 1;
+	      last = strtol(s, &end, 10);
+	      if (end == s || last < first || last > 65535)
+		  break;
+	  }
+	  for (long c = first; c <= last; ++c)
+	      thread_cpus.push_back(c);
+	  if (*end != ',') {
+	      s = end;
+	      break;
+	  }
+	  s = end + 1;
+      }
+      if (*s || !thread_cpus.size()) {
+	  errh->error("%<--cpus%> should be a list of CPUs, such as %<0-3,8%>");
+	  goto bad_option;
+      }
+      thread_affinity = true;
+      break;
+     }
+
+     case WORK_STEALING_OPT:
+#if HAVE_MULTITHREAD
+      RouterThread::set_work_stealing(!clp->negated);
+#else
+      if (!clp->negated)
+	  errh->warning("Click was built without multithread support, ignoring %<--work-stealing%>");
+#endif
+      break;
+
     case SIMTIME_OPT: {
 	Timestamp::warp_set_class(Timestamp::warp_simulation);
 	Timestamp simbegin(clp->have_val ? clp->val.d : 1000000000);
@@ -606,6 +725,10 @@ particular purpose.\n");
   // provide hotconfig handler if asked
   if (allow_reconfigure)
       Router::add_write_handler(0, "hotconfig", hotconfig_handler, 0, Handler::RAW | Handler::NONEXCLUSIVE);
+#if HAVE_CLICK_PACKET_POOL
+  if (packet_pool_size || prewarm_packet_pool)
+      Packet::set_pool_size(packet_pool_size, prewarm_packet_pool);
+#endif
   Router::add_read_handler(0, "timewarp", timewarp_read_handler, 0);
   if (Timestamp::warp_class() != Timestamp::warp_simulation)
       Router::add_write_handler(0, "timewarp", timewarp_write_handler, 0);